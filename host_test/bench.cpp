@@ -0,0 +1,568 @@
+// Host microbenchmarks: decoder throughput on synthesized bus captures, the
+// schedule scan against its event count, status and schedule serialization,
+// AuditLogger::logEvent, JSON against CBOR per API endpoint, and OTA upload
+// throughput. The results are one JSON document on stdout (or in the file
+// given as argument), so runs can be compared between commits.
+//
+//   bench [--quick] [results.json]
+//
+// Each case runs a calibrated number of iterations REPEATS times and keeps
+// the fastest repetition. Heap allocations are counted by the operator new
+// below, on the benchmark thread only. --quick runs every case once, as a
+// smoke test for ctest. With cJSON installed (PURESPA_BENCH_CJSON), the
+// serializers also run through the cJSON path the handlers used before.
+#include "test_util.h"
+#include "host_gpio.h"
+#include "host_httpd.h"
+#include "host_ota.h"
+#include "host_system.h"
+#include "PureSpaIO.h"
+#include "PureSpaService.h"
+#include "ReplayBusBackend.h"
+#include "GpioBusBackend.h"
+#include "AuditLogger.h"
+#include "json_writer.h"
+#include "cbor_writer.h"
+#include "web_server.h"
+#ifdef PURESPA_BENCH_CJSON
+#include "cJSON.h"
+#endif
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+
+static thread_local bool t_counting = false;
+static thread_local uint64_t t_allocs = 0;
+static thread_local uint64_t t_allocBytes = 0;
+
+void* operator new(size_t size)
+{
+    if (t_counting) {
+        t_allocs++;
+        t_allocBytes += size;
+    }
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+#ifdef PURESPA_BENCH_CJSON
+// cJSON allocates through its hooks, not operator new
+static void* countingMalloc(size_t size)
+{
+    if (t_counting) {
+        t_allocs++;
+        t_allocBytes += size;
+    }
+    return malloc(size);
+}
+#endif
+
+static const int REPEATS = 5;
+static bool s_quick = false;
+
+struct Measurement {
+    uint64_t iterations;
+    double ns;          // per iteration, fastest repetition
+    double allocs;      // per iteration
+    double allocBytes;  // per iteration
+};
+
+static uint64_t nowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Doubles the iteration count until one repetition takes minNs, then keeps
+// the fastest of REPEATS repetitions
+template<typename F>
+static Measurement measure(F&& op, uint64_t minNs = 20000000)
+{
+    uint64_t iterations = 1;
+    if (!s_quick) {
+        while (true) {
+            uint64_t start = nowNs();
+            for (uint64_t i = 0; i < iterations; i++) op();
+            if (nowNs() - start >= minNs / 4) break;
+            iterations *= 2;
+        }
+        iterations *= 4;
+    }
+
+    Measurement m = { iterations, 0, 0, 0 };
+    uint64_t best = UINT64_MAX;
+    t_allocs = t_allocBytes = 0;
+    int repeats = s_quick ? 1 : REPEATS;
+    for (int r = 0; r < repeats; r++) {
+        t_counting = true;
+        uint64_t start = nowNs();
+        for (uint64_t i = 0; i < iterations; i++) op();
+        uint64_t elapsed = nowNs() - start;
+        t_counting = false;
+        if (elapsed < best) best = elapsed;
+    }
+    m.ns = (double)best / iterations;
+    m.allocs = (double)t_allocs / (iterations * repeats);
+    m.allocBytes = (double)t_allocBytes / (iterations * repeats);
+    return m;
+}
+
+// DocWriter only takes integers: fractions are reported in thousandths
+static long long milli(double v)
+{
+    return (long long)(v * 1000 + 0.5);
+}
+
+static void writeMeasurement(DocWriter& w, const Measurement& m)
+{
+    w.field("iterations", (long long)m.iterations)
+        .field("ns", (long long)(m.ns + 0.5))
+        .field("allocs_milli", milli(m.allocs))
+        .field("alloc_bytes", (long long)(m.allocBytes + 0.5));
+}
+
+// Hands the decoder's edge handler to the benchmark instead of a task
+class TraceBackend : public BusBackend {
+public:
+    const char* getName() const override { return "bench"; }
+    bool start(EdgeHandler h, void* c) override { handler = h; ctx = c; return true; }
+    void stop() override {}
+    void pullDataLow() override {}
+
+    // Same bit order and cut frame handling as ReplayBusBackend::deliver
+    void play(const std::vector<ReplayBusBackend::Frame>& frames)
+    {
+        for (const ReplayBusBackend::Frame& frame : frames) {
+            for (unsigned int i = 0; i < frame.bits; i++) {
+                handler(ctx, (frame.value >> (15 - i)) & 1, true);
+            }
+            if (frame.bits < 16) handler(ctx, false, false);
+        }
+    }
+
+    EdgeHandler handler = nullptr;
+    void* ctx = nullptr;
+};
+
+static void benchDecoder(DocWriter& w)
+{
+    static const char* const TRACES[] = { "steady", "error", "noisy" };
+    static PureSpaIO io;
+    static TraceBackend backend;
+    io.setup(LANG::EN, backend);
+
+    w.beginArray("decoder");
+    for (const char* name : TRACES) {
+        std::string path = std::string(PURESPA_BENCH_TRACE_DIR "/") + name + ".txt";
+        ReplayBusBackend replay(0, 0);
+        CHECK(replay.load(path.c_str()));
+        const std::vector<ReplayBusBackend::Frame>& frames = replay.getFrames();
+        uint64_t edges = 0;
+        for (const ReplayBusBackend::Frame& frame : frames) edges += frame.bits + (frame.bits < 16 ? 1 : 0);
+
+        PureSpaIO::BusCounters before = io.getBusCounters();
+        backend.play(frames);
+        PureSpaIO::BusCounters after = io.getBusCounters();
+        CHECK(after.validFrames > before.validFrames);
+
+        Measurement m = measure([&] { backend.play(frames); });
+        w.beginObject()
+            .field("trace", name)
+            .field("frames", (long long)frames.size())
+            .field("edges", (long long)edges)
+            .field("valid_frames", (long long)(after.validFrames - before.validFrames))
+            .field("invalid_frames", (long long)(after.invalidFrames - before.invalidFrames));
+        writeMeasurement(w, m);
+        w.field("ns_per_frame_milli", milli(m.ns / frames.size()))
+            .field("frames_per_s", (long long)(frames.size() * 1e9 / m.ns))
+            .endObject();
+    }
+    w.endArray();
+}
+
+// The same captures through GpioBusBackend's interrupt handler, fired by the
+// GPIO shim, with the backend's own cycle accounting: what the ISR costs
+// between its cycle count reads, register read and decoder included
+static void benchGpioEdge(DocWriter& w)
+{
+    static const gpio_num_t CLOCK = GPIO_NUM_18, DATA = GPIO_NUM_19, LATCH = GPIO_NUM_21;
+    static PureSpaIO io;
+    static GpioBusBackend<PureSpaIO> bus(CLOCK, DATA, LATCH);
+    io.setup(LANG::EN, bus);
+
+    ReplayBusBackend replay(0, 0);
+    CHECK(replay.load(PURESPA_BENCH_TRACE_DIR "/steady.txt"));
+    // Pin levels per edge, computed up front: DATA and LATCH are active low
+    std::vector<uint32_t> levels;
+    for (const ReplayBusBackend::Frame& frame : replay.getFrames()) {
+        for (unsigned int i = 0; i < frame.bits; i++) {
+            bool data = (frame.value >> (15 - i)) & 1;
+            levels.push_back(data ? ~(1UL << DATA) : ~0UL);
+        }
+    }
+    auto play = [&] {
+        for (uint32_t level : levels) {
+            host_gpio_set_inputs(level & ~(1UL << LATCH));
+            host_gpio_edge(CLOCK);
+        }
+    };
+
+    play();
+    bus.takeEdgeCost();
+    int repeats = s_quick ? 1 : REPEATS;
+    BusBackend::EdgeCost best = {};
+    for (int r = 0; r < repeats; r++) {
+        play();
+        BusBackend::EdgeCost cost = bus.takeEdgeCost();
+        if (r == 0 || cost.cyclesSum < best.cyclesSum) best = cost;
+    }
+    CHECK(best.calls == levels.size());
+    w.beginObject("gpio_edge")
+        .field("edges", (long long)best.calls)
+        .field("cycles_milli", milli((double)best.cyclesSum / best.calls))
+        .field("cycles_min", (long long)best.cyclesMin)
+        .field("cycles_max", (long long)best.cyclesMax)
+        .endObject();
+}
+
+static esp_err_t discardSink(void* ctx, const char* data, size_t len)
+{
+    *static_cast<size_t*>(ctx) += len;
+    return ESP_OK;
+}
+
+static ScheduledEvent benchEvent(const tm& now)
+{
+    // Due this minute but not today, so the scan looks at every field and
+    // nothing triggers
+    ScheduledEvent event = {};
+    event.enabled = true;
+    event.recurring = true;
+    event.dayOfWeekMask = 0x7F & ~(1 << now.tm_wday);
+    event.hour = now.tm_hour;
+    event.minute = now.tm_min;
+    event.setPower = true;
+    event.powerValue = true;
+    event.setTargetTemp = true;
+    event.targetTempValue = 38;
+    return event;
+}
+
+class ServiceBench {
+public:
+    static void scheduleCheck(DocWriter& w)
+    {
+        PureSpaService& service = PureSpaService::getInstance();
+        service.clearSchedule();
+        time_t t = time(nullptr);
+        tm now;
+        localtime_r(&t, &now);
+
+        w.beginArray("schedule_check");
+        for (size_t events = 0; events <= PureSpaService::MAX_EVENTS; events++) {
+            if (events > 0) service.addEvent(benchEvent(now));
+            Measurement m = measure([&] {
+                service._lastCheckedMinute = -1;
+                service.checkSchedule();
+            });
+            CHECK(service._events.size() == events);
+            w.beginObject().field("events", (long long)events);
+            writeMeasurement(w, m);
+            w.endObject();
+        }
+        w.endArray();
+    }
+
+#ifdef PURESPA_BENCH_CJSON
+    // The documents as the handlers built them before JsonWriter: a cJSON
+    // DOM printed unformatted, then copied into the std::string they returned
+    static std::string statusCjson(PureSpaService& service)
+    {
+        const PureSpaService::StatusSnapshot& s = service._status;
+        cJSON* root = cJSON_CreateObject();
+        cJSON_AddNumberToObject(root, "spa", service.getIndex());
+        cJSON_AddBoolToObject(root, "online", s.online);
+        cJSON_AddNumberToObject(root, "act_temp", s.actTemp);
+        cJSON_AddNumberToObject(root, "set_temp", s.setTemp);
+        cJSON_AddBoolToObject(root, "power", s.power == 1);
+        cJSON_AddBoolToObject(root, "filter", s.filter == 1);
+        cJSON_AddBoolToObject(root, "heater", s.heater == 1);
+        cJSON_AddBoolToObject(root, "bubble", s.bubble == 1);
+        cJSON_AddStringToObject(root, "time", s.time);
+        cJSON_AddNumberToObject(root, "free_heap", s.freeHeap);
+        cJSON_AddNumberToObject(root, "min_free_heap", s.minFreeHeap);
+        cJSON_AddNumberToObject(root, "uptime", s.uptime);
+        cJSON_AddNumberToObject(root, "wifi_rssi", s.rssi);
+        cJSON_AddNumberToObject(root, "version", service._statusVersion);
+        char* printed = cJSON_PrintUnformatted(root);
+        std::string json(printed);
+        cJSON_free(printed);
+        cJSON_Delete(root);
+        return json;
+    }
+
+    static std::string scheduleCjson(PureSpaService& service)
+    {
+        std::lock_guard<std::recursive_mutex> lock(service._eventsMutex);
+        cJSON* root = cJSON_CreateArray();
+        for (const ScheduledEvent& ev : service._events) {
+            cJSON* item = cJSON_CreateObject();
+            const uint8_t* base = reinterpret_cast<const uint8_t*>(&ev);
+            for (size_t i = 0; i < SCHEDULED_EVENT_FIELD_COUNT; i++) {
+                const JsonField& f = SCHEDULED_EVENT_FIELDS[i];
+                if (f.type == JsonField::BOOL) {
+                    cJSON_AddBoolToObject(item, f.key, *reinterpret_cast<const bool*>(base + f.offset));
+                } else if (f.type == JsonField::INT) {
+                    int32_t v;
+                    memcpy(&v, base + f.offset, sizeof(v));
+                    cJSON_AddNumberToObject(item, f.key, v);
+                } else {
+                    cJSON_AddStringToObject(item, f.key, reinterpret_cast<const char*>(base + f.offset));
+                }
+            }
+            cJSON_AddItemToArray(root, item);
+        }
+        char* printed = cJSON_PrintUnformatted(root);
+        std::string json(printed);
+        cJSON_free(printed);
+        cJSON_Delete(root);
+        return json;
+    }
+#endif
+
+    // Writer cost alone (status fields, full schedule) in both encodings,
+    // then the status cache refresh the service task does on every change
+    static void serializers(DocWriter& w)
+    {
+        PureSpaService& service = PureSpaService::getInstance();
+        service.refreshStatus(true);
+
+        w.beginArray("serializers");
+#ifdef PURESPA_BENCH_CJSON
+        cJSON_Hooks hooks = { countingMalloc, free };
+        cJSON_InitHooks(&hooks);
+        for (int doc = 0; doc < 2; doc++) {
+            std::string expected;
+            char buf[512];
+            JsonWriter json(buf, sizeof(buf), DocWriter::stringSink, &expected);
+            if (doc == 0) service.writeStatus(json); else service.writeSchedule(json);
+            CHECK(json.finish() == ESP_OK);
+
+            std::string printed;
+            Measurement m = measure([&] { printed = doc == 0 ? statusCjson(service) : scheduleCjson(service); });
+            // Same document, only the way it is built differs
+            CHECK(printed == expected);
+            w.beginObject()
+                .field("doc", doc == 0 ? "status" : "schedule")
+                .field("format", "cjson")
+                .field("bytes", (long long)printed.size());
+            writeMeasurement(w, m);
+            w.endObject();
+        }
+#endif
+        for (int doc = 0; doc < 2; doc++) {
+            for (int cbor = 0; cbor < 2; cbor++) {
+                // Flushed and discarded like the web server's chunk buffer
+                char buf[512];
+                size_t flushed = 0;
+                size_t bytes = 0;
+                Measurement m = measure([&] {
+                    flushed = 0;
+                    JsonWriter json(buf, sizeof(buf), discardSink, &flushed);
+                    CborWriter cborWriter(buf, sizeof(buf), discardSink, &flushed);
+                    DocWriter& out = cbor ? static_cast<DocWriter&>(cborWriter) : json;
+                    if (doc == 0) service.writeStatus(out); else service.writeSchedule(out);
+                    CHECK(out.finish() == ESP_OK);
+                    bytes = flushed;
+                });
+                w.beginObject()
+                    .field("doc", doc == 0 ? "status" : "schedule")
+                    .field("format", cbor ? "cbor" : "json")
+                    .field("bytes", (long long)bytes);
+                writeMeasurement(w, m);
+                w.endObject();
+            }
+        }
+        Measurement m = measure([&] { service.refreshStatus(true); });
+        w.beginObject()
+            .field("doc", "status_refresh")
+            .field("format", "json+cbor")
+            .field("bytes", (long long)(service._statusJsonLen + service._statusCborLen));
+        writeMeasurement(w, m);
+        w.endObject();
+        w.endArray();
+    }
+};
+
+// Each call is timed on its own while the log fills up and then drops its
+// oldest event on every call, the steady state on a device. Costs are
+// averaged per range of events already held.
+static void benchAudit(DocWriter& w)
+{
+    static const size_t RANGES = 3; // below half, half to full, full
+    AuditLogger& logger = AuditLogger::getInstance();
+    double best[RANGES];
+    uint64_t calls[RANGES] = {};
+    uint64_t allocs[RANGES] = {};
+    uint64_t allocBytes[RANGES] = {};
+    for (double& b : best) b = 1e18;
+
+    int repeats = s_quick ? 1 : REPEATS;
+    for (int r = 0; r < repeats; r++) {
+        logger.clearLog();
+        uint64_t sumNs[RANGES] = {};
+        uint64_t count[RANGES] = {};
+        for (size_t i = 0; i < 2 * AuditLogger::MAX_EVENTS; i++) {
+            size_t held = i < AuditLogger::MAX_EVENTS ? i : AuditLogger::MAX_EVENTS;
+            size_t range = held < AuditLogger::MAX_EVENTS / 2 ? 0 : (held < AuditLogger::MAX_EVENTS ? 1 : 2);
+            t_allocs = t_allocBytes = 0;
+            t_counting = true;
+            uint64_t start = nowNs();
+            logger.logEvent("bench", "heater", i % 2);
+            sumNs[range] += nowNs() - start;
+            t_counting = false;
+            allocs[range] += t_allocs;
+            allocBytes[range] += t_allocBytes;
+            count[range]++;
+        }
+        for (size_t k = 0; k < RANGES; k++) {
+            double avg = (double)sumNs[k] / count[k];
+            if (avg < best[k]) best[k] = avg;
+            calls[k] += count[k];
+        }
+    }
+
+    static const char* const NAMES[RANGES] = { "below_half", "half_to_full", "full" };
+    w.beginArray("audit_log");
+    for (size_t k = 0; k < RANGES; k++) {
+        Measurement m = { calls[k], best[k], (double)allocs[k] / calls[k], (double)allocBytes[k] / calls[k] };
+        w.beginObject().field("events_held", NAMES[k]);
+        writeMeasurement(w, m);
+        w.endObject();
+    }
+    w.endArray();
+}
+
+// Whole GET requests through the registered handlers, once per encoding.
+// Runs after the other cases, so the schedule holds MAX_EVENTS events and
+// the audit log is full. Bytes are the response body, headers excluded.
+static void benchEndpoints(DocWriter& w)
+{
+    static const char* const URIS[] = {
+        "/api/status", "/api/bootstrap", "/api/schedule", "/api/admin/audit",
+        "/api/admin/audit/config", "/api/admin/http", "/api/debug/bus", "/api/debug/profile",
+    };
+    WebServer::getInstance().start();
+
+    w.beginArray("endpoints");
+    for (const char* uri : URIS) {
+        w.beginObject().field("uri", uri);
+        for (int cbor = 0; cbor < 2; cbor++) {
+            HostRequestOptions options = {};
+            if (cbor) options.headers.push_back({ "Accept", "application/cbor" });
+            HostResponse response = host_httpd_request(HTTP_GET, uri, std::string(), options);
+            CHECK(response.status == 200);
+            CHECK(response.contentType == (cbor ? "application/cbor" : "application/json"));
+            Measurement m = measure([&] { host_httpd_request(HTTP_GET, uri, std::string(), options); });
+            w.field(cbor ? "cbor_bytes" : "json_bytes", (long long)response.body.size())
+                .field(cbor ? "cbor_ns" : "json_ns", (long long)(m.ns + 0.5));
+        }
+        w.endObject();
+    }
+    w.endArray();
+}
+
+// Plain image uploads through /api/admin/ota into the simulated flash, once
+// with free network and flash (the handler's own overhead) and once with
+// Wi-Fi sized receives and ESP32 like erase and write costs. Each upload
+// schedules a reboot, which the host only counts.
+static void benchOtaUpload(DocWriter& w)
+{
+    struct Case {
+        const char* name;
+        size_t recvChunk;       // bytes per httpd_req_recv(), one TCP segment
+        uint32_t recvDelayUs;   // per httpd_req_recv()
+        uint32_t writeDelayUs;  // per esp_ota_write()
+        uint32_t perKbUs;       // per KiB written
+    };
+    static const Case CASES[] = {
+        { "no_cost", 0, 0, 0, 0 },
+        { "wifi_flash", 1436, 1000, 100, 2000 },
+    };
+    std::string image((s_quick ? 64 : 512) * 1024, '\0');
+    for (size_t i = 0; i < image.size(); i++) image[i] = (char)(i * 31 + (i >> 8));
+    image[0] = (char)0xE9;
+
+    WebServer::getInstance().start();
+    host_restart_set_counting(true);
+    int repeats = s_quick ? 1 : REPEATS;
+    w.beginArray("ota_upload");
+    for (const Case& c : CASES) {
+        HostRequestOptions options = {};
+        options.recvChunk = c.recvChunk;
+        options.recvDelayUs = c.recvDelayUs;
+        uint64_t best = UINT64_MAX;
+        for (int r = 0; r < repeats; r++) {
+            host_ota_reset();
+            host_ota_set_write_cost(c.writeDelayUs, c.perKbUs);
+            uint64_t start = nowNs();
+            HostResponse response = host_httpd_request(HTTP_POST, "/api/admin/ota", image, options);
+            uint64_t elapsed = nowNs() - start;
+            CHECK(response.status == 200);
+            CHECK(host_ota_boot_set() && host_ota_written_image() == image);
+            if (elapsed < best) best = elapsed;
+        }
+        w.beginObject().field("case", c.name)
+            .field("bytes", (long long)image.size())
+            .field("us", (long long)(best / 1000))
+            .field("kib_per_s", (long long)(image.size() / 1024.0 * 1e9 / best + 0.5))
+            .endObject();
+    }
+    w.endArray();
+    host_ota_reset();
+}
+
+int main(int argc, char** argv)
+{
+    const char* output = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) s_quick = true;
+        else output = argv[i];
+    }
+
+    std::string result;
+    char buf[512];
+    JsonWriter w(buf, sizeof(buf), DocWriter::stringSink, &result);
+    w.beginObject().field("quick", s_quick);
+#ifdef PURESPA_BENCH_CJSON
+    w.field("cjson", true);
+#else
+    w.field("cjson", false);
+#endif
+    benchDecoder(w);
+    benchGpioEdge(w);
+    ServiceBench::scheduleCheck(w);
+    ServiceBench::serializers(w);
+    benchAudit(w);
+    benchEndpoints(w);
+    benchOtaUpload(w);
+    w.endObject();
+    CHECK(w.finish() == ESP_OK);
+    result += '\n';
+
+    FILE* f = output ? fopen(output, "w") : stdout;
+    CHECK(f != nullptr);
+    fwrite(result.data(), 1, result.size(), f);
+    if (f != stdout) fclose(f);
+    return exitNow(0);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+
+// Entry point of every fuzz target, called by libFuzzer or by fuzz_main.cpp.
+// Returns 0; a broken invariant aborts so the input is kept as a crash.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+#define FUZZ_CHECK(cond) do {                                                   \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: FUZZ_CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort();                                                            \
+        }                                                                       \
+    } while (0)
@@ -0,0 +1,105 @@
+// One POST body per input into the handler registered for FUZZ_URI (set per
+// target in CMakeLists.txt), through the in-process HTTP server so the body is
+// read and parsed exactly as on the chip. The first input byte is the recv
+// size (0: whole body), which splits tokens across reads.
+//
+// The service is not started, so accepted commands fail at the empty command
+// queue (503 for batches) instead of waiting for a spa. The schedule, scenes
+// and audit settings it stores are checked after every request.
+#include "fuzz.h"
+#include "host_httpd.h"
+#include "PureSpaService.h"
+#include "AuditLogger.h"
+#include "ota_session.h"
+#include "web_server.h"
+#include "esp_log.h"
+#include <cstring>
+#include <string>
+
+#ifndef FUZZ_URI
+#error "FUZZ_URI names the endpoint under test"
+#endif
+
+static const int STATUSES[] = { 200, 400, 404, 409, 413, 500, 503 };
+
+static bool isValidCommand(const SpaBatchCommand& c)
+{
+    if (c.cmd == SpaCommand::SET_TEMP) {
+        return c.value >= PureSpaIO::WATER_TEMP::SET_MIN && c.value <= PureSpaIO::WATER_TEMP::SET_MAX;
+    }
+    return c.cmd >= SpaCommand::POWER_ON && c.cmd <= SpaCommand::HEATER_OFF;
+}
+
+class ServiceFuzz {
+public:
+    // Every input starts from event ID 1 and the scene "Evening", so update,
+    // toggle and delete have something to find
+    static void reset(PureSpaService& service)
+    {
+        service.clearSchedule();
+        ScheduledEvent ev = {};
+        ev.recurring = true;
+        ev.dayOfWeekMask = 0x7F;
+        ev.hour = 7;
+        ev.minute = 30;
+        ev.setPower = true;
+        ev.powerValue = true;
+        service.addEvent(ev);
+
+        for (const SpaScene& scene : service.getScenes()) service.deleteScene(scene.name);
+        SpaScene scene = {};
+        snprintf(scene.name, sizeof(scene.name), "Evening");
+        scene.count = 1;
+        scene.commands[0] = { SpaCommand::POWER_ON, 0 };
+        FUZZ_CHECK(service.saveScene(scene) == ESP_OK);
+    }
+
+    static void check(PureSpaService& service)
+    {
+        FUZZ_CHECK(service._events.size() <= PureSpaService::MAX_EVENTS);
+        for (const ScheduledEvent& ev : service._events) {
+            FUZZ_CHECK(PureSpaService::isValidEvent(ev));
+            FUZZ_CHECK(ev.id > 0 && ev.id < service._nextEventId);
+        }
+
+        std::vector<SpaScene> scenes = service.getScenes();
+        FUZZ_CHECK(scenes.size() <= PureSpaService::MAX_SCENES);
+        for (const SpaScene& scene : scenes) {
+            FUZZ_CHECK(memchr(scene.name, '\0', sizeof(scene.name)) != nullptr && scene.name[0] != '\0');
+            FUZZ_CHECK(scene.count >= 1 && scene.count <= SpaScene::MAX_COMMANDS);
+            for (size_t i = 0; i < scene.count; i++) FUZZ_CHECK(isValidCommand(scene.commands[i]));
+        }
+
+        int days = AuditLogger::getInstance().getRetentionDays();
+        FUZZ_CHECK(days >= 1 && days <= 7);
+    }
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static bool started = false;
+    if (!started) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+        WebServer::getInstance().start();
+        started = true;
+    }
+    if (size == 0) return 0;
+
+    PureSpaService& service = PureSpaService::getInstance();
+    ServiceFuzz::reset(service);
+
+    HostRequestOptions options = {};
+    options.recvChunk = data[0];
+    std::string body(reinterpret_cast<const char*>(data + 1), size - 1);
+    HostResponse response = host_httpd_request(HTTP_POST, FUZZ_URI, body, options);
+
+    bool known = false;
+    for (int status : STATUSES) known |= response.status == status;
+    if (!known) fprintf(stderr, "%s answered %d\n", FUZZ_URI, response.status);
+    FUZZ_CHECK(known);
+    ServiceFuzz::check(service);
+
+    // A started upload session would answer 409 to every later input
+    if (OtaSession::getInstance().getInfo().active) OtaSession::getInstance().cancel();
+    return 0;
+}
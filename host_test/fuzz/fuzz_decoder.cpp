@@ -0,0 +1,136 @@
+// Random frame sequences through PureSpaIO and on into the service's status
+// snapshot and rendered document, which must only ever hold decoded values in
+// range or the UNDEF markers the API documents.
+//
+// Input: 3 bytes per frame, the 16 bit value MSB first and a length byte.
+// With its top bit set the frame is cut after 1 to 15 bits (LATCH released
+// early), otherwise all 16 bits are clocked out.
+#include "fuzz.h"
+#include "PureSpaService.h"
+#include "BusBackend.h"
+#include "json_reader.h"
+#include "esp_log.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+static const size_t FRAME_BYTES = 3;
+static const size_t CHECK_FRAMES = 32; // about one display cycle
+
+class FrameBackend : public BusBackend {
+public:
+    const char* getName() const override { return "fuzz"; }
+    bool start(EdgeHandler h, void* c) override { handler = h; ctx = c; return true; }
+    void stop() override {}
+    void pullDataLow() override {}
+
+    // Same bit order and cut frame handling as ReplayBusBackend::deliver
+    void deliver(uint16_t value, unsigned int bits)
+    {
+        for (unsigned int i = 0; i < bits; i++) handler(ctx, (value >> (15 - i)) & 1, true);
+        if (bits < 16) handler(ctx, false, false);
+    }
+
+private:
+    EdgeHandler handler = nullptr;
+    void* ctx = nullptr;
+};
+
+static bool isTemp(int v)
+{
+    return v == PureSpaIO::UNDEF::INT || (v >= 0 && v <= 60);
+}
+
+static bool isSwitch(uint8_t v)
+{
+    return v == 0 || v == 1 || v == PureSpaIO::UNDEF::BOOL;
+}
+
+// Bus fields of the rendered status: switches are booleans, temperatures a
+// reading or -99
+class StatusCheck : public JsonReader::Handler {
+public:
+    bool onToken(JsonReader::Token token, uint8_t depth, const char* text, size_t len) override
+    {
+        typedef JsonReader::Token Token;
+        if (depth != 1) return true;
+        if (token == Token::KEY) {
+            snprintf(key, sizeof(key), "%s", text);
+            return true;
+        }
+        if (strcmp(key, "power") == 0 || strcmp(key, "filter") == 0 ||
+            strcmp(key, "heater") == 0 || strcmp(key, "bubble") == 0) {
+            FUZZ_CHECK(token == Token::TRUE || token == Token::FALSE);
+            switches++;
+        } else if (strcmp(key, "act_temp") == 0 || strcmp(key, "set_temp") == 0) {
+            FUZZ_CHECK(token == Token::NUMBER && isTemp(atoi(text)));
+            temps++;
+        }
+        return true;
+    }
+
+    char key[JsonReader::MAX_SCALAR + 1] = "";
+    int switches = 0;
+    int temps = 0;
+};
+
+class ServiceFuzz {
+public:
+    static void check(PureSpaService& service)
+    {
+        const PureSpaIO& io = service._io;
+        FUZZ_CHECK(isTemp(io.getActWaterTempCelsius()));
+        FUZZ_CHECK(isTemp(io.getDesiredWaterTempCelsius()));
+        int hours = io.getDisinfectionTime();
+        FUZZ_CHECK(hours == PureSpaIO::UNDEF::INT || (hours >= 0 && hours <= 999));
+
+        service.refreshStatus(true);
+        const PureSpaService::StatusSnapshot& s = service._status;
+        FUZZ_CHECK(isTemp(s.actTemp) && isTemp(s.setTemp));
+        FUZZ_CHECK(isSwitch(s.power) && isSwitch(s.filter) && isSwitch(s.heater) && isSwitch(s.bubble));
+        FUZZ_CHECK(isSwitch(s.heaterStandby) && isSwitch(s.jet) && isSwitch(s.disinfection));
+        FUZZ_CHECK(memchr(s.error, '\0', sizeof(s.error)) != nullptr);
+        for (const char* c = s.error; *c; c++) FUZZ_CHECK(isprint((unsigned char)*c));
+
+        StatusCheck status;
+        JsonReader reader(status);
+        FUZZ_CHECK(reader.feed(service._statusJson, service._statusJsonLen) == ESP_OK);
+        FUZZ_CHECK(reader.finish() == ESP_OK);
+        FUZZ_CHECK(status.switches == 4 && status.temps == 2);
+        FUZZ_CHECK(service._statusCborLen > 1 && service._statusCborLen <= sizeof(service._statusCbor));
+    }
+
+    static void run(const uint8_t* data, size_t size)
+    {
+        // A fresh decoder and status cache per input, outside the spa slots
+        std::unique_ptr<PureSpaService> service(new PureSpaService());
+        FrameBackend backend;
+        service->_io.setup(LANG::EN, backend);
+
+        size_t frames = size / FRAME_BYTES;
+        for (size_t i = 0; i < frames; i++) {
+            const uint8_t* f = data + i * FRAME_BYTES;
+            uint16_t value = (uint16_t)(f[0] << 8 | f[1]);
+            unsigned int bits = (f[2] & 0x80) ? 1 + (f[2] & 0x7F) % 15 : 16;
+            backend.deliver(value, bits);
+            if ((i + 1) % CHECK_FRAMES == 0) {
+                service->_io.loop();
+                check(*service);
+            }
+        }
+        service->_io.loop();
+        check(*service);
+    }
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static bool started = false;
+    if (!started) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+        started = true;
+    }
+    ServiceFuzz::run(data, size);
+    return 0;
+}
@@ -0,0 +1,207 @@
+// Stand-in for libFuzzer when the compiler has none (GCC): runs every corpus
+// input once, then -runs mutations of them. It takes the libFuzzer flags the
+// ctest entries use, so the same command works with either build:
+//
+//   fuzz_<target> [-runs=N] [-seed=N] [-max_len=N] [-dict=file] [corpus dirs or files]
+//
+// No coverage feedback: mutations are byte flips, inserts, erases, dictionary
+// tokens and splices of random corpus entries. When a check aborts or the
+// target crashes, the input is written to crash-<target>.bin in the working
+// directory (with the sanitizers, set abort_on_error=1 in ASAN_OPTIONS and
+// UBSAN_OPTIONS).
+#include "fuzz.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> Input;
+
+static const Input* s_current = nullptr;
+static char s_crashPath[256] = "crash.bin";
+
+// Async-signal-safe: only open/write/close
+static void onAbort(int sig)
+{
+    if (s_current != nullptr) {
+        int fd = open(s_crashPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            if (write(fd, s_current->data(), s_current->size()) < 0) {}
+            close(fd);
+        }
+        static const char msg[] = "input written to ";
+        if (write(2, msg, sizeof(msg) - 1) < 0 || write(2, s_crashPath, strlen(s_crashPath)) < 0 ||
+            write(2, "\n", 1) < 0) {}
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static bool readFile(const std::string& path, Input& out)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static void addPath(const std::string& path, std::vector<Input>& corpus)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        fprintf(stderr, "cannot read %s\n", path.c_str());
+        exit(1);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        Input input;
+        if (readFile(path, input)) corpus.push_back(input);
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) return;
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') names.push_back(entry->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end()); // same order, same mutations
+    for (const std::string& name : names) addPath(path + "/" + name, corpus);
+}
+
+// libFuzzer dictionary lines: name="token" or "token", with \\ \" \xNN escapes
+static void loadDict(const std::string& path, std::vector<Input>& dict)
+{
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line)) {
+        size_t open = line.find('"');
+        size_t close = line.rfind('"');
+        if (line.empty() || line[0] == '#' || open == std::string::npos || close <= open) continue;
+        Input token;
+        for (size_t i = open + 1; i < close; i++) {
+            if (line[i] == '\\' && i + 1 < close) {
+                i++;
+                if (line[i] == 'x' && i + 2 < close) {
+                    token.push_back((uint8_t)strtoul(line.substr(i + 1, 2).c_str(), nullptr, 16));
+                    i += 2;
+                    continue;
+                }
+            }
+            token.push_back((uint8_t)line[i]);
+        }
+        if (!token.empty()) dict.push_back(token);
+    }
+}
+
+static void mutate(Input& in, const std::vector<Input>& corpus, const std::vector<Input>& dict,
+                   size_t maxLen, std::mt19937& rng)
+{
+    auto pick = [&](size_t n) { return n ? (size_t)(rng() % n) : 0; };
+    int steps = 1 + pick(4);
+    for (int s = 0; s < steps; s++) {
+        switch (pick(7)) {
+            case 0: // flip a bit
+                if (!in.empty()) in[pick(in.size())] ^= (uint8_t)(1u << pick(8));
+                break;
+            case 1: // replace a byte
+                if (!in.empty()) in[pick(in.size())] = (uint8_t)rng();
+                break;
+            case 2: // insert a byte
+                in.insert(in.begin() + pick(in.size() + 1), (uint8_t)rng());
+                break;
+            case 3: { // erase a range
+                if (in.empty()) break;
+                size_t at = pick(in.size());
+                size_t n = 1 + pick(std::min<size_t>(in.size() - at, 16));
+                in.erase(in.begin() + at, in.begin() + at + n);
+                break;
+            }
+            case 4: { // duplicate a range
+                if (in.empty()) break;
+                size_t at = pick(in.size());
+                size_t n = 1 + pick(std::min<size_t>(in.size() - at, 32));
+                Input copy(in.begin() + at, in.begin() + at + n);
+                in.insert(in.begin() + pick(in.size() + 1), copy.begin(), copy.end());
+                break;
+            }
+            case 5: // dictionary token
+                if (!dict.empty()) {
+                    const Input& token = dict[pick(dict.size())];
+                    in.insert(in.begin() + pick(in.size() + 1), token.begin(), token.end());
+                }
+                break;
+            case 6: { // splice the tail of another input
+                if (corpus.empty()) break;
+                const Input& other = corpus[pick(corpus.size())];
+                size_t at = pick(in.size() + 1);
+                size_t from = pick(other.size() + 1);
+                in.resize(at);
+                in.insert(in.end(), other.begin() + from, other.end());
+                break;
+            }
+        }
+    }
+    if (in.size() > maxLen) in.resize(maxLen);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long runs = 0;
+    unsigned long seed = 1;
+    size_t maxLen = 4096;
+    std::vector<Input> corpus;
+    std::vector<Input> dict;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 6, "-runs=") == 0) {
+            runs = strtoul(arg.c_str() + 6, nullptr, 10);
+        } else if (arg.compare(0, 6, "-seed=") == 0) {
+            seed = strtoul(arg.c_str() + 6, nullptr, 10);
+        } else if (arg.compare(0, 9, "-max_len=") == 0) {
+            maxLen = strtoul(arg.c_str() + 9, nullptr, 10);
+        } else if (arg.compare(0, 6, "-dict=") == 0) {
+            loadDict(arg.substr(6), dict);
+        } else if (arg[0] == '-') {
+            fprintf(stderr, "ignoring %s (libFuzzer only)\n", arg.c_str());
+        } else {
+            addPath(arg, corpus);
+        }
+    }
+
+    const char* name = strrchr(argv[0], '/');
+    snprintf(s_crashPath, sizeof(s_crashPath), "crash-%s.bin", name ? name + 1 : argv[0]);
+    signal(SIGABRT, onAbort);
+    // Keep the sanitizer's own report when it already handles SIGSEGV
+    struct sigaction segv;
+    if (sigaction(SIGSEGV, nullptr, &segv) == 0 && segv.sa_handler == SIG_DFL) signal(SIGSEGV, onAbort);
+
+    auto start = std::chrono::steady_clock::now();
+    for (const Input& input : corpus) {
+        s_current = &input;
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    std::mt19937 rng(seed);
+    Input input;
+    for (unsigned long r = 0; r < runs; r++) {
+        input = corpus.empty() ? Input() : corpus[rng() % corpus.size()];
+        mutate(input, corpus, dict, maxLen, rng);
+        s_current = &input;
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    s_current = nullptr;
+
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu corpus inputs and %lu mutations in %lld ms\n", corpus.size(), runs, ms);
+    fflush(stdout);
+    // Like the tests: web server and service tasks may still be running
+    _Exit(0);
+}
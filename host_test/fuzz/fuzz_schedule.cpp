@@ -0,0 +1,93 @@
+// Stored schedules through PureSpaService::loadSchedule: whatever NVS holds,
+// the loaded events are valid, IDs handed out afterwards are new, and the
+// schedule survives a save and load unchanged.
+//
+// Input: the stored next_id (4 bytes, little endian), then the JSON string.
+#include "fuzz.h"
+#include "host_nvs.h"
+#include "nvs.h"
+#include "PureSpaService.h"
+#include "json_writer.h"
+#include "esp_log.h"
+#include <cstring>
+#include <string>
+
+// Where the schedule is stored, as in PureSpaService.cpp
+static const char* const SCHEDULE_NAMESPACE = "purespa_sched";
+static const char* const SCHEDULE_KEY = "events";
+
+class ServiceFuzz {
+public:
+    static std::string scheduleJson(PureSpaService& service)
+    {
+        std::string json;
+        char chunk[128];
+        JsonWriter w(chunk, sizeof(chunk), JsonWriter::stringSink, &json);
+        service.writeSchedule(w);
+        FUZZ_CHECK(w.finish() == ESP_OK);
+        return json;
+    }
+
+    static void check(PureSpaService& service)
+    {
+        FUZZ_CHECK(service._events.size() <= PureSpaService::MAX_EVENTS);
+        for (const ScheduledEvent& ev : service._events) {
+            FUZZ_CHECK(PureSpaService::isValidEvent(ev));
+            FUZZ_CHECK(ev.id > 0 && ev.id < service._nextEventId);
+        }
+    }
+
+    static void run(const uint8_t* data, size_t size)
+    {
+        int32_t nextId = 0;
+        memcpy(&nextId, data, sizeof(nextId));
+        std::string json(reinterpret_cast<const char*>(data + sizeof(nextId)), size - sizeof(nextId));
+
+        PureSpaService& service = PureSpaService::getInstance();
+        service.clearSchedule();
+        host_nvs_reset();
+        nvs_handle_t nvs;
+        FUZZ_CHECK(nvs_open(SCHEDULE_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK);
+        nvs_set_str(nvs, SCHEDULE_KEY, json.c_str());
+        nvs_set_i32(nvs, "next_id", nextId);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+
+        service.loadSchedule();
+        check(service);
+
+        // Written back and read again, nothing changes
+        std::vector<ScheduledEvent> loaded = service._events;
+        std::string saved = scheduleJson(service);
+        service.saveSchedule();
+        service.loadSchedule();
+        check(service);
+        FUZZ_CHECK(scheduleJson(service) == saved);
+
+        // The next event gets an ID no stored event has
+        if (loaded.size() < PureSpaService::MAX_EVENTS) {
+            ScheduledEvent ev = loaded.empty() ? ScheduledEvent() : loaded.front();
+            if (loaded.empty()) {
+                ev.recurring = true;
+                ev.hour = 6;
+            }
+            service.addEvent(ev);
+            FUZZ_CHECK(service._events.size() == loaded.size() + 1);
+            int id = service._events.back().id;
+            for (const ScheduledEvent& old : loaded) FUZZ_CHECK(old.id != id);
+            check(service);
+        }
+    }
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static bool started = false;
+    if (!started) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+        started = true;
+    }
+    if (size < sizeof(int32_t)) return 0;
+    ServiceFuzz::run(data, size);
+    return 0;
+}
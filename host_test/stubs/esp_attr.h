@@ -0,0 +1,6 @@
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_BSS_ATTR
+#define FORCE_INLINE_ATTR static inline __attribute__((always_inline))
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+// Time stamp counter on x86, nanoseconds elsewhere
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (esp_cpu_cycle_count_t)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (esp_cpu_cycle_count_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+
+// Host build: the ESP-IDF error codes used by main/
+typedef int esp_err_t;
+
+#define ESP_OK                          0
+#define ESP_FAIL                        -1
+#define ESP_ERR_NO_MEM                  0x101
+#define ESP_ERR_INVALID_ARG             0x102
+#define ESP_ERR_INVALID_STATE           0x103
+#define ESP_ERR_INVALID_SIZE            0x104
+#define ESP_ERR_NOT_FOUND               0x105
+#define ESP_ERR_NOT_SUPPORTED           0x106
+#define ESP_ERR_TIMEOUT                 0x107
+#define ESP_ERR_INVALID_RESPONSE        0x108
+#define ESP_ERR_INVALID_CRC             0x109
+#define ESP_ERR_INVALID_VERSION         0x10A
+#define ESP_ERR_NVS_NOT_FOUND           0x1102
+#define ESP_ERR_NVS_TYPE_MISMATCH       0x1103
+#define ESP_ERR_NVS_READ_ONLY           0x1104
+#define ESP_ERR_NVS_INVALID_HANDLE      0x1107
+#define ESP_ERR_NVS_INVALID_LENGTH      0x110c
+#define ESP_ERR_NVS_NO_FREE_PAGES       0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND   0x1110
+#define ESP_ERR_OTA_VALIDATE_FAILED     0x1503
+#define ESP_ERR_HTTPD_BASE              0xb000
+#define ESP_ERR_HTTPD_RESULT_TRUNC      (ESP_ERR_HTTPD_BASE + 8)
+
+const char* esp_err_to_name(esp_err_t code);
+
+#define ESP_ERROR_CHECK(x) do {                                 \
+        esp_err_t err_rc_ = (x);                                \
+        if (err_rc_ != ESP_OK) esp_error_check_failed(err_rc_, #x, __FILE__, __LINE__); \
+    } while (0)
+
+void esp_error_check_failed(esp_err_t rc, const char* expr, const char* file, int line) __attribute__((noreturn));
@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+#include <zlib.h>
+
+// Same polynomial and conventions as the ROM routine
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len)
+{
+    return (uint32_t)crc32(crc, buf, len);
+}
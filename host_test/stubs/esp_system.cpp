@@ -0,0 +1,263 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_rom_sys.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "host_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::chrono::steady_clock::time_point s_start = std::chrono::steady_clock::now();
+
+// HOST_LOG_LEVEL=0..5 (none..verbose), warnings by default
+esp_log_level_t initialLogLevel()
+{
+    const char* env = getenv("HOST_LOG_LEVEL");
+    return env != nullptr ? (esp_log_level_t)atoi(env) : ESP_LOG_WARN;
+}
+
+esp_log_level_t s_logLevel = initialLogLevel();
+
+std::atomic<bool> s_countRestarts(false);
+std::atomic<unsigned> s_restarts(0);
+
+} // namespace
+
+void esp_log_level_set(const char* tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0) s_logLevel = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+{
+    if (level > s_logLevel) return;
+    static const char LETTERS[] = "NEWIDV";
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    fprintf(stderr, "%c (%lld) %s: %s\n", LETTERS[level], (long long)(esp_timer_get_time() / 1000), tag, line);
+}
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_OTA_VALIDATE_FAILED: return "ESP_ERR_OTA_VALIDATE_FAILED";
+        case ESP_ERR_HTTPD_RESULT_TRUNC: return "ESP_ERR_HTTPD_RESULT_TRUNC";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+void esp_error_check_failed(esp_err_t rc, const char* expr, const char* file, int line)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: %s (%s) at %s:%d\n", esp_err_to_name(rc), expr, file, line);
+    abort();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_start).count();
+}
+
+// One dispatch thread for every timer, like the esp_timer task
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool armed;
+    int64_t due;        // [us] esp_timer_get_time()
+    uint64_t period;    // [us] 0 for one-shot
+};
+
+namespace {
+
+std::mutex s_timersMutex;
+std::condition_variable s_timersCond;
+std::vector<esp_timer*> s_timers;
+bool s_timerThread = false;
+
+void runTimers()
+{
+    std::unique_lock<std::mutex> lock(s_timersMutex);
+    while (true) {
+        esp_timer* next = nullptr;
+        for (esp_timer* timer : s_timers) {
+            if (timer->armed && (next == nullptr || timer->due < next->due)) next = timer;
+        }
+        if (next == nullptr) {
+            s_timersCond.wait(lock);
+            continue;
+        }
+        int64_t wait = next->due - esp_timer_get_time();
+        if (wait > 0) {
+            s_timersCond.wait_for(lock, std::chrono::microseconds(wait));
+            continue;
+        }
+        if (next->period) {
+            next->due += next->period;
+        } else {
+            next->armed = false;
+        }
+        esp_timer_cb_t callback = next->callback;
+        void* arg = next->arg;
+        lock.unlock();
+        callback(arg);
+        lock.lock();
+    }
+}
+
+} // namespace
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out)
+{
+    if (args == nullptr || args->callback == nullptr || out == nullptr) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(s_timersMutex);
+    if (!s_timerThread) {
+        std::thread(runTimers).detach();
+        s_timerThread = true;
+    }
+    esp_timer* timer = new esp_timer{args->callback, args->arg, false, 0, 0};
+    s_timers.push_back(timer);
+    *out = timer;
+    return ESP_OK;
+}
+
+static esp_err_t armTimer(esp_timer_handle_t timer, uint64_t delay, uint64_t period)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_timersMutex);
+        if (timer->armed) return ESP_ERR_INVALID_STATE;
+        timer->armed = true;
+        timer->due = esp_timer_get_time() + (int64_t)delay;
+        timer->period = period;
+    }
+    s_timersCond.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return armTimer(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return armTimer(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::mutex> lock(s_timersMutex);
+    if (!timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::mutex> lock(s_timersMutex);
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+    for (size_t i = 0; i < s_timers.size(); i++) {
+        if (s_timers[i] == timer) {
+            s_timers.erase(s_timers.begin() + i);
+            break;
+        }
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+// A steady heap, so request heap deltas read 0
+uint32_t esp_get_free_heap_size(void)
+{
+    return 200 * 1024;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return 180 * 1024;
+}
+
+void esp_restart(void)
+{
+    if (s_countRestarts) {
+        s_restarts++;
+        vTaskDelete(NULL);
+    }
+    fprintf(stderr, "esp_restart() called on the host\n");
+    abort();
+}
+
+void host_restart_set_counting(bool enabled)
+{
+    s_restarts = 0;
+    s_countRestarts = enabled;
+}
+
+unsigned host_restart_count()
+{
+    return s_restarts;
+}
+
+uint32_t esp_random(void)
+{
+    static std::mutex mutex;
+    static std::mt19937 generator(std::random_device{}());
+    std::lock_guard<std::mutex> lock(mutex);
+    return generator();
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return 240;
+}
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key)
+{
+    return nullptr;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t* esp_netif, esp_netif_ip_info_t* ip_info)
+{
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info)
+{
+    return ESP_ERR_INVALID_STATE;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+// Host build: never associated, esp_wifi_sta_get_ap_info() fails
+typedef struct {
+    uint8_t ssid[33];
+    int8_t rssi;
+} wifi_ap_record_t;
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info);
@@ -0,0 +1,344 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct tskTaskControlBlock {
+    std::string name;
+    bool thread;        // created with xTaskCreate, not an adopted host thread
+    std::mutex mutex;
+    std::condition_variable cond;
+    uint32_t notify = 0;
+};
+
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t itemSize;
+    size_t length;
+    size_t head = 0;
+    size_t count = 0;
+    std::vector<uint8_t> items;
+};
+
+namespace {
+
+// Thrown by vTaskDelete(NULL) to unwind the task's thread
+struct TaskDeleted {};
+
+const std::chrono::steady_clock::time_point s_start = std::chrono::steady_clock::now();
+
+std::mutex s_tasksMutex;
+std::vector<std::unique_ptr<tskTaskControlBlock>> s_tasks;
+thread_local tskTaskControlBlock* s_current = nullptr;
+
+// Once exit() has started, tasks stop in their next FreeRTOS call instead of
+// running on against singletons being destroyed
+std::atomic<bool> s_exiting{false};
+
+void onExit()
+{
+    s_exiting = true;
+}
+
+void parkIfExiting()
+{
+    if (s_exiting && s_current != nullptr && s_current->thread) {
+        while (true) std::this_thread::sleep_for(std::chrono::hours(1));
+    }
+}
+
+tskTaskControlBlock* addTask(const char* name, bool thread)
+{
+    std::lock_guard<std::mutex> lock(s_tasksMutex);
+    s_tasks.emplace_back(new tskTaskControlBlock());
+    tskTaskControlBlock* task = s_tasks.back().get();
+    task->name = name ? name : "";
+    task->thread = thread;
+    return task;
+}
+
+tskTaskControlBlock* currentTask()
+{
+    if (s_current == nullptr) s_current = addTask("host", false);
+    return s_current;
+}
+
+// Waits on cond until ready() holds or ticks expire, portMAX_DELAY forever
+template<typename Ready>
+bool waitTicks(std::unique_lock<std::mutex>& lock, std::condition_variable& cond, TickType_t ticks, Ready ready)
+{
+    if (ticks == portMAX_DELAY) {
+        cond.wait(lock, ready);
+        return true;
+    }
+    return cond.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+} // namespace
+
+void vPortEnterCritical(portMUX_TYPE* mux)
+{
+    static thread_local char self;
+    uintptr_t me = (uintptr_t)&self;
+    if (mux->owner.load(std::memory_order_acquire) == me) {
+        mux->count++;
+        return;
+    }
+    uintptr_t expected = 0;
+    while (!mux->owner.compare_exchange_weak(expected, me, std::memory_order_acquire)) {
+        expected = 0;
+        std::this_thread::yield();
+    }
+    mux->count = 1;
+}
+
+void vPortExitCritical(portMUX_TYPE* mux)
+{
+    if (--mux->count == 0) mux->owner.store(0, std::memory_order_release);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack, void* param,
+                       UBaseType_t priority, TaskHandle_t* out)
+{
+    static std::once_flag registerExit;
+    std::call_once(registerExit, [] { atexit(onExit); });
+
+    tskTaskControlBlock* task = addTask(name, true);
+    if (out != nullptr) *out = task;
+    std::thread([fn, param, task] {
+        s_current = task;
+        try {
+            fn(param);
+        } catch (const TaskDeleted&) {
+        }
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* param,
+                                   UBaseType_t priority, TaskHandle_t* out, BaseType_t core)
+{
+    return xTaskCreate(fn, name, stack, param, priority, out);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr || task == s_current) {
+        if (s_current != nullptr && s_current->thread) throw TaskDeleted();
+        abort();
+    }
+    // A thread cannot be stopped from outside; nothing in main/ needs it
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    parkIfExiting();
+    if (ticks == 0) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+    }
+    parkIfExiting();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - s_start).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return currentTask();
+}
+
+TaskHandle_t xTaskGetHandle(const char* name)
+{
+    std::lock_guard<std::mutex> lock(s_tasksMutex);
+    for (auto& task : s_tasks) {
+        if (task->thread && task->name == name) return task.get();
+    }
+    return nullptr;
+}
+
+const char* pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : currentTask())->name.c_str();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return 1024;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    parkIfExiting();
+    tskTaskControlBlock* task = currentTask();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    waitTicks(lock, task->cond, ticks, [task] { return task->notify > 0 || s_exiting; });
+    lock.unlock();
+    parkIfExiting();
+    lock.lock();
+    uint32_t value = task->notify;
+    if (value > 0) task->notify = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notify++;
+    }
+    task->cond.notify_all();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken)
+{
+    xTaskNotifyGive(task);
+    if (woken != nullptr) *woken = pdFALSE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    if (length == 0) return nullptr;
+    QueueDefinition* queue = new QueueDefinition();
+    queue->itemSize = itemSize;
+    queue->length = length;
+    queue->items.resize((size_t)length * itemSize);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+    parkIfExiting();
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitTicks(lock, queue->cond, ticks, [queue] { return queue->count < queue->length; })) return pdFAIL;
+    size_t tail = (queue->head + queue->count) % queue->length;
+    if (queue->itemSize > 0) memcpy(&queue->items[tail * queue->itemSize], item, queue->itemSize);
+    queue->count++;
+    lock.unlock();
+    queue->cond.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+    return xQueueSend(queue, item, ticks);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken)
+{
+    if (woken != nullptr) *woken = pdFALSE;
+    return xQueueSend(queue, item, 0);
+}
+
+static BaseType_t queueTake(QueueHandle_t queue, void* item, TickType_t ticks, bool remove)
+{
+    parkIfExiting();
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    bool ready = waitTicks(lock, queue->cond, ticks, [queue] { return queue->count > 0 || s_exiting; });
+    if (s_exiting) {
+        lock.unlock();
+        parkIfExiting();
+        lock.lock();
+    }
+    if (!ready || queue->count == 0) return pdFAIL;
+    if (queue->itemSize > 0 && item != nullptr) {
+        memcpy(item, &queue->items[queue->head * queue->itemSize], queue->itemSize);
+    }
+    if (remove) {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        lock.unlock();
+        queue->cond.notify_all();
+    }
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+    return queueTake(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+    return queueTake(queue, item, ticks, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->head = 0;
+        queue->count = 0;
+    }
+    queue->cond.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    QueueHandle_t queue = xQueueCreate(max, 0);
+    if (queue != nullptr) queue->count = initial;
+    return queue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, nullptr, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSend(sem, nullptr, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* woken)
+{
+    return xQueueSendFromISR(sem, nullptr, woken);
+}
@@ -0,0 +1,80 @@
+#include "driver/gpio.h"
+#include "soc/gpio_reg.h"
+#include "rom/ets_sys.h"
+#include "esp_rom_sys.h"
+#include "host_gpio.h"
+#include <atomic>
+
+volatile uint32_t host_gpio_in = 0xFFFFFFFF;
+
+namespace {
+
+struct IsrSlot {
+    gpio_isr_t isr;
+    void* arg;
+};
+
+IsrSlot s_isr[GPIO_NUM_MAX] = {};
+bool s_serviceInstalled = false;
+std::atomic<uint32_t> s_outputs{0};
+
+} // namespace
+
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+    return config->pin_bit_mask >> GPIO_NUM_MAX ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    if (s_serviceInstalled) return ESP_ERR_INVALID_STATE;
+    s_serviceInstalled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t isr, void* arg)
+{
+    if (!s_serviceInstalled) return ESP_ERR_INVALID_STATE;
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    s_isr[pin] = { isr, arg };
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    s_isr[pin] = {};
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    s_outputs++;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+    return ESP_OK;
+}
+
+void ets_delay_us(uint32_t us)
+{
+    esp_rom_delay_us(us);
+}
+
+void host_gpio_set_inputs(uint32_t levels)
+{
+    host_gpio_in = levels;
+}
+
+void host_gpio_edge(gpio_num_t pin)
+{
+    const IsrSlot& slot = s_isr[pin];
+    if (slot.isr != nullptr) slot.isr(slot.arg);
+}
+
+uint32_t host_gpio_outputs()
+{
+    return s_outputs;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+#include "driver/gpio.h"
+
+// Test side of the GPIO shim: plays the wires of a bus
+void host_gpio_set_inputs(uint32_t levels);
+// Runs the ISR registered on pin on the calling thread, as the interrupt would
+void host_gpio_edge(gpio_num_t pin);
+// Level changes driven by the firmware through gpio_set_level() so far
+uint32_t host_gpio_outputs();
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "esp_http_server.h"
+
+// Test side of the in-process esp_http_server
+struct HostResponse {
+    int status;                 // 0 when no route matched
+    std::string statusLine;     // "200 OK"
+    std::string contentType;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+
+    // Value of a response header, empty when absent
+    std::string header(const char* name) const;
+};
+
+struct HostRequestOptions {
+    std::vector<std::pair<std::string, std::string>> headers;
+    // Largest piece httpd_req_recv() returns, 0 for the whole buffer
+    size_t recvChunk;
+    // Sleep before each httpd_req_recv(), the network of a slow client
+    uint32_t recvDelayUs;
+};
+
+// Runs the handler registered for method and uri (query included) on the
+// calling thread, as the httpd task would, and waits for requests handed to
+// an async worker to complete. Like the single httpd task, the server runs
+// one handler at a time; requests from other threads queue behind it.
+HostResponse host_httpd_request(httpd_method_t method, const char* uri, const std::string& body = std::string(),
+                                const HostRequestOptions& options = HostRequestOptions());
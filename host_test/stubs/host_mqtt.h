@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "mqtt_client.h"
+
+// Test side of the in-process MQTT client: plays the broker
+struct HostMqttMessage {
+    std::string topic;
+    std::string payload;
+    int qos;
+    bool retain;
+};
+
+// Client created by the last esp_mqtt_client_init(), NULL before
+esp_mqtt_client_handle_t host_mqtt_client();
+// Runs the registered handler on the calling thread, as the MQTT task would
+void host_mqtt_connect(esp_mqtt_client_handle_t client);
+void host_mqtt_disconnect(esp_mqtt_client_handle_t client);
+void host_mqtt_deliver(esp_mqtt_client_handle_t client, const char* topic, const char* payload, bool retain);
+// Publishes and enqueued messages so far, optionally clearing them
+std::vector<HostMqttMessage> host_mqtt_published(esp_mqtt_client_handle_t client, bool clear = false);
+std::vector<std::string> host_mqtt_subscriptions(esp_mqtt_client_handle_t client);
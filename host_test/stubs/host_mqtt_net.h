@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+#include "mqtt_client.h"
+
+// Test side of the TCP MQTT client in mqtt_net.cpp. The broker is the one in
+// HOST_MQTT_URI (mqtt://host:port) when set, else the configured URI;
+// HOST_MQTT_RECONNECT_MS overrides the reconnect delay.
+
+// Client created by the last esp_mqtt_client_init(), NULL before
+esp_mqtt_client_handle_t host_mqtt_net_client();
+bool host_mqtt_net_connected(esp_mqtt_client_handle_t client);
+// Closes the link without DISCONNECT, so the broker publishes the last will;
+// the client reconnects after the reconnect delay
+void host_mqtt_net_drop(esp_mqtt_client_handle_t client);
+// While held the outbox is not sent, as on a stalled link
+void host_mqtt_net_hold_outbox(esp_mqtt_client_handle_t client, bool hold);
+// Outbox size in bytes past which enqueue and QoS 1 publish fail, 0 for none
+void host_mqtt_net_set_outbox_limit(esp_mqtt_client_handle_t client, size_t bytes);
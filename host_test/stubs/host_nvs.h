@@ -0,0 +1,6 @@
+#pragma once
+
+// Test side of the in-memory NVS
+void host_nvs_reset();
+// Number of nvs_commit() calls since the last reset
+unsigned host_nvs_commits();
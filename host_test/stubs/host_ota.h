@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// Test side of the simulated flash. esp_ota_write() sleeps writeDelayUs per
+// call plus perKbUs per KiB, roughly what an ESP32 spends erasing and
+// programming flash.
+void host_ota_set_write_cost(uint32_t writeDelayUs, uint32_t perKbUs);
+// Image of the running partition, read by the delta patcher
+void host_ota_set_running_image(const std::string& image);
+// Bytes written to the update partition, and whether it was made bootable
+std::string host_ota_written_image();
+bool host_ota_boot_set();
+void host_ota_reset();
@@ -0,0 +1,8 @@
+#pragma once
+
+// Test side of esp_restart(). It aborts the process unless restarts are
+// counted: then it only ends the calling task, so a test can run several
+// updates that each schedule a reboot.
+void host_restart_set_counting(bool enabled);
+// esp_restart() calls since counting was enabled
+unsigned host_restart_count();
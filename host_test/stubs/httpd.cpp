@@ -0,0 +1,367 @@
+#include "esp_http_server.h"
+#include "host_httpd.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <strings.h>
+#include <thread>
+
+namespace {
+
+struct Server {
+    httpd_config_t config;
+    std::vector<httpd_uri_t> uris;
+    // Held while a handler runs, the single httpd task: concurrent requests
+    // wait for it until the handler returns or detaches to an async worker
+    std::mutex task;
+};
+
+// One request in flight: shared by the request and its async copy
+struct Exchange {
+    std::string path;
+    std::string query;
+    bool hasQuery;
+    const std::string* body;
+    size_t bodyPos;
+    HostRequestOptions options;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    HostResponse response;
+    bool responded;     // status line and headers are out
+    bool finished;      // last byte sent
+    bool detached;      // httpd_req_async_handler_begin() called
+    bool completed;     // httpd_req_async_handler_complete() called
+};
+
+std::mutex s_serversMutex;
+std::vector<Server*> s_servers;
+
+Exchange* exchangeOf(httpd_req_t* r)
+{
+    return static_cast<Exchange*>(r->aux);
+}
+
+const char* statusLine(httpd_err_code_t error)
+{
+    switch (error) {
+        case HTTPD_501_METHOD_NOT_IMPLEMENTED: return "501 Method Not Implemented";
+        case HTTPD_505_VERSION_NOT_SUPPORTED: return "505 Version Not Supported";
+        case HTTPD_400_BAD_REQUEST: return "400 Bad Request";
+        case HTTPD_401_UNAUTHORIZED: return "401 Unauthorized";
+        case HTTPD_403_FORBIDDEN: return "403 Forbidden";
+        case HTTPD_404_NOT_FOUND: return "404 Not Found";
+        case HTTPD_405_METHOD_NOT_ALLOWED: return "405 Method Not Allowed";
+        case HTTPD_408_REQ_TIMEOUT: return "408 Request Timeout";
+        case HTTPD_411_LENGTH_REQUIRED: return "411 Length Required";
+        case HTTPD_414_URI_TOO_LONG: return "414 URI Too Long";
+        case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE: return "431 Request Header Fields Too Large";
+        default: return "500 Internal Server Error";
+    }
+}
+
+void respond(Exchange* ex)
+{
+    if (ex->responded) return;
+    ex->responded = true;
+    if (ex->response.statusLine.empty()) ex->response.statusLine = "200 OK";
+    ex->response.status = atoi(ex->response.statusLine.c_str());
+}
+
+void finish(Exchange* ex)
+{
+    std::lock_guard<std::mutex> lock(ex->mutex);
+    ex->finished = true;
+    ex->cond.notify_all();
+}
+
+bool findHeader(const std::vector<std::pair<std::string, std::string>>& headers, const char* name, std::string& value)
+{
+    for (const auto& header : headers) {
+        if (strcasecmp(header.first.c_str(), name) == 0) {
+            value = header.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t copyTruncated(const std::string& value, char* buf, size_t size)
+{
+    if (size == 0) return ESP_ERR_HTTPD_RESULT_TRUNC;
+    size_t n = std::min(value.size(), size - 1);
+    memcpy(buf, value.data(), n);
+    buf[n] = '\0';
+    return n < value.size() ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+} // namespace
+
+std::string HostResponse::header(const char* name) const
+{
+    std::string value;
+    findHeader(headers, name, value);
+    return value;
+}
+
+const char* http_method_str(enum http_method m)
+{
+    switch (m) {
+        case HTTP_DELETE: return "DELETE";
+        case HTTP_GET: return "GET";
+        case HTTP_HEAD: return "HEAD";
+        case HTTP_POST: return "POST";
+        case HTTP_PUT: return "PUT";
+        case HTTP_OPTIONS: return "OPTIONS";
+        default: return "<unknown>";
+    }
+}
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config)
+{
+    Server* server = new Server();
+    server->config = *config;
+    std::lock_guard<std::mutex> lock(s_serversMutex);
+    s_servers.push_back(server);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_serversMutex);
+    for (size_t i = 0; i < s_servers.size(); i++) {
+        if (s_servers[i] == handle) {
+            delete s_servers[i];
+            s_servers.erase(s_servers.begin() + i);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler)
+{
+    Server* server = static_cast<Server*>(handle);
+    if (server->uris.size() >= server->config.max_uri_handlers) return ESP_ERR_NO_MEM;
+    server->uris.push_back(*uri_handler);
+    return ESP_OK;
+}
+
+// Same rules as the IDF: a trailing '*' matches any rest, a trailing '?'
+// makes the character before it optional
+bool httpd_uri_match_wildcard(const char* uri_template, const char* uri_to_match, size_t match_upto)
+{
+    size_t tplLen = strlen(uri_template);
+    if (tplLen > 0 && uri_template[tplLen - 1] == '*') {
+        return match_upto >= tplLen - 1 && strncmp(uri_template, uri_to_match, tplLen - 1) == 0;
+    }
+    if (tplLen > 1 && uri_template[tplLen - 1] == '?') {
+        if (match_upto == tplLen - 1 && strncmp(uri_template, uri_to_match, tplLen - 1) == 0) return true;
+        return match_upto == tplLen - 2 && strncmp(uri_template, uri_to_match, tplLen - 2) == 0;
+    }
+    return match_upto == tplLen && strncmp(uri_template, uri_to_match, tplLen) == 0;
+}
+
+int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len)
+{
+    Exchange* ex = exchangeOf(r);
+    if (ex->options.recvDelayUs) std::this_thread::sleep_for(std::chrono::microseconds(ex->options.recvDelayUs));
+    size_t n = std::min(buf_len, ex->body->size() - ex->bodyPos);
+    if (ex->options.recvChunk) n = std::min(n, ex->options.recvChunk);
+    memcpy(buf, ex->body->data() + ex->bodyPos, n);
+    ex->bodyPos += n;
+    return (int)n;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t* r, const char* field)
+{
+    std::string value;
+    return findHeader(exchangeOf(r)->options.headers, field, value) ? value.size() : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r, const char* field, char* val, size_t val_size)
+{
+    std::string value;
+    if (!findHeader(exchangeOf(r)->options.headers, field, value)) return ESP_ERR_NOT_FOUND;
+    return copyTruncated(value, val, val_size);
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t* r)
+{
+    return exchangeOf(r)->query.size();
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t buf_len)
+{
+    Exchange* ex = exchangeOf(r);
+    if (!ex->hasQuery) return ESP_ERR_NOT_FOUND;
+    return copyTruncated(ex->query, buf, buf_len);
+}
+
+esp_err_t httpd_query_key_value(const char* qry, const char* key, char* val, size_t val_size)
+{
+    size_t keyLen = strlen(key);
+    const char* p = qry;
+    while (p != nullptr && *p) {
+        const char* end = strchr(p, '&');
+        size_t pairLen = end ? (size_t)(end - p) : strlen(p);
+        if (pairLen > keyLen && strncmp(p, key, keyLen) == 0 && p[keyLen] == '=') {
+            return copyTruncated(std::string(p + keyLen + 1, pairLen - keyLen - 1), val, val_size);
+        }
+        p = end ? end + 1 : nullptr;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_to_sockfd(httpd_req_t* r)
+{
+    return 3;
+}
+
+esp_err_t httpd_sess_set_send_override(httpd_handle_t hd, int sockfd, httpd_send_func_t send_func)
+{
+    // Responses are captured, nothing reaches a socket to count
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t* r, httpd_req_t** out)
+{
+    httpd_req_t* copy = static_cast<httpd_req_t*>(malloc(sizeof(httpd_req_t)));
+    if (copy == nullptr) return ESP_ERR_NO_MEM;
+    memcpy((void*)copy, r, sizeof(*r));
+    exchangeOf(r)->detached = true;
+    *out = copy;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t* r)
+{
+    Exchange* ex = exchangeOf(r);
+    free(r);
+    std::lock_guard<std::mutex> lock(ex->mutex);
+    ex->completed = true;
+    ex->cond.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* status)
+{
+    exchangeOf(r)->response.statusLine = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type)
+{
+    exchangeOf(r)->response.contentType = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field, const char* value)
+{
+    exchangeOf(r)->response.headers.emplace_back(field, value);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t buf_len)
+{
+    Exchange* ex = exchangeOf(r);
+    if (ex->responded) return ESP_ERR_INVALID_STATE;
+    respond(ex);
+    if (buf != nullptr) ex->response.body.assign(buf, buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len);
+    finish(ex);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf, ssize_t buf_len)
+{
+    Exchange* ex = exchangeOf(r);
+    if (ex->finished) return ESP_ERR_INVALID_STATE;
+    respond(ex);
+    size_t len = buf == nullptr ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    if (len == 0) {
+        finish(ex);
+    } else {
+        ex->response.body.append(buf, len);
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t* req, httpd_err_code_t error, const char* msg)
+{
+    Exchange* ex = exchangeOf(req);
+    if (ex->responded) return ESP_ERR_INVALID_STATE;
+    ex->response.statusLine = statusLine(error);
+    ex->response.contentType = "text/html";
+    return httpd_resp_send(req, msg ? msg : ex->response.statusLine.c_str(), HTTPD_RESP_USE_STRLEN);
+}
+
+HostResponse host_httpd_request(httpd_method_t method, const char* uri, const std::string& body,
+                                const HostRequestOptions& options)
+{
+    Exchange ex;
+    const char* q = strchr(uri, '?');
+    ex.path = q ? std::string(uri, q - uri) : std::string(uri);
+    ex.hasQuery = q != nullptr;
+    ex.query = q ? std::string(q + 1) : std::string();
+    ex.body = &body;
+    ex.bodyPos = 0;
+    ex.options = options;
+    ex.response.status = 0;
+    ex.responded = ex.finished = ex.detached = ex.completed = false;
+
+    httpd_uri_t match = {};
+    bool pathFound = false;
+    bool found = false;
+    Server* server = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_serversMutex);
+        if (s_servers.empty()) return ex.response;
+        server = s_servers.front();
+        httpd_uri_match_func_t matchFn = server->config.uri_match_fn;
+        for (const httpd_uri_t& candidate : server->uris) {
+            bool matches = matchFn ? matchFn(candidate.uri, ex.path.c_str(), ex.path.size())
+                                   : ex.path == candidate.uri;
+            if (!matches) continue;
+            pathFound = true;
+            if (candidate.method == method) {
+                match = candidate;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    // The uri member is const, as in the IDF: build the request in raw storage
+    alignas(httpd_req_t) unsigned char storage[sizeof(httpd_req_t)] = {};
+    httpd_req_t* req = reinterpret_cast<httpd_req_t*>(storage);
+    req->handle = server;
+    req->method = method;
+    snprintf(const_cast<char*>(req->uri), sizeof(req->uri), "%s", uri);
+    req->content_len = body.size();
+    req->aux = &ex;
+    if (!found) {
+        httpd_resp_send_err(req, pathFound ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, nullptr);
+        return ex.response;
+    }
+    req->user_ctx = match.user_ctx;
+
+    esp_err_t err;
+    {
+        std::lock_guard<std::mutex> task(server->task);
+        err = match.handler(req);
+    }
+    std::unique_lock<std::mutex> lock(ex.mutex);
+    if (ex.detached) {
+        ex.cond.wait(lock, [&ex] { return ex.completed; });
+    } else if (err != ESP_OK && !ex.finished) {
+        // The IDF closes the connection
+        ex.response.status = 0;
+        ex.response.statusLine.clear();
+    }
+    return ex.response;
+}
@@ -0,0 +1,70 @@
+#include "miniz.h"
+#include <cstring>
+
+static voidpf arenaAlloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor* r = static_cast<tinfl_decompressor*>(opaque);
+    size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+    if (r->used + bytes > sizeof(r->arena)) return Z_NULL;
+    void* p = r->arena + r->used;
+    r->used += bytes;
+    return p;
+}
+
+static void arenaFree(voidpf opaque, voidpf address)
+{
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const mz_uint8* pIn_buf_next, size_t* pIn_buf_size,
+                              mz_uint8* pOut_buf_start, mz_uint8* pOut_buf_next, size_t* pOut_buf_size,
+                              const mz_uint32 decomp_flags)
+{
+    enum { START = 0, INFLATING, DONE, FAILED };
+
+    if (r->m_state == START) {
+        memset(&r->stream, 0, sizeof(r->stream));
+        r->used = 0;
+        r->stream.zalloc = arenaAlloc;
+        r->stream.zfree = arenaFree;
+        r->stream.opaque = r;
+        int window = (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15;
+        if (inflateInit2(&r->stream, window) != Z_OK) {
+            r->m_state = FAILED;
+        } else {
+            r->m_state = INFLATING;
+        }
+    }
+    if (r->m_state == DONE) {
+        *pIn_buf_size = 0;
+        *pOut_buf_size = 0;
+        return TINFL_STATUS_DONE;
+    }
+    if (r->m_state == FAILED) {
+        *pIn_buf_size = 0;
+        *pOut_buf_size = 0;
+        return TINFL_STATUS_FAILED;
+    }
+
+    r->stream.next_in = const_cast<mz_uint8*>(pIn_buf_next);
+    r->stream.avail_in = (uInt)*pIn_buf_size;
+    r->stream.next_out = pOut_buf_next;
+    r->stream.avail_out = (uInt)*pOut_buf_size;
+    int rc = inflate(&r->stream, Z_NO_FLUSH);
+    *pIn_buf_size -= r->stream.avail_in;
+    *pOut_buf_size -= r->stream.avail_out;
+
+    if (rc == Z_STREAM_END) {
+        r->m_state = DONE;
+        return TINFL_STATUS_DONE;
+    }
+    if (rc != Z_OK && rc != Z_BUF_ERROR) {
+        r->m_state = FAILED;
+        return TINFL_STATUS_FAILED;
+    }
+    if (r->stream.avail_out == 0) return TINFL_STATUS_HAS_MORE_OUTPUT;
+    if (!(decomp_flags & TINFL_FLAG_HAS_MORE_INPUT)) {
+        r->m_state = FAILED;
+        return TINFL_STATUS_FAILED;
+    }
+    return TINFL_STATUS_NEEDS_MORE_INPUT;
+}
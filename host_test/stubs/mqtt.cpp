@@ -0,0 +1,165 @@
+#include "mqtt_client.h"
+#include "host_mqtt.h"
+#include <cstring>
+#include <mutex>
+
+struct esp_mqtt_client {
+    std::string uri;
+    esp_event_handler_t handler = nullptr;
+    void* handlerArgs = nullptr;
+
+    std::mutex mutex;
+    bool started = false;
+    bool connected = false;
+    int nextMsgId = 1;
+    std::vector<HostMqttMessage> published;
+    std::vector<std::string> subscriptions;
+};
+
+namespace {
+
+std::mutex s_clientMutex;
+esp_mqtt_client* s_client = nullptr;
+
+void dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_t& event)
+{
+    event.client = client;
+    if (client->handler != nullptr) {
+        client->handler(client->handlerArgs, "MQTT_EVENTS", event.event_id, &event);
+    }
+}
+
+int record(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos, int retain)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    if (len <= 0 && data != nullptr) len = (int)strlen(data);
+    client->published.push_back(HostMqttMessage{topic, std::string(data ? data : "", data ? len : 0), qos, retain != 0});
+    return client->nextMsgId++;
+}
+
+} // namespace
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config)
+{
+    esp_mqtt_client* client = new esp_mqtt_client();
+    client->uri = config->broker.address.uri ? config->broker.address.uri : "";
+    std::lock_guard<std::mutex> lock(s_clientMutex);
+    s_client = client;
+    return client;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    if (client->started) return ESP_FAIL;
+    client->started = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    client->started = false;
+    client->connected = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void* handler_args)
+{
+    client->handler = handler;
+    client->handlerArgs = handler_args;
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    if (!client->connected) return -1;
+    client->subscriptions.push_back(topic);
+    return client->nextMsgId++;
+}
+
+// QoS 0 messages are not kept while disconnected, as in the IDF client
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain)
+{
+    {
+        std::lock_guard<std::mutex> lock(client->mutex);
+        if (!client->connected) return -1;
+    }
+    return record(client, topic, data, len, qos, retain);
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain, bool store)
+{
+    {
+        std::lock_guard<std::mutex> lock(client->mutex);
+        if (!client->connected && !store) return -1;
+    }
+    return record(client, topic, data, len, qos, retain);
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+    return 0;
+}
+
+esp_mqtt_client_handle_t host_mqtt_client()
+{
+    std::lock_guard<std::mutex> lock(s_clientMutex);
+    return s_client;
+}
+
+void host_mqtt_connect(esp_mqtt_client_handle_t client)
+{
+    {
+        std::lock_guard<std::mutex> lock(client->mutex);
+        client->connected = true;
+        client->subscriptions.clear();
+    }
+    esp_mqtt_event_t event = {};
+    event.event_id = MQTT_EVENT_CONNECTED;
+    dispatch(client, event);
+}
+
+void host_mqtt_disconnect(esp_mqtt_client_handle_t client)
+{
+    {
+        std::lock_guard<std::mutex> lock(client->mutex);
+        client->connected = false;
+    }
+    esp_mqtt_event_t event = {};
+    event.event_id = MQTT_EVENT_DISCONNECTED;
+    dispatch(client, event);
+}
+
+void host_mqtt_deliver(esp_mqtt_client_handle_t client, const char* topic, const char* payload, bool retain)
+{
+    std::string topicCopy(topic);
+    std::string payloadCopy(payload);
+    esp_mqtt_event_t event = {};
+    event.event_id = MQTT_EVENT_DATA;
+    event.topic = &topicCopy[0];
+    event.topic_len = (int)topicCopy.size();
+    event.data = &payloadCopy[0];
+    event.data_len = (int)payloadCopy.size();
+    event.total_data_len = event.data_len;
+    event.retain = retain;
+    dispatch(client, event);
+}
+
+std::vector<HostMqttMessage> host_mqtt_published(esp_mqtt_client_handle_t client, bool clear)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    std::vector<HostMqttMessage> published = client->published;
+    if (clear) client->published.clear();
+    return published;
+}
+
+std::vector<std::string> host_mqtt_subscriptions(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    return client->subscriptions;
+}
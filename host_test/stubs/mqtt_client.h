@@ -0,0 +1,83 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+// Host build: an in-process client. Nothing is sent, see host_mqtt.h to
+// inspect what was published and to deliver broker events.
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED
+} esp_mqtt_event_id_t;
+
+typedef struct esp_mqtt_event_t {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char* data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char* topic;
+    int topic_len;
+    int msg_id;
+    int session_present;
+    bool retain;
+    int qos;
+    bool dup;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t* esp_mqtt_event_handle_t;
+
+typedef struct {
+    struct {
+        struct { const char* uri; } address;
+    } broker;
+    struct {
+        const char* username;
+        const char* client_id;
+        struct { const char* password; } authentication;
+    } credentials;
+    struct {
+        struct { const char* topic; const char* msg; int msg_len; int qos; int retain; } last_will;
+        bool disable_clean_session;
+        int keepalive;
+    } session;
+    struct {
+        int reconnect_timeout_ms;
+        int timeout_ms;
+    } network;
+    struct {
+        int priority;
+        int stack_size;
+    } task;
+    struct {
+        int size;
+        int out_size;
+    } buffer;
+    struct {
+        uint64_t limit;
+    } outbox;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void* handler_args);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain, bool store);
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client);
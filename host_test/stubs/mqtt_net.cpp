@@ -0,0 +1,487 @@
+// Host build: an MQTT 3.1.1 client over TCP behind the same esp-mqtt API as
+// mqtt.cpp, for tests against a real broker. Link it into the test
+// executable: its definitions then win over the in-process client in
+// idf_host. See host_mqtt_net.h for the test side.
+//
+// One task per client connects, reads and keeps the session alive, and runs
+// the event handler, like the IDF's MQTT task. QoS 0 publishes go straight to
+// the socket; QoS 1 publishes and enqueued messages go through the outbox,
+// which the task drains. Only what PureSpa and its tests use is implemented.
+#include "mqtt_client.h"
+#include "host_mqtt_net.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum PacketType : uint8_t {
+    CONNECT = 1, CONNACK = 2, PUBLISH = 3, PUBACK = 4, SUBSCRIBE = 8, SUBACK = 9,
+    PINGREQ = 12, PINGRESP = 13, DISCONNECT = 14,
+};
+
+const int DEFAULT_KEEPALIVE_S = 120;
+const int DEFAULT_RECONNECT_MS = 10000;
+const int DEFAULT_TIMEOUT_MS = 10000;
+const int POLL_MS = 20;
+
+typedef std::vector<uint8_t> Packet;
+
+void putLength(Packet& p, size_t len)
+{
+    do {
+        uint8_t b = len % 128;
+        len /= 128;
+        p.push_back(len ? b | 0x80 : b);
+    } while (len);
+}
+
+void putString(Packet& p, const char* s, size_t len)
+{
+    p.push_back((uint8_t)(len >> 8));
+    p.push_back((uint8_t)len);
+    p.insert(p.end(), s, s + len);
+}
+
+// Fixed header plus body
+Packet frame(uint8_t header, const Packet& body)
+{
+    Packet p;
+    p.push_back(header);
+    putLength(p, body.size());
+    p.insert(p.end(), body.begin(), body.end());
+    return p;
+}
+
+Packet publishPacket(const char* topic, const char* data, int len, int qos, int retain, uint16_t msgId)
+{
+    Packet body;
+    putString(body, topic, strlen(topic));
+    if (qos > 0) {
+        body.push_back((uint8_t)(msgId >> 8));
+        body.push_back((uint8_t)msgId);
+    }
+    body.insert(body.end(), data, data + len);
+    return frame((uint8_t)(PUBLISH << 4 | (qos > 0 ? 2 : 0) | (retain ? 1 : 0)), body);
+}
+
+std::string copyOf(const char* s)
+{
+    return s ? std::string(s) : std::string();
+}
+
+} // namespace
+
+struct esp_mqtt_client {
+    std::string host;
+    uint16_t port = 1883;
+    std::string clientId;
+    std::string username;
+    std::string password;
+    std::string willTopic;
+    std::string willMsg;
+    int willQos = 0;
+    bool willRetain = false;
+    int keepaliveS = DEFAULT_KEEPALIVE_S;
+    int reconnectMs = DEFAULT_RECONNECT_MS;
+    int timeoutMs = DEFAULT_TIMEOUT_MS;
+
+    esp_event_handler_t handler = nullptr;
+    void* handlerArgs = nullptr;
+
+    std::atomic<bool> started{false};
+    std::atomic<bool> connected{false};
+    std::atomic<bool> dropRequested{false};
+    std::atomic<bool> holdOutbox{false};
+    int sock = -1;
+    std::mutex sendMutex;       // socket writes, from the task and publishers
+    std::chrono::steady_clock::time_point lastSend;
+
+    std::mutex mutex;           // outbox and message IDs
+    std::deque<Packet> outbox;
+    size_t outboxBytes = 0;
+    size_t outboxLimit = 0;     // 0: unlimited, as the IDF default
+    uint16_t nextMsgId = 1;
+};
+
+namespace {
+
+std::mutex s_clientMutex;
+esp_mqtt_client* s_client = nullptr;
+int s_clientCount = 0;
+
+void dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_t& event)
+{
+    event.client = client;
+    if (client->handler != nullptr) {
+        client->handler(client->handlerArgs, "MQTT_EVENTS", event.event_id, &event);
+    }
+}
+
+void dispatchSimple(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t id, int msgId = 0)
+{
+    esp_mqtt_event_t event = {};
+    event.event_id = id;
+    event.msg_id = msgId;
+    dispatch(client, event);
+}
+
+uint16_t takeMsgId(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    uint16_t id = client->nextMsgId++;
+    if (client->nextMsgId == 0) client->nextMsgId = 1;
+    return id;
+}
+
+bool sendAll(esp_mqtt_client_handle_t client, const Packet& p)
+{
+    std::lock_guard<std::mutex> lock(client->sendMutex);
+    if (client->sock < 0) return false;
+    size_t sent = 0;
+    while (sent < p.size()) {
+        ssize_t n = send(client->sock, p.data() + sent, p.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    client->lastSend = std::chrono::steady_clock::now();
+    return true;
+}
+
+// Reads exactly len bytes, false on error, EOF or after timeoutMs of silence
+bool readAll(int sock, uint8_t* buf, size_t len, int timeoutMs)
+{
+    size_t got = 0;
+    while (got < len) {
+        pollfd pfd = { sock, POLLIN, 0 };
+        if (poll(&pfd, 1, timeoutMs) <= 0) return false;
+        ssize_t n = recv(sock, buf + got, len - got, 0);
+        if (n <= 0) return false;
+        got += n;
+    }
+    return true;
+}
+
+bool readPacket(int sock, uint8_t& header, Packet& body, int timeoutMs)
+{
+    if (!readAll(sock, &header, 1, timeoutMs)) return false;
+    size_t len = 0;
+    for (int shift = 0; shift < 28; shift += 7) {
+        uint8_t b;
+        if (!readAll(sock, &b, 1, timeoutMs)) return false;
+        len |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            body.resize(len);
+            return len == 0 || readAll(sock, body.data(), len, timeoutMs);
+        }
+    }
+    return false;
+}
+
+int openSocket(esp_mqtt_client_handle_t client)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    char port[8];
+    snprintf(port, sizeof(port), "%u", (unsigned)client->port);
+    if (getaddrinfo(client->host.c_str(), port, &hints, &res) != 0) return -1;
+    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock >= 0) {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return sock;
+}
+
+Packet connectPacket(esp_mqtt_client_handle_t client)
+{
+    Packet body;
+    putString(body, "MQTT", 4);
+    body.push_back(4); // 3.1.1
+    uint8_t flags = 0x02; // clean session
+    if (!client->willTopic.empty()) {
+        flags |= 0x04 | (uint8_t)(client->willQos << 3) | (client->willRetain ? 0x20 : 0);
+    }
+    if (!client->username.empty()) flags |= 0x80;
+    if (!client->password.empty()) flags |= 0x40;
+    body.push_back(flags);
+    body.push_back((uint8_t)(client->keepaliveS >> 8));
+    body.push_back((uint8_t)client->keepaliveS);
+    putString(body, client->clientId.data(), client->clientId.size());
+    if (!client->willTopic.empty()) {
+        putString(body, client->willTopic.data(), client->willTopic.size());
+        putString(body, client->willMsg.data(), client->willMsg.size());
+    }
+    if (!client->username.empty()) putString(body, client->username.data(), client->username.size());
+    if (!client->password.empty()) putString(body, client->password.data(), client->password.size());
+    return frame(CONNECT << 4, body);
+}
+
+// One broker session: CONNECT, then packets until the link or the client stops
+void runSession(esp_mqtt_client_handle_t client, int sock)
+{
+    {
+        std::lock_guard<std::mutex> lock(client->sendMutex);
+        client->sock = sock;
+    }
+    uint8_t header;
+    Packet body;
+    if (!sendAll(client, connectPacket(client)) || !readPacket(sock, header, body, client->timeoutMs) ||
+        header >> 4 != CONNACK || body.size() != 2 || body[1] != 0) {
+        dispatchSimple(client, MQTT_EVENT_ERROR);
+        return;
+    }
+
+    client->connected = true;
+    esp_mqtt_event_t connected = {};
+    connected.event_id = MQTT_EVENT_CONNECTED;
+    connected.session_present = body[0] & 1;
+    dispatch(client, connected);
+
+    while (client->started && !client->dropRequested) {
+        pollfd pfd = { sock, POLLIN, 0 };
+        int ready = poll(&pfd, 1, POLL_MS);
+        if (ready < 0) break;
+        if (ready > 0) {
+            if (!readPacket(sock, header, body, client->timeoutMs)) break;
+            uint8_t type = header >> 4;
+            if (type == PUBLISH && body.size() >= 2) {
+                int qos = (header >> 1) & 3;
+                size_t topicLen = (size_t)body[0] << 8 | body[1];
+                size_t pos = 2 + topicLen + (qos > 0 ? 2 : 0);
+                if (pos > body.size()) break;
+                std::string topic(body.begin() + 2, body.begin() + 2 + topicLen);
+                std::string data(body.begin() + pos, body.end());
+                if (qos > 0) {
+                    Packet ack = { body[2 + topicLen], body[3 + topicLen] };
+                    sendAll(client, frame(PUBACK << 4, ack));
+                }
+                esp_mqtt_event_t event = {};
+                event.event_id = MQTT_EVENT_DATA;
+                event.topic = &topic[0];
+                event.topic_len = (int)topic.size();
+                event.data = &data[0];
+                event.data_len = (int)data.size();
+                event.total_data_len = event.data_len;
+                event.retain = header & 1;
+                event.qos = qos;
+                event.dup = header & 8;
+                dispatch(client, event);
+            } else if (type == SUBACK && body.size() >= 2) {
+                dispatchSimple(client, MQTT_EVENT_SUBSCRIBED, body[0] << 8 | body[1]);
+            } else if (type == PUBACK && body.size() >= 2) {
+                dispatchSimple(client, MQTT_EVENT_PUBLISHED, body[0] << 8 | body[1]);
+            }
+        }
+
+        // Drain the outbox unless a test holds it back (a stalled link)
+        while (!client->holdOutbox) {
+            Packet next;
+            {
+                std::lock_guard<std::mutex> lock(client->mutex);
+                if (client->outbox.empty()) break;
+                next.swap(client->outbox.front());
+                client->outbox.pop_front();
+                client->outboxBytes -= next.size();
+            }
+            if (!sendAll(client, next)) break;
+        }
+
+        std::chrono::steady_clock::time_point lastSend;
+        {
+            std::lock_guard<std::mutex> lock(client->sendMutex);
+            lastSend = client->lastSend;
+        }
+        if (std::chrono::steady_clock::now() - lastSend > std::chrono::seconds(client->keepaliveS) / 2) {
+            if (!sendAll(client, frame(PINGREQ << 4, Packet()))) break;
+        }
+    }
+    // A clean stop says goodbye, so the broker discards the last will
+    if (!client->started) sendAll(client, frame(DISCONNECT << 4, Packet()));
+}
+
+void clientTask(void* param)
+{
+    esp_mqtt_client_handle_t client = static_cast<esp_mqtt_client_handle_t>(param);
+    while (client->started) {
+        dispatchSimple(client, MQTT_EVENT_BEFORE_CONNECT);
+        int sock = openSocket(client);
+        if (sock >= 0) {
+            runSession(client, sock);
+            {
+                std::lock_guard<std::mutex> lock(client->sendMutex);
+                client->sock = -1;
+            }
+            // Closing without DISCONNECT is an unclean close: the broker
+            // publishes the last will
+            close(sock);
+            client->dropRequested = false;
+            if (client->connected.exchange(false)) dispatchSimple(client, MQTT_EVENT_DISCONNECTED);
+        } else {
+            dispatchSimple(client, MQTT_EVENT_ERROR);
+        }
+        for (int waited = 0; client->started && waited < client->reconnectMs; waited += POLL_MS) {
+            vTaskDelay(pdMS_TO_TICKS(POLL_MS));
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+// Stores a packet for the task to send, -2 when the outbox limit is reached
+int store(esp_mqtt_client_handle_t client, Packet p, int msgId)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    if (client->outboxLimit && client->outboxBytes + p.size() > client->outboxLimit) return -2;
+    client->outboxBytes += p.size();
+    client->outbox.push_back(std::move(p));
+    return msgId;
+}
+
+} // namespace
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config)
+{
+    esp_mqtt_client* client = new esp_mqtt_client();
+    // HOST_MQTT_URI points the firmware's configured URI at the test broker
+    const char* env = getenv("HOST_MQTT_URI");
+    std::string uri = env ? env : copyOf(config->broker.address.uri);
+    if (uri.compare(0, 7, "mqtt://") == 0) uri = uri.substr(7);
+    size_t colon = uri.rfind(':');
+    if (colon != std::string::npos) {
+        client->port = (uint16_t)atoi(uri.c_str() + colon + 1);
+        uri.resize(colon);
+    }
+    client->host = uri;
+    client->username = copyOf(config->credentials.username);
+    client->password = copyOf(config->credentials.authentication.password);
+    client->willTopic = copyOf(config->session.last_will.topic);
+    if (config->session.last_will.msg != nullptr) {
+        int len = config->session.last_will.msg_len;
+        client->willMsg.assign(config->session.last_will.msg, len > 0 ? len : strlen(config->session.last_will.msg));
+    }
+    client->willQos = config->session.last_will.qos;
+    client->willRetain = config->session.last_will.retain != 0;
+    if (config->session.keepalive > 0) client->keepaliveS = config->session.keepalive;
+    if (config->network.timeout_ms > 0) client->timeoutMs = config->network.timeout_ms;
+    env = getenv("HOST_MQTT_RECONNECT_MS");
+    if (env != nullptr) {
+        client->reconnectMs = atoi(env);
+    } else if (config->network.reconnect_timeout_ms > 0) {
+        client->reconnectMs = config->network.reconnect_timeout_ms;
+    }
+    client->outboxLimit = (size_t)config->outbox.limit;
+
+    std::lock_guard<std::mutex> lock(s_clientMutex);
+    client->clientId = config->credentials.client_id ? config->credentials.client_id
+                                                     : "purespa_host_" + std::to_string(getpid()) + "_" + std::to_string(s_clientCount);
+    s_clientCount++;
+    s_client = client;
+    return client;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (client->started.exchange(true)) return ESP_FAIL;
+    xTaskCreate(clientTask, "mqtt_task", 6144, client, 5, NULL);
+    return ESP_OK;
+}
+
+// Does not wait for the task; a stopped client is not started again here
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    client->started = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void* handler_args)
+{
+    client->handler = handler;
+    client->handlerArgs = handler_args;
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos)
+{
+    if (!client->connected) return -1;
+    uint16_t msgId = takeMsgId(client);
+    Packet body = { (uint8_t)(msgId >> 8), (uint8_t)msgId };
+    putString(body, topic, strlen(topic));
+    body.push_back((uint8_t)qos);
+    return sendAll(client, frame(SUBSCRIBE << 4 | 2, body)) ? msgId : -1;
+}
+
+// QoS 0 is written at once and not kept while disconnected, as in the IDF
+// client; QoS 1 goes through the outbox
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain)
+{
+    if (!client->connected) return -1;
+    if (len <= 0) len = data ? (int)strlen(data) : 0;
+    if (qos == 0) return sendAll(client, publishPacket(topic, data, len, 0, retain, 0)) ? 0 : -1;
+    uint16_t msgId = takeMsgId(client);
+    return store(client, publishPacket(topic, data, len, qos, retain, msgId), msgId);
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain, bool store_)
+{
+    if (!client->connected && !store_) return -1;
+    if (len <= 0) len = data ? (int)strlen(data) : 0;
+    uint16_t msgId = qos > 0 ? takeMsgId(client) : 0;
+    return store(client, publishPacket(topic, data, len, qos, retain, msgId), msgId);
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    return (int)client->outboxBytes;
+}
+
+esp_mqtt_client_handle_t host_mqtt_net_client()
+{
+    std::lock_guard<std::mutex> lock(s_clientMutex);
+    return s_client;
+}
+
+bool host_mqtt_net_connected(esp_mqtt_client_handle_t client)
+{
+    return client->connected;
+}
+
+void host_mqtt_net_drop(esp_mqtt_client_handle_t client)
+{
+    client->dropRequested = true;
+}
+
+void host_mqtt_net_hold_outbox(esp_mqtt_client_handle_t client, bool hold)
+{
+    client->holdOutbox = hold;
+}
+
+void host_mqtt_net_set_outbox_limit(esp_mqtt_client_handle_t client, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    client->outboxLimit = bytes;
+}
@@ -0,0 +1,186 @@
+#include "nvs_flash.h"
+#include "host_nvs.h"
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace {
+
+enum class Type { STR, BLOB, I32, U32 };
+
+struct Entry {
+    Type type;
+    std::string bytes;
+};
+
+struct Handle {
+    std::string ns;
+    bool writable;
+};
+
+std::mutex s_mutex;
+std::map<std::string, std::map<std::string, Entry>> s_namespaces;
+std::map<nvs_handle_t, Handle> s_handles;
+nvs_handle_t s_nextHandle = 1;
+unsigned s_commits = 0;
+
+// Entries of handle, NULL for an unknown handle
+std::map<std::string, Entry>* entries(nvs_handle_t handle, bool write, esp_err_t& err)
+{
+    auto it = s_handles.find(handle);
+    if (it == s_handles.end()) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+        return nullptr;
+    }
+    if (write && !it->second.writable) {
+        err = ESP_ERR_NVS_READ_ONLY;
+        return nullptr;
+    }
+    err = ESP_OK;
+    return &s_namespaces[it->second.ns];
+}
+
+esp_err_t get(nvs_handle_t handle, const char* key, Type type, void* out, size_t* length)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    esp_err_t err;
+    auto* map = entries(handle, false, err);
+    if (map == nullptr) return err;
+    auto it = map->find(key);
+    if (it == map->end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (it->second.type != type) return ESP_ERR_NVS_TYPE_MISMATCH;
+    const std::string& bytes = it->second.bytes;
+    if (out == nullptr) {
+        *length = bytes.size();
+        return ESP_OK;
+    }
+    if (*length < bytes.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, bytes.data(), bytes.size());
+    *length = bytes.size();
+    return ESP_OK;
+}
+
+esp_err_t set(nvs_handle_t handle, const char* key, Type type, const void* value, size_t length)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    esp_err_t err;
+    auto* map = entries(handle, true, err);
+    if (map == nullptr) return err;
+    (*map)[key] = Entry{type, std::string((const char*)value, length)};
+    return ESP_OK;
+}
+
+} // namespace
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_namespaces.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    // Like the real NVS, a namespace only exists once opened for writing
+    if (open_mode == NVS_READONLY && s_namespaces.find(name) == s_namespaces.end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (open_mode == NVS_READWRITE) s_namespaces[name];
+    nvs_handle_t handle = s_nextHandle++;
+    s_handles[handle] = Handle{name, open_mode == NVS_READWRITE};
+    *out_handle = handle;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_handles.find(handle) == s_handles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+    s_commits++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length)
+{
+    return get(handle, key, Type::STR, out_value, length);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value)
+{
+    return set(handle, key, Type::STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length)
+{
+    return get(handle, key, Type::BLOB, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length)
+{
+    return set(handle, key, Type::BLOB, value, length);
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value)
+{
+    size_t length = sizeof(*out_value);
+    return get(handle, key, Type::I32, out_value, &length);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value)
+{
+    return set(handle, key, Type::I32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value)
+{
+    size_t length = sizeof(*out_value);
+    return get(handle, key, Type::U32, out_value, &length);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value)
+{
+    return set(handle, key, Type::U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    esp_err_t err;
+    auto* map = entries(handle, true, err);
+    if (map == nullptr) return err;
+    return map->erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    esp_err_t err;
+    auto* map = entries(handle, true, err);
+    if (map == nullptr) return err;
+    map->clear();
+    return ESP_OK;
+}
+
+void host_nvs_reset()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_namespaces.clear();
+    s_commits = 0;
+}
+
+unsigned host_nvs_commits()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_commits;
+}
@@ -0,0 +1,141 @@
+#include "esp_ota_ops.h"
+#include "host_ota.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Layout of partitions.csv: two 1.5 MB app slots
+const esp_partition_t s_running = { 0x10000, 0x180000, "ota_0" };
+const esp_partition_t s_update = { 0x190000, 0x180000, "ota_1" };
+const uint8_t IMAGE_MAGIC = 0xE9;
+
+std::mutex s_mutex;
+std::string s_runningImage;
+std::string s_written;
+esp_ota_handle_t s_handle = 0;
+esp_ota_handle_t s_nextHandle = 1;
+bool s_bootSet = false;
+uint32_t s_writeDelayUs = 0;
+uint32_t s_perKbUs = 0;
+
+} // namespace
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from)
+{
+    return &s_update;
+}
+
+const esp_partition_t* esp_ota_get_running_partition(void)
+{
+    return &s_running;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (partition != &s_running) return ESP_ERR_NOT_SUPPORTED;
+    if (src_offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    // Erased flash past the image
+    memset(dst, 0xFF, size);
+    if (src_offset < s_runningImage.size()) {
+        size_t n = std::min(size, s_runningImage.size() - src_offset);
+        memcpy(dst, s_runningImage.data() + src_offset, n);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (partition != &s_update || out_handle == nullptr) return ESP_ERR_INVALID_ARG;
+    if (image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES &&
+        image_size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_written.clear();
+    s_bootSet = false;
+    s_handle = s_nextHandle++;
+    *out_handle = s_handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size)
+{
+    uint32_t delayUs;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (handle == 0 || handle != s_handle) return ESP_ERR_INVALID_ARG;
+        // Checked on the first write, like the IDF
+        if (s_written.empty() && size > 0 && ((const uint8_t*)data)[0] != IMAGE_MAGIC) {
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        if (s_written.size() + size > s_update.size) return ESP_ERR_INVALID_SIZE;
+        s_written.append((const char*)data, size);
+        delayUs = s_writeDelayUs + (uint32_t)((uint64_t)s_perKbUs * size / 1024);
+    }
+    if (delayUs) std::this_thread::sleep_for(std::chrono::microseconds(delayUs));
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (handle == 0 || handle != s_handle) return ESP_ERR_NOT_FOUND;
+    s_handle = 0;
+    return s_written.empty() ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (handle == 0 || handle != s_handle) return ESP_ERR_NOT_FOUND;
+    s_handle = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (partition != &s_update) return ESP_ERR_INVALID_ARG;
+    s_bootSet = true;
+    return ESP_OK;
+}
+
+void host_ota_set_write_cost(uint32_t writeDelayUs, uint32_t perKbUs)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_writeDelayUs = writeDelayUs;
+    s_perKbUs = perKbUs;
+}
+
+void host_ota_set_running_image(const std::string& image)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_runningImage = image;
+}
+
+std::string host_ota_written_image()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_written;
+}
+
+bool host_ota_boot_set()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_bootSet;
+}
+
+void host_ota_reset()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_written.clear();
+    s_handle = 0;
+    s_bootSet = false;
+    s_writeDelayUs = 0;
+    s_perKbUs = 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// Host build configuration: the linux target with MQTT enabled, so every
+// module of main/ is compiled
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_PURESPA_BUS_SPEED 0
+#define CONFIG_PURESPA_HOST_BUS_EMULATOR 1
+#define CONFIG_PURESPA_SPA_COUNT 1
+#define CONFIG_PURESPA_MQTT 1
+#define CONFIG_PURESPA_MQTT_BROKER_URI "mqtt://127.0.0.1"
+#define CONFIG_PURESPA_MQTT_USERNAME ""
+#define CONFIG_PURESPA_MQTT_PASSWORD ""
+#define CONFIG_PURESPA_MQTT_QUEUE_LEN 16
@@ -0,0 +1,6 @@
+#pragma once
+#include <stdint.h>
+
+// Input levels of GPIO 0-31, set through host_gpio_set_inputs()
+extern volatile uint32_t host_gpio_in;
+#define GPIO_IN_REG ((uintptr_t)&host_gpio_in)
@@ -0,0 +1,4 @@
+#pragma once
+#include <stdint.h>
+
+#define REG_READ(reg) (*(volatile uint32_t*)(reg))
@@ -0,0 +1,178 @@
+// GzipDeflater against zlib: random, repetitive and JSON-like inputs, fed in
+// odd chunk sizes and long enough to slide the window several times, must
+// inflate back unchanged. Then the encoder budget, and the gzip branch of the
+// JSON endpoints end to end (GET /api/schedule with Accept-Encoding: gzip).
+#include "test_util.h"
+#include "host_httpd.h"
+#include "gzip_deflater.h"
+#include "PureSpaService.h"
+#include "web_server.h"
+#include <zlib.h>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static esp_err_t appendOutput(void* ctx, const char* data, size_t len)
+{
+    static_cast<std::string*>(ctx)->append(data, len);
+    return ESP_OK;
+}
+
+// Whole gzip member through zlib, empty on any error
+static std::string gunzip(const std::string& in)
+{
+    z_stream zs = {};
+    CHECK(inflateInit2(&zs, 16 + MAX_WBITS) == Z_OK);
+    zs.next_in = (Bytef*)in.data();
+    zs.avail_in = (uInt)in.size();
+    std::string out;
+    char buf[4096];
+    int ret;
+    do {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK);
+    bool ok = ret == Z_STREAM_END && zs.avail_in == 0;
+    inflateEnd(&zs);
+    return ok ? out : std::string();
+}
+
+static std::string compress(const std::string& input, size_t chunk)
+{
+    std::string out;
+    GzipDeflater gzip(appendOutput, &out);
+    CHECK(gzip.init() == ESP_OK);
+    for (size_t pos = 0; pos < input.size(); pos += chunk) {
+        size_t n = std::min(chunk, input.size() - pos);
+        CHECK(gzip.feed((const uint8_t*)input.data() + pos, n) == ESP_OK);
+    }
+    CHECK(gzip.finish() == ESP_OK);
+    CHECK(gzip.inputSize() == input.size());
+    CHECK(gzip.outputSize() == out.size());
+    return out;
+}
+
+static std::string jsonLike(size_t size, std::mt19937& rng)
+{
+    std::string s = "[";
+    while (s.size() < size) {
+        char item[160];
+        snprintf(item, sizeof(item),
+                 "{\"id\":%u,\"enabled\":%s,\"hour\":%u,\"minute\":%u,\"days\":%u,\"temp\":%u,\"name\":\"event %u\"},",
+                 (unsigned)(rng() % 1000), rng() % 2 ? "true" : "false", (unsigned)(rng() % 24),
+                 (unsigned)(rng() % 60), (unsigned)(rng() % 128), (unsigned)(20 + rng() % 20), (unsigned)(rng() % 50));
+        s += item;
+    }
+    s.resize(size);
+    return s;
+}
+
+static void roundTrips()
+{
+    // All but the first two span many windows, so the window slides
+    // (every WINDOW_SIZE bytes) with matches reaching back across it
+    std::mt19937 rng(1);
+    std::vector<std::pair<const char*, std::string>> inputs;
+    inputs.push_back({ "empty", std::string() });
+    inputs.push_back({ "one byte", "x" });
+    std::string random(20000, '\0');
+    for (char& c : random) c = (char)rng();
+    inputs.push_back({ "random", random });
+    std::string repetitive;
+    while (repetitive.size() < 50000) repetitive += "abcabcabd";
+    inputs.push_back({ "repetitive", repetitive });
+    inputs.push_back({ "zeros", std::string(30000, '\0') });
+    inputs.push_back({ "json", jsonLike(40000, rng) });
+
+    static const size_t CHUNKS[] = { 1, 7, 333, 512, 4099, 100000 };
+    for (const auto& input : inputs) {
+        for (size_t chunk : CHUNKS) {
+            std::string gz = compress(input.second, chunk);
+            if (gunzip(gz) != input.second) {
+                fprintf(stderr, "%s in %zu byte chunks does not round-trip\n", input.first, chunk);
+                exitNow(1);
+            }
+        }
+        printf("%-10s %6zu -> %6zu bytes\n", input.first, input.second.size(), compress(input.second, 512).size());
+    }
+    // Repetitive input really is compressed, not stored
+    CHECK(compress(repetitive, 512).size() < repetitive.size() / 10);
+}
+
+// At most MAX_ACTIVE encoders hold a workspace; a slot is free again once
+// its encoder is gone
+static void budget()
+{
+    std::string sink;
+    std::vector<std::unique_ptr<GzipDeflater>> held;
+    for (size_t i = 0; i < GzipDeflater::MAX_ACTIVE; i++) {
+        held.emplace_back(new GzipDeflater(appendOutput, &sink));
+        CHECK(held.back()->init() == ESP_OK);
+    }
+    GzipDeflater extra(appendOutput, &sink);
+    CHECK(extra.init() == ESP_ERR_NO_MEM);
+    held.pop_back();
+    GzipDeflater again(appendOutput, &sink);
+    CHECK(again.init() == ESP_OK);
+}
+
+static HostResponse getSchedule(bool gzip)
+{
+    HostRequestOptions options = {};
+    if (gzip) options.headers.push_back({ "Accept-Encoding", "gzip, deflate" });
+    HostResponse response = host_httpd_request(HTTP_GET, "/api/schedule", std::string(), options);
+    CHECK(response.status == 200);
+    return response;
+}
+
+static void endpoint()
+{
+    // A full schedule is larger than one response buffer, so it is streamed
+    PureSpaService& service = PureSpaService::getInstance();
+    service.clearSchedule();
+    for (size_t i = 0; i < PureSpaService::MAX_EVENTS; i++) {
+        ScheduledEvent ev = {};
+        ev.recurring = true;
+        ev.dayOfWeekMask = 0x7F;
+        ev.hour = (uint8_t)(6 + i);
+        ev.minute = (uint8_t)(5 * i);
+        ev.setPower = true;
+        ev.powerValue = i % 2 == 0;
+        service.addEvent(ev);
+    }
+    WebServer::getInstance().start();
+
+    HostResponse plain = getSchedule(false);
+    CHECK(plain.header("Content-Encoding").empty());
+    CHECK(plain.body.size() > 512);
+
+    HostResponse gz = getSchedule(true);
+    CHECK(gz.header("Content-Encoding") == "gzip");
+    CHECK(gz.header("Vary").find("Accept-Encoding") != std::string::npos);
+    CHECK(gunzip(gz.body) == plain.body);
+    CHECK(gz.body.size() < plain.body.size());
+    printf("schedule   %6zu -> %6zu bytes\n", plain.body.size(), gz.body.size());
+
+    // With the encoder budget taken the same request is answered uncompressed
+    std::string sink;
+    std::vector<std::unique_ptr<GzipDeflater>> held;
+    for (size_t i = 0; i < GzipDeflater::MAX_ACTIVE; i++) {
+        held.emplace_back(new GzipDeflater(appendOutput, &sink));
+        CHECK(held.back()->init() == ESP_OK);
+    }
+    HostResponse fallback = getSchedule(true);
+    CHECK(fallback.header("Content-Encoding").empty());
+    CHECK(fallback.body == plain.body);
+}
+
+int main()
+{
+    roundTrips();
+    budget();
+    endpoint();
+    return exitNow(0);
+}
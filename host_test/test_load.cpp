@@ -0,0 +1,145 @@
+// /api/status latency while an OTA upload holds a connection: two clients
+// poll the status as fast as they can, first alone and then during a plain
+// image upload over a slow link into slow flash. The upload runs on an async
+// worker, so the server task stays free and the status p99 must stay far
+// below the time one upload takes. Meanwhile the parked long-poll list is
+// full (?since=&wait=), which must neither take a worker from the upload nor
+// slow the plain polls down.
+//
+//   test_load [image KiB]
+#include "test_util.h"
+#include "host_httpd.h"
+#include "host_ota.h"
+#include "host_system.h"
+#include "PureSpaService.h"
+#include "web_server.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int CLIENTS = 2;
+static const uint32_t P99_LIMIT_US = 20000;
+static const size_t LONG_POLLS = 4;           // WebServer::MAX_PARKED_POLLS
+static const uint32_t LONG_POLL_WAIT_MS = 2000;
+
+typedef std::chrono::steady_clock Clock;
+
+static long long elapsedUs(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+// Polls /api/status from CLIENTS threads until stop is set, every latency in us
+static std::vector<long long> pollStatus(const std::atomic<bool>& stop)
+{
+    std::mutex mutex;
+    std::vector<long long> all;
+    std::vector<std::thread> clients;
+    for (int i = 0; i < CLIENTS; i++) {
+        clients.emplace_back([&] {
+            std::vector<long long> mine;
+            while (!stop) {
+                Clock::time_point start = Clock::now();
+                HostResponse response = host_httpd_request(HTTP_GET, "/api/status");
+                mine.push_back(elapsedUs(start));
+                CHECK(response.status == 200);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            all.insert(all.end(), mine.begin(), mine.end());
+        });
+    }
+    for (std::thread& client : clients) client.join();
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+static long long percentile(const std::vector<long long>& sorted, double p)
+{
+    return sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * p))];
+}
+
+static void report(const char* name, const std::vector<long long>& sorted)
+{
+    printf("%-14s %6zu requests  p50 %6lld us  p99 %6lld us  max %6lld us\n", name, sorted.size(),
+           percentile(sorted, 0.5), percentile(sorted, 0.99), sorted.back());
+}
+
+int main(int argc, char** argv)
+{
+    size_t kib = argc > 1 ? (size_t)atoi(argv[1]) : 256;
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    host_restart_set_counting(true);
+    WebServer::getInstance().start();
+
+    // Without an upload, for comparison
+    std::atomic<bool> stop(false);
+    std::thread timer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        stop = true;
+    });
+    std::vector<long long> idle = pollStatus(stop);
+    timer.join();
+    CHECK(!idle.empty());
+    report("idle", idle);
+
+    // 1436 byte segments at 1 ms each, flash at 2 ms per KiB, as in the bench
+    std::string image(kib * 1024, '\0');
+    for (size_t i = 0; i < image.size(); i++) image[i] = (char)(i * 31 + (i >> 8));
+    image[0] = (char)0xE9;
+    host_ota_reset();
+    host_ota_set_write_cost(100, 2000);
+
+    // Nothing changes the status, so every long-poll waits out its time.
+    // Once the list is full a further one is refused at once.
+    char longPoll[64];
+    snprintf(longPoll, sizeof(longPoll), "/api/status?since=%lu&wait=%lu",
+             (unsigned long)PureSpaService::getInstance().getStatusVersion(), (unsigned long)LONG_POLL_WAIT_MS);
+    Clock::time_point parkedAt = Clock::now();
+    std::vector<HostResponse> parked(LONG_POLLS);
+    std::vector<std::thread> longPolls;
+    for (size_t i = 0; i < LONG_POLLS; i++) {
+        longPolls.emplace_back([&, i] { parked[i] = host_httpd_request(HTTP_GET, longPoll); });
+    }
+    CHECK(waitFor([] { return WebServer::getInstance().getParkedPollCount() == LONG_POLLS; }, 1000));
+    CHECK(host_httpd_request(HTTP_GET, longPoll).status == 503);
+
+    stop = false;
+    long long uploadUs = 0;
+    HostResponse upload;
+    std::thread uploader([&] {
+        HostRequestOptions options = {};
+        options.recvChunk = 1436;
+        options.recvDelayUs = 1000;
+        Clock::time_point start = Clock::now();
+        upload = host_httpd_request(HTTP_POST, "/api/admin/ota", image, options);
+        uploadUs = elapsedUs(start);
+        stop = true;
+    });
+    std::vector<long long> busy = pollStatus(stop);
+    uploader.join();
+    CHECK(upload.status == 200);
+    CHECK(host_ota_boot_set() && host_ota_written_image() == image);
+    CHECK(!busy.empty());
+    report("during upload", busy);
+    printf("upload: %zu KiB in %lld ms with %zu long-polls parked\n", kib, uploadUs / 1000, LONG_POLLS);
+
+    CHECK(busy.size() >= 100);
+    CHECK(percentile(busy, 0.99) < P99_LIMIT_US);
+    CHECK(percentile(busy, 0.99) * 10 < uploadUs);
+    // The upload was done before any long-poll gave up its wait
+    CHECK(elapsedUs(parkedAt) < (long long)LONG_POLL_WAIT_MS * 1000);
+
+    for (std::thread& t : longPolls) t.join();
+    long long longPollMs = elapsedUs(parkedAt) / 1000;
+    printf("long-polls: answered after %lld ms\n", longPollMs);
+    for (const HostResponse& response : parked) CHECK(response.status == 200);
+    CHECK(longPollMs >= LONG_POLL_WAIT_MS);
+    return exitNow(0);
+}
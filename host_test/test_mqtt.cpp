@@ -0,0 +1,135 @@
+// MqttPublisher against the in-process client playing the broker, with the
+// emulated mainboard behind the service so commands really press buttons:
+// publishing across reconnects, then retained and live command floods.
+#include "test_util.h"
+#include "host_mqtt.h"
+#include "mqtt_publisher.h"
+#include "PureSpaService.h"
+#include "EmulatorBusBackend.h"
+#include "SpaEmulator.h"
+#include "common.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const char* const FLOOD_TOPICS[] = {
+    MQTT_TOPIC::CMD_POWER, MQTT_TOPIC::CMD_FILTER, MQTT_TOPIC::CMD_HEATER,
+    MQTT_TOPIC::CMD_BUBBLE, MQTT_TOPIC::CMD_WATER,
+};
+
+// Last payload published on a topic, empty if none
+static std::string lastPublished(esp_mqtt_client_handle_t client, const char* topic, bool* retained = nullptr)
+{
+    std::string payload;
+    for (const HostMqttMessage& msg : host_mqtt_published(client)) {
+        if (msg.topic != topic) continue;
+        payload = msg.payload;
+        if (retained != nullptr) *retained = msg.retain;
+    }
+    return payload;
+}
+
+static std::vector<std::string> results(esp_mqtt_client_handle_t client)
+{
+    std::vector<std::string> out;
+    for (const HostMqttMessage& msg : host_mqtt_published(client)) {
+        if (msg.topic == MQTT_TOPIC::CMD_RESULT) out.push_back(msg.payload);
+    }
+    return out;
+}
+
+int main()
+{
+    static SpaEmulator spa;
+    spa.setWaterTemp(30);
+    spa.setSetpoint(38);
+    static EmulatorBusBackend bus(spa, 1);
+
+    PureSpaService& service = PureSpaService::getInstance();
+    service.init(bus);
+    MqttPublisher& mqtt = MqttPublisher::getInstance();
+    mqtt.start();
+    esp_mqtt_client_handle_t client = host_mqtt_client();
+    CHECK(client != nullptr);
+
+    // A fresh session announces the spa and subscribes to the commands
+    host_mqtt_connect(client);
+    bool retainedFlag = false;
+    CHECK(waitFor([&] { return lastPublished(client, MQTT_TOPIC::POWER, &retainedFlag) == "off"; }, 5000));
+    CHECK(retainedFlag);
+    CHECK(lastPublished(client, MQTT_TOPIC::STATE) == "online");
+    CHECK(lastPublished(client, MQTT_TOPIC::VERSION) == CONFIG::WIFI_VERSION);
+    CHECK(!lastPublished(client, MQTT_TOPIC::MODEL).empty());
+    std::vector<std::string> subscribed = host_mqtt_subscriptions(client);
+    for (const char* topic : FLOOD_TOPICS) {
+        CHECK(std::find(subscribed.begin(), subscribed.end(), topic) != subscribed.end());
+    }
+
+    // Changes while the broker is away are not queued up...
+    host_mqtt_disconnect(client);
+    CHECK(!mqtt.isConnected());
+    host_mqtt_published(client, true);
+    service.setPower(true, "test");
+    CHECK(waitFor([] { return spa.isPowerOn(); }, 5000));
+    vTaskDelay(pdMS_TO_TICKS(300));
+    CHECK(host_mqtt_published(client).empty());
+
+    // ...the reconnect republishes the current state instead
+    host_mqtt_connect(client);
+    CHECK(waitFor([&] { return lastPublished(client, MQTT_TOPIC::POWER) == "on"; }, 5000));
+    CHECK(lastPublished(client, MQTT_TOPIC::STATE) == "online");
+    CHECK(waitFor([&] { return lastPublished(client, MQTT_TOPIC::WATER_ACT) == "30"; }, 5000));
+    size_t republished = host_mqtt_published(client).size();
+    host_mqtt_disconnect(client);
+    service.setPower(false, "test");
+    CHECK(waitFor([] { return !spa.isPowerOn(); }, 5000));
+    host_mqtt_published(client, true);
+    const uint32_t presses = spa.getPresses();
+
+    // Retained commands left on the broker come back with every subscribe:
+    // none of them may reach the spa, however many reconnects there are
+    const int RECONNECTS = 5;
+    const int RETAINED_PER_TOPIC = 200;
+    for (int round = 0; round < RECONNECTS; round++) {
+        host_mqtt_connect(client);
+        CHECK(mqtt.isConnected());
+        for (int i = 0; i < RETAINED_PER_TOPIC; i++) {
+            for (const char* topic : FLOOD_TOPICS) {
+                host_mqtt_deliver(client, topic, topic == MQTT_TOPIC::CMD_WATER ? "25" : "on", true);
+            }
+        }
+        host_mqtt_disconnect(client);
+        CHECK(!mqtt.isConnected());
+    }
+    const uint32_t retained = RECONNECTS * RETAINED_PER_TOPIC * (uint32_t)(sizeof(FLOOD_TOPICS) / sizeof(FLOOD_TOPICS[0]));
+    CHECK(mqtt.getRetainedIgnoredCount() == retained);
+    vTaskDelay(pdMS_TO_TICKS(1500));
+    CHECK(spa.getPresses() == presses);
+    CHECK(!spa.isPowerOn());
+    CHECK(results(client).empty());
+
+    // A live flood coalesces into the last value of each topic
+    host_mqtt_connect(client);
+    const int LIVE = 500;
+    for (int i = 0; i < LIVE; i++) {
+        host_mqtt_deliver(client, MQTT_TOPIC::CMD_POWER, i == LIVE - 1 || i % 2 ? "on" : "off", false);
+        host_mqtt_deliver(client, MQTT_TOPIC::CMD_WATER, std::to_string(30 + i % 7).c_str(), false);
+    }
+    CHECK(waitFor([] { return spa.isPowerOn() && spa.getSetpoint() == 30 + (LIVE - 1) % 7; }, 30000));
+    CHECK(waitFor([&] { return !results(client).empty(); }, 5000));
+    vTaskDelay(pdMS_TO_TICKS(500));
+    std::vector<std::string> done = results(client);
+    // The first message can start a batch before the rest arrive, the rest
+    // end up in at most one more
+    CHECK(done.size() <= 2);
+    CHECK(done.back().find("\"result\":\"ok\"") != std::string::npos);
+    CHECK(mqtt.getCoalescedCount() >= 2 * LIVE - 4);
+    CHECK(mqtt.getRetainedIgnoredCount() == retained);
+
+    printf("%zu messages republished on reconnect\n", republished);
+    printf("retained ignored %lu over %d reconnects, %d live messages ran as %zu batches (%lu coalesced), %lu presses\n",
+           (unsigned long)retained, RECONNECTS, 2 * LIVE, done.size(), (unsigned long)mqtt.getCoalescedCount(),
+           (unsigned long)(spa.getPresses() - presses));
+    return exitNow(0);
+}
@@ -0,0 +1,279 @@
+// MqttPublisher against a real broker: mosquitto on a free local port, the
+// TCP client from stubs/mqtt_net.cpp in place of the in-process one, and a
+// second client on "#" playing the home automation side. Covers what only a
+// broker does: retained commands replayed on every subscribe, the last will
+// on a dropped link, reconnects, and result publishes while the outbox is
+// full. The live and retained command floods of test_mqtt run here too.
+//
+//   test_mqtt_broker <path to mosquitto>
+// Without a path (mosquitto not installed) the test is skipped.
+#include "test_util.h"
+#include "host_mqtt_net.h"
+#include "mqtt_publisher.h"
+#include "PureSpaService.h"
+#include "EmulatorBusBackend.h"
+#include "SpaEmulator.h"
+#include "common.h"
+#include "esp_log.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static const int SKIPPED = 77;  // SKIP_RETURN_CODE in CMakeLists.txt
+
+static const char* const FLOOD_TOPICS[] = {
+    MQTT_TOPIC::CMD_POWER, MQTT_TOPIC::CMD_FILTER, MQTT_TOPIC::CMD_HEATER,
+    MQTT_TOPIC::CMD_BUBBLE, MQTT_TOPIC::CMD_WATER,
+};
+static const uint32_t COMMAND_TOPICS = sizeof(FLOOD_TOPICS) / sizeof(FLOOD_TOPICS[0]);
+
+static pid_t s_broker = 0;
+
+static int finish(int rc)
+{
+    if (s_broker > 0) {
+        kill(s_broker, SIGTERM);
+        waitpid(s_broker, nullptr, 0);
+    }
+    return exitNow(rc);
+}
+
+#undef CHECK
+#define CHECK(cond) do {                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            finish(1);                                                          \
+        }                                                                       \
+    } while (0)
+
+static uint16_t freePort()
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(sock, (sockaddr*)&addr, &len) != 0) {
+        close(sock);
+        return 0;
+    }
+    close(sock);
+    return ntohs(addr.sin_port);
+}
+
+static bool accepting(uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    bool ok = connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0;
+    close(sock);
+    return ok;
+}
+
+// mosquitto -p <port>, killed with us if we die first
+static bool startBroker(const char* path, uint16_t port)
+{
+    char portArg[8];
+    snprintf(portArg, sizeof(portArg), "%u", (unsigned)port);
+    pid_t parent = getpid();
+    s_broker = fork();
+    if (s_broker < 0) return false;
+    if (s_broker == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != parent) _exit(1);
+        execl(path, path, "-p", portArg, (char*)nullptr);
+        _exit(127);
+    }
+    return waitFor([port] { return accepting(port); }, 5000);
+}
+
+// Everything the broker sent to the "#" subscriber, in order
+struct Observer {
+    struct Message {
+        std::string topic;
+        std::string payload;
+    };
+
+    esp_mqtt_client_handle_t client = nullptr;
+    std::mutex mutex;
+    std::vector<Message> messages;
+
+    static void handler(void* arg, esp_event_base_t base, int32_t id, void* data)
+    {
+        Observer& self = *static_cast<Observer*>(arg);
+        esp_mqtt_event_handle_t event = static_cast<esp_mqtt_event_handle_t>(data);
+        if (id == MQTT_EVENT_CONNECTED) {
+            esp_mqtt_client_subscribe(self.client, "#", 1);
+        } else if (id == MQTT_EVENT_DATA) {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            self.messages.push_back({ std::string(event->topic, event->topic_len),
+                                      std::string(event->data, event->data_len) });
+        }
+    }
+
+    void publish(const char* topic, const std::string& payload, bool retain = false)
+    {
+        CHECK(esp_mqtt_client_publish(client, topic, payload.c_str(), (int)payload.size(), 0, retain) >= 0);
+    }
+
+    std::vector<std::string> on(const char* topic)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> out;
+        for (const Message& msg : messages) {
+            if (msg.topic == topic) out.push_back(msg.payload);
+        }
+        return out;
+    }
+
+    std::string last(const char* topic)
+    {
+        std::vector<std::string> all = on(topic);
+        return all.empty() ? std::string() : all.back();
+    }
+
+    size_t count(const char* topic, const char* payloadPart)
+    {
+        size_t n = 0;
+        for (const std::string& payload : on(topic)) {
+            if (payload.find(payloadPart) != std::string::npos) n++;
+        }
+        return n;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argv[1][0] == '\0') {
+        printf("mosquitto not found, skipped\n");
+        return exitNow(SKIPPED);
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    uint16_t port = freePort();
+    CHECK(port != 0);
+    if (!startBroker(argv[1], port)) {
+        fprintf(stderr, "%s -p %u did not start\n", argv[1], (unsigned)port);
+        return finish(1);
+    }
+    char uri[40];
+    snprintf(uri, sizeof(uri), "mqtt://127.0.0.1:%u", (unsigned)port);
+    setenv("HOST_MQTT_URI", uri, 1);
+    setenv("HOST_MQTT_RECONNECT_MS", "200", 1);
+
+    // Retained commands somebody left on the broker, before the spa connects
+    static Observer observer;
+    esp_mqtt_client_config_t config = {};
+    observer.client = esp_mqtt_client_init(&config);
+    esp_mqtt_client_register_event(observer.client, MQTT_EVENT_ANY, Observer::handler, &observer);
+    CHECK(esp_mqtt_client_start(observer.client) == ESP_OK);
+    CHECK(waitFor([] { return host_mqtt_net_connected(observer.client); }, 5000));
+    for (const char* topic : FLOOD_TOPICS) {
+        observer.publish(topic, topic == MQTT_TOPIC::CMD_WATER ? "25" : "on", true);
+    }
+    CHECK(waitFor([] {
+        for (const char* topic : FLOOD_TOPICS) {
+            if (observer.on(topic).empty()) return false;
+        }
+        return true;
+    }, 5000));
+
+    static SpaEmulator spa;
+    spa.setWaterTemp(30);
+    spa.setSetpoint(38);
+    static EmulatorBusBackend bus(spa, 1);
+    PureSpaService& service = PureSpaService::getInstance();
+    service.init(bus);
+    MqttPublisher& mqtt = MqttPublisher::getInstance();
+    mqtt.start();
+    esp_mqtt_client_handle_t client = host_mqtt_net_client();
+    CHECK(client != nullptr && client != observer.client);
+
+    // The session announces the spa; the retained commands replayed on its
+    // subscribe are ignored
+    CHECK(waitFor([] { return observer.last(MQTT_TOPIC::POWER) == "off"; }, 10000));
+    CHECK(observer.last(MQTT_TOPIC::STATE) == "online");
+    CHECK(observer.last(MQTT_TOPIC::VERSION) == CONFIG::WIFI_VERSION);
+    CHECK(waitFor([&] { return mqtt.getRetainedIgnoredCount() == COMMAND_TOPICS; }, 5000));
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    CHECK(spa.getPresses() == 0);
+    CHECK(!spa.isPowerOn() && spa.getSetpoint() == 38);
+    CHECK(observer.on(MQTT_TOPIC::CMD_RESULT).empty());
+
+    // A live flood coalesces into the last value of each topic. Messages
+    // arrive over TCP while a batch runs, so there can be a few more batches
+    // than in test_mqtt, but nowhere near one per message. The bubble command
+    // is read last: once its batch reports, no flood command is left pending.
+    const int LIVE = 500;
+    for (int i = 0; i < LIVE; i++) {
+        observer.publish(MQTT_TOPIC::CMD_POWER, i == LIVE - 1 || i % 2 ? "on" : "off");
+        observer.publish(MQTT_TOPIC::CMD_WATER, std::to_string(30 + i % 7));
+    }
+    observer.publish(MQTT_TOPIC::CMD_BUBBLE, "on");
+    CHECK(waitFor([] { return observer.count(MQTT_TOPIC::CMD_RESULT, "\"bubble\":1") > 0; }, 60000));
+    const int finalSetpoint = 30 + (LIVE - 1) % 7;
+    CHECK(spa.isPowerOn() && spa.isBubbleOn() && spa.getSetpoint() == finalSetpoint);
+    size_t batches = observer.on(MQTT_TOPIC::CMD_RESULT).size();
+    CHECK(batches <= 4);
+    CHECK(observer.last(MQTT_TOPIC::CMD_RESULT).find("\"result\":\"ok\"") != std::string::npos);
+    CHECK(mqtt.getCoalescedCount() >= 2 * LIVE - 10);
+    CHECK(waitFor([] { return observer.last(MQTT_TOPIC::POWER) == "on"; }, 10000));
+
+    // Dropped links: the broker publishes the will, the reconnect announces
+    // the spa again and its subscribe replays the retained commands, which
+    // still must not run
+    const int RECONNECTS = 3;
+    const uint32_t presses = spa.getPresses();
+    for (int round = 1; round <= RECONNECTS; round++) {
+        size_t states = observer.on(MQTT_TOPIC::STATE).size();
+        host_mqtt_net_drop(client);
+        CHECK(waitFor([&] { return observer.on(MQTT_TOPIC::STATE).size() > states; }, 5000));
+        CHECK(observer.last(MQTT_TOPIC::STATE) == "offline");
+        CHECK(waitFor([&] { return observer.on(MQTT_TOPIC::STATE).size() > states + 1; }, 5000));
+        CHECK(observer.last(MQTT_TOPIC::STATE) == "online");
+        CHECK(waitFor([&] { return mqtt.getRetainedIgnoredCount() == COMMAND_TOPICS * (round + 1); }, 5000));
+    }
+    CHECK(mqtt.isConnected());
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    CHECK(spa.getPresses() == presses);
+    CHECK(spa.getSetpoint() == finalSetpoint);
+    CHECK(observer.on(MQTT_TOPIC::CMD_RESULT).size() == batches);
+
+    // Outbox full on a stalled link: the invalid-command replies go through
+    // the outbox and are dropped past its limit, while QoS 0 status and batch
+    // results are still written. The filter command after the flood is read
+    // after every invalid one, so its result means all of them were handled.
+    const size_t OUTBOX_LIMIT = 256;
+    const int INVALID = 50;
+    host_mqtt_net_set_outbox_limit(client, OUTBOX_LIMIT);
+    host_mqtt_net_hold_outbox(client, true);
+    for (int i = 0; i < INVALID; i++) observer.publish(MQTT_TOPIC::CMD_HEATER, "maybe");
+    observer.publish(MQTT_TOPIC::CMD_FILTER, "on");
+    CHECK(waitFor([] { return observer.count(MQTT_TOPIC::CMD_RESULT, "\"filter\":1") > 0; }, 10000));
+    CHECK(waitFor([] { return observer.last(MQTT_TOPIC::FILTER) == "on"; }, 10000));
+    CHECK(observer.count(MQTT_TOPIC::CMD_RESULT, "invalid") == 0);
+    int outbox = esp_mqtt_client_get_outbox_size(client);
+    CHECK(outbox > 0 && (size_t)outbox <= OUTBOX_LIMIT);
+    host_mqtt_net_hold_outbox(client, false);
+    CHECK(waitFor([&] { return esp_mqtt_client_get_outbox_size(client) == 0; }, 5000));
+    CHECK(waitFor([] { return observer.count(MQTT_TOPIC::CMD_RESULT, "invalid") > 0; }, 5000));
+    vTaskDelay(pdMS_TO_TICKS(300));
+    size_t invalid = observer.count(MQTT_TOPIC::CMD_RESULT, "invalid");
+    CHECK(invalid < (size_t)INVALID);
+
+    printf("live flood: %d messages ran as %zu batches (%lu coalesced)\n", 2 * LIVE, batches,
+           (unsigned long)mqtt.getCoalescedCount());
+    printf("retained ignored %lu over %d reconnects\n", (unsigned long)mqtt.getRetainedIgnoredCount(), RECONNECTS);
+    printf("outbox full: %zu of %d invalid-command replies sent (%d bytes held)\n", invalid, INVALID, outbox);
+    return finish(0);
+}
@@ -0,0 +1,128 @@
+// PureSpaService end to end against the emulated mainboard: the decoder reads
+// the emulator's frames, commands go out as button acknowledgements and the
+// emulator's state comes back through the status cache and the HTTP API.
+#include "test_util.h"
+#include "host_httpd.h"
+#include "PureSpaService.h"
+#include "EmulatorBusBackend.h"
+#include "SpaEmulator.h"
+#include "web_server.h"
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+static std::mutex s_statusMutex;
+static PureSpaService::StatusSnapshot s_status = {};
+
+static void onStatus(void* ctx, const PureSpaService::StatusSnapshot& status)
+{
+    std::lock_guard<std::mutex> lock(s_statusMutex);
+    s_status = status;
+}
+
+static PureSpaService::StatusSnapshot status()
+{
+    std::lock_guard<std::mutex> lock(s_statusMutex);
+    return s_status;
+}
+
+static std::string statusJson(PureSpaService& service)
+{
+    std::string json;
+    service.withStatusJson([&](const char* doc, size_t len, uint32_t version, uint32_t renders) {
+        json.assign(doc, len);
+    });
+    return json;
+}
+
+int main()
+{
+    static SpaEmulator spa;
+    spa.setWaterTemp(30);
+    spa.setSetpoint(38);
+    // At the bus rate: button presses are timed in real milliseconds
+    static EmulatorBusBackend bus(spa, 1);
+
+    PureSpaService& service = PureSpaService::getInstance();
+    service.setStatusListener(onStatus, nullptr);
+    service.init(bus);
+    WebServer::getInstance().start();
+
+    // The decoder locks on and reports the switched off spa
+    CHECK(waitFor([] { return status().online; }, 5000));
+    CHECK(status().power == 0);
+    CHECK(strstr(statusJson(service).c_str(), "\"online\":true") != nullptr);
+
+    // Power on shows the water temperature. A long-poll parked before is
+    // answered with the change instead of waiting out its 20 s.
+    char longPoll[64];
+    snprintf(longPoll, sizeof(longPoll), "/api/status?since=%lu&wait=20000", (unsigned long)service.getStatusVersion());
+    HostResponse woken;
+    TickType_t parkedAt = xTaskGetTickCount();
+    std::thread poller([&] { woken = host_httpd_request(HTTP_GET, longPoll); });
+    CHECK(waitFor([] { return WebServer::getInstance().getParkedPollCount() == 1; }, 1000));
+    service.setPower(true, "test");
+    poller.join();
+    CHECK(woken.status == 200);
+    CHECK(xTaskGetTickCount() - parkedAt < pdMS_TO_TICKS(10000));
+    CHECK(waitFor([] { return spa.isPowerOn(); }, 5000));
+    CHECK(waitFor([] { return status().power == 1 && status().actTemp == 30; }, 5000));
+
+    // A batch through the API: the heater brings the filter with it
+    HostResponse batch = host_httpd_request(HTTP_POST, "/api/control/batch",
+        "{\"commands\":[{\"cmd\":\"heater\",\"value\":true},{\"cmd\":\"bubble\",\"value\":true}]}");
+    CHECK(batch.status == 200);
+    CHECK(batch.body.find("\"status\":\"ok\"") != std::string::npos);
+    CHECK(spa.isHeaterOn() && spa.isFilterOn() && spa.isBubbleOn());
+    CHECK(waitFor([] { return status().heater == 1 && status().filter == 1 && status().bubble == 1; }, 5000));
+
+    // The set point is stepped with temp up/down until the display agrees
+    service.setTargetTemp(34);
+    CHECK(waitFor([] { return spa.getSetpoint() == 34; }, 15000));
+    CHECK(waitFor([] { return status().setTemp == 34; }, 15000));
+
+    // Out of range values are refused before reaching the bus
+    HostResponse hot = host_httpd_request(HTTP_POST, "/api/control", "{\"cmd\":\"temp\",\"value\":99}");
+    CHECK(hot.status == 400);
+    CHECK(spa.getSetpoint() == 34);
+
+    // Losing the water flow trips E90, shown instead of the temperature
+    spa.setWaterFlow(false);
+    CHECK(waitFor([] { return strcmp(status().error, "E90") == 0; }, 10000));
+    CHECK(spa.getError() == "E90");
+
+    // Power clears it and switches everything off. The decoder keeps the code
+    // while the display is blank and drops it with the next temperature.
+    spa.setWaterFlow(true);
+    service.setPower(false, "test");
+    CHECK(waitFor([] { return status().power == 0; }, 10000));
+    CHECK(!spa.isPowerOn() && !spa.isFilterOn() && !spa.isHeaterOn());
+    CHECK(spa.getError().empty());
+    service.setPower(true, "test");
+    CHECK(waitFor([] { return status().power == 1 && status().error[0] == '\0'; }, 10000));
+
+    HostResponse get = host_httpd_request(HTTP_GET, "/api/status");
+    CHECK(get.status == 200);
+    CHECK(get.body.find("\"power\":true") != std::string::npos);
+    CHECK(!get.header("ETag").empty());
+
+    // A metrics re-sample (clock, heap, uptime) keeps the version but not the
+    // ETag, so revalidating clients do not get a 304 with a frozen clock
+    std::string etag = get.header("ETag");
+    std::string versionPart = etag.substr(0, etag.find('.'));
+    HostResponse resampled;
+    CHECK(waitFor([&] {
+        HostRequestOptions options = {};
+        options.headers.push_back({ "If-None-Match", etag });
+        resampled = host_httpd_request(HTTP_GET, "/api/status", std::string(), options);
+        return resampled.status == 200 && resampled.header("ETag").compare(0, versionPart.size(), versionPart) == 0;
+    }, 7000));
+    CHECK(resampled.header("ETag") != etag);
+    HostRequestOptions revalidate = {};
+    revalidate.headers.push_back({ "If-None-Match", resampled.header("ETag") });
+    CHECK(host_httpd_request(HTTP_GET, "/api/status", std::string(), revalidate).status == 304);
+
+    printf("scenario: %u emulated cycles, %u presses\n", (unsigned)bus.getCycles(), (unsigned)spa.getPresses());
+    return exitNow(0);
+}
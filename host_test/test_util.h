@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Ends a test. The service, bus and web server tasks are still running, so
+// the static destructors they would race with are skipped.
+inline int exitNow(int rc)
+{
+    fflush(stdout);
+    fflush(stderr);
+    _Exit(rc);
+}
+
+// Minimal checks for the host tests: the first failure ends the process
+#define CHECK(cond) do {                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            exitNow(1);                                                         \
+        }                                                                       \
+    } while (0)
+
+// Polls cond every millisecond, false when timeoutMs passes first
+template<typename F>
+bool waitFor(F cond, uint32_t timeoutMs)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (!cond()) {
+        if (xTaskGetTickCount() - start > pdMS_TO_TICKS(timeoutMs)) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
@@ -3,20 +3,20 @@
 #include <ctype.h>
 #include <cstring>
 #include "wifi_manager.h"
+#include "http_body.h"
+#include "static_assets.h"
 #include "esp_system.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 static const char *TAG = "CaptivePortal";
 
-extern const uint8_t config_html_gz_start[] asm("_binary_config_html_gz_start");
-extern const uint8_t config_html_gz_end[]   asm("_binary_config_html_gz_end");
-
 void CaptivePortal::start() {
     if (_server != NULL) return;
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.ctrl_port = 32769;
+    config.uri_match_fn = httpd_uri_match_wildcard;
 
     static const httpd_uri_t config_get = {
         .uri       = "/config",
@@ -32,9 +32,18 @@ void CaptivePortal::start() {
         .user_ctx  = NULL
     };
 
+    // Hashed assets referenced by the config page (favicon)
+    static const httpd_uri_t static_files = {
+        .uri       = "/static/*",
+        .method    = HTTP_GET,
+        .handler   = staticAssetHandler,
+        .user_ctx  = NULL
+    };
+
     if (httpd_start(&_server, &config) == ESP_OK) {
         httpd_register_uri_handler(_server, &config_get);
         httpd_register_uri_handler(_server, &config_post);
+        httpd_register_uri_handler(_server, &static_files);
         httpd_register_err_handler(_server, HTTPD_404_NOT_FOUND, http404ErrorHandler);
         ESP_LOGI(TAG, "Captive Portal started");
     }
@@ -73,23 +82,12 @@ void CaptivePortal::urlDecode(char *dst, const char *src) {
 }
 
 esp_err_t CaptivePortal::configGetHandler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-    httpd_resp_send(req, (const char *)config_html_gz_start, config_html_gz_end - config_html_gz_start);
-    return ESP_OK;
+    return sendStaticAsset(req, *findStaticAsset("/config"));
 }
 
 esp_err_t CaptivePortal::configPostHandler(httpd_req_t *req) {
-    char buf[128];
-    int ret, remaining = req->content_len;
-    if (remaining >= sizeof(buf)) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Content too long");
-        return ESP_FAIL;
-    }
-
-    ret = httpd_req_recv(req, buf, remaining);
-    if (ret <= 0) return ESP_FAIL;
-    buf[ret] = '\0';
+    char buf[384]; // fits fully percent-encoded 32 byte SSID and 64 byte password
+    if (readBodyString(req, buf, sizeof(buf)) != ESP_OK) return ESP_FAIL;
 
     char ssid[32] = {0};
     char pass[64] = {0};
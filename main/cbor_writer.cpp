@@ -0,0 +1,115 @@
+#include "cbor_writer.h"
+#include <cstring>
+
+static const uint8_t MAJOR_UINT = 0;
+static const uint8_t MAJOR_NINT = 1;
+static const uint8_t MAJOR_TEXT = 3;
+static const char CBOR_ARRAY_INDEF = (char)0x9F;
+static const char CBOR_MAP_INDEF = (char)0xBF;
+static const char CBOR_FALSE = (char)0xF4;
+static const char CBOR_TRUE = (char)0xF5;
+static const char CBOR_BREAK = (char)0xFF;
+
+CborWriter::CborWriter(char* buf, size_t size, FlushFn flush, void* ctx)
+    : DocWriter(buf, size, flush, ctx) {}
+
+CborWriter& CborWriter::beginObject(const char* k) {
+    if (k) string(k);
+    raw(CBOR_MAP_INDEF);
+    return *this;
+}
+
+CborWriter& CborWriter::endObject() {
+    raw(CBOR_BREAK);
+    return *this;
+}
+
+CborWriter& CborWriter::beginArray(const char* k) {
+    if (k) string(k);
+    raw(CBOR_ARRAY_INDEF);
+    return *this;
+}
+
+CborWriter& CborWriter::endArray() {
+    raw(CBOR_BREAK);
+    return *this;
+}
+
+CborWriter& CborWriter::field(const char* k, bool v) {
+    string(k);
+    raw(v ? CBOR_TRUE : CBOR_FALSE);
+    return *this;
+}
+
+CborWriter& CborWriter::field(const char* k, long long v) {
+    string(k);
+    integer(v);
+    return *this;
+}
+
+CborWriter& CborWriter::field(const char* k, const char* v) {
+    string(k);
+    string(v);
+    return *this;
+}
+
+CborWriter& CborWriter::rawField(const char* k, const char* cbor, size_t len) {
+    string(k);
+    raw(cbor, len);
+    return *this;
+}
+
+CborWriter& CborWriter::value(bool v) {
+    raw(v ? CBOR_TRUE : CBOR_FALSE);
+    return *this;
+}
+
+CborWriter& CborWriter::value(long long v) {
+    integer(v);
+    return *this;
+}
+
+CborWriter& CborWriter::value(const char* v) {
+    string(v);
+    return *this;
+}
+
+void CborWriter::head(uint8_t major, uint64_t v) {
+    char tmp[9];
+    size_t n;
+    major <<= 5;
+    if (v < 24) {
+        tmp[0] = major | v;
+        n = 1;
+    } else if (v <= 0xFF) {
+        tmp[0] = major | 24;
+        n = 2;
+    } else if (v <= 0xFFFF) {
+        tmp[0] = major | 25;
+        n = 3;
+    } else if (v <= 0xFFFFFFFFULL) {
+        tmp[0] = major | 26;
+        n = 5;
+    } else {
+        tmp[0] = major | 27;
+        n = 9;
+    }
+    // Argument follows the initial byte in network byte order
+    for (size_t i = n - 1; i > 0; i--) {
+        tmp[i] = (char)(v & 0xFF);
+        v >>= 8;
+    }
+    raw(tmp, n);
+}
+
+void CborWriter::integer(long long v) {
+    // Negative integers encode -1 - v, which cannot overflow for any long long
+    if (v < 0) head(MAJOR_NINT, (uint64_t)(-1 - v));
+    else head(MAJOR_UINT, (uint64_t)v);
+}
+
+void CborWriter::string(const char* s) {
+    size_t len = s ? strlen(s) : 0;
+    head(MAJOR_TEXT, len);
+    raw(s, len);
+}
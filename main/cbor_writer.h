@@ -0,0 +1,42 @@
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "doc_writer.h"
+
+// Streaming CBOR (RFC 8949) writer producing the same documents as JsonWriter.
+// Objects and arrays use indefinite-length encoding so nothing has to be
+// counted up front; integers use the shortest head.
+class CborWriter : public DocWriter {
+public:
+    CborWriter(char* buf, size_t size, FlushFn flush = nullptr, void* ctx = nullptr);
+
+    using DocWriter::field;
+    using DocWriter::value;
+
+    CborWriter& beginObject(const char* key = nullptr) override;
+    CborWriter& endObject() override;
+    CborWriter& beginArray(const char* key = nullptr) override;
+    CborWriter& endArray() override;
+
+    CborWriter& field(const char* key, bool value) override;
+    CborWriter& field(const char* key, long long value) override;
+    CborWriter& field(const char* key, const char* value) override;
+
+    // Member whose value is already a complete CBOR data item
+    CborWriter& rawField(const char* key, const char* cbor, size_t len) override;
+
+    CborWriter& value(bool value) override;
+    CborWriter& value(long long value) override;
+    CborWriter& value(const char* value) override;
+
+    const char* contentType() const override { return "application/cbor"; }
+
+private:
+    void head(uint8_t major, uint64_t value);
+    void integer(long long v);
+    void string(const char* s);
+};
+
+#endif // CBOR_WRITER_H
@@ -0,0 +1,208 @@
+#include "delta_patcher.h"
+#include <esp_log.h>
+#include <esp_ota_ops.h>
+#include <cstring>
+
+static const char *TAG = "DeltaPatcher";
+
+static inline uint32_t readU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+DeltaPatcher::DeltaPatcher(OutputFn output, void* ctx)
+    : _output(output), _ctx(ctx), _inflater(onInflated, this) {
+    mbedtls_sha256_init(&_sha);
+}
+
+DeltaPatcher::~DeltaPatcher() {
+    mbedtls_sha256_free(&_sha);
+}
+
+esp_err_t DeltaPatcher::init() {
+    _source = esp_ota_get_running_partition();
+    if (_source == NULL) {
+        ESP_LOGE(TAG, "Running partition not found");
+        return fail(ESP_ERR_NOT_FOUND);
+    }
+    esp_err_t err = _inflater.init();
+    if (err != ESP_OK) return fail(err);
+    mbedtls_sha256_starts(&_sha, 0);
+    return ESP_OK;
+}
+
+esp_err_t DeltaPatcher::fail(esp_err_t err) {
+    _state = State::ERROR;
+    return err;
+}
+
+esp_err_t DeltaPatcher::feed(const uint8_t* data, size_t len) {
+    if (_state == State::ERROR) return ESP_FAIL;
+    if (_state == State::HEADER) {
+        size_t n = HEADER_SIZE - _headerPos;
+        if (n > len) n = len;
+        memcpy(_header + _headerPos, data, n);
+        _headerPos += n;
+        data += n;
+        len -= n;
+        if (_headerPos < HEADER_SIZE) return ESP_OK;
+        esp_err_t err = parseHeader();
+        if (err != ESP_OK) return fail(err);
+    }
+    if (len == 0) return ESP_OK;
+    esp_err_t err = _inflater.feed(data, len);
+    if (err != ESP_OK && _state != State::ERROR) _state = State::ERROR;
+    return err;
+}
+
+esp_err_t DeltaPatcher::parseHeader() {
+    if (!isDelta(_header, HEADER_SIZE) || _header[4] != VERSION) {
+        ESP_LOGE(TAG, "Unsupported patch format");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    _oldSize = readU32(_header + 8);
+    _newSize = readU32(_header + 44);
+    ESP_LOGI(TAG, "Patch %lu -> %lu bytes against partition %s", (unsigned long)_oldSize,
+             (unsigned long)_newSize, _source->label);
+
+    esp_err_t err = verifySource();
+    if (err != ESP_OK) return err;
+    _state = State::CONTROL;
+    return ESP_OK;
+}
+
+// The patch is only valid for the exact image it was computed against
+esp_err_t DeltaPatcher::verifySource() {
+    if (_oldSize > _source->size) {
+        ESP_LOGE(TAG, "Patch base is larger than the running partition");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    esp_err_t err = ESP_OK;
+    for (uint32_t pos = 0; pos < _oldSize && err == ESP_OK; pos += OLD_CHUNK) {
+        size_t n = _oldSize - pos < OLD_CHUNK ? _oldSize - pos : OLD_CHUNK;
+        err = esp_partition_read(_source, pos, _oldBuf, n);
+        if (err == ESP_OK) mbedtls_sha256_update(&sha, _oldBuf, n);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Reading running partition failed (%s)", esp_err_to_name(err));
+        return err;
+    }
+    if (memcmp(digest, _header + 12, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Patch was not made for the running firmware");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+esp_err_t DeltaPatcher::onInflated(void* ctx, const char* data, size_t len) {
+    return static_cast<DeltaPatcher*>(ctx)->applyRecords((const uint8_t*)data, len);
+}
+
+esp_err_t DeltaPatcher::applyRecords(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        switch (_state) {
+            case State::CONTROL: {
+                size_t n = CONTROL_SIZE - _controlPos;
+                if (n > len) n = len;
+                memcpy(_control + _controlPos, data, n);
+                _controlPos += n;
+                data += n;
+                len -= n;
+                if (_controlPos < CONTROL_SIZE) break;
+                _controlPos = 0;
+                _diffLeft = readU32(_control);
+                _extraLeft = readU32(_control + 4);
+                _seek = (int32_t)readU32(_control + 8);
+                if (_diffLeft > _oldSize - _oldPos || _diffLeft + _extraLeft > _newSize - _produced) {
+                    ESP_LOGE(TAG, "Patch record out of bounds");
+                    return fail(ESP_ERR_INVALID_SIZE);
+                }
+                _state = State::DIFF;
+                esp_err_t err = endRecordPart();
+                if (err != ESP_OK) return err;
+                break;
+            }
+
+            case State::DIFF: {
+                size_t n = _diffLeft < OLD_CHUNK ? _diffLeft : OLD_CHUNK;
+                if (n > len) n = len;
+                esp_err_t err = esp_partition_read(_source, _oldPos, _oldBuf, n);
+                if (err != ESP_OK) return fail(err);
+                for (size_t i = 0; i < n; i++) _oldBuf[i] += data[i];
+                err = emit(_oldBuf, n);
+                if (err != ESP_OK) return err;
+                _oldPos += n;
+                _diffLeft -= n;
+                data += n;
+                len -= n;
+                err = endRecordPart();
+                if (err != ESP_OK) return err;
+                break;
+            }
+
+            case State::EXTRA: {
+                size_t n = _extraLeft < len ? _extraLeft : len;
+                esp_err_t err = emit(data, n);
+                if (err != ESP_OK) return err;
+                _extraLeft -= n;
+                data += n;
+                len -= n;
+                err = endRecordPart();
+                if (err != ESP_OK) return err;
+                break;
+            }
+
+            default:
+                return fail(ESP_FAIL);
+        }
+    }
+    return ESP_OK;
+}
+
+// Advances past empty or finished diff/extra parts of the current record
+esp_err_t DeltaPatcher::endRecordPart() {
+    if (_state == State::DIFF && _diffLeft == 0) _state = State::EXTRA;
+    if (_state == State::EXTRA && _extraLeft == 0) {
+        int64_t pos = (int64_t)_oldPos + _seek;
+        if (pos < 0 || pos > _oldSize) {
+            ESP_LOGE(TAG, "Patch seek out of bounds");
+            return fail(ESP_ERR_INVALID_SIZE);
+        }
+        _oldPos = pos;
+        _state = State::CONTROL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t DeltaPatcher::emit(const uint8_t* data, size_t len) {
+    mbedtls_sha256_update(&_sha, data, len);
+    _produced += len;
+    esp_err_t err = _output(_ctx, (const char*)data, len);
+    return err == ESP_OK ? ESP_OK : fail(err);
+}
+
+esp_err_t DeltaPatcher::finish() {
+    if (_state != State::CONTROL || _controlPos != 0) {
+        ESP_LOGE(TAG, "Truncated patch");
+        return fail(ESP_ERR_INVALID_SIZE);
+    }
+    esp_err_t err = _inflater.finish();
+    if (err != ESP_OK) return fail(err);
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&_sha, digest);
+    if (_produced != _newSize || memcmp(digest, _header + 48, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Patched image does not match (%lu of %lu bytes)", (unsigned long)_produced,
+                 (unsigned long)_newSize);
+        return fail(ESP_ERR_INVALID_CRC);
+    }
+    ESP_LOGI(TAG, "Patched image verified (%lu bytes)", (unsigned long)_produced);
+    return ESP_OK;
+}
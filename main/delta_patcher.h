@@ -0,0 +1,82 @@
+#ifndef DELTA_PATCHER_H
+#define DELTA_PATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+#include "gzip_inflater.h"
+
+// Rebuilds a new firmware image from the running partition and a delta patch
+// produced by tools/ota_delta.py. Patch layout (little endian):
+//
+//   "PSDL" | version u8 | 3 reserved | old size u32 | old sha256 | new size u32 | new sha256
+//   gzip( records )
+//   record = diff len u32 | extra len u32 | seek i32 | diff bytes | extra bytes
+//
+// Diff bytes are added to the old image at the current old position, extra
+// bytes are copied as-is, then the old position moves by seek (bsdiff style).
+// The patch streams through; the running image is read back in small pieces.
+class DeltaPatcher {
+public:
+    typedef esp_err_t (*OutputFn)(void* ctx, const char* data, size_t len);
+
+    static const size_t HEADER_SIZE = 80;
+
+    DeltaPatcher(OutputFn output, void* ctx);
+    ~DeltaPatcher();
+
+    DeltaPatcher(const DeltaPatcher&) = delete;
+    DeltaPatcher& operator=(const DeltaPatcher&) = delete;
+
+    esp_err_t init();
+    esp_err_t feed(const uint8_t* data, size_t len);
+    // Checks that exactly the announced image was produced and its sha256 matches
+    esp_err_t finish();
+
+    uint32_t newSize() const { return _newSize; }
+    size_t outputSize() const { return _produced; }
+
+    static bool isDelta(const uint8_t* data, size_t len) {
+        return len >= 4 && data[0] == 'P' && data[1] == 'S' && data[2] == 'D' && data[3] == 'L';
+    }
+
+private:
+    enum class State : uint8_t { HEADER, CONTROL, DIFF, EXTRA, ERROR };
+
+    static const uint8_t VERSION = 1;
+    static const size_t CONTROL_SIZE = 12;
+    static const size_t OLD_CHUNK = 512;
+
+    static esp_err_t onInflated(void* ctx, const char* data, size_t len);
+    esp_err_t parseHeader();
+    esp_err_t verifySource();
+    esp_err_t applyRecords(const uint8_t* data, size_t len);
+    esp_err_t endRecordPart();
+    esp_err_t emit(const uint8_t* data, size_t len);
+    esp_err_t fail(esp_err_t err);
+
+    OutputFn _output;
+    void* _ctx;
+    GzipInflater _inflater;
+    const esp_partition_t* _source = nullptr;
+    mbedtls_sha256_context _sha;
+
+    State _state = State::HEADER;
+    uint8_t _header[HEADER_SIZE];
+    size_t _headerPos = 0;
+    uint8_t _control[CONTROL_SIZE];
+    size_t _controlPos = 0;
+    uint8_t _oldBuf[OLD_CHUNK];
+
+    uint32_t _oldSize = 0;
+    uint32_t _newSize = 0;
+    uint32_t _oldPos = 0;
+    uint32_t _diffLeft = 0;
+    uint32_t _extraLeft = 0;
+    int32_t _seek = 0;
+    size_t _produced = 0;
+};
+
+#endif // DELTA_PATCHER_H
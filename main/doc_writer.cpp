@@ -0,0 +1,57 @@
+#include "doc_writer.h"
+#include <cstring>
+
+DocWriter::DocWriter(char* buf, size_t size, FlushFn flush, void* ctx)
+    : _err(ESP_OK), _buf(buf), _size(size), _len(0), _total(0), _flush(flush), _ctx(ctx) {}
+
+esp_err_t DocWriter::finish() {
+    if (_flush && _len > 0) flush();
+    if (!_flush && _err == ESP_OK && _len < _size) _buf[_len] = '\0';
+    return _err;
+}
+
+esp_err_t DocWriter::stringSink(void* ctx, const char* data, size_t len) {
+    static_cast<std::string*>(ctx)->append(data, len);
+    return ESP_OK;
+}
+
+void DocWriter::raw(char c) {
+    if (_err != ESP_OK) return;
+    // Keep one byte spare so unflushed output can always be NUL terminated
+    if (_len + 1 >= _size) {
+        if (!_flush) {
+            _err = ESP_ERR_NO_MEM;
+            return;
+        }
+        flush();
+        if (_err != ESP_OK) return;
+    }
+    _buf[_len++] = c;
+}
+
+void DocWriter::raw(const char* s, size_t n) {
+    while (n > 0 && _err == ESP_OK) {
+        size_t room = _size - 1 - _len;
+        if (room == 0) {
+            if (!_flush) {
+                _err = ESP_ERR_NO_MEM;
+                return;
+            }
+            flush();
+            continue;
+        }
+        size_t chunk = n < room ? n : room;
+        memcpy(_buf + _len, s, chunk);
+        _len += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+void DocWriter::flush() {
+    if (_len == 0) return;
+    esp_err_t err = _flush(_ctx, _buf, _len);
+    _total += _len;
+    _len = 0;
+    if (err != ESP_OK) _err = err;
+}
@@ -0,0 +1,81 @@
+#ifndef DOC_WRITER_H
+#define DOC_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "esp_err.h"
+
+// Streaming document writer: emits directly into a caller-provided buffer and
+// hands full buffers to a flush callback (e.g. httpd_resp_send_chunk). No heap
+// use. The encoding (JsonWriter, CborWriter) is picked by the caller, code
+// producing a document only sees this interface.
+// Without a flush callback the output must fit the buffer, otherwise ok() is false.
+class DocWriter {
+public:
+    typedef esp_err_t (*FlushFn)(void* ctx, const char* data, size_t len);
+
+    virtual ~DocWriter() {}
+
+    DocWriter(const DocWriter&) = delete;
+    DocWriter& operator=(const DocWriter&) = delete;
+
+    virtual DocWriter& beginObject(const char* key = nullptr) = 0;
+    virtual DocWriter& endObject() = 0;
+    virtual DocWriter& beginArray(const char* key = nullptr) = 0;
+    virtual DocWriter& endArray() = 0;
+
+    // Object members (integer overloads on fundamental types so int32_t/long and
+    // uint32_t/unsigned long resolve the same way on xtensa and on the host)
+    virtual DocWriter& field(const char* key, bool value) = 0;
+    DocWriter& field(const char* key, int value)                 { return field(key, (long long)value); }
+    DocWriter& field(const char* key, unsigned int value)        { return field(key, (long long)value); }
+    DocWriter& field(const char* key, long value)                { return field(key, (long long)value); }
+    DocWriter& field(const char* key, unsigned long value)       { return field(key, (long long)value); }
+    virtual DocWriter& field(const char* key, long long value) = 0;
+    virtual DocWriter& field(const char* key, const char* value) = 0;
+
+    // Member whose value is already encoded in this writer's format (e.g. a cached document)
+    virtual DocWriter& rawField(const char* key, const char* data, size_t len) = 0;
+
+    // Array elements
+    virtual DocWriter& value(bool value) = 0;
+    DocWriter& value(int v)                                      { return value((long long)v); }
+    DocWriter& value(long v)                                     { return value((long long)v); }
+    virtual DocWriter& value(long long value) = 0;
+    virtual DocWriter& value(const char* value) = 0;
+
+    virtual const char* contentType() const = 0;
+
+    // Flushes whatever is still buffered (no-op without flush callback)
+    esp_err_t finish();
+
+    bool ok() const { return _err == ESP_OK; }
+    esp_err_t error() const { return _err; }
+    const char* data() const { return _buf; }
+    size_t length() const { return _len; }        // bytes currently buffered
+    size_t total() const { return _total + _len; } // bytes produced so far
+    bool flushed() const { return _total > 0; }
+
+    // Flush callback appending to a std::string passed as ctx (for NVS blobs)
+    static esp_err_t stringSink(void* ctx, const char* data, size_t len);
+
+protected:
+    DocWriter(char* buf, size_t size, FlushFn flush, void* ctx);
+
+    void raw(char c);
+    void raw(const char* s, size_t n);
+    void flush();
+
+    esp_err_t _err;
+
+private:
+    char* _buf;
+    size_t _size;
+    size_t _len;
+    size_t _total;
+    FlushFn _flush;
+    void* _ctx;
+};
+
+#endif // DOC_WRITER_H
@@ -0,0 +1,221 @@
+#include "gzip_deflater.h"
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+static const char *TAG = "GzipDeflater";
+
+static const size_t MIN_MATCH = 3;
+static const size_t MAX_MATCH = 258;
+static const uint16_t NO_POS = 0xFFFF;
+static const uint16_t END_OF_BLOCK = 256;
+
+// gzip member header (RFC 1952): deflate, no flags, no mtime, unknown OS
+static const uint8_t GZIP_HEADER[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+
+// Length and distance symbol tables (RFC 1951 3.2.5)
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[24] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073
+};
+static const uint8_t DIST_EXTRA[24] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10
+};
+static_assert(GzipDeflater::WINDOW_SIZE <= 4096, "distance table only covers 4 KB windows");
+
+static std::mutex s_budgetMutex;
+static size_t s_active = 0;
+
+static inline size_t hash3(const uint8_t* p) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - GzipDeflater::HASH_BITS);
+}
+
+GzipDeflater::GzipDeflater(OutputFn output, void* ctx) : _output(output), _ctx(ctx) {}
+
+GzipDeflater::~GzipDeflater() {
+    free(_workspace);
+    if (_reserved) {
+        std::lock_guard<std::mutex> lock(s_budgetMutex);
+        s_active--;
+    }
+}
+
+esp_err_t GzipDeflater::init() {
+    {
+        std::lock_guard<std::mutex> lock(s_budgetMutex);
+        if (s_active >= MAX_ACTIVE) {
+            ESP_LOGD(TAG, "Compression budget in use (%d streams)", (int)MAX_ACTIVE);
+            return ESP_ERR_NO_MEM;
+        }
+        s_active++;
+        _reserved = true;
+    }
+
+    _workspace = (uint8_t*)malloc(WORKSPACE_SIZE);
+    if (_workspace == NULL) {
+        ESP_LOGW(TAG, "Failed to allocate %d byte workspace", (int)WORKSPACE_SIZE);
+        return _err = ESP_ERR_NO_MEM;
+    }
+    _window = _workspace;
+    _head = (uint16_t*)(_workspace + BUFFER_SIZE);
+    _out = _workspace + BUFFER_SIZE + HASH_SIZE * sizeof(uint16_t);
+    for (size_t i = 0; i < HASH_SIZE; i++) _head[i] = NO_POS;
+
+    for (uint8_t b : GZIP_HEADER) byte(b);
+    // The whole body goes into one fixed-Huffman block, closed in finish()
+    bits(0, 1);
+    bits(1, 2);
+    return _err;
+}
+
+esp_err_t GzipDeflater::feed(const uint8_t* data, size_t len) {
+    if (_workspace == NULL) return ESP_ERR_INVALID_STATE;
+    while (len > 0 && _err == ESP_OK) {
+        if (_end == BUFFER_SIZE) slide();
+        size_t n = BUFFER_SIZE - _end;
+        if (n > len) n = len;
+        memcpy(_window + _end, data, n);
+        _crc = esp_rom_crc32_le(_crc, data, n);
+        _inputSize += n;
+        _end += n;
+        data += n;
+        len -= n;
+        compress(false);
+    }
+    return _err;
+}
+
+esp_err_t GzipDeflater::finish() {
+    if (_workspace == NULL) return ESP_ERR_INVALID_STATE;
+    compress(true);
+    symbol(END_OF_BLOCK);
+    // Empty final block, then pad to a byte boundary
+    bits(1, 1);
+    bits(1, 2);
+    symbol(END_OF_BLOCK);
+    if (_bitCount > 0) bits(0, 8 - _bitCount);
+
+    for (int i = 0; i < 4; i++) byte(_crc >> (8 * i));
+    for (int i = 0; i < 4; i++) byte((uint32_t)_inputSize >> (8 * i));
+    flushOutput();
+    return _err;
+}
+
+// Encodes buffered input, keeping MAX_MATCH bytes of lookahead unless final
+void GzipDeflater::compress(bool final) {
+    while (_pos < _end && (final || _end - _pos >= MAX_MATCH) && _err == ESP_OK) {
+        size_t avail = _end - _pos;
+        size_t bestLen = 0;
+        size_t bestDist = 0;
+        if (avail >= MIN_MATCH) {
+            size_t h = hash3(_window + _pos);
+            uint16_t candidate = _head[h];
+            _head[h] = _pos;
+            if (candidate != NO_POS && _pos - candidate <= WINDOW_SIZE) {
+                size_t maxLen = avail < MAX_MATCH ? avail : MAX_MATCH;
+                const uint8_t* a = _window + candidate;
+                const uint8_t* b = _window + _pos;
+                size_t len = 0;
+                while (len < maxLen && a[len] == b[len]) len++;
+                if (len >= MIN_MATCH) {
+                    bestLen = len;
+                    bestDist = _pos - candidate;
+                }
+            }
+        }
+
+        if (bestLen == 0) {
+            literal(_window[_pos++]);
+            continue;
+        }
+        match(bestLen, bestDist);
+        // Index the positions inside the match so later repeats can find them
+        for (size_t i = 1; i < bestLen; i++) {
+            size_t p = _pos + i;
+            if (p + MIN_MATCH <= _end) _head[hash3(_window + p)] = p;
+        }
+        _pos += bestLen;
+    }
+}
+
+// Drops the oldest half of the buffer; the kept half stays reachable as history
+void GzipDeflater::slide() {
+    memmove(_window, _window + WINDOW_SIZE, _end - WINDOW_SIZE);
+    _pos -= WINDOW_SIZE;
+    _end -= WINDOW_SIZE;
+    for (size_t i = 0; i < HASH_SIZE; i++) {
+        uint16_t p = _head[i];
+        _head[i] = (p != NO_POS && p >= WINDOW_SIZE) ? p - WINDOW_SIZE : NO_POS;
+    }
+}
+
+void GzipDeflater::literal(uint8_t c) {
+    symbol(c);
+}
+
+void GzipDeflater::match(size_t len, size_t dist) {
+    int l = 28;
+    while (LENGTH_BASE[l] > len) l--;
+    symbol(257 + l);
+    bits(len - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+
+    int d = 23;
+    while (DIST_BASE[d] > dist) d--;
+    code(d, 5);
+    bits(dist - DIST_BASE[d], DIST_EXTRA[d]);
+}
+
+// Fixed literal/length code (RFC 1951 3.2.6)
+void GzipDeflater::symbol(uint16_t sym) {
+    if (sym < 144) code(0x30 + sym, 8);
+    else if (sym < 256) code(0x190 + sym - 144, 9);
+    else if (sym < 280) code(sym - 256, 7);
+    else code(0xC0 + sym - 280, 8);
+}
+
+// Huffman codes are packed starting with their most significant bit
+void GzipDeflater::code(uint16_t c, uint8_t len) {
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < len; i++) {
+        reversed = (reversed << 1) | (c & 1);
+        c >>= 1;
+    }
+    bits(reversed, len);
+}
+
+void GzipDeflater::bits(uint32_t value, uint8_t count) {
+    _bitBuf |= value << _bitCount;
+    _bitCount += count;
+    while (_bitCount >= 8) {
+        byte(_bitBuf & 0xFF);
+        _bitBuf >>= 8;
+        _bitCount -= 8;
+    }
+}
+
+void GzipDeflater::byte(uint8_t b) {
+    _out[_outLen++] = b;
+    if (_outLen == OUT_SIZE) flushOutput();
+}
+
+void GzipDeflater::flushOutput() {
+    if (_outLen == 0 || _err != ESP_OK) {
+        _outLen = 0;
+        return;
+    }
+    _err = _output(_ctx, (const char*)_out, _outLen);
+    _outputSize += _outLen;
+    _outLen = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef GZIP_DEFLATER_H
+#define GZIP_DEFLATER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Streaming gzip encoder for dynamic responses. A greedy LZ77 pass over a
+// small sliding window (one hash candidate per position) feeding a single
+// fixed-Huffman deflate block, which is plenty for repetitive JSON. The ROM
+// tdefl compressor would need ~170 KB of state; this needs WORKSPACE_SIZE.
+//
+// Memory budget: each active encoder holds WORKSPACE_SIZE bytes of heap and
+// at most MAX_ACTIVE encoders exist at once. init() fails with ESP_ERR_NO_MEM
+// when the budget is taken, callers then send the body uncompressed.
+class GzipDeflater {
+public:
+    typedef esp_err_t (*OutputFn)(void* ctx, const char* data, size_t len);
+
+    static const size_t WINDOW_SIZE = 2048;
+    static const size_t HASH_BITS = 10;
+    static const size_t OUT_SIZE = 512;
+    static const size_t WORKSPACE_SIZE = 2 * WINDOW_SIZE + (sizeof(uint16_t) << HASH_BITS) + OUT_SIZE; // 6.5 KB
+    static const size_t MAX_ACTIVE = 2;
+
+    GzipDeflater(OutputFn output, void* ctx);
+    ~GzipDeflater();
+
+    GzipDeflater(const GzipDeflater&) = delete;
+    GzipDeflater& operator=(const GzipDeflater&) = delete;
+
+    // Reserves a budget slot, allocates the workspace and emits the gzip header
+    esp_err_t init();
+    esp_err_t feed(const uint8_t* data, size_t len);
+    // Encodes the remaining input and emits the end of stream and trailer
+    esp_err_t finish();
+
+    size_t inputSize() const { return _inputSize; }
+    size_t outputSize() const { return _outputSize; }
+
+private:
+    static const size_t BUFFER_SIZE = 2 * WINDOW_SIZE;
+    static const size_t HASH_SIZE = 1 << HASH_BITS;
+
+    void compress(bool final);
+    void slide();
+    void literal(uint8_t c);
+    void match(size_t len, size_t dist);
+    void symbol(uint16_t sym);
+    void code(uint16_t code, uint8_t len);
+    void bits(uint32_t value, uint8_t count);
+    void byte(uint8_t b);
+    void flushOutput();
+
+    OutputFn _output;
+    void* _ctx;
+    uint8_t* _workspace = nullptr;
+    uint8_t* _window = nullptr;  // BUFFER_SIZE bytes: history plus lookahead
+    uint16_t* _head = nullptr;   // last position of each 3-byte hash
+    uint8_t* _out = nullptr;
+    size_t _outLen = 0;
+    size_t _pos = 0;             // next byte to encode
+    size_t _end = 0;             // end of buffered input
+    uint32_t _bitBuf = 0;
+    uint8_t _bitCount = 0;
+    uint32_t _crc = 0;
+    size_t _inputSize = 0;
+    size_t _outputSize = 0;
+    bool _reserved = false;
+    esp_err_t _err = ESP_OK;
+};
+
+#endif // GZIP_DEFLATER_H
@@ -0,0 +1,177 @@
+#include "gzip_inflater.h"
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <cstdlib>
+
+static const char *TAG = "GzipInflater";
+
+// gzip header flags (RFC 1952)
+static const uint8_t FHCRC    = 0x02;
+static const uint8_t FEXTRA   = 0x04;
+static const uint8_t FNAME    = 0x08;
+static const uint8_t FCOMMENT = 0x10;
+
+static const uint8_t METHOD_DEFLATE = 8;
+static const uint8_t FIXED_HEADER_SIZE = 10;
+
+GzipInflater::GzipInflater(OutputFn output, void* ctx) : _output(output), _ctx(ctx) {}
+
+GzipInflater::~GzipInflater() {
+    free(_decomp);
+    free(_window);
+}
+
+esp_err_t GzipInflater::init() {
+    _decomp = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+    _window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+    if (_decomp == NULL || _window == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate inflate window");
+        return fail(ESP_ERR_NO_MEM);
+    }
+    tinfl_init(_decomp);
+    return ESP_OK;
+}
+
+esp_err_t GzipInflater::fail(esp_err_t err) {
+    _state = State::ERROR;
+    return err;
+}
+
+// Walks the variable length gzip header one byte at a time
+bool GzipInflater::headerByte(uint8_t c) {
+    switch (_state) {
+        case State::HEADER:
+            if ((_headerPos == 0 && c != 0x1f) || (_headerPos == 1 && c != 0x8b) ||
+                (_headerPos == 2 && c != METHOD_DEFLATE)) {
+                return false;
+            }
+            if (_headerPos == 3) _flags = c;
+            if (++_headerPos < FIXED_HEADER_SIZE) return true;
+            _fieldLeft = 0;
+            _headerPos = 0;
+            _state = (_flags & FEXTRA) ? State::EXTRA_LEN : State::NAME;
+            break;
+
+        case State::EXTRA_LEN:
+            _fieldLeft |= (uint16_t)c << (8 * _headerPos);
+            if (++_headerPos < 2) return true;
+            _state = _fieldLeft ? State::EXTRA : State::NAME;
+            break;
+
+        case State::EXTRA:
+            if (--_fieldLeft) return true;
+            _state = State::NAME;
+            break;
+
+        case State::NAME:
+            if (c != 0) return true;
+            _state = State::COMMENT;
+            break;
+
+        case State::COMMENT:
+            if (c != 0) return true;
+            _state = State::HEADER_CRC;
+            _headerPos = 0;
+            break;
+
+        case State::HEADER_CRC:
+            if (++_headerPos < 2) return true;
+            _state = State::DEFLATE;
+            return true;
+
+        default:
+            return false;
+    }
+
+    // Skip optional fields that are not present
+    if (_state == State::NAME && !(_flags & FNAME)) _state = State::COMMENT;
+    if (_state == State::COMMENT && !(_flags & FCOMMENT)) {
+        _state = State::HEADER_CRC;
+        _headerPos = 0;
+    }
+    if (_state == State::HEADER_CRC && !(_flags & FHCRC)) _state = State::DEFLATE;
+    return true;
+}
+
+esp_err_t GzipInflater::inflate(const uint8_t* data, size_t len, size_t* consumed) {
+    *consumed = 0;
+    while (true) {
+        size_t inBytes = len;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - _windowOffset;
+        tinfl_status status = tinfl_decompress(_decomp, data, &inBytes, _window, _window + _windowOffset,
+                                               &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+        data += inBytes;
+        len -= inBytes;
+        *consumed += inBytes;
+
+        if (outBytes > 0) {
+            _crc = esp_rom_crc32_le(_crc, _window + _windowOffset, outBytes);
+            _outputSize += outBytes;
+            esp_err_t err = _output(_ctx, (const char*)_window + _windowOffset, outBytes);
+            if (err != ESP_OK) return fail(err);
+            _windowOffset = (_windowOffset + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            _state = State::TRAILER;
+            return ESP_OK;
+        }
+        if (status < 0) {
+            ESP_LOGE(TAG, "Corrupt deflate stream (%d)", (int)status);
+            return fail(ESP_ERR_INVALID_RESPONSE);
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) return ESP_OK;
+    }
+}
+
+esp_err_t GzipInflater::feed(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        switch (_state) {
+            case State::DEFLATE: {
+                size_t consumed;
+                esp_err_t err = inflate(data, len, &consumed);
+                if (err != ESP_OK) return err;
+                data += consumed;
+                len -= consumed;
+                break;
+            }
+
+            case State::TRAILER:
+                _trailer[_trailerPos++] = *data++;
+                len--;
+                if (_trailerPos == sizeof(_trailer)) _state = State::DONE;
+                break;
+
+            case State::DONE:
+                ESP_LOGE(TAG, "Unexpected data after gzip trailer");
+                return fail(ESP_ERR_INVALID_SIZE);
+
+            case State::ERROR:
+                return ESP_FAIL;
+
+            default:
+                if (!headerByte(*data++)) {
+                    ESP_LOGE(TAG, "Invalid gzip header");
+                    return fail(ESP_ERR_INVALID_ARG);
+                }
+                len--;
+                break;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t GzipInflater::finish() {
+    if (_state != State::DONE) {
+        ESP_LOGE(TAG, "Truncated gzip stream");
+        return fail(ESP_ERR_INVALID_SIZE);
+    }
+    uint32_t crc = _trailer[0] | (_trailer[1] << 8) | (_trailer[2] << 16) | ((uint32_t)_trailer[3] << 24);
+    uint32_t size = _trailer[4] | (_trailer[5] << 8) | (_trailer[6] << 16) | ((uint32_t)_trailer[7] << 24);
+    if (crc != _crc || size != (uint32_t)_outputSize) {
+        ESP_LOGE(TAG, "gzip trailer mismatch (crc %08lx/%08lx, size %lu/%lu)", (unsigned long)crc,
+                 (unsigned long)_crc, (unsigned long)size, (unsigned long)_outputSize);
+        return fail(ESP_ERR_INVALID_CRC);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,59 @@
+#ifndef GZIP_INFLATER_H
+#define GZIP_INFLATER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "miniz.h"
+
+// Streaming gzip decoder on top of the ROM tinfl inflater. Input can arrive in
+// arbitrary pieces; decompressed data is handed to the output callback in
+// pieces of at most the 32 KB window. The gzip trailer (CRC32 and size) is
+// verified in finish().
+class GzipInflater {
+public:
+    typedef esp_err_t (*OutputFn)(void* ctx, const char* data, size_t len);
+
+    GzipInflater(OutputFn output, void* ctx);
+    ~GzipInflater();
+
+    GzipInflater(const GzipInflater&) = delete;
+    GzipInflater& operator=(const GzipInflater&) = delete;
+
+    // Allocates the window and decompressor state (~43 KB)
+    esp_err_t init();
+    esp_err_t feed(const uint8_t* data, size_t len);
+    esp_err_t finish();
+
+    size_t outputSize() const { return _outputSize; }
+
+    static bool isGzip(const uint8_t* data, size_t len) {
+        return len >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+    }
+
+private:
+    enum class State : uint8_t {
+        HEADER, EXTRA_LEN, EXTRA, NAME, COMMENT, HEADER_CRC, DEFLATE, TRAILER, DONE, ERROR
+    };
+
+    bool headerByte(uint8_t c);
+    esp_err_t inflate(const uint8_t* data, size_t len, size_t* consumed);
+    esp_err_t fail(esp_err_t err);
+
+    OutputFn _output;
+    void* _ctx;
+    tinfl_decompressor* _decomp = nullptr;
+    uint8_t* _window = nullptr;
+    size_t _windowOffset = 0;
+
+    State _state = State::HEADER;
+    uint8_t _flags = 0;
+    uint16_t _fieldLeft = 0;
+    uint8_t _headerPos = 0;
+    uint8_t _trailer[8];
+    uint8_t _trailerPos = 0;
+    uint32_t _crc = 0;
+    size_t _outputSize = 0;
+};
+
+#endif // GZIP_INFLATER_H
@@ -0,0 +1,88 @@
+#include "http_body.h"
+#include <esp_log.h>
+#include <cstring>
+
+static const char *TAG = "HttpBody";
+
+static const size_t RECV_CHUNK_SIZE = 128;
+static const int RECV_TIMEOUT_RETRIES = 3;
+
+static void sendTooLarge(httpd_req_t* req) {
+    httpd_resp_set_status(req, "413 Payload Too Large");
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_sendstr(req, "Request body too large");
+}
+
+esp_err_t readRequestBody(httpd_req_t* req, size_t maxLen, BodyChunkFn onChunk, void* ctx) {
+    if (req->content_len == 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Empty request body");
+        return ESP_FAIL;
+    }
+    if (req->content_len > maxLen) {
+        ESP_LOGW(TAG, "%s: body of %u bytes exceeds limit of %u", req->uri,
+                 (unsigned)req->content_len, (unsigned)maxLen);
+        sendTooLarge(req);
+        return ESP_FAIL;
+    }
+
+    char buf[RECV_CHUNK_SIZE];
+    size_t remaining = req->content_len;
+    int timeouts = 0;
+    while (remaining > 0) {
+        int ret = httpd_req_recv(req, buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts <= RECV_TIMEOUT_RETRIES) {
+            continue;
+        }
+        if (ret <= 0) {
+            ESP_LOGW(TAG, "%s: receive failed with %u bytes left (%d)", req->uri, (unsigned)remaining, ret);
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Request body timed out");
+            }
+            return ESP_FAIL;
+        }
+        timeouts = 0;
+        remaining -= ret;
+        if (!onChunk(ctx, buf, ret)) return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+struct JsonBodyContext {
+    httpd_req_t* req;
+    JsonReader reader;
+    explicit JsonBodyContext(httpd_req_t* r, JsonReader::Handler& handler) : req(r), reader(handler) {}
+};
+
+esp_err_t readJsonBody(httpd_req_t* req, size_t maxLen, JsonReader::Handler& handler) {
+    JsonBodyContext body(req, handler);
+    esp_err_t err = readRequestBody(req, maxLen, [](void* ctx, const char* data, size_t len) {
+        auto* body = static_cast<JsonBodyContext*>(ctx);
+        if (body->reader.feed(data, len) == ESP_OK) return true;
+        httpd_resp_send_err(body->req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return false;
+    }, &body);
+    if (err != ESP_OK) return err;
+
+    if (body.reader.finish() != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+struct StringBodyContext {
+    char* buf;
+    size_t len;
+};
+
+esp_err_t readBodyString(httpd_req_t* req, char* buf, size_t size) {
+    StringBodyContext body = { buf, 0 };
+    esp_err_t err = readRequestBody(req, size - 1, [](void* ctx, const char* data, size_t len) {
+        auto* body = static_cast<StringBodyContext*>(ctx);
+        memcpy(body->buf + body->len, data, len);
+        body->len += len;
+        return true;
+    }, &body);
+    buf[body.len] = '\0';
+    return err;
+}
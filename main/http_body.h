@@ -0,0 +1,23 @@
+#ifndef HTTP_BODY_H
+#define HTTP_BODY_H
+
+#include <stddef.h>
+#include <esp_http_server.h>
+#include "json_reader.h"
+
+// Receives a request body in small pieces, looping over partial recvs and
+// retrying socket timeouts. Bodies above maxLen are refused with 413 before
+// anything is read. onChunk returning false stops reading; the callback is
+// then responsible for the error response. On failure an error response has
+// already been sent and the handler should just return ESP_FAIL.
+typedef bool (*BodyChunkFn)(void* ctx, const char* data, size_t len);
+esp_err_t readRequestBody(httpd_req_t* req, size_t maxLen, BodyChunkFn onChunk, void* ctx);
+
+// Feeds the body straight into a JSON handler, so it never has to be held in
+// one contiguous buffer. Malformed JSON is answered with 400.
+esp_err_t readJsonBody(httpd_req_t* req, size_t maxLen, JsonReader::Handler& handler);
+
+// Copies the body into buf as a NUL terminated string (at most size - 1 bytes)
+esp_err_t readBodyString(httpd_req_t* req, char* buf, size_t size);
+
+#endif // HTTP_BODY_H
@@ -0,0 +1,113 @@
+#include "json_fields.h"
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+
+// Members are accessed with memcpy so int and long members can share INT
+static_assert(sizeof(int) == sizeof(int32_t), "INT fields assume 32-bit int");
+
+static inline void storeInt(uint8_t* p, int32_t v) { memcpy(p, &v, sizeof(v)); }
+static inline int32_t loadInt(const uint8_t* p) { int32_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+void applyFieldDefaults(const JsonField* fields, size_t count, void* obj) {
+    uint8_t* base = static_cast<uint8_t*>(obj);
+    for (size_t i = 0; i < count; i++) {
+        const JsonField& f = fields[i];
+        switch (f.type) {
+            case JsonField::BOOL:
+                *reinterpret_cast<bool*>(base + f.offset) = f.defaultValue != 0;
+                break;
+            case JsonField::INT:
+                storeInt(base + f.offset, f.defaultValue);
+                break;
+            case JsonField::STRING:
+                base[f.offset] = '\0';
+                break;
+        }
+    }
+}
+
+void writeFields(DocWriter& w, const JsonField* fields, size_t count, const void* obj) {
+    const uint8_t* base = static_cast<const uint8_t*>(obj);
+    for (size_t i = 0; i < count; i++) {
+        const JsonField& f = fields[i];
+        switch (f.type) {
+            case JsonField::BOOL:
+                w.field(f.key, *reinterpret_cast<const bool*>(base + f.offset));
+                break;
+            case JsonField::INT:
+                w.field(f.key, loadInt(base + f.offset));
+                break;
+            case JsonField::STRING:
+                w.field(f.key, reinterpret_cast<const char*>(base + f.offset));
+                break;
+        }
+    }
+}
+
+JsonFieldBinder::JsonFieldBinder(const JsonField* fields, size_t count, void* obj, uint8_t objectDepth,
+                                 ObjectFn onObject, void* ctx)
+    : _fields(fields), _count(count), _obj(obj), _objectDepth(objectDepth),
+      _onObject(onObject), _ctx(ctx), _field(-1), _seen(0), _objects(0) {
+    applyFieldDefaults(_fields, _count, _obj);
+}
+
+bool JsonFieldBinder::has(const char* key) const {
+    for (size_t i = 0; i < _count; i++) {
+        if ((_seen & (1UL << i)) && strcmp(_fields[i].key, key) == 0) return true;
+    }
+    return false;
+}
+
+bool JsonFieldBinder::onToken(JsonReader::Token token, uint8_t depth, const char* text, size_t len) {
+    typedef JsonReader::Token Token;
+
+    if (token == Token::BEGIN_OBJECT && depth + 1 == _objectDepth) {
+        if (_objects > 0) applyFieldDefaults(_fields, _count, _obj);
+        _seen = 0;
+        _field = -1;
+        return true;
+    }
+    if (token == Token::END_OBJECT && depth + 1 == _objectDepth) {
+        _objects++;
+        return _onObject ? _onObject(_ctx, _obj, _seen) : true;
+    }
+    if (depth != _objectDepth) return true;
+
+    if (token == Token::KEY) {
+        _field = -1;
+        for (size_t i = 0; i < _count; i++) {
+            if (strcmp(_fields[i].key, text) == 0) {
+                _field = i;
+                break;
+            }
+        }
+        return true;
+    }
+    if (_field < 0) return true; // unknown key or nested value: skipped
+
+    // Several table entries may share a key with different types (e.g. "value")
+    uint8_t* base = static_cast<uint8_t*>(_obj);
+    const char* key = _fields[_field].key;
+    for (size_t i = _field; i < _count; i++) {
+        const JsonField& f = _fields[i];
+        if (strcmp(f.key, key) != 0) continue;
+        if (f.type == JsonField::BOOL && (token == Token::TRUE || token == Token::FALSE)) {
+            *reinterpret_cast<bool*>(base + f.offset) = (token == Token::TRUE);
+        } else if (f.type == JsonField::INT && token == Token::NUMBER) {
+            long long v = strtoll(text, nullptr, 10);
+            if (v > INT32_MAX) v = INT32_MAX;
+            if (v < INT32_MIN) v = INT32_MIN;
+            storeInt(base + f.offset, (int32_t)v);
+        } else if (f.type == JsonField::STRING && token == Token::STRING) {
+            size_t n = len < (size_t)(f.size - 1) ? len : (size_t)(f.size - 1);
+            memcpy(base + f.offset, text, n);
+            base[f.offset + n] = '\0';
+        } else {
+            continue;
+        }
+        _seen |= (1UL << i);
+    }
+    _field = -1;
+    return true;
+}
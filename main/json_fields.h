@@ -0,0 +1,64 @@
+#ifndef JSON_FIELDS_H
+#define JSON_FIELDS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "json_reader.h"
+#include "doc_writer.h"
+
+// Compile-time description of one struct member and its JSON key. A table of
+// these drives both parsing (JsonFieldBinder) and serialization (writeFields),
+// so the key list of a struct exists in exactly one place.
+struct JsonField {
+    enum Type : uint8_t { BOOL, INT, STRING };
+
+    const char* key;
+    Type type;
+    uint16_t offset;
+    uint16_t size;      // capacity for STRING members (including NUL)
+    int32_t defaultValue;
+
+    template<typename T> static constexpr Type typeOf();
+};
+
+template<> constexpr JsonField::Type JsonField::typeOf<bool>() { return BOOL; }
+template<> constexpr JsonField::Type JsonField::typeOf<int>() { return INT; }
+
+#define JSON_FIELD(Struct, member, key, def) \
+    { key, JsonField::typeOf<decltype(Struct::member)>(), offsetof(Struct, member), sizeof(Struct::member), def }
+#define JSON_STRING_FIELD(Struct, member, key) \
+    { key, JsonField::STRING, offsetof(Struct, member), sizeof(Struct::member), 0 }
+
+void applyFieldDefaults(const JsonField* fields, size_t count, void* obj);
+void writeFields(DocWriter& w, const JsonField* fields, size_t count, const void* obj);
+
+// Binds the members of every object found at objectDepth (1 = top-level object,
+// 2 = objects inside a top-level array) onto obj using the field table. Members
+// missing from the input keep their default. onObject fires after each object.
+class JsonFieldBinder : public JsonReader::Handler {
+public:
+    typedef bool (*ObjectFn)(void* ctx, void* obj, uint32_t seen);
+
+    JsonFieldBinder(const JsonField* fields, size_t count, void* obj, uint8_t objectDepth = 1,
+                    ObjectFn onObject = nullptr, void* ctx = nullptr);
+
+    bool onToken(JsonReader::Token token, uint8_t depth, const char* text, size_t len) override;
+
+    // Bit n set when fields[n] was present with a matching type
+    uint32_t seen() const { return _seen; }
+    bool has(const char* key) const;
+    size_t objects() const { return _objects; }
+
+private:
+    const JsonField* _fields;
+    size_t _count;
+    void* _obj;
+    uint8_t _objectDepth;
+    ObjectFn _onObject;
+    void* _ctx;
+    int16_t _field; // first field matching the pending key, or -1
+    uint32_t _seen;
+    size_t _objects;
+};
+
+#endif // JSON_FIELDS_H
@@ -0,0 +1,226 @@
+#include "json_reader.h"
+#include <cstring>
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool isLiteralChar(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '-' || c == '+' || c == '.';
+}
+
+static inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+JsonReader::JsonReader(Handler& handler) : _handler(handler) {
+    reset();
+}
+
+void JsonReader::reset() {
+    _state = State::VALUE;
+    _depth = 0;
+    _objects = 0;
+    _isKey = false;
+    _unicodeDigits = 0;
+    _unicode = 0;
+    _len = 0;
+}
+
+esp_err_t JsonReader::feed(const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!step(data[i])) return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t JsonReader::finish() {
+    // A bare top-level number has no terminator
+    if (_state == State::LITERAL && _depth == 0 && !emitLiteral()) return ESP_FAIL;
+    return _state == State::DONE ? ESP_OK : ESP_FAIL;
+}
+
+bool JsonReader::fail() {
+    _state = State::ERROR;
+    return false;
+}
+
+bool JsonReader::append(char c) {
+    if (_len >= MAX_SCALAR) return fail();
+    _scratch[_len++] = c;
+    return true;
+}
+
+bool JsonReader::step(char c) {
+    switch (_state) {
+        case State::VALUE:
+            if (isSpace(c)) return true;
+            return beginValue(c);
+
+        case State::VALUE_OR_END:
+            if (isSpace(c)) return true;
+            if (c == ']') return endContainer(c);
+            return beginValue(c);
+
+        case State::KEY_OR_END:
+            if (isSpace(c)) return true;
+            if (c == '}') return endContainer(c);
+            // fall through
+        case State::KEY:
+            if (isSpace(c)) return true;
+            if (c != '"') return fail();
+            _isKey = true;
+            _len = 0;
+            _state = State::STRING;
+            return true;
+
+        case State::COLON:
+            if (isSpace(c)) return true;
+            if (c != ':') return fail();
+            _state = State::VALUE;
+            return true;
+
+        case State::AFTER_VALUE:
+            if (isSpace(c)) return true;
+            if (c == ',') {
+                _state = (_objects & (1UL << _depth)) ? State::KEY : State::VALUE;
+                return true;
+            }
+            if (c == '}' || c == ']') return endContainer(c);
+            return fail();
+
+        case State::STRING:
+            if (c == '"') {
+                _scratch[_len] = '\0';
+                if (_isKey) {
+                    _isKey = false;
+                    if (!_handler.onToken(Token::KEY, _depth, _scratch, _len)) return fail();
+                    _state = State::COLON;
+                    return true;
+                }
+                return endScalar(Token::STRING);
+            }
+            if (c == '\\') {
+                _state = State::STRING_ESCAPE;
+                return true;
+            }
+            if ((unsigned char)c < 0x20) return fail();
+            return append(c);
+
+        case State::STRING_ESCAPE:
+            _state = State::STRING;
+            switch (c) {
+                case '"': case '\\': case '/': return append(c);
+                case 'b': return append('\b');
+                case 'f': return append('\f');
+                case 'n': return append('\n');
+                case 'r': return append('\r');
+                case 't': return append('\t');
+                case 'u':
+                    _unicode = 0;
+                    _unicodeDigits = 0;
+                    _state = State::STRING_UNICODE;
+                    return true;
+                default: return fail();
+            }
+
+        case State::STRING_UNICODE: {
+            int v = hexValue(c);
+            if (v < 0) return fail();
+            _unicode = (_unicode << 4) | v;
+            if (++_unicodeDigits < 4) return true;
+            _state = State::STRING;
+            // Encode the BMP code point as UTF-8 (surrogate pairs are kept as-is)
+            if (_unicode < 0x80) return append((char)_unicode);
+            if (_unicode < 0x800) {
+                return append((char)(0xC0 | (_unicode >> 6))) &&
+                       append((char)(0x80 | (_unicode & 0x3F)));
+            }
+            return append((char)(0xE0 | (_unicode >> 12))) &&
+                   append((char)(0x80 | ((_unicode >> 6) & 0x3F))) &&
+                   append((char)(0x80 | (_unicode & 0x3F)));
+        }
+
+        case State::LITERAL:
+            if (isLiteralChar(c)) return append(c);
+            if (!emitLiteral()) return false;
+            return step(c);
+
+        case State::DONE:
+            if (isSpace(c)) return true;
+            return fail();
+
+        case State::ERROR:
+            return false;
+    }
+    return fail();
+}
+
+bool JsonReader::beginValue(char c) {
+    if (c == '{' || c == '[') {
+        if (_depth + 1 >= MAX_DEPTH) return fail();
+        bool object = (c == '{');
+        if (!_handler.onToken(object ? Token::BEGIN_OBJECT : Token::BEGIN_ARRAY, _depth, nullptr, 0)) return fail();
+        _depth++;
+        if (object) _objects |= (1UL << _depth); else _objects &= ~(1UL << _depth);
+        _state = object ? State::KEY_OR_END : State::VALUE_OR_END;
+        return true;
+    }
+    if (c == '"') {
+        _isKey = false;
+        _len = 0;
+        _state = State::STRING;
+        return true;
+    }
+    if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+        _len = 0;
+        _state = State::LITERAL;
+        return append(c);
+    }
+    return fail();
+}
+
+bool JsonReader::endContainer(char c) {
+    bool object = (_objects & (1UL << _depth)) != 0;
+    if (_depth == 0 || object != (c == '}')) return fail();
+    _depth--;
+    if (!_handler.onToken(object ? Token::END_OBJECT : Token::END_ARRAY, _depth, nullptr, 0)) return fail();
+    _state = (_depth == 0) ? State::DONE : State::AFTER_VALUE;
+    return true;
+}
+
+bool JsonReader::endScalar(Token token) {
+    if (!_handler.onToken(token, _depth, _scratch, _len)) return fail();
+    _state = (_depth == 0) ? State::DONE : State::AFTER_VALUE;
+    return true;
+}
+
+bool JsonReader::emitLiteral() {
+    _scratch[_len] = '\0';
+    if (strcmp(_scratch, "true") == 0) return endScalar(Token::TRUE);
+    if (strcmp(_scratch, "false") == 0) return endScalar(Token::FALSE);
+    if (strcmp(_scratch, "null") == 0) return endScalar(Token::NUL);
+
+    // Validate number grammar: -?digits(.digits)?([eE][+-]?digits)?
+    const char* p = _scratch;
+    if (*p == '-') p++;
+    if (*p < '0' || *p > '9') return fail();
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        if (*p < '0' || *p > '9') return fail();
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        if (*p == '+' || *p == '-') p++;
+        if (*p < '0' || *p > '9') return fail();
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p != '\0') return fail();
+    return endScalar(Token::NUMBER);
+}
@@ -0,0 +1,79 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Minimal jsmn-style JSON tokenizer. Input can be fed in arbitrary pieces; every
+// token is reported to the handler as soon as it is complete, so no DOM and no
+// heap is needed. Scalars longer than MAX_SCALAR are rejected.
+class JsonReader {
+public:
+    enum class Token : uint8_t {
+        BEGIN_OBJECT, END_OBJECT,
+        BEGIN_ARRAY, END_ARRAY,
+        KEY, STRING, NUMBER,
+        TRUE, FALSE, NUL
+    };
+
+    class Handler {
+    public:
+        virtual ~Handler() {}
+        // depth is the nesting level the token lives in (0 = top-level value).
+        // text is NUL terminated for KEY/STRING/NUMBER and only valid during the call.
+        // Returning false aborts parsing.
+        virtual bool onToken(Token token, uint8_t depth, const char* text, size_t len) = 0;
+    };
+
+    static const size_t MAX_SCALAR = 96;
+    static const uint8_t MAX_DEPTH = 16;
+
+    explicit JsonReader(Handler& handler);
+
+    esp_err_t feed(const char* data, size_t len);
+    esp_err_t finish(); // ESP_OK only if exactly one complete value was read
+
+    void reset();
+    bool failed() const { return _state == State::ERROR; }
+
+private:
+    enum class State : uint8_t {
+        VALUE, VALUE_OR_END, KEY, KEY_OR_END, COLON, AFTER_VALUE,
+        STRING, STRING_ESCAPE, STRING_UNICODE, LITERAL, DONE, ERROR
+    };
+
+    bool step(char c);
+    bool beginValue(char c);
+    bool endContainer(char c);
+    bool endScalar(Token token);
+    bool emitLiteral();
+    bool append(char c);
+    bool fail();
+
+    Handler& _handler;
+    State _state;
+    uint8_t _depth;
+    uint32_t _objects; // bit n set: level n is an object
+    bool _isKey;
+    uint8_t _unicodeDigits;
+    uint16_t _unicode;
+    size_t _len;
+    char _scratch[MAX_SCALAR + 1];
+};
+
+// Forwards every token to two handlers, e.g. field binders for different depths
+class JsonTee : public JsonReader::Handler {
+public:
+    JsonTee(JsonReader::Handler& a, JsonReader::Handler& b) : _a(a), _b(b) {}
+
+    bool onToken(JsonReader::Token token, uint8_t depth, const char* text, size_t len) override {
+        return _a.onToken(token, depth, text, len) && _b.onToken(token, depth, text, len);
+    }
+
+private:
+    JsonReader::Handler& _a;
+    JsonReader::Handler& _b;
+};
+
+#endif // JSON_READER_H
@@ -0,0 +1,133 @@
+#include "json_writer.h"
+
+JsonWriter::JsonWriter(char* buf, size_t size, FlushFn flush, void* ctx)
+    : DocWriter(buf, size, flush, ctx), _hasItems(0), _depth(0) {}
+
+JsonWriter& JsonWriter::beginObject(const char* k) {
+    if (k) key(k); else separator();
+    raw('{');
+    if (_depth < MAX_DEPTH) {
+        _depth++;
+        _hasItems &= ~(1UL << _depth);
+    } else {
+        _err = ESP_ERR_INVALID_STATE;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    raw('}');
+    if (_depth > 0) _depth--;
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(const char* k) {
+    if (k) key(k); else separator();
+    raw('[');
+    if (_depth < MAX_DEPTH) {
+        _depth++;
+        _hasItems &= ~(1UL << _depth);
+    } else {
+        _err = ESP_ERR_INVALID_STATE;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    raw(']');
+    if (_depth > 0) _depth--;
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* k, bool v) {
+    key(k);
+    if (v) raw("true", 4); else raw("false", 5);
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* k, long long v) {
+    key(k);
+    integer(v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* k, const char* v) {
+    key(k);
+    string(v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::rawField(const char* k, const char* json, size_t len) {
+    key(k);
+    raw(json, len);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool v) {
+    separator();
+    if (v) raw("true", 4); else raw("false", 5);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(long long v) {
+    separator();
+    integer(v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* v) {
+    separator();
+    string(v);
+    return *this;
+}
+
+void JsonWriter::separator() {
+    if (_hasItems & (1UL << _depth)) raw(',');
+    _hasItems |= (1UL << _depth);
+}
+
+void JsonWriter::key(const char* k) {
+    separator();
+    string(k);
+    raw(':');
+}
+
+void JsonWriter::string(const char* s) {
+    static const char HEX[] = "0123456789abcdef";
+    raw('"');
+    if (s) {
+        const char* run = s;
+        for (; *s; s++) {
+            unsigned char c = (unsigned char)*s;
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            raw(run, s - run);
+            run = s + 1;
+            switch (c) {
+                case '"':  raw("\\\"", 2); break;
+                case '\\': raw("\\\\", 2); break;
+                case '\n': raw("\\n", 2); break;
+                case '\r': raw("\\r", 2); break;
+                case '\t': raw("\\t", 2); break;
+                default: {
+                    char esc[6] = { '\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF] };
+                    raw(esc, sizeof(esc));
+                    break;
+                }
+            }
+        }
+        raw(run, s - run);
+    }
+    raw('"');
+}
+
+void JsonWriter::integer(long long v) {
+    char tmp[21];
+    int pos = sizeof(tmp);
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do {
+        tmp[--pos] = '0' + (u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) tmp[--pos] = '-';
+    raw(tmp + pos, sizeof(tmp) - pos);
+}
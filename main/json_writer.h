@@ -0,0 +1,46 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "doc_writer.h"
+
+// Streaming JSON writer, see DocWriter for the buffering rules.
+class JsonWriter : public DocWriter {
+public:
+    JsonWriter(char* buf, size_t size, FlushFn flush = nullptr, void* ctx = nullptr);
+
+    using DocWriter::field;
+    using DocWriter::value;
+
+    JsonWriter& beginObject(const char* key = nullptr) override;
+    JsonWriter& endObject() override;
+    JsonWriter& beginArray(const char* key = nullptr) override;
+    JsonWriter& endArray() override;
+
+    JsonWriter& field(const char* key, bool value) override;
+    JsonWriter& field(const char* key, long long value) override;
+    JsonWriter& field(const char* key, const char* value) override;
+
+    // Member whose value is already serialized JSON (e.g. a cached document)
+    JsonWriter& rawField(const char* key, const char* json, size_t len) override;
+
+    JsonWriter& value(bool value) override;
+    JsonWriter& value(long long value) override;
+    JsonWriter& value(const char* value) override;
+
+    const char* contentType() const override { return "application/json"; }
+
+private:
+    static const uint8_t MAX_DEPTH = 16;
+
+    void separator();
+    void key(const char* key);
+    void string(const char* s);
+    void integer(long long v);
+
+    uint32_t _hasItems; // one bit per nesting level
+    uint8_t _depth;
+};
+
+#endif // JSON_WRITER_H
@@ -11,7 +11,14 @@
 #include "captive_portal.h"
 #include "web_server.h"
 #include "PureSpaService.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "ReplayBusBackend.h"
+#include "EmulatorBusBackend.h"
+#else
+#include "GpioBusBackend.h"
+#endif
 #include "status_led.h"
+#include "mqtt_publisher.h"
 
 static const char *TAG = "app_main";
 
@@ -40,6 +47,7 @@ static void connect_handler(void* arg, esp_event_base_t event_base,
     ESP_LOGI(TAG, "Starting webserver");
     WebServer::getInstance().start();
     init_sntp();
+    MqttPublisher::getInstance().start();
 }
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
@@ -75,7 +83,42 @@ extern "C" void app_main(void)
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &disconnect_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
 
-    PureSpaService::getInstance().init();
+#if CONFIG_IDF_TARGET_LINUX && CONFIG_PURESPA_HOST_BUS_EMULATOR
+    // No bus on the host: a simulated mainboard answers instead
+    static SpaEmulator spa;
+    static EmulatorBusBackend bus(spa, CONFIG_PURESPA_BUS_SPEED);
+#elif CONFIG_IDF_TARGET_LINUX
+    // No bus on the host: play a capture back instead
+#ifdef CONFIG_PURESPA_REPLAY_LOOP
+    const bool replayLoop = true;
+#else
+    const bool replayLoop = false;
+#endif
+    static ReplayBusBackend bus(PureSpaIO::getExpectedCyclePeriodUs() / PureSpaIO::getExpectedFramesPerCycle(),
+                                CONFIG_PURESPA_BUS_SPEED, replayLoop);
+    if (!bus.load(CONFIG_PURESPA_REPLAY_FILE)) {
+        ESP_LOGE(TAG, "No bus capture, the spa stays offline");
+    }
+#else
+    static GpioBusBackend<PureSpaIO> bus;
+#endif
+    PureSpaService::getInstance().init(bus);
+
+#if CONFIG_PURESPA_SPA_COUNT > 1
+#if CONFIG_IDF_TARGET_LINUX && CONFIG_PURESPA_HOST_BUS_EMULATOR
+    static SpaEmulator spa2;
+    static EmulatorBusBackend bus2(spa2, CONFIG_PURESPA_BUS_SPEED);
+#elif CONFIG_IDF_TARGET_LINUX
+    // Same capture on both buses, to measure two decoders side by side
+    static ReplayBusBackend bus2(PureSpaIO::getExpectedCyclePeriodUs() / PureSpaIO::getExpectedFramesPerCycle(),
+                                 CONFIG_PURESPA_BUS_SPEED, replayLoop);
+    bus2.load(CONFIG_PURESPA_REPLAY_FILE);
+#else
+    static GpioBusBackend<PureSpaIO> bus2((gpio_num_t)CONFIG_PURESPA_SPA2_CLOCK_PIN, (gpio_num_t)CONFIG_PURESPA_SPA2_DATA_PIN,
+                                           (gpio_num_t)CONFIG_PURESPA_SPA2_LATCH_PIN);
+#endif
+    PureSpaService::addSpa(bus2);
+#endif
     WiFiManager::getInstance().startSTA();
 
     while (1) {
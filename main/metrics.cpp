@@ -0,0 +1,512 @@
+#include "metrics.h"
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_http_server.h>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "web_server.h"
+#include "mqtt_publisher.h"
+
+static const char *TAG = "Metrics";
+
+static const size_t OUTPUT_BUFFER_SIZE = 512;
+
+const uint32_t Metrics::LATENCY_BOUNDS_MS[LATENCY_BUCKETS] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000
+};
+
+static const char* const COMMAND_KIND_NAMES[] = {
+    "power", "filter", "bubble", "heater", "temp", "batch"
+};
+
+static const char* const PROFILE_PATH_NAMES[] = {
+    "schedule_check", "schedule_write", "status_render", "audit_write", "audit_log"
+};
+static const char* const PROFILE_UNIT_NAMES[] = {
+    "events", "events", "bytes", "events", "events"
+};
+static_assert(sizeof(PROFILE_PATH_NAMES) / sizeof(PROFILE_PATH_NAMES[0]) == Metrics::PROFILE_COUNT, "profile path names");
+static_assert(sizeof(PROFILE_UNIT_NAMES) / sizeof(PROFILE_UNIT_NAMES[0]) == Metrics::PROFILE_COUNT, "profile unit names");
+
+// Tasks whose stack headroom is reported; missing ones (MQTT disabled, no OTA
+// running) are skipped
+static const char* const WATCHED_TASKS[] = {
+    "purespa_service_task", "purespa_svc_1", "httpd", "httpd_async_0", "httpd_async_1", "httpd_async_2",
+    "httpd_poll", "mqtt_publisher", "mqtt_commands", "mqtt_task", "status_led_task", "dns_server", "ota_writer",
+};
+
+// Formats lines into a stack buffer, handing it to flush whenever the next
+// line does not fit
+class MetricsOutput {
+public:
+    MetricsOutput(Metrics::FlushFn flush, void* ctx) : _flush(flush), _ctx(ctx) {}
+
+    void line(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (_err != ESP_OK) return;
+        for (int attempt = 0; attempt < 2; attempt++) {
+            va_list args;
+            va_start(args, fmt);
+            int n = vsnprintf(_buf + _len, sizeof(_buf) - _len, fmt, args);
+            va_end(args);
+            if (n < 0) return;
+            if ((size_t)n < sizeof(_buf) - _len) {
+                _len += n;
+                return;
+            }
+            flush();
+        }
+        ESP_LOGW(TAG, "Metric line longer than %d bytes dropped", (int)OUTPUT_BUFFER_SIZE);
+    }
+
+    esp_err_t finish() {
+        flush();
+        return _err;
+    }
+
+private:
+    void flush() {
+        if (_len > 0 && _err == ESP_OK) _err = _flush(_ctx, _buf, _len);
+        _len = 0;
+    }
+
+    char _buf[OUTPUT_BUFFER_SIZE];
+    size_t _len = 0;
+    Metrics::FlushFn _flush;
+    void* _ctx;
+    esp_err_t _err = ESP_OK;
+};
+
+// Milliseconds as fractional seconds, without pulling in float formatting
+#define MS_AS_SECONDS(ms) (unsigned long)((ms) / 1000), (unsigned long)((ms) % 1000)
+#define US_AS_SECONDS(us) (unsigned long)((us) / 1000000), (unsigned long)((us) % 1000000)
+
+template<typename T>
+static void storeMax(std::atomic<T>& target, T value) {
+    T current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void Metrics::LatencyHistogram::record(uint32_t ms) {
+    size_t i = 0;
+    while (i < LATENCY_BUCKETS && ms > LATENCY_BOUNDS_MS[i]) i++;
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    sumMs.fetch_add(ms, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t Metrics::LatencyHistogram::percentileMs(uint32_t percent) const {
+    uint32_t total = count.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+    // Rank of the sample at that percentile, rounded up
+    uint32_t rank = (uint32_t)(((uint64_t)total * percent + 99) / 100);
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        if (cumulative >= rank) return LATENCY_BOUNDS_MS[i];
+    }
+    return LATENCY_BOUNDS_MS[LATENCY_BUCKETS - 1]; // beyond the last bound
+}
+
+Metrics::Endpoint* Metrics::registerEndpoint(const char* uri, int method) {
+    size_t index = _endpointCount.load(std::memory_order_relaxed);
+    if (index >= MAX_ENDPOINTS) {
+        ESP_LOGW(TAG, "Endpoint table full, %s not tracked", uri);
+        return nullptr;
+    }
+    Endpoint& endpoint = _endpoints[index];
+    endpoint.uri = uri;
+    endpoint.method = method;
+    // Publish the slot only once it is filled in
+    _endpointCount.store(index + 1, std::memory_order_release);
+    return &endpoint;
+}
+
+void Metrics::recordRequest(Endpoint* endpoint, const RequestSample& sample) {
+    if (endpoint == nullptr) return;
+    endpoint->latency.record(sample.durationMs);
+    endpoint->bytesOut.fetch_add(sample.bytesOut, std::memory_order_relaxed);
+    endpoint->sendMs.fetch_add(sample.sendMs, std::memory_order_relaxed);
+    if (sample.error) endpoint->errors.fetch_add(1, std::memory_order_relaxed);
+
+    if (sample.durationMs < SLOW_REQUEST_MS) return;
+    _slowTotal.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(_slowMutex);
+    SlowRequest& slow = _slow[_slowNext];
+    _slowNext = (_slowNext + 1) % SLOW_SAMPLES;
+    snprintf(slow.uri, sizeof(slow.uri), "%s", sample.uri);
+    slow.method = endpoint->method;
+    slow.durationMs = sample.durationMs;
+    slow.sendMs = sample.sendMs;
+    slow.bytesOut = sample.bytesOut;
+    slow.heapDelta = sample.heapDelta;
+    slow.uptime = (uint32_t)(esp_timer_get_time() / 1000000);
+    ESP_LOGD(TAG, "Slow request %s: %lu ms (%lu ms sending %lu bytes), heap %+ld",
+             slow.uri, (unsigned long)slow.durationMs, (unsigned long)slow.sendMs,
+             (unsigned long)slow.bytesOut, (long)slow.heapDelta);
+}
+
+void Metrics::writeHttpStats(DocWriter& w) {
+    // Copy the samples so the lock is not held while the response is sent
+    SlowRequest slow[SLOW_SAMPLES];
+    size_t next;
+    {
+        std::lock_guard<std::mutex> lock(_slowMutex);
+        memcpy(slow, _slow, sizeof(slow));
+        next = _slowNext;
+    }
+
+    w.beginObject();
+    w.field("slowThresholdMs", (unsigned long)SLOW_REQUEST_MS);
+    w.field("slowTotal", (unsigned long)_slowTotal.load(std::memory_order_relaxed));
+    w.beginArray("endpoints");
+    size_t endpointCount = _endpointCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < endpointCount; i++) {
+        const Endpoint& e = _endpoints[i];
+        uint32_t count = e.latency.count.load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        w.beginObject()
+            .field("method", http_method_str((enum http_method)e.method))
+            .field("uri", e.uri)
+            .field("count", (unsigned long)count)
+            .field("errors", (unsigned long)e.errors.load(std::memory_order_relaxed))
+            .field("bytes", (unsigned long)e.bytesOut.load(std::memory_order_relaxed))
+            .field("avgMs", (unsigned long)(e.latency.sumMs.load(std::memory_order_relaxed) / count))
+            .field("p50Ms", (unsigned long)e.latency.percentileMs(50))
+            .field("p95Ms", (unsigned long)e.latency.percentileMs(95))
+            .field("sendMs", (unsigned long)e.sendMs.load(std::memory_order_relaxed))
+            .endObject();
+    }
+    w.endArray();
+    // Most recent first
+    w.beginArray("slow");
+    for (size_t n = 0; n < SLOW_SAMPLES; n++) {
+        const SlowRequest& r = slow[(next + SLOW_SAMPLES - 1 - n) % SLOW_SAMPLES];
+        if (r.uri[0] == '\0') break;
+        w.beginObject()
+            .field("method", http_method_str((enum http_method)r.method))
+            .field("uri", r.uri)
+            .field("ms", (unsigned long)r.durationMs)
+            .field("sendMs", (unsigned long)r.sendMs)
+            .field("bytes", (unsigned long)r.bytesOut)
+            .field("heapDelta", (long)r.heapDelta)
+            .field("uptime", (unsigned long)r.uptime)
+            .endObject();
+    }
+    w.endArray();
+    w.endObject();
+}
+
+void Metrics::recordCommand(SpaCommand cmd, uint32_t latencyMs) {
+    CommandKind kind;
+    switch (cmd) {
+        case SpaCommand::POWER_ON:
+        case SpaCommand::POWER_OFF:  kind = KIND_POWER; break;
+        case SpaCommand::FILTER_ON:
+        case SpaCommand::FILTER_OFF: kind = KIND_FILTER; break;
+        case SpaCommand::BUBBLE_ON:
+        case SpaCommand::BUBBLE_OFF: kind = KIND_BUBBLE; break;
+        case SpaCommand::HEATER_ON:
+        case SpaCommand::HEATER_OFF: kind = KIND_HEATER; break;
+        case SpaCommand::SET_TEMP:   kind = KIND_TEMP; break;
+        case SpaCommand::BATCH:      kind = KIND_BATCH; break;
+        default: return;
+    }
+    _commands[kind].record(latencyMs);
+}
+
+void Metrics::countNvsCommit(const char* ns) {
+    for (size_t i = 0; i < MAX_NVS_NAMESPACES; i++) {
+        const char* name = _nvs[i].name.load(std::memory_order_acquire);
+        if (name == nullptr) {
+            // Claim the free slot; if another task got there first, check what it stored
+            if (_nvs[i].name.compare_exchange_strong(name, ns, std::memory_order_acq_rel)) {
+                name = ns;
+            }
+        }
+        if (name == ns || strcmp(name, ns) == 0) {
+            _nvs[i].commits.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    _nvsOverflow.fetch_add(1, std::memory_order_relaxed);
+}
+
+Metrics::ProfileScope::ProfileScope(ProfilePath path, uint32_t units)
+    : _path(path), _units(units), _start(esp_timer_get_time()), _freeHeap(esp_get_free_heap_size()) {}
+
+Metrics::ProfileScope::~ProfileScope() {
+    int32_t heapDelta = (int32_t)(_freeHeap - esp_get_free_heap_size());
+    Metrics::getInstance().recordProfile(_path, (uint32_t)(esp_timer_get_time() - _start), _units, heapDelta);
+}
+
+void Metrics::recordProfile(ProfilePath path, uint32_t us, uint32_t units, int32_t heapDelta) {
+    if (path >= PROFILE_COUNT) return;
+    ProfileStats& p = _profile[path];
+    p.sumUs.fetch_add(us, std::memory_order_relaxed);
+    p.units.fetch_add(units, std::memory_order_relaxed);
+    p.lastUs.store(us, std::memory_order_relaxed);
+    p.lastUnits.store(units, std::memory_order_relaxed);
+    storeMax(p.maxUs, us);
+    storeMax(p.maxHeapDelta, heapDelta);
+    p.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::writeProfile(DocWriter& w) {
+    w.beginObject();
+    w.field("uptime", (unsigned long)(esp_timer_get_time() / 1000000));
+    w.beginArray("paths");
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        const ProfileStats& p = _profile[i];
+        uint32_t count = p.count.load(std::memory_order_relaxed);
+        uint32_t sumUs = p.sumUs.load(std::memory_order_relaxed);
+        uint32_t units = p.units.load(std::memory_order_relaxed);
+        w.beginObject()
+            .field("path", PROFILE_PATH_NAMES[i])
+            .field("unit", PROFILE_UNIT_NAMES[i])
+            .field("count", (unsigned long)count)
+            .field("totalUs", (unsigned long)sumUs)
+            .field("avgUs", (unsigned long)(count ? sumUs / count : 0))
+            .field("maxUs", (unsigned long)p.maxUs.load(std::memory_order_relaxed))
+            .field("lastUs", (unsigned long)p.lastUs.load(std::memory_order_relaxed))
+            .field("lastUnits", (unsigned long)p.lastUnits.load(std::memory_order_relaxed))
+            .field("units", (unsigned long)units)
+            .field("nsPerUnit", (unsigned long)(units ? (uint64_t)sumUs * 1000 / units : 0))
+            .field("maxHeapDelta", (long)p.maxHeapDelta.load(std::memory_order_relaxed))
+            .endObject();
+    }
+    w.endArray();
+    w.endObject();
+}
+
+esp_err_t Metrics::render(FlushFn flush, void* ctx) {
+    MetricsOutput out(flush, ctx);
+    size_t spas = PureSpaService::getSpaCount();
+
+    // Bus decoder, one series per spa
+    out.line("# HELP purespa_bus_isr_total Clock edges handled by the bus ISR.\n"
+             "# TYPE purespa_bus_isr_total counter\n");
+    for (size_t spa = 0; spa < spas; spa++) {
+        PureSpaIO::BusCounters bus = PureSpaService::getInstance(spa)->getBusCounters();
+        out.line("purespa_bus_isr_total{spa=\"%u\"} %lu\n", (unsigned)spa, (unsigned long)bus.isr);
+    }
+    out.line("# HELP purespa_bus_frames_total Complete frames decoded, by frame type.\n"
+             "# TYPE purespa_bus_frames_total counter\n");
+    for (size_t spa = 0; spa < spas; spa++) {
+        PureSpaIO::BusCounters bus = PureSpaService::getInstance(spa)->getBusCounters();
+        out.line("purespa_bus_frames_total{spa=\"%u\",type=\"cue\"} %lu\n"
+                 "purespa_bus_frames_total{spa=\"%u\",type=\"digit\"} %lu\n"
+                 "purespa_bus_frames_total{spa=\"%u\",type=\"led\"} %lu\n"
+                 "purespa_bus_frames_total{spa=\"%u\",type=\"button\"} %lu\n"
+                 "purespa_bus_frames_total{spa=\"%u\",type=\"unsupported\"} %lu\n",
+                 (unsigned)spa, (unsigned long)bus.cueFrames, (unsigned)spa, (unsigned long)bus.digitFrames,
+                 (unsigned)spa, (unsigned long)bus.ledFrames, (unsigned)spa, (unsigned long)bus.buttonFrames,
+                 (unsigned)spa, (unsigned long)bus.unsupportedFrames);
+    }
+    out.line("# HELP purespa_bus_frames_valid_total Frames with the full bit count.\n"
+             "# TYPE purespa_bus_frames_valid_total counter\n");
+    for (size_t spa = 0; spa < spas; spa++) {
+        PureSpaIO::BusCounters bus = PureSpaService::getInstance(spa)->getBusCounters();
+        out.line("purespa_bus_frames_valid_total{spa=\"%u\"} %lu\n", (unsigned)spa, (unsigned long)bus.validFrames);
+    }
+    out.line("# HELP purespa_bus_frames_invalid_total Frames cut short by the clock ISR.\n"
+             "# TYPE purespa_bus_frames_invalid_total counter\n");
+    for (size_t spa = 0; spa < spas; spa++) {
+        PureSpaIO::BusCounters bus = PureSpaService::getInstance(spa)->getBusCounters();
+        out.line("purespa_bus_frames_invalid_total{spa=\"%u\"} %lu\n", (unsigned)spa, (unsigned long)bus.invalidFrames);
+    }
+    out.line("# HELP purespa_bus_frames_dropped_total Frames dropped by either ISR.\n"
+             "# TYPE purespa_bus_frames_dropped_total counter\n");
+    for (size_t spa = 0; spa < spas; spa++) {
+        out.line("purespa_bus_frames_dropped_total{spa=\"%u\"} %lu\n",
+                 (unsigned)spa, (unsigned long)PureSpaService::getInstance(spa)->getDroppedFrames());
+    }
+
+    // Queues
+    out.line("# HELP purespa_queue_depth Messages waiting per queue.\n"
+             "# TYPE purespa_queue_depth gauge\n");
+    for (size_t spa = 0; spa < spas; spa++) {
+        out.line("purespa_queue_depth{queue=\"command\",spa=\"%u\"} %u\n",
+                 (unsigned)spa, (unsigned)PureSpaService::getInstance(spa)->getQueueDepth());
+    }
+    out.line("purespa_queue_depth{queue=\"http_async\"} %u\n"
+             "purespa_queue_depth{queue=\"http_long_poll\"} %u\n"
+             "purespa_queue_depth{queue=\"mqtt\"} %u\n",
+             (unsigned)WebServer::getInstance().getAsyncQueueDepth(),
+             (unsigned)WebServer::getInstance().getParkedPollCount(),
+             (unsigned)MqttPublisher::getInstance().getQueueDepth());
+
+    // Command latency, queueing included
+    out.line("# HELP purespa_command_latency_seconds Time from queueing a spa command to its completion.\n"
+             "# TYPE purespa_command_latency_seconds histogram\n");
+    for (size_t k = 0; k < KIND_COUNT; k++) {
+        const LatencyHistogram& h = _commands[k];
+        const char* kind = COMMAND_KIND_NAMES[k];
+        uint32_t cumulative = 0;
+        for (size_t b = 0; b < LATENCY_BUCKETS; b++) {
+            cumulative += h.buckets[b].load(std::memory_order_relaxed);
+            out.line("purespa_command_latency_seconds_bucket{command=\"%s\",le=\"%lu.%03lu\"} %lu\n",
+                     kind, MS_AS_SECONDS(LATENCY_BOUNDS_MS[b]), (unsigned long)cumulative);
+        }
+        cumulative += h.buckets[LATENCY_BUCKETS].load(std::memory_order_relaxed);
+        uint32_t sumMs = h.sumMs.load(std::memory_order_relaxed);
+        out.line("purespa_command_latency_seconds_bucket{command=\"%s\",le=\"+Inf\"} %lu\n"
+                 "purespa_command_latency_seconds_sum{command=\"%s\"} %lu.%03lu\n"
+                 "purespa_command_latency_seconds_count{command=\"%s\"} %lu\n",
+                 kind, (unsigned long)cumulative, kind, MS_AS_SECONDS(sumMs),
+                 kind, (unsigned long)cumulative);
+    }
+
+    // HTTP endpoints
+    size_t endpointCount = _endpointCount.load(std::memory_order_acquire);
+    out.line("# HELP purespa_http_requests_total Requests handled, by endpoint.\n"
+             "# TYPE purespa_http_requests_total counter\n");
+    for (size_t i = 0; i < endpointCount; i++) {
+        const Endpoint& e = _endpoints[i];
+        out.line("purespa_http_requests_total{method=\"%s\",uri=\"%s\"} %lu\n",
+                 http_method_str((enum http_method)e.method), e.uri,
+                 (unsigned long)e.latency.count.load(std::memory_order_relaxed));
+    }
+    out.line("# HELP purespa_http_handler_errors_total Requests whose handler failed, by endpoint.\n"
+             "# TYPE purespa_http_handler_errors_total counter\n");
+    for (size_t i = 0; i < endpointCount; i++) {
+        const Endpoint& e = _endpoints[i];
+        out.line("purespa_http_handler_errors_total{method=\"%s\",uri=\"%s\"} %lu\n",
+                 http_method_str((enum http_method)e.method), e.uri,
+                 (unsigned long)e.errors.load(std::memory_order_relaxed));
+    }
+    out.line("# HELP purespa_http_response_bytes_total Bytes written to the socket, by endpoint.\n"
+             "# TYPE purespa_http_response_bytes_total counter\n");
+    for (size_t i = 0; i < endpointCount; i++) {
+        const Endpoint& e = _endpoints[i];
+        out.line("purespa_http_response_bytes_total{method=\"%s\",uri=\"%s\"} %lu\n",
+                 http_method_str((enum http_method)e.method), e.uri,
+                 (unsigned long)e.bytesOut.load(std::memory_order_relaxed));
+    }
+    out.line("# HELP purespa_http_send_seconds_total Time handlers spent blocked in send(), by endpoint.\n"
+             "# TYPE purespa_http_send_seconds_total counter\n");
+    for (size_t i = 0; i < endpointCount; i++) {
+        const Endpoint& e = _endpoints[i];
+        out.line("purespa_http_send_seconds_total{method=\"%s\",uri=\"%s\"} %lu.%03lu\n",
+                 http_method_str((enum http_method)e.method), e.uri,
+                 MS_AS_SECONDS(e.sendMs.load(std::memory_order_relaxed)));
+    }
+    // Histogram series only for endpoints that were hit, to keep scrapes small
+    out.line("# HELP purespa_http_request_duration_seconds Handler time, long-poll parking excluded.\n"
+             "# TYPE purespa_http_request_duration_seconds histogram\n");
+    for (size_t i = 0; i < endpointCount; i++) {
+        const Endpoint& e = _endpoints[i];
+        if (e.latency.count.load(std::memory_order_relaxed) == 0) continue;
+        const char* method = http_method_str((enum http_method)e.method);
+        uint32_t cumulative = 0;
+        for (size_t b = 0; b < LATENCY_BUCKETS; b++) {
+            cumulative += e.latency.buckets[b].load(std::memory_order_relaxed);
+            out.line("purespa_http_request_duration_seconds_bucket{method=\"%s\",uri=\"%s\",le=\"%lu.%03lu\"} %lu\n",
+                     method, e.uri, MS_AS_SECONDS(LATENCY_BOUNDS_MS[b]), (unsigned long)cumulative);
+        }
+        cumulative += e.latency.buckets[LATENCY_BUCKETS].load(std::memory_order_relaxed);
+        out.line("purespa_http_request_duration_seconds_bucket{method=\"%s\",uri=\"%s\",le=\"+Inf\"} %lu\n"
+                 "purespa_http_request_duration_seconds_sum{method=\"%s\",uri=\"%s\"} %lu.%03lu\n"
+                 "purespa_http_request_duration_seconds_count{method=\"%s\",uri=\"%s\"} %lu\n",
+                 method, e.uri, (unsigned long)cumulative,
+                 method, e.uri, MS_AS_SECONDS(e.latency.sumMs.load(std::memory_order_relaxed)),
+                 method, e.uri, (unsigned long)cumulative);
+    }
+    out.line("# HELP purespa_http_slow_requests_total Requests slower than the sampling threshold.\n"
+             "# TYPE purespa_http_slow_requests_total counter\n"
+             "purespa_http_slow_requests_total %lu\n",
+             (unsigned long)_slowTotal.load(std::memory_order_relaxed));
+
+    // NVS writes
+    out.line("# HELP purespa_nvs_commits_total NVS commits, by namespace.\n"
+             "# TYPE purespa_nvs_commits_total counter\n");
+    for (size_t i = 0; i < MAX_NVS_NAMESPACES; i++) {
+        const char* name = _nvs[i].name.load(std::memory_order_acquire);
+        if (name == nullptr) break;
+        out.line("purespa_nvs_commits_total{namespace=\"%s\"} %lu\n",
+                 name, (unsigned long)_nvs[i].commits.load(std::memory_order_relaxed));
+    }
+    uint32_t overflow = _nvsOverflow.load(std::memory_order_relaxed);
+    if (overflow > 0) {
+        out.line("purespa_nvs_commits_total{namespace=\"other\"} %lu\n", (unsigned long)overflow);
+    }
+
+    // Profiled code paths
+    out.line("# HELP purespa_profile_calls_total Runs of a profiled code path.\n"
+             "# TYPE purespa_profile_calls_total counter\n");
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        out.line("purespa_profile_calls_total{path=\"%s\"} %lu\n",
+                 PROFILE_PATH_NAMES[i], (unsigned long)_profile[i].count.load(std::memory_order_relaxed));
+    }
+    out.line("# HELP purespa_profile_seconds_total Time spent in a profiled code path.\n"
+             "# TYPE purespa_profile_seconds_total counter\n");
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        out.line("purespa_profile_seconds_total{path=\"%s\"} %lu.%06lu\n",
+                 PROFILE_PATH_NAMES[i], US_AS_SECONDS(_profile[i].sumUs.load(std::memory_order_relaxed)));
+    }
+    out.line("# HELP purespa_profile_max_seconds Longest run of a profiled code path.\n"
+             "# TYPE purespa_profile_max_seconds gauge\n");
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        out.line("purespa_profile_max_seconds{path=\"%s\"} %lu.%06lu\n",
+                 PROFILE_PATH_NAMES[i], US_AS_SECONDS(_profile[i].maxUs.load(std::memory_order_relaxed)));
+    }
+    out.line("# HELP purespa_profile_units_total Work done by a profiled code path, in its own unit.\n"
+             "# TYPE purespa_profile_units_total counter\n");
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        out.line("purespa_profile_units_total{path=\"%s\",unit=\"%s\"} %lu\n",
+                 PROFILE_PATH_NAMES[i], PROFILE_UNIT_NAMES[i],
+                 (unsigned long)_profile[i].units.load(std::memory_order_relaxed));
+    }
+
+    // MQTT
+    MqttPublisher& mqtt = MqttPublisher::getInstance();
+    out.line("# HELP purespa_mqtt_connected Whether the broker connection is up.\n"
+             "# TYPE purespa_mqtt_connected gauge\n"
+             "purespa_mqtt_connected %d\n"
+             "# HELP purespa_mqtt_dropped_total State updates dropped on a full publish queue.\n"
+             "# TYPE purespa_mqtt_dropped_total counter\n"
+             "purespa_mqtt_dropped_total %lu\n"
+             "# HELP purespa_mqtt_coalesced_total Commands overwritten before they were executed.\n"
+             "# TYPE purespa_mqtt_coalesced_total counter\n"
+             "purespa_mqtt_coalesced_total %lu\n"
+             "# HELP purespa_mqtt_retained_ignored_total Retained command messages that were not executed.\n"
+             "# TYPE purespa_mqtt_retained_ignored_total counter\n"
+             "purespa_mqtt_retained_ignored_total %lu\n",
+             mqtt.isConnected() ? 1 : 0, (unsigned long)mqtt.getDroppedCount(),
+             (unsigned long)mqtt.getCoalescedCount(), (unsigned long)mqtt.getRetainedIgnoredCount());
+
+    // Task stacks (ESP-IDF reports the high-water mark in bytes)
+    out.line("# HELP purespa_task_stack_free_bytes Smallest free stack seen, by task.\n"
+             "# TYPE purespa_task_stack_free_bytes gauge\n");
+    for (const char* name : WATCHED_TASKS) {
+        TaskHandle_t task = xTaskGetHandle(name);
+        if (task == NULL) continue;
+        out.line("purespa_task_stack_free_bytes{task=\"%s\"} %u\n",
+                 name, (unsigned)uxTaskGetStackHighWaterMark(task));
+    }
+
+    // System
+    out.line("# HELP purespa_free_heap_bytes Free heap.\n"
+             "# TYPE purespa_free_heap_bytes gauge\n"
+             "purespa_free_heap_bytes %lu\n"
+             "# HELP purespa_min_free_heap_bytes Lowest free heap since boot.\n"
+             "# TYPE purespa_min_free_heap_bytes gauge\n"
+             "purespa_min_free_heap_bytes %lu\n"
+             "# HELP purespa_uptime_seconds Time since boot.\n"
+             "# TYPE purespa_uptime_seconds counter\n"
+             "purespa_uptime_seconds %lu\n",
+             (unsigned long)esp_get_free_heap_size(), (unsigned long)esp_get_minimum_free_heap_size(),
+             (unsigned long)(esp_timer_get_time() / 1000000));
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        out.line("# HELP purespa_wifi_rssi_dbm Signal strength of the station link.\n"
+                 "# TYPE purespa_wifi_rssi_dbm gauge\n"
+                 "purespa_wifi_rssi_dbm %d\n", (int)ap_info.rssi);
+    }
+
+    return out.finish();
+}
@@ -0,0 +1,168 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include "esp_err.h"
+#include "PureSpaService.h"
+#include "doc_writer.h"
+
+// Prometheus text exposition of bus, service, HTTP and system counters for
+// GET /metrics. Everything recorded here is a relaxed std::atomic, so the hot
+// paths (service task, httpd task) never take a lock, and render() streams
+// through a stack buffer without touching the heap. Only the slow request
+// samples, written a few times at most per second, sit behind a mutex.
+//
+// Counters are uint32_t and wrap; Prometheus' rate() treats a wrap as a reset.
+class Metrics {
+public:
+    static Metrics& getInstance() {
+        static Metrics instance;
+        return instance;
+    }
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    typedef esp_err_t (*FlushFn)(void* ctx, const char* data, size_t len);
+
+    // Upper bounds of the latency histogram buckets [ms], +Inf is implicit
+    static const size_t LATENCY_BUCKETS = 14;
+    static const uint32_t LATENCY_BOUNDS_MS[LATENCY_BUCKETS];
+
+    struct LatencyHistogram {
+        std::atomic<uint32_t> buckets[LATENCY_BUCKETS + 1]; // not cumulative, summed in render()
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> sumMs;
+        void record(uint32_t ms);
+        // Upper bound of the bucket holding the given percentile, 0 when empty
+        uint32_t percentileMs(uint32_t percent) const;
+    };
+
+    // Per registered URI handler
+    struct Endpoint {
+        const char* uri;
+        int method;
+        LatencyHistogram latency;          // handler time, parked time excluded
+        std::atomic<uint32_t> errors;      // handler returned an error, socket closed
+        std::atomic<uint32_t> bytesOut;    // socket bytes, headers included
+        std::atomic<uint32_t> sendMs;      // blocked in send(), i.e. waiting on the link
+    };
+
+    // One finished request, as measured by the WebServer timing shim
+    struct RequestSample {
+        const char* uri;       // as requested, query included
+        uint32_t durationMs;
+        uint32_t sendMs;
+        uint32_t bytesOut;
+        int32_t heapDelta;     // free heap after minus before
+        bool error;
+    };
+
+    // Code paths timed in place, so a regression shows up on the device that
+    // runs them. Units scale the work: cost per unit is how a path grows.
+    enum ProfilePath : uint8_t {
+        PROFILE_SCHEDULE_CHECK,    // units: events scanned, triggered ones excluded
+        PROFILE_SCHEDULE_WRITE,    // units: events serialized
+        PROFILE_STATUS_RENDER,     // units: JSON plus CBOR bytes
+        PROFILE_AUDIT_WRITE,       // units: events serialized
+        PROFILE_AUDIT_LOG,         // units: events held, NVS write included
+        PROFILE_COUNT
+    };
+
+    struct ProfileStats {
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> sumUs;
+        std::atomic<uint32_t> maxUs;
+        std::atomic<uint32_t> lastUs;
+        std::atomic<uint32_t> units;
+        std::atomic<uint32_t> lastUnits;
+        std::atomic<int32_t> maxHeapDelta; // largest heap still held on return
+    };
+
+    // Times the enclosing scope into a path. The heap delta is the free heap
+    // lost between construction and destruction, which includes whatever other
+    // tasks allocated meanwhile, so only its maximum is kept.
+    class ProfileScope {
+    public:
+        explicit ProfileScope(ProfilePath path, uint32_t units = 0);
+        ~ProfileScope();
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+        // For work that is only counted once done
+        void setUnits(uint32_t units) { _units = units; }
+    private:
+        ProfilePath _path;
+        uint32_t _units;
+        int64_t _start;
+        uint32_t _freeHeap;
+    };
+
+    static const size_t MAX_ENDPOINTS = 40;
+    static const size_t MAX_NVS_NAMESPACES = 8;
+
+    // Requests slower than this are kept in a small ring for the admin panel
+    static const uint32_t SLOW_REQUEST_MS = 500;
+    static const size_t SLOW_SAMPLES = 8;
+
+    // Called while registering handlers, from the task starting the server.
+    // uri must have static storage. Returns nullptr when the table is full.
+    Endpoint* registerEndpoint(const char* uri, int method);
+    void recordRequest(Endpoint* endpoint, const RequestSample& sample);
+
+    // Compact per-endpoint summary plus the slow request samples
+    void writeHttpStats(DocWriter& w);
+
+    // Time from queueing a command to the end of its execution
+    void recordCommand(SpaCommand cmd, uint32_t latencyMs);
+
+    // Call after each nvs_commit(); ns must have static storage (a literal)
+    void countNvsCommit(const char* ns);
+
+    void recordProfile(ProfilePath path, uint32_t us, uint32_t units, int32_t heapDelta);
+    // Per path totals, average, maximum and cost per unit
+    void writeProfile(DocWriter& w);
+
+    // Streams the whole exposition through flush
+    esp_err_t render(FlushFn flush, void* ctx);
+
+private:
+    enum CommandKind : uint8_t {
+        KIND_POWER, KIND_FILTER, KIND_BUBBLE, KIND_HEATER, KIND_TEMP, KIND_BATCH,
+        KIND_COUNT
+    };
+
+    struct SlowRequest {
+        char uri[48];
+        int method;
+        uint32_t durationMs;
+        uint32_t sendMs;
+        uint32_t bytesOut;
+        int32_t heapDelta;
+        uint32_t uptime;       // [s] when it finished
+    };
+
+    struct NvsNamespace {
+        std::atomic<const char*> name;
+        std::atomic<uint32_t> commits;
+    };
+
+    Metrics() {}
+
+    LatencyHistogram _commands[KIND_COUNT] = {};
+    ProfileStats _profile[PROFILE_COUNT] = {};
+    Endpoint _endpoints[MAX_ENDPOINTS] = {};
+    std::atomic<size_t> _endpointCount{0};
+    NvsNamespace _nvs[MAX_NVS_NAMESPACES] = {};
+    std::atomic<uint32_t> _nvsOverflow{0};
+
+    // Slow requests are rare, a lock keeps each sample consistent
+    std::mutex _slowMutex;
+    SlowRequest _slow[SLOW_SAMPLES] = {};
+    size_t _slowNext = 0;
+    std::atomic<uint32_t> _slowTotal{0};
+};
+
+#endif // METRICS_H
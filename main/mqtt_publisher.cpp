@@ -0,0 +1,408 @@
+#include "mqtt_publisher.h"
+#include <esp_log.h>
+#include <esp_netif.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <strings.h>
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "json_writer.h"
+
+static const char *TAG = "MqttPublisher";
+
+static const int QOS = 0;
+static const int RETAIN = 1;
+
+// Same order as MqttPublisher::Topic
+static const char* const STATUS_TOPICS[] = {
+    MQTT_TOPIC::POWER,
+    MQTT_TOPIC::FILTER,
+    MQTT_TOPIC::HEATER,
+    MQTT_TOPIC::BUBBLE,
+    MQTT_TOPIC::JET,
+    MQTT_TOPIC::DISINFECTION,
+    MQTT_TOPIC::WATER_ACT,
+    MQTT_TOPIC::WATER_SET,
+    MQTT_TOPIC::ERROR,
+};
+
+// Same order as MqttPublisher::Command. Jet and disinfection have no service
+// command yet, so their topics are not subscribed.
+static const char* const COMMAND_TOPICS[] = {
+    MQTT_TOPIC::CMD_POWER,
+    MQTT_TOPIC::CMD_FILTER,
+    MQTT_TOPIC::CMD_HEATER,
+    MQTT_TOPIC::CMD_BUBBLE,
+    MQTT_TOPIC::CMD_WATER,
+};
+static const char* const COMMAND_NAMES[] = { "power", "filter", "heater", "bubble", "water/tempSet" };
+
+static bool parseSwitch(const char* data, size_t len, int* value) {
+    char buf[8];
+    if (len >= sizeof(buf)) return false;
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+    if (strcasecmp(buf, "on") == 0 || strcmp(buf, "1") == 0 || strcasecmp(buf, "true") == 0) {
+        *value = 1;
+    } else if (strcasecmp(buf, "off") == 0 || strcmp(buf, "0") == 0 || strcasecmp(buf, "false") == 0) {
+        *value = 0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parseTemp(const char* data, size_t len, int* value) {
+    char buf[8];
+    if (len == 0 || len >= sizeof(buf)) return false;
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+    char* end;
+    long v = strtol(buf, &end, 10);
+    if (*end != '\0' || v < PureSpaIO::WATER_TEMP::SET_MIN || v > PureSpaIO::WATER_TEMP::SET_MAX) return false;
+    *value = (int)v;
+    return true;
+}
+
+void MqttPublisher::start() {
+#if CONFIG_PURESPA_MQTT
+    if (_client != nullptr) return;
+
+    _queue = xQueueCreate(CONFIG_PURESPA_MQTT_QUEUE_LEN, sizeof(Message));
+    if (_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create send queue");
+        return;
+    }
+
+    esp_mqtt_client_config_t config = {};
+    config.broker.address.uri = CONFIG_PURESPA_MQTT_BROKER_URI;
+    if (strlen(CONFIG_PURESPA_MQTT_USERNAME) > 0) {
+        config.credentials.username = CONFIG_PURESPA_MQTT_USERNAME;
+        config.credentials.authentication.password = CONFIG_PURESPA_MQTT_PASSWORD;
+    }
+    // The broker flags us offline if the connection drops
+    config.session.last_will.topic = MQTT_TOPIC::STATE;
+    config.session.last_will.msg = "offline";
+    config.session.last_will.qos = 1;
+    config.session.last_will.retain = RETAIN;
+
+    _client = esp_mqtt_client_init(&config);
+    if (_client == nullptr) {
+        ESP_LOGE(TAG, "Failed to create MQTT client");
+        return;
+    }
+    esp_mqtt_client_register_event(_client, MQTT_EVENT_ANY, eventHandler, this);
+
+    // Core 0, away from the bus polling service task on core 1
+    xTaskCreatePinnedToCore(taskWrapper, "mqtt_publisher", 4096, this, 4, NULL, 0);
+    xTaskCreatePinnedToCore(commandTaskWrapper, "mqtt_commands", 4096, this, 4, &_commandTask, 0);
+    PureSpaService::getInstance().setStatusListener(onStatus, this);
+
+    ESP_LOGI(TAG, "Connecting to %s", CONFIG_PURESPA_MQTT_BROKER_URI);
+    esp_mqtt_client_start(_client);
+#else
+    ESP_LOGI(TAG, "MQTT disabled in menuconfig");
+#endif
+}
+
+// Service task: queue the topics whose payload differs from what was last queued
+void MqttPublisher::onStatus(void* ctx, const PureSpaService::StatusSnapshot& status) {
+    MqttPublisher& self = *static_cast<MqttPublisher*>(ctx);
+    std::lock_guard<std::mutex> lock(self._stateMutex);
+    self._latest = status;
+    self._hasLatest = true;
+    if (!self._connected) return;
+
+    for (uint8_t t = 0; t < TOPIC_COUNT; t++) {
+        Message msg;
+        msg.topic = t;
+        if (!formatTopic(t, status, msg.payload)) continue;
+        if (strcmp(msg.payload, self._queued[t]) == 0) continue;
+        if (xQueueSend(self._queue, &msg, 0) != pdPASS) {
+            self._dropped++;
+            continue;
+        }
+        strcpy(self._queued[t], msg.payload);
+    }
+}
+
+// False while the value has not been decoded from the bus yet
+bool MqttPublisher::formatTopic(uint8_t topic, const PureSpaService::StatusSnapshot& s, char* out) {
+    auto onOff = [out](uint8_t v) {
+        if (v == PureSpaIO::UNDEF::BOOL) return false;
+        strcpy(out, v ? "on" : "off");
+        return true;
+    };
+    auto temp = [out](int v) {
+        if (v == PureSpaIO::UNDEF::INT) return false;
+        snprintf(out, PAYLOAD_SIZE, "%d", v);
+        return true;
+    };
+
+    if (!s.online) return false;
+    switch (topic) {
+        case POWER:  return onOff(s.power);
+        case FILTER: return onOff(s.filter);
+        case HEATER:
+            if (s.heater != PureSpaIO::UNDEF::BOOL && !s.heater && s.heaterStandby == 1) {
+                strcpy(out, "standby");
+                return true;
+            }
+            return onOff(s.heater);
+        case BUBBLE: return onOff(s.bubble);
+        case JET:          return PureSpaService::getInstance().getCapabilities().jet && onOff(s.jet);
+        case DISINFECTION: return PureSpaService::getInstance().getCapabilities().disinfection && onOff(s.disinfection);
+        case WATER_ACT: return temp(s.actTemp);
+        case WATER_SET: return temp(s.setTemp);
+        case ERROR:
+            snprintf(out, PAYLOAD_SIZE, "%s", s.error[0] ? s.error : "none");
+            return true;
+        default:
+            return false;
+    }
+}
+
+void MqttPublisher::eventHandler(void* arg, esp_event_base_t base, int32_t eventId, void* eventData) {
+    MqttPublisher& self = *static_cast<MqttPublisher*>(arg);
+    switch ((esp_mqtt_event_id_t)eventId) {
+        case MQTT_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "Connected to broker");
+            self._connected = true;
+            self._republish = true;
+            self.subscribeCommands();
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            ESP_LOGW(TAG, "Disconnected from broker");
+            self._connected = false;
+            break;
+        case MQTT_EVENT_DATA: {
+            esp_mqtt_event_handle_t event = static_cast<esp_mqtt_event_handle_t>(eventData);
+            // Commands are a few bytes, anything fragmented is not one of ours
+            if (event->current_data_offset != 0 || event->data_len != event->total_data_len) break;
+            // A retained command is stale: the broker replays it on every
+            // (re)subscribe, long after whoever sent it stopped caring
+            if (event->retain) {
+                // Warn once, a replayed burst would flood the log
+                if (self._retainedIgnored++ == 0) {
+                    ESP_LOGW(TAG, "Ignoring retained command on %.*s (publish commands without retain)",
+                             event->topic_len, event->topic);
+                }
+                break;
+            }
+            self.onCommand(event->topic, event->topic_len, event->data, event->data_len);
+            break;
+        }
+        case MQTT_EVENT_ERROR:
+            ESP_LOGW(TAG, "MQTT error");
+            break;
+        default:
+            break;
+    }
+}
+
+void MqttPublisher::subscribeCommands() {
+    for (const char* topic : COMMAND_TOPICS) {
+        if (esp_mqtt_client_subscribe(_client, topic, 0) < 0) {
+            ESP_LOGW(TAG, "Subscribe to %s failed", topic);
+        }
+    }
+}
+
+// MQTT client task: only records the wanted value, the command task executes it
+void MqttPublisher::onCommand(const char* topic, size_t topicLen, const char* data, size_t len) {
+    for (uint8_t c = 0; c < COMMAND_COUNT; c++) {
+        if (strlen(COMMAND_TOPICS[c]) != topicLen || strncmp(COMMAND_TOPICS[c], topic, topicLen) != 0) continue;
+
+        int value;
+        bool valid = (c == CMD_WATER) ? parseTemp(data, len, &value) : parseSwitch(data, len, &value);
+        if (!valid) {
+            char buf[64];
+            JsonWriter w(buf, sizeof(buf));
+            w.beginObject().field("command", COMMAND_NAMES[c]).field("result", "invalid").endObject();
+            if (w.finish() == ESP_OK) {
+                esp_mqtt_client_enqueue(_client, MQTT_TOPIC::CMD_RESULT, buf, w.length(), 0, 0, true);
+            }
+            ESP_LOGW(TAG, "Invalid payload for %s", COMMAND_TOPICS[c]);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_commandMutex);
+            PendingCommand& pending = _pending[c];
+            if (pending.dirty) {
+                _coalesced++;
+            } else {
+                pending.dirty = true;
+                pending.receivedAt = esp_timer_get_time();
+            }
+            pending.value = value;
+        }
+        xTaskNotifyGive(_commandTask);
+        return;
+    }
+}
+
+SpaBatchCommand MqttPublisher::toBatchCommand(uint8_t command, int value) {
+    switch (command) {
+        case CMD_POWER:  return { value ? SpaCommand::POWER_ON : SpaCommand::POWER_OFF, 0 };
+        case CMD_FILTER: return { value ? SpaCommand::FILTER_ON : SpaCommand::FILTER_OFF, 0 };
+        case CMD_HEATER: return { value ? SpaCommand::HEATER_ON : SpaCommand::HEATER_OFF, 0 };
+        case CMD_BUBBLE: return { value ? SpaCommand::BUBBLE_ON : SpaCommand::BUBBLE_OFF, 0 };
+        default:         return { SpaCommand::SET_TEMP, value };
+    }
+}
+
+void MqttPublisher::taskWrapper(void* param) {
+    static_cast<MqttPublisher*>(param)->run();
+}
+
+void MqttPublisher::commandTaskWrapper(void* param) {
+    static_cast<MqttPublisher*>(param)->runCommands();
+}
+
+// Turns the pending slots into one batch at a time. While a batch runs, new
+// messages just overwrite their slot, so at most one MQTT job sits in _cmdQueue.
+void MqttPublisher::runCommands() {
+    PureSpaService& service = PureSpaService::getInstance();
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (true) {
+            SpaBatchCommand batch[COMMAND_COUNT];
+            uint8_t commands[COMMAND_COUNT];
+            int values[COMMAND_COUNT];
+            int64_t receivedAt[COMMAND_COUNT];
+            int64_t oldest = INT64_MAX;
+            size_t count = 0;
+            {
+                std::lock_guard<std::mutex> lock(_commandMutex);
+                for (uint8_t c = 0; c < COMMAND_COUNT; c++) {
+                    if (!_pending[c].dirty) continue;
+                    _pending[c].dirty = false;
+                    commands[count] = c;
+                    values[count] = _pending[c].value;
+                    receivedAt[count] = _pending[c].receivedAt;
+                    batch[count] = toBatchCommand(c, values[count]);
+                    if (receivedAt[count] < oldest) oldest = receivedAt[count];
+                    count++;
+                }
+            }
+            if (count == 0) break;
+
+            SpaBatchResult result;
+            esp_err_t err = service.runBatch(batch, count, "MQTT", BATCH_TIMEOUT_MS, result);
+            if (err == ESP_ERR_NO_MEM) {
+                // Command queue full: hand the commands back unless a newer value arrived meanwhile
+                {
+                    std::lock_guard<std::mutex> lock(_commandMutex);
+                    for (size_t i = 0; i < count; i++) {
+                        PendingCommand& pending = _pending[commands[i]];
+                        if (!pending.dirty) pending = { true, values[i], receivedAt[i] };
+                    }
+                }
+                vTaskDelay(pdMS_TO_TICKS(QUEUE_FULL_RETRY_MS));
+                continue;
+            }
+            publishResult(commands, values, count, err, result, oldest);
+        }
+    }
+}
+
+void MqttPublisher::publishResult(const uint8_t* commands, const int* values, size_t count, esp_err_t err,
+                                  const SpaBatchResult& result, int64_t receivedAt) {
+    const char* outcome = err == ESP_ERR_TIMEOUT ? "timeout" : (result.failed > 0 ? "failed" : "ok");
+    char buf[256];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    w.beginObject("commands");
+    for (size_t i = 0; i < count; i++) w.field(COMMAND_NAMES[commands[i]], values[i]);
+    w.endObject();
+    w.field("result", outcome)
+        .field("executed", result.executed)
+        .field("failed", result.failed)
+        .field("skipped", result.skipped)
+        .field("duration_ms", result.durationMs)
+        .field("latency_ms", (long long)((esp_timer_get_time() - receivedAt) / 1000))
+        .endObject();
+    if (w.finish() != ESP_OK || !_connected) return;
+    if (esp_mqtt_client_publish(_client, MQTT_TOPIC::CMD_RESULT, buf, w.length(), 0, 0) < 0) {
+        ESP_LOGW(TAG, "Publish to %s failed", MQTT_TOPIC::CMD_RESULT);
+    }
+}
+
+void MqttPublisher::run() {
+    TickType_t lastForced = xTaskGetTickCount();
+    TickType_t lastWifi = 0;
+    Message msg;
+
+    while (true) {
+        if (xQueueReceive(_queue, &msg, pdMS_TO_TICKS(CONFIG::POOL_UPDATE_PERIOD)) == pdPASS && _connected) {
+            publish(STATUS_TOPICS[msg.topic], msg.payload);
+        }
+        if (!_connected) continue;
+
+        TickType_t now = xTaskGetTickCount();
+        if (_republish.exchange(false)) {
+            // Fresh session: announce ourselves and the static topics first
+            publish(MQTT_TOPIC::STATE, "online");
+            publish(MQTT_TOPIC::MODEL, PureSpaService::getInstance().getCapabilities().modelName);
+            publish(MQTT_TOPIC::VERSION, CONFIG::WIFI_VERSION);
+            publishAll();
+            publishWifi();
+            lastForced = lastWifi = now;
+            continue;
+        }
+        if (now - lastForced >= pdMS_TO_TICKS(CONFIG::FORCED_STATE_UPDATE_PERIOD)) {
+            publishAll();
+            lastForced = now;
+        }
+        if (now - lastWifi >= pdMS_TO_TICKS(CONFIG::WIFI_UPDATE_PERIOD)) {
+            publishWifi();
+            lastWifi = now;
+        }
+    }
+}
+
+// Republishes every known status topic, whether it changed or not
+void MqttPublisher::publishAll() {
+    char payloads[TOPIC_COUNT][PAYLOAD_SIZE];
+    bool known[TOPIC_COUNT] = {};
+    {
+        std::lock_guard<std::mutex> lock(_stateMutex);
+        if (!_hasLatest) return;
+        for (uint8_t t = 0; t < TOPIC_COUNT; t++) {
+            known[t] = formatTopic(t, _latest, payloads[t]);
+            if (known[t]) strcpy(_queued[t], payloads[t]);
+        }
+    }
+    for (uint8_t t = 0; t < TOPIC_COUNT; t++) {
+        if (known[t]) publish(STATUS_TOPICS[t], payloads[t]);
+    }
+}
+
+void MqttPublisher::publishWifi() {
+    char payload[PAYLOAD_SIZE];
+    int rssi;
+    {
+        std::lock_guard<std::mutex> lock(_stateMutex);
+        rssi = _latest.rssi;
+    }
+    snprintf(payload, sizeof(payload), "%d", rssi);
+    publish(MQTT_TOPIC::RSSI, payload);
+
+    esp_netif_ip_info_t ip;
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif && esp_netif_get_ip_info(netif, &ip) == ESP_OK) {
+        snprintf(payload, sizeof(payload), IPSTR, IP2STR(&ip.ip));
+        publish(MQTT_TOPIC::IP, payload);
+    }
+}
+
+void MqttPublisher::publish(const char* topic, const char* payload) {
+    if (esp_mqtt_client_publish(_client, topic, payload, 0, QOS, RETAIN) < 0) {
+        ESP_LOGW(TAG, "Publish to %s failed", topic);
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef MQTT_PUBLISHER_H
+#define MQTT_PUBLISHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+#include "PureSpaService.h"
+
+// Publishes the spa state on the MQTT_TOPIC::* topics of the original project.
+// Status changes from the service are diffed per topic and only changed values
+// are put on a bounded queue (never blocking the bus task; a full queue drops
+// the update until the next change or forced republish). A dedicated task
+// drains the queue into the broker and republishes everything every
+// CONFIG::FORCED_STATE_UPDATE_PERIOD, the wifi/* topics every WIFI_UPDATE_PERIOD.
+//
+// The MQTT_TOPIC::CMD_* topics are consumed too. Incoming commands only update
+// one pending slot per feature (last value wins), a command task turns the
+// pending slots into a single service batch at a time and publishes the outcome
+// with its latency on MQTT_TOPIC::CMD_RESULT. A burst of messages therefore
+// costs at most one _cmdQueue entry.
+class MqttPublisher {
+public:
+    static MqttPublisher& getInstance() {
+        static MqttPublisher instance;
+        return instance;
+    }
+
+    MqttPublisher(const MqttPublisher&) = delete;
+    MqttPublisher& operator=(const MqttPublisher&) = delete;
+
+    // Connects to CONFIG_PURESPA_MQTT_BROKER_URI on the first call (later calls
+    // are no-ops, the client reconnects by itself). Does nothing when MQTT is
+    // disabled in menuconfig.
+    void start();
+
+    bool isConnected() const { return _connected; }
+    uint32_t getDroppedCount() const { return _dropped; }
+    uint32_t getCoalescedCount() const { return _coalesced; }
+    uint32_t getRetainedIgnoredCount() const { return _retainedIgnored; }
+    size_t getQueueDepth() const { return _queue != nullptr ? uxQueueMessagesWaiting(_queue) : 0; }
+
+private:
+    static const size_t PAYLOAD_SIZE = 16;
+
+    // Topics derived from the status snapshot, index into the topic table
+    enum Topic : uint8_t {
+        POWER, FILTER, HEATER, BUBBLE, JET, DISINFECTION, WATER_ACT, WATER_SET, ERROR,
+        TOPIC_COUNT
+    };
+
+    struct Message {
+        uint8_t topic;
+        char payload[PAYLOAD_SIZE];
+    };
+
+    // Command topics, index into the command table
+    enum Command : uint8_t {
+        CMD_POWER, CMD_FILTER, CMD_HEATER, CMD_BUBBLE, CMD_WATER,
+        COMMAND_COUNT
+    };
+
+    struct PendingCommand {
+        bool dirty;
+        int value;
+        int64_t receivedAt; // [us] first message since the slot was last taken
+    };
+
+    static const uint32_t BATCH_TIMEOUT_MS = 30000;
+    static const uint32_t QUEUE_FULL_RETRY_MS = 250;
+
+    MqttPublisher() {}
+
+    static void onStatus(void* ctx, const PureSpaService::StatusSnapshot& status);
+    static bool formatTopic(uint8_t topic, const PureSpaService::StatusSnapshot& s, char* out);
+    static void eventHandler(void* arg, esp_event_base_t base, int32_t eventId, void* eventData);
+    static void taskWrapper(void* param);
+    static void commandTaskWrapper(void* param);
+    void run();
+    void runCommands();
+    void subscribeCommands();
+    static SpaBatchCommand toBatchCommand(uint8_t command, int value);
+    void onCommand(const char* topic, size_t topicLen, const char* data, size_t len);
+    void publishResult(const uint8_t* commands, const int* values, size_t count, esp_err_t err,
+                       const SpaBatchResult& result, int64_t receivedAt);
+    void publishAll();
+    void publishWifi();
+    void publish(const char* topic, const char* payload);
+
+    esp_mqtt_client_handle_t _client = nullptr;
+    QueueHandle_t _queue = nullptr;
+    std::atomic<bool> _connected{false};
+    std::atomic<bool> _republish{false};
+    std::atomic<uint32_t> _dropped{0};
+
+    // Latest snapshot and the payload last queued per topic, shared between
+    // the service task (onStatus) and the publisher task
+    std::mutex _stateMutex;
+    PureSpaService::StatusSnapshot _latest = {};
+    bool _hasLatest = false;
+    char _queued[TOPIC_COUNT][PAYLOAD_SIZE] = {};
+
+    // Written by the MQTT client task, drained by the command task
+    std::mutex _commandMutex;
+    PendingCommand _pending[COMMAND_COUNT] = {};
+    TaskHandle_t _commandTask = nullptr;
+    std::atomic<uint32_t> _coalesced{0};
+    std::atomic<uint32_t> _retainedIgnored{0};
+};
+
+#endif // MQTT_PUBLISHER_H
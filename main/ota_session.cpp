@@ -0,0 +1,126 @@
+#include "ota_session.h"
+#include "ota_updater.h"
+#include <esp_log.h>
+#include <esp_random.h>
+#include <cstdio>
+#include <cstring>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "OtaSession";
+
+esp_err_t OtaSession::start(uint32_t imageSize, Info* info) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = onTimeout,
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "ota_session",
+            .skip_unhandled_events = true,
+        };
+        esp_err_t err = esp_timer_create(&args, &_timer);
+        if (err != ESP_OK) return err;
+    }
+    if (_active) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = OtaUpdater::getInstance().begin(imageSize);
+    if (err != ESP_OK) return err;
+
+    _active = true;
+    _busy = false;
+    _size = imageSize;
+    snprintf(_id, sizeof(_id), "%08lx", (unsigned long)esp_random());
+    armTimeout();
+    ESP_LOGI(TAG, "Session %s started for %lu bytes", _id, (unsigned long)imageSize);
+
+    if (info) {
+        info->active = true;
+        strcpy(info->id, _id);
+        info->size = _size;
+        info->offset = 0;
+        info->flushed = 0;
+        info->expiresInMs = TIMEOUT_MS;
+    }
+    return ESP_OK;
+}
+
+esp_err_t OtaSession::acquire(const char* id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_active || strcmp(id, _id) != 0) return ESP_ERR_NOT_FOUND;
+    if (_busy) return ESP_ERR_INVALID_STATE;
+    _busy = true;
+    esp_timer_stop(_timer);
+    return ESP_OK;
+}
+
+void OtaSession::release() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _busy = false;
+    if (_active) armTimeout();
+}
+
+esp_err_t OtaSession::finish() {
+    esp_err_t err = OtaUpdater::getInstance().finish();
+    ESP_LOGI(TAG, "Session %s finished (%s)", _id, esp_err_to_name(err));
+    std::lock_guard<std::mutex> lock(_mutex);
+    close();
+    return err;
+}
+
+void OtaSession::cancel() {
+    OtaUpdater::getInstance().abort();
+    ESP_LOGW(TAG, "Session %s cancelled", _id);
+    std::lock_guard<std::mutex> lock(_mutex);
+    close();
+}
+
+OtaSession::Info OtaSession::getInfo() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Info info = {};
+    info.active = _active;
+    if (!_active) return info;
+    OtaUpdater::Progress p = OtaUpdater::getInstance().getProgress();
+    strcpy(info.id, _id);
+    info.size = _size;
+    info.offset = p.received;
+    info.flushed = p.written;
+    int64_t left = _busy ? TIMEOUT_MS * 1000LL : _deadline - esp_timer_get_time();
+    info.expiresInMs = left > 0 ? left / 1000 : 0;
+    return info;
+}
+
+void OtaSession::armTimeout() {
+    _deadline = esp_timer_get_time() + TIMEOUT_MS * 1000LL;
+    esp_timer_stop(_timer);
+    esp_timer_start_once(_timer, TIMEOUT_MS * 1000ULL);
+}
+
+void OtaSession::close() {
+    esp_timer_stop(_timer);
+    _active = false;
+    _busy = false;
+    _id[0] = '\0';
+    _size = 0;
+}
+
+// Aborting drains the writer task, which must not happen on the esp_timer task
+void OtaSession::onTimeout(void* arg) {
+    if (xTaskCreate(expireTask, "ota_expire", 3072, arg, 5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start session cleanup");
+    }
+}
+
+void OtaSession::expireTask(void* param) {
+    OtaSession* self = static_cast<OtaSession*>(param);
+    {
+        std::lock_guard<std::mutex> lock(self->_mutex);
+        // A request may have claimed or refreshed the session in the meantime
+        if (self->_active && !self->_busy && esp_timer_get_time() >= self->_deadline) {
+            ESP_LOGW(TAG, "Session %s abandoned, aborting update", self->_id);
+            OtaUpdater::getInstance().abort();
+            self->close();
+        }
+    }
+    vTaskDelete(NULL);
+}
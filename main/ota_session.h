@@ -0,0 +1,69 @@
+#ifndef OTA_SESSION_H
+#define OTA_SESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include "esp_err.h"
+#include "esp_timer.h"
+
+// Resumable upload of a plain firmware image in several requests. A session
+// owns the OtaUpdater from start() until finish(), cancel() or the
+// inactivity timeout; chunks must arrive in order, but a chunk may overlap
+// what was already accepted so a client that lost its connection simply
+// resends from the last offset it was told about.
+class OtaSession {
+public:
+    static OtaSession& getInstance() {
+        static OtaSession instance;
+        return instance;
+    }
+
+    OtaSession(const OtaSession&) = delete;
+    OtaSession& operator=(const OtaSession&) = delete;
+
+    static const uint32_t TIMEOUT_MS = 120000;
+    static const size_t ID_LEN = 8;
+
+    struct Info {
+        bool active;
+        char id[ID_LEN + 1];
+        uint32_t size;
+        uint32_t offset;      // image bytes accepted, the next chunk starts here
+        uint32_t flushed;     // image bytes already written to flash
+        uint32_t expiresInMs;
+    };
+
+    // ESP_ERR_INVALID_STATE when another update or session is running
+    esp_err_t start(uint32_t imageSize, Info* info);
+
+    // Claims the session for one request. ESP_ERR_NOT_FOUND for an unknown or
+    // expired id, ESP_ERR_INVALID_STATE while another request holds it.
+    esp_err_t acquire(const char* id);
+    // Ends the request and re-arms the inactivity timeout
+    void release();
+
+    // Only between acquire() and release(); both close the session
+    esp_err_t finish();
+    void cancel();
+
+    Info getInfo();
+
+private:
+    OtaSession() {}
+
+    static void onTimeout(void* arg);
+    static void expireTask(void* param);
+    void armTimeout();
+    void close();
+
+    std::mutex _mutex;
+    esp_timer_handle_t _timer = nullptr;
+    bool _active = false;
+    bool _busy = false;
+    char _id[ID_LEN + 1] = "";
+    uint32_t _size = 0;
+    int64_t _deadline = 0;
+};
+
+#endif // OTA_SESSION_H
@@ -0,0 +1,214 @@
+#include "ota_updater.h"
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cstring>
+#include <cstdlib>
+#include "freertos/task.h"
+
+static const char *TAG = "OtaUpdater";
+
+static const uint32_t WRITER_STACK = 4096;
+static const uint32_t BUFFER_WAIT_MS = 10000;
+
+esp_err_t OtaUpdater::begin(size_t imageSize) {
+    bool expected = false;
+    if (!_active.compare_exchange_strong(expected, true)) {
+        ESP_LOGW(TAG, "Another update is already running");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    _partition = esp_ota_get_next_update_partition(NULL);
+    if (_partition == NULL) {
+        ESP_LOGE(TAG, "Passive OTA partition not found");
+        _active = false;
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", _partition->label, (unsigned long)_partition->address);
+
+    _freeQueue = xQueueCreate(BUFFER_COUNT, sizeof(uint8_t));
+    _fullQueue = xQueueCreate(BUFFER_COUNT + 1, sizeof(Block));
+    _writerDone = xSemaphoreCreateBinary();
+    bool ok = _freeQueue && _fullQueue && _writerDone;
+    for (size_t i = 0; ok && i < BUFFER_COUNT; i++) {
+        _buffers[i] = (char*)malloc(BUFFER_SIZE);
+        ok = _buffers[i] != NULL;
+        if (ok) {
+            uint8_t index = i;
+            xQueueSend(_freeQueue, &index, 0);
+        }
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to allocate %d OTA buffers", (int)BUFFER_COUNT);
+        release();
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Without a size, erase sector by sector as the image arrives instead of the whole partition up front
+    esp_err_t err = esp_ota_begin(_partition, imageSize ? imageSize : OTA_WITH_SEQUENTIAL_WRITES, &_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
+        release();
+        return err;
+    }
+
+    _current = -1;
+    _fill = 0;
+    _total = imageSize;
+    _received = 0;
+    _written = 0;
+    _writeError = ESP_OK;
+    _startTime = esp_timer_get_time();
+
+    if (xTaskCreate(writerTaskWrapper, "ota_writer", WRITER_STACK, this, 6, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start OTA writer task");
+        esp_ota_abort(_handle);
+        release();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void OtaUpdater::writerTaskWrapper(void* param) {
+    static_cast<OtaUpdater*>(param)->writerTask();
+    vTaskDelete(NULL);
+}
+
+void OtaUpdater::writerTask() {
+    Block block;
+    while (xQueueReceive(_fullQueue, &block, portMAX_DELAY) == pdTRUE) {
+        if (block.len == 0) break;
+
+        // After a failure keep draining so the producer never blocks on a full ring
+        if (_writeError == ESP_OK) {
+            esp_err_t err = esp_ota_write(_handle, _buffers[block.index], block.len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "esp_ota_write failed (%s)", esp_err_to_name(err));
+                _writeError = err;
+            } else {
+                uint32_t written = _written.fetch_add(block.len) + block.len;
+                if (written / 102400 != (written - block.len) / 102400) {
+                    ESP_LOGI(TAG, "OTA Progress: %lu / %lu bytes written", (unsigned long)written, (unsigned long)_total);
+                }
+            }
+        }
+        xQueueSend(_freeQueue, &block.index, portMAX_DELAY);
+    }
+    xSemaphoreGive(_writerDone);
+}
+
+char* OtaUpdater::reserve(size_t* room) {
+    if (_current < 0) {
+        uint8_t index;
+        if (xQueueReceive(_freeQueue, &index, pdMS_TO_TICKS(BUFFER_WAIT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "Timed out waiting for a free OTA buffer");
+            *room = 0;
+            return NULL;
+        }
+        _current = index;
+        _fill = 0;
+    }
+    *room = BUFFER_SIZE - _fill;
+    return _buffers[_current] + _fill;
+}
+
+esp_err_t OtaUpdater::commit(size_t len) {
+    if (_current < 0 || _fill + len > BUFFER_SIZE) return ESP_ERR_INVALID_STATE;
+    _fill += len;
+    _received += len;
+    if (_fill == BUFFER_SIZE) return submitCurrent();
+    return _writeError;
+}
+
+esp_err_t OtaUpdater::write(const char* data, size_t len) {
+    while (len > 0) {
+        size_t room;
+        char* dst = reserve(&room);
+        if (dst == NULL) return ESP_ERR_TIMEOUT;
+        size_t n = len < room ? len : room;
+        memcpy(dst, data, n);
+        esp_err_t err = commit(n);
+        if (err != ESP_OK) return err;
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t OtaUpdater::submitCurrent() {
+    if (_current < 0 || _fill == 0) return _writeError;
+    Block block = { (uint8_t)_current, (uint16_t)_fill };
+    xQueueSend(_fullQueue, &block, portMAX_DELAY);
+    _current = -1;
+    _fill = 0;
+    return _writeError;
+}
+
+void OtaUpdater::stopWriter() {
+    Block stop = { 0, 0 };
+    xQueueSend(_fullQueue, &stop, portMAX_DELAY);
+    xSemaphoreTake(_writerDone, portMAX_DELAY);
+}
+
+esp_err_t OtaUpdater::finish() {
+    submitCurrent();
+    stopWriter();
+
+    esp_err_t err = _writeError;
+    if (err != ESP_OK) {
+        esp_ota_abort(_handle);
+        release();
+        return err;
+    }
+
+    int64_t elapsed = esp_timer_get_time() - _startTime;
+    uint32_t written = _written;
+    ESP_LOGI(TAG, "Wrote %lu bytes in %lu ms (%lu KB/s)", (unsigned long)written,
+             (unsigned long)(elapsed / 1000), (unsigned long)(elapsed > 0 ? written * 1000000LL / elapsed / 1024 : 0));
+
+    err = esp_ota_end(_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_end failed (%s)", esp_err_to_name(err));
+        release();
+        return err;
+    }
+
+    err = esp_ota_set_boot_partition(_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_set_boot_partition failed (%s)", esp_err_to_name(err));
+    }
+    release();
+    return err;
+}
+
+void OtaUpdater::abort() {
+    if (!_active) return;
+    stopWriter();
+    esp_ota_abort(_handle);
+    ESP_LOGW(TAG, "Update aborted after %lu bytes", (unsigned long)(uint32_t)_received);
+    release();
+}
+
+void OtaUpdater::release() {
+    for (size_t i = 0; i < BUFFER_COUNT; i++) {
+        free(_buffers[i]);
+        _buffers[i] = NULL;
+    }
+    if (_freeQueue) vQueueDelete(_freeQueue);
+    if (_fullQueue) vQueueDelete(_fullQueue);
+    if (_writerDone) vSemaphoreDelete(_writerDone);
+    _freeQueue = NULL;
+    _fullQueue = NULL;
+    _writerDone = NULL;
+    _current = -1;
+    _fill = 0;
+    _active = false;
+}
+
+OtaUpdater::Progress OtaUpdater::getProgress() const {
+    Progress p;
+    p.active = _active;
+    p.received = _received;
+    p.written = _written;
+    p.total = _total;
+    return p;
+}
@@ -0,0 +1,89 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "esp_err.h"
+#include "esp_ota_ops.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// Writes a firmware image to the passive OTA partition. Incoming data is
+// collected in a ring of buffers; a dedicated writer task drains full buffers
+// with esp_ota_write, so receiving the next block overlaps the flash
+// erase/write of the previous one. Only one update can run at a time.
+class OtaUpdater {
+public:
+    static OtaUpdater& getInstance() {
+        static OtaUpdater instance;
+        return instance;
+    }
+
+    OtaUpdater(const OtaUpdater&) = delete;
+    OtaUpdater& operator=(const OtaUpdater&) = delete;
+
+    static const size_t BUFFER_COUNT = 4;
+    static const size_t BUFFER_SIZE = 4096;
+
+    struct Progress {
+        bool active;
+        uint32_t received;  // image bytes handed to the updater
+        uint32_t written;   // image bytes written to flash
+        uint32_t total;     // expected image size, 0 if unknown
+    };
+
+    // imageSize may be 0 when it is not known up front (compressed or delta upload).
+    // ESP_ERR_INVALID_STATE if another update is running.
+    esp_err_t begin(size_t imageSize);
+
+    // Zero-copy input: returns the free space of the current buffer (blocking
+    // until the writer released one), the caller fills up to *room bytes and
+    // commits what it actually wrote.
+    char* reserve(size_t* room);
+    esp_err_t commit(size_t len);
+
+    // Copying input for producers that generate data in their own buffers
+    esp_err_t write(const char* data, size_t len);
+
+    // Drains the ring, validates the image and selects it for the next boot
+    esp_err_t finish();
+    void abort();
+
+    Progress getProgress() const;
+    bool isActive() const { return _active; }
+
+private:
+    OtaUpdater() {}
+
+    struct Block {
+        uint8_t index;
+        uint16_t len; // 0 terminates the writer
+    };
+
+    static void writerTaskWrapper(void* param);
+    void writerTask();
+    esp_err_t submitCurrent();
+    void stopWriter();
+    void release();
+
+    const esp_partition_t* _partition = nullptr;
+    esp_ota_handle_t _handle = 0;
+    char* _buffers[BUFFER_COUNT] = {};
+    QueueHandle_t _freeQueue = nullptr;  // indices of empty buffers
+    QueueHandle_t _fullQueue = nullptr;  // blocks waiting for flash
+    SemaphoreHandle_t _writerDone = nullptr;
+
+    int _current = -1;  // buffer being filled
+    size_t _fill = 0;
+    int64_t _startTime = 0;
+
+    std::atomic<bool> _active{false};
+    std::atomic<esp_err_t> _writeError{ESP_OK};
+    std::atomic<uint32_t> _received{0};
+    std::atomic<uint32_t> _written{0};
+    uint32_t _total = 0;
+};
+
+#endif // OTA_UPDATER_H
@@ -1,6 +1,7 @@
 #include "AuditLogger.h"
 #include <esp_log.h>
 #include "nvs_flash.h"
+#include "metrics.h"
 #include <cstring>
 #include <algorithm>
 
@@ -14,6 +15,7 @@ void AuditLogger::init() {
 
 void AuditLogger::logEvent(const char* source, const char* feature, bool state) {
     std::lock_guard<std::mutex> lock(_mutex);
+    Metrics::ProfileScope profile(Metrics::PROFILE_AUDIT_LOG);
     
     AuditEvent event;
     time(&event.timestamp);
@@ -28,7 +30,7 @@ void AuditLogger::logEvent(const char* source, const char* feature, bool state)
     event.state = state;
 
     // Prune before inserting if list exceeds safe limit
-    if (_events.size() >= 100) {
+    if (_events.size() >= MAX_EVENTS) {
         // Remove oldest event
         _events.erase(_events.begin());
     }
@@ -37,6 +39,7 @@ void AuditLogger::logEvent(const char* source, const char* feature, bool state)
     ESP_LOGI(TAG, "Logged event: %s changed %s to %s", source, feature, state ? "ON" : "OFF");
 
     saveToNvs();
+    profile.setUnits(_events.size());
 }
 
 std::vector<AuditEvent> AuditLogger::getEvents() {
@@ -45,6 +48,16 @@ std::vector<AuditEvent> AuditLogger::getEvents() {
     return _events;
 }
 
+size_t AuditLogger::copyEvents(size_t start, AuditEvent* out, size_t max) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (start == 0) pruneOldEvents();
+    size_t count = 0;
+    for (size_t i = start; i < _events.size() && count < max; i++) {
+        out[count++] = _events[i];
+    }
+    return count;
+}
+
 void AuditLogger::setRetentionDays(int days) {
     std::lock_guard<std::mutex> lock(_mutex);
     if (days < 1) days = 1;
@@ -59,6 +72,7 @@ void AuditLogger::setRetentionDays(int days) {
         nvs_set_i32(my_handle, "retention", _retentionDays);
         nvs_commit(my_handle);
         nvs_close(my_handle);
+        Metrics::getInstance().countNvsCommit(NVS_NAMESPACE);
     }
     
     pruneOldEvents();
@@ -122,10 +136,22 @@ void AuditLogger::loadFromNvs() {
     size_t required_size = 0;
     err = nvs_get_blob(my_handle, "logs", NULL, &required_size);
     if (err == ESP_OK && required_size > 0) {
-        size_t event_count = required_size / sizeof(AuditEvent);
-        _events.resize(event_count);
-        nvs_get_blob(my_handle, "logs", _events.data(), &required_size);
-        ESP_LOGI(TAG, "Loaded %d audit events from NVS", (int)event_count);
+        // A blob written with another AuditEvent layout would overrun the buffer
+        if (required_size % sizeof(AuditEvent) != 0 || required_size / sizeof(AuditEvent) > MAX_EVENTS) {
+            ESP_LOGE(TAG, "Stored audit trail has an unexpected size (%d bytes), ignoring it", (int)required_size);
+        } else {
+            size_t event_count = required_size / sizeof(AuditEvent);
+            _events.resize(event_count);
+            if (nvs_get_blob(my_handle, "logs", _events.data(), &required_size) == ESP_OK) {
+                for (auto& event : _events) {
+                    event.source[sizeof(event.source) - 1] = '\0';
+                    event.feature[sizeof(event.feature) - 1] = '\0';
+                }
+                ESP_LOGI(TAG, "Loaded %d audit events from NVS", (int)event_count);
+            } else {
+                _events.clear();
+            }
+        }
     }
     
     nvs_close(my_handle);
@@ -150,4 +176,5 @@ void AuditLogger::saveToNvs() {
     
     nvs_commit(my_handle);
     nvs_close(my_handle);
+    Metrics::getInstance().countNvsCommit(NVS_NAMESPACE);
 }
@@ -23,9 +23,12 @@ public:
     AuditLogger(const AuditLogger&) = delete;
     AuditLogger& operator=(const AuditLogger&) = delete;
 
+    static const size_t MAX_EVENTS = 100;
+
     void init();
     void logEvent(const char* source, const char* feature, bool state);
     std::vector<AuditEvent> getEvents();
+    size_t copyEvents(size_t start, AuditEvent* out, size_t max);
     
     void setRetentionDays(int days);
     int getRetentionDays() const { return _retentionDays; }
@@ -0,0 +1,53 @@
+#ifndef BUS_BACKEND_H
+#define BUS_BACKEND_H
+
+#include <stdint.h>
+
+// Source of the display bus clock edges decoded by PureSpaIO. GpioBusBackend
+// samples a wired spa from the CLOCK interrupt, ReplayBusBackend plays a
+// capture back, so the decoder and everything above it run without a spa.
+class BusBackend
+{
+public:
+  // Called once per clock edge with the logical DATA bit and whether LATCH
+  // is active. Runs in interrupt context for GpioBusBackend: must not block.
+  typedef void (*EdgeHandler)(void* ctx, bool data, bool enabled);
+
+  // Edge handler cost histogram: bucket i counts calls below
+  // COST_FIRST_BUCKET << i CPU cycles, the last bucket the rest
+  static const unsigned int COST_BUCKETS = 8;
+  static const unsigned int COST_FIRST_BUCKET = 64;
+
+  // Cost of the edge handler in CPU cycles since the previous takeEdgeCost()
+  struct EdgeCost
+  {
+    uint32_t calls;
+    uint64_t cyclesSum;
+    uint32_t cyclesMin;
+    uint32_t cyclesMax;
+    uint32_t spacingMin;             // cycles between two edges, the real budget
+    uint32_t buckets[COST_BUCKETS];
+  };
+
+  virtual ~BusBackend() {}
+
+  virtual const char* getName() const = 0;
+
+  // Starts delivering edges to handler, returns false if the bus could not
+  // be set up. Edges are delivered from a single context at a time.
+  virtual bool start(EdgeHandler handler, void* ctx) = 0;
+  virtual void stop() = 0;
+
+  // Acknowledges the button frame just received by pulling DATA low for a
+  // moment. Called from the edge handler.
+  virtual void pullDataLow() = 0;
+
+  // Backends without a cycle counter report no calls
+  virtual EdgeCost takeEdgeCost()
+  {
+    EdgeCost cost = {};
+    return cost;
+  }
+};
+
+#endif /* BUS_BACKEND_H */
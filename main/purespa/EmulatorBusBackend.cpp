@@ -0,0 +1,112 @@
+#include "EmulatorBusBackend.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "EmulatorBusBackend";
+
+// At speed 0 the task still yields every few cycles so lower priority tasks run
+static const unsigned int YIELD_CYCLES = 2;
+
+EmulatorBusBackend::EmulatorBusBackend(SpaEmulator& emulator, unsigned int speed)
+  : emulator(emulator), speed(speed)
+{
+}
+
+EmulatorBusBackend::~EmulatorBusBackend()
+{
+  stop();
+}
+
+const char* EmulatorBusBackend::getName() const
+{
+  return "emulator";
+}
+
+bool EmulatorBusBackend::start(EdgeHandler handler, void* ctx)
+{
+  if (taskAlive)
+  {
+    ESP_LOGE(TAG, "Already running");
+    return false;
+  }
+
+  this->handler = handler;
+  this->handlerCtx = ctx;
+  running = true;
+  taskAlive = true;
+  // Above the service task, like the interrupt it stands in for
+  if (xTaskCreate(taskWrapper, "bus_emulator", 4096, this, 6, NULL) != pdPASS)
+  {
+    running = false;
+    taskAlive = false;
+    return false;
+  }
+  return true;
+}
+
+void EmulatorBusBackend::stop()
+{
+  running = false;
+  while (taskAlive)
+  {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+// Called by the decoder right after the button frame it acknowledges
+void EmulatorBusBackend::pullDataLow()
+{
+  emulator.acknowledge(currentFrame);
+}
+
+void EmulatorBusBackend::taskWrapper(void* param)
+{
+  EmulatorBusBackend* self = static_cast<EmulatorBusBackend*>(param);
+  self->run();
+  self->taskAlive = false;
+  vTaskDelete(NULL);
+}
+
+void EmulatorBusBackend::run()
+{
+  ESP_LOGI(TAG, "Emulating the spa at speed %u", speed);
+
+  int64_t start = esp_timer_get_time();
+  uint64_t emulatedUs = 0;
+  uint16_t frames[SpaEmulator::CYCLE_FRAMES];
+  while (running)
+  {
+    emulator.buildCycle(frames);
+    for (size_t i = 0; i < SpaEmulator::CYCLE_FRAMES; i++)
+    {
+      deliver(frames[i]);
+    }
+    emulator.endCycle();
+    cycles++;
+    emulatedUs += SpaEmulator::CYCLE_PERIOD_MS*1000;
+
+    if (speed)
+    {
+      int64_t aheadUs = (int64_t)(emulatedUs/speed) - (esp_timer_get_time() - start);
+      if (aheadUs >= (int64_t)portTICK_PERIOD_MS*1000)
+      {
+        vTaskDelay(aheadUs/1000/portTICK_PERIOD_MS);
+      }
+    }
+    else if (cycles % YIELD_CYCLES == 0)
+    {
+      vTaskDelay(1);
+    }
+  }
+}
+
+void EmulatorBusBackend::deliver(uint16_t frame)
+{
+  currentFrame = frame;
+  for (unsigned int i = 0; i < FRAME_BITS; i++)
+  {
+    handler(handlerCtx, (frame >> (FRAME_BITS - 1 - i)) & 1, true);
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef EMULATOR_BUS_BACKEND_H
+#define EMULATOR_BUS_BACKEND_H
+
+#include <atomic>
+#include "BusBackend.h"
+#include "SpaEmulator.h"
+
+// Runs a SpaEmulator as the bus: a task clocks out its cycles and hands the
+// decoder's button acknowledgements back to it, closing the loop the replay
+// cannot. Used on the linux target.
+class EmulatorBusBackend : public BusBackend
+{
+public:
+  // speed: 1 runs at the bus rate, N is N times faster, 0 as fast as the
+  // decoder takes the frames. The emulator must outlive the backend.
+  EmulatorBusBackend(SpaEmulator& emulator, unsigned int speed = 1);
+  ~EmulatorBusBackend();
+
+  const char* getName() const override;
+  bool start(EdgeHandler handler, void* ctx) override;
+  void stop() override;
+  void pullDataLow() override;
+
+  uint32_t getCycles() const { return cycles; }
+
+private:
+  static void taskWrapper(void* param);
+  void run();
+  void deliver(uint16_t frame);
+
+private:
+  static const unsigned int FRAME_BITS = 16;
+
+  SpaEmulator& emulator;
+  unsigned int speed;
+
+  EdgeHandler handler = nullptr;
+  void* handlerCtx = nullptr;
+  uint16_t currentFrame = 0;
+  std::atomic<bool> running{false};   // cleared to stop the task
+  std::atomic<bool> taskAlive{false};
+  std::atomic<uint32_t> cycles{0};
+};
+
+#endif /* EMULATOR_BUS_BACKEND_H */
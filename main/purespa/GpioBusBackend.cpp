@@ -0,0 +1,100 @@
+#include "GpioBusBackend.h"
+#include <rom/ets_sys.h>
+#include <string.h>
+
+static const char *TAG = "GpioBusBackend";
+
+GpioBusBackendBase::GpioBusBackendBase(gpio_num_t clock, gpio_num_t data, gpio_num_t latch)
+  : clockPin(clock), dataPin(data), latchPin(latch),
+    dataMask(1UL << (data & 31)), latchMask(1UL << (latch & 31))
+{
+}
+
+const char* GpioBusBackendBase::getName() const
+{
+  return "gpio";
+}
+
+bool GpioBusBackendBase::attach(gpio_isr_t isr)
+{
+  // The ISR reads DATA and LATCH from GPIO_IN_REG in one go
+  if (dataPin >= 32 || latchPin >= 32)
+  {
+    ESP_LOGE(TAG, "DATA (%d) and LATCH (%d) must be below GPIO 32", dataPin, latchPin);
+    return false;
+  }
+
+  takeEdgeCost();
+
+  // Configure CLOCK as Interrupt Input (Rising Edge)
+  gpio_config_t io_conf = {};
+  io_conf.intr_type = GPIO_INTR_POSEDGE;
+  io_conf.pin_bit_mask = (1ULL << clockPin);
+  io_conf.mode = GPIO_MODE_INPUT;
+  io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+  io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+  gpio_config(&io_conf);
+
+  // Configure LATCH as Interrupt Input (Falling Edge)
+  io_conf.intr_type = GPIO_INTR_POSEDGE;
+  io_conf.pin_bit_mask = (1ULL << latchPin);
+  gpio_config(&io_conf);
+
+  // Configure DATA as Input
+  io_conf.intr_type = GPIO_INTR_DISABLE;
+  io_conf.pin_bit_mask = (1ULL << dataPin);
+  gpio_config(&io_conf);
+
+  // Already installed when another bus runs on this board
+  esp_err_t err = gpio_install_isr_service(0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+  {
+    ESP_LOGE(TAG, "Failed to install the GPIO ISR service: %s", esp_err_to_name(err));
+    return false;
+  }
+  err = gpio_isr_handler_add(clockPin, isr, this);
+  if (err != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Failed to add the CLOCK handler: %s", esp_err_to_name(err));
+    return false;
+  }
+
+  started = true;
+  return true;
+}
+
+void GpioBusBackendBase::stop()
+{
+  if (started)
+  {
+    gpio_isr_handler_remove(clockPin);
+    started = false;
+  }
+}
+
+IRAM_ATTR void GpioBusBackendBase::pullDataLow()
+{
+  ets_delay_us(1);
+  gpio_set_level(dataPin, 0); // Explicitly pull low
+  gpio_set_direction(dataPin, GPIO_MODE_OUTPUT);
+  ets_delay_us(2);
+  gpio_set_direction(dataPin, GPIO_MODE_INPUT);
+}
+
+BusBackend::EdgeCost GpioBusBackendBase::takeEdgeCost()
+{
+  EdgeCost taken;
+  portENTER_CRITICAL(&costMux);
+  memcpy(&taken, (const void*)&cost, sizeof(taken));
+  cost.calls      = 0;
+  cost.cyclesSum  = 0;
+  cost.cyclesMin  = UINT32_MAX;
+  cost.cyclesMax  = 0;
+  cost.spacingMin = UINT32_MAX;
+  for (unsigned int i = 0; i < COST_BUCKETS; i++)
+  {
+    cost.buckets[i] = 0;
+  }
+  portEXIT_CRITICAL(&costMux);
+  return taken;
+}
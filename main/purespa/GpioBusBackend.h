@@ -0,0 +1,108 @@
+#ifndef GPIO_BUS_BACKEND_H
+#define GPIO_BUS_BACKEND_H
+
+#include "BusBackend.h"
+#include "common.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+
+// The wired spa: CLOCK rising edges raise a GPIO interrupt that samples DATA
+// and LATCH with a single read of the input register. Pin setup and the
+// cycle accounting live here, the interrupt handler in GpioBusBackend<Sink>.
+class GpioBusBackendBase : public BusBackend
+{
+public:
+  const char* getName() const override;
+  void stop() override;
+  void pullDataLow() override;
+  EdgeCost takeEdgeCost() override;
+
+protected:
+  GpioBusBackendBase(gpio_num_t clock, gpio_num_t data, gpio_num_t latch);
+
+  // Configures the pins and installs isr on CLOCK with this as argument
+  bool attach(gpio_isr_t isr);
+
+  // Cycle budget accounting, inlined into the ISR to stay off the call path.
+  // No lock: the ISR runs on the core that called start(), the service
+  // task's, where the critical section in takeEdgeCost() masks it.
+  inline void recordEdge(uint32_t entry) __attribute__((always_inline))
+  {
+    uint32_t cycles = esp_cpu_get_cycle_count() - entry;
+    uint32_t spacing = entry - lastEntry;
+    lastEntry = entry;
+    unsigned int bucket = 0;
+    if (cycles >= COST_FIRST_BUCKET)
+    {
+      bucket = 31 - __builtin_clz(cycles / COST_FIRST_BUCKET) + 1;
+      if (bucket >= COST_BUCKETS) bucket = COST_BUCKETS - 1;
+    }
+    cost.buckets[bucket] = cost.buckets[bucket] + 1;
+    cost.calls = cost.calls + 1;
+    cost.cyclesSum = cost.cyclesSum + cycles;
+    if (cycles < cost.cyclesMin) cost.cyclesMin = cycles;
+    if (cycles > cost.cyclesMax) cost.cyclesMax = cycles;
+    if (spacing < cost.spacingMin) cost.spacingMin = spacing;
+  }
+
+protected:
+  gpio_num_t clockPin;
+  gpio_num_t dataPin;
+  gpio_num_t latchPin;
+  uint32_t dataMask;
+  uint32_t latchMask;
+
+private:
+  bool started = false;
+
+  uint32_t lastEntry = 0; // CPU cycle count
+  volatile EdgeCost cost = {};
+  portMUX_TYPE costMux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+// Bound to the decoder type at compile time: the ISR calls Sink::handleEdge
+// directly, which inlines the per-edge shift into it, instead of an indirect
+// call through the EdgeHandler pointer. start() only accepts Sink's own
+// handler (Sink::receiveEdge) and the Sink instance as context.
+template<typename Sink>
+class GpioBusBackend : public GpioBusBackendBase
+{
+public:
+  GpioBusBackend(gpio_num_t clock = PIN::CLOCK, gpio_num_t data = PIN::DATA, gpio_num_t latch = PIN::LATCH)
+    : GpioBusBackendBase(clock, data, latch)
+  {
+  }
+
+  bool start(EdgeHandler handler, void* ctx) override
+  {
+    if (handler != &Sink::receiveEdge)
+    {
+      ESP_LOGE("GpioBusBackend", "Only delivers edges to its sink type");
+      return false;
+    }
+    sink = static_cast<Sink*>(ctx);
+    return attach(clockRisingISR);
+  }
+
+private:
+  // Runs on every clock edge (~24k/s): one register read, the decoder's
+  // shift and the cycle accounting, all inlined
+  static IRAM_ATTR void clockRisingISR(void* arg)
+  {
+    GpioBusBackend* self = static_cast<GpioBusBackend*>(arg);
+    uint32_t entry = esp_cpu_get_cycle_count();
+    uint32_t in = REG_READ(GPIO_IN_REG);
+    self->sink->handleEdge(!(in & self->dataMask), !(in & self->latchMask));
+    self->recordEdge(entry);
+  }
+
+private:
+  Sink* sink = nullptr;
+};
+
+#endif /* GPIO_BUS_BACKEND_H */
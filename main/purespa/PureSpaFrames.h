@@ -0,0 +1,78 @@
+#ifndef PURE_SPA_FRAMES_H
+#define PURE_SPA_FRAMES_H
+
+#include <stdint.h>
+#include "common.h"
+
+// Display bus frame layout of the selected model, shared by the decoder in
+// PureSpaIO and the mainboard emulator
+
+#if defined MODEL_SB_H20
+namespace FRAME_LED {
+  const uint16_t POWER          = 0x0001;
+  const uint16_t HEATER_ON      = 0x0080;
+  const uint16_t NO_BEEP        = 0x0100;
+  const uint16_t HEATER_STANDBY = 0x0200;
+  const uint16_t BUBBLE         = 0x0400;
+  const uint16_t FILTER         = 0x1000;
+}
+
+namespace FRAME_BUTTON {
+  const uint16_t FILTER    = 0x0002;
+  const uint16_t BUBBLE    = 0x0008;
+  const uint16_t TEMP_DOWN = 0x0080;
+  const uint16_t POWER     = 0x0400;
+  const uint16_t TEMP_UP   = 0x1000;
+  const uint16_t TEMP_UNIT = 0x2000;
+  const uint16_t HEATER    = 0x8000;
+}
+#endif
+
+namespace FRAME_DIGIT {
+  const uint16_t POS_1 = 0x0040;
+  const uint16_t POS_2 = 0x0020;
+  const uint16_t POS_3 = 0x0800;
+  const uint16_t POS_4 = 0x0004;
+
+  const uint16_t SEGMENT_A  = 0x2000;
+  const uint16_t SEGMENT_B  = 0x1000;
+  const uint16_t SEGMENT_C  = 0x0200;
+  const uint16_t SEGMENT_D  = 0x0400;
+  const uint16_t SEGMENT_E  = 0x0080;
+  const uint16_t SEGMENT_F  = 0x0008;
+  const uint16_t SEGMENT_G  = 0x0010;
+  const uint16_t SEGMENT_DP = 0x8000;
+  const uint16_t SEGMENTS   = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_E | SEGMENT_F | SEGMENT_G;
+
+  const uint16_t OFF   = 0x0000;
+  const uint16_t NUM_0 = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_E | SEGMENT_F;
+  const uint16_t NUM_1 = SEGMENT_B | SEGMENT_C;
+  const uint16_t NUM_2 = SEGMENT_A | SEGMENT_B | SEGMENT_G | SEGMENT_E | SEGMENT_D;
+  const uint16_t NUM_3 = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_G;
+  const uint16_t NUM_4 = SEGMENT_F | SEGMENT_G | SEGMENT_B | SEGMENT_C;
+  const uint16_t NUM_5 = SEGMENT_A | SEGMENT_F | SEGMENT_G | SEGMENT_C | SEGMENT_D;
+  const uint16_t NUM_6 = SEGMENT_A | SEGMENT_F | SEGMENT_E | SEGMENT_D | SEGMENT_C | SEGMENT_G;
+  const uint16_t NUM_7 = SEGMENT_A | SEGMENT_B | SEGMENT_C;
+  const uint16_t NUM_8 = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_E | SEGMENT_F | SEGMENT_G;
+  const uint16_t NUM_9 = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_F | SEGMENT_G;
+  const uint16_t LET_C = SEGMENT_A | SEGMENT_F | SEGMENT_E | SEGMENT_D;
+  const uint16_t LET_D = SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_E | SEGMENT_G;
+  const uint16_t LET_E = SEGMENT_A | SEGMENT_F | SEGMENT_E | SEGMENT_D | SEGMENT_G;
+  const uint16_t LET_F = SEGMENT_E | SEGMENT_F | SEGMENT_A | SEGMENT_G;
+  const uint16_t LET_H = SEGMENT_B | SEGMENT_C | SEGMENT_E | SEGMENT_F | SEGMENT_G;
+  const uint16_t LET_N = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_E | SEGMENT_F;
+}
+
+namespace FRAME_TYPE {
+  const uint16_t CUE    = 0x0100;
+  const uint16_t LED    = 0x4000;
+  const uint16_t DIGIT  = FRAME_DIGIT::POS_1 | FRAME_DIGIT::POS_2 | FRAME_DIGIT::POS_3 | FRAME_DIGIT::POS_4;
+
+#if defined MODEL_SB_H20
+  const uint16_t BUTTON = CUE | FRAME_BUTTON::POWER | FRAME_BUTTON::FILTER | FRAME_BUTTON::HEATER | FRAME_BUTTON::BUBBLE | FRAME_BUTTON::TEMP_UP | FRAME_BUTTON::TEMP_DOWN | FRAME_BUTTON::TEMP_UNIT;
+#elif defined MODEL_SJB_HS
+  const uint16_t BUTTON = CUE | FRAME_BUTTON::POWER | FRAME_BUTTON::FILTER | FRAME_BUTTON::HEATER | FRAME_BUTTON::BUBBLE | FRAME_BUTTON::TEMP_UP | FRAME_BUTTON::TEMP_DOWN | FRAME_BUTTON::TEMP_UNIT | FRAME_BUTTON::DISINFECTION | FRAME_BUTTON::JET;
+#endif
+}
+
+#endif /* PURE_SPA_FRAMES_H */
@@ -1,6 +1,6 @@
 #include "PureSpaIO.h"
+#include "PureSpaFrames.h"
 #include <esp_timer.h>
-#include <rom/ets_sys.h>
 #include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -10,26 +10,6 @@ static const char *TAG = "PureSpaIO";
 
 #if defined MODEL_SB_H20
 #define DEFAULT_MODEL_NAME "Intex PureSpa SB-H20"
-
-namespace FRAME_LED {
-  const uint16_t POWER          = 0x0001;
-  const uint16_t HEATER_ON      = 0x0080;
-  const uint16_t NO_BEEP        = 0x0100;
-  const uint16_t HEATER_STANDBY = 0x0200;
-  const uint16_t BUBBLE         = 0x0400;
-  const uint16_t FILTER         = 0x1000;
-}
-
-namespace FRAME_BUTTON {
-  const uint16_t FILTER    = 0x0002;
-  const uint16_t BUBBLE    = 0x0008;
-  const uint16_t TEMP_DOWN = 0x0080;
-  const uint16_t POWER     = 0x0400;
-  const uint16_t TEMP_UP   = 0x1000;
-  const uint16_t TEMP_UNIT = 0x2000;
-  const uint16_t HEATER    = 0x8000;
-}
-
 #elif defined MODEL_SJB_HS
 #define DEFAULT_MODEL_NAME "Intex PureSpa SJB-HS"
 #endif
@@ -40,53 +20,6 @@ const char MODEL_NAME[] = CUSTOM_MODEL_NAME;
 const char MODEL_NAME[] = DEFAULT_MODEL_NAME;
 #endif
 
-namespace FRAME_DIGIT {
-  const uint16_t POS_1 = 0x0040;
-  const uint16_t POS_2 = 0x0020;
-  const uint16_t POS_3 = 0x0800;
-  const uint16_t POS_4 = 0x0004;
-
-  const uint16_t SEGMENT_A  = 0x2000;
-  const uint16_t SEGMENT_B  = 0x1000;
-  const uint16_t SEGMENT_C  = 0x0200;
-  const uint16_t SEGMENT_D  = 0x0400;
-  const uint16_t SEGMENT_E  = 0x0080;
-  const uint16_t SEGMENT_F  = 0x0008;
-  const uint16_t SEGMENT_G  = 0x0010;
-  const uint16_t SEGMENT_DP = 0x8000;
-  const uint16_t SEGMENTS   = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_E | SEGMENT_F | SEGMENT_G;
-
-  const uint16_t OFF   = 0x0000;
-  const uint16_t NUM_0 = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_E | SEGMENT_F;
-  const uint16_t NUM_1 = SEGMENT_B | SEGMENT_C;
-  const uint16_t NUM_2 = SEGMENT_A | SEGMENT_B | SEGMENT_G | SEGMENT_E | SEGMENT_D;
-  const uint16_t NUM_3 = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_G;
-  const uint16_t NUM_4 = SEGMENT_F | SEGMENT_G | SEGMENT_B | SEGMENT_C;
-  const uint16_t NUM_5 = SEGMENT_A | SEGMENT_F | SEGMENT_G | SEGMENT_C | SEGMENT_D;
-  const uint16_t NUM_6 = SEGMENT_A | SEGMENT_F | SEGMENT_E | SEGMENT_D | SEGMENT_C | SEGMENT_G;
-  const uint16_t NUM_7 = SEGMENT_A | SEGMENT_B | SEGMENT_C;
-  const uint16_t NUM_8 = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_E | SEGMENT_F | SEGMENT_G;
-  const uint16_t NUM_9 = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_F | SEGMENT_G;
-  const uint16_t LET_C = SEGMENT_A | SEGMENT_F | SEGMENT_E | SEGMENT_D;
-  const uint16_t LET_D = SEGMENT_B | SEGMENT_C | SEGMENT_D | SEGMENT_E | SEGMENT_G;
-  const uint16_t LET_E = SEGMENT_A | SEGMENT_F | SEGMENT_E | SEGMENT_D | SEGMENT_G;
-  const uint16_t LET_F = SEGMENT_E | SEGMENT_F | SEGMENT_A | SEGMENT_G;
-  const uint16_t LET_H = SEGMENT_B | SEGMENT_C | SEGMENT_E | SEGMENT_F | SEGMENT_G;
-  const uint16_t LET_N = SEGMENT_A | SEGMENT_B | SEGMENT_C | SEGMENT_E | SEGMENT_F;
-}
-
-namespace FRAME_TYPE {
-  const uint16_t CUE    = 0x0100;
-  const uint16_t LED    = 0x4000;
-  const uint16_t DIGIT  = FRAME_DIGIT::POS_1 | FRAME_DIGIT::POS_2 | FRAME_DIGIT::POS_3 | FRAME_DIGIT::POS_4;
-
-#if defined MODEL_SB_H20
-  const uint16_t BUTTON = CUE | FRAME_BUTTON::POWER | FRAME_BUTTON::FILTER | FRAME_BUTTON::HEATER | FRAME_BUTTON::BUBBLE | FRAME_BUTTON::TEMP_UP | FRAME_BUTTON::TEMP_DOWN | FRAME_BUTTON::TEMP_UNIT;
-#elif defined MODEL_SJB_HS
-  const uint16_t BUTTON = CUE | FRAME_BUTTON::POWER | FRAME_BUTTON::FILTER | FRAME_BUTTON::HEATER | FRAME_BUTTON::BUBBLE | FRAME_BUTTON::TEMP_UP | FRAME_BUTTON::TEMP_DOWN | FRAME_BUTTON::TEMP_UNIT | FRAME_BUTTON::DISINFECTION | FRAME_BUTTON::JET;
-#endif
-}
-
 namespace DIGIT {
   const uint8_t POS_1     = 0x8;
   const uint8_t POS_2     = 0x4;
@@ -142,6 +75,8 @@ namespace ERROR {
 }
 
 inline char display2LastDigit(uint32_t v) { return (v >> 24) & 0xFFU; }
+inline bool isDigit(uint32_t c)             { return c >= '0' && c <= '9'; }
+inline bool displayHasNum(uint32_t v)      { return isDigit(v & 0xFFU) && isDigit((v >> 8) & 0xFFU) && isDigit((v >> 16) & 0xFFU); }
 inline uint16_t display2Num(uint32_t v)     { return (((v & 0xFFU) - '0')*100) + ((((v >> 8) & 0xFFU) - '0')*10) + (((v >> 16) & 0xFFU) - '0'); }
 inline uint32_t display2Error(uint32_t v)   { return v & 0x00FFFFFFU; }
 inline bool displayIsTemp(uint32_t v)     { return display2LastDigit(v) == 'C' || display2LastDigit(v) == 'F'; }
@@ -149,10 +84,6 @@ inline bool displayIsTime(uint32_t v)     { return display2LastDigit(v) == 'H';
 inline bool displayIsError(uint32_t v)    { return (v & 0xFFU) == 'E'; }
 inline bool displayIsBlank(uint32_t v)    { return (v & 0x00FFFFFFU) == (' ' << 16) + (' ' << 8) + ' '; }
 
-volatile PureSpaIO::State PureSpaIO::state;
-volatile PureSpaIO::IsrState PureSpaIO::isrState;
-volatile PureSpaIO::Buttons PureSpaIO::buttons;
-
 static unsigned long millis() {
     return (unsigned long)(esp_timer_get_time() / 1000);
 }
@@ -161,36 +92,18 @@ static void delay(uint32_t ms) {
     vTaskDelay(pdMS_TO_TICKS(ms));
 }
 
-static void delayMicroseconds(uint32_t us) {
-    ets_delay_us(us);
-}
-
-void PureSpaIO::setup(LANG language)
+void PureSpaIO::setup(LANG language, BusBackend& backend)
 {
   this->language = language;
+  this->backend = &backend;
 
-  // Configure CLOCK as Interrupt Input (Rising Edge)
-  gpio_config_t io_conf = {};
-  io_conf.intr_type = GPIO_INTR_POSEDGE;
-  io_conf.pin_bit_mask = (1ULL << PIN::CLOCK);
-  io_conf.mode = GPIO_MODE_INPUT;
-  io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
-  io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-  gpio_config(&io_conf);
-
-  // Configure LATCH as Interrupt Input (Falling Edge)
-  io_conf.intr_type = GPIO_INTR_POSEDGE;
-  io_conf.pin_bit_mask = (1ULL << PIN::LATCH);
-  gpio_config(&io_conf);
+  // Start the first signal stats interval
+  takeSignalStats();
 
-  // Configure DATA as Input
-  io_conf.intr_type = GPIO_INTR_DISABLE;
-  io_conf.pin_bit_mask = (1ULL << PIN::DATA);
-  gpio_config(&io_conf);
-
-  gpio_install_isr_service(0);
-  gpio_isr_handler_add(PIN::CLOCK, PureSpaIO::clockRisingISR, this);
-  //gpio_isr_handler_add(PIN::LATCH, PureSpaIO::latchRisingISR, this);
+  if (!backend.start(PureSpaIO::receiveEdge, this))
+  {
+    ESP_LOGE(TAG, "Failed to start the %s bus backend", backend.getName());
+  }
 }
 
 PureSpaIO::MODEL PureSpaIO::getModel() const
@@ -229,6 +142,11 @@ bool PureSpaIO::isOnline() const
   return state.online;
 }
 
+const char* PureSpaIO::getBusBackendName() const
+{
+  return backend ? backend->getName() : "none";
+}
+
 unsigned int PureSpaIO::getTotalFrames() const
 {
   return state.frameCounter;
@@ -239,6 +157,68 @@ unsigned int PureSpaIO::getDroppedFrames() const
   return state.frameDropped;
 }
 
+PureSpaIO::SignalStats PureSpaIO::takeSignalStats()
+{
+  SignalStats stats;
+  portENTER_CRITICAL(&signalMux);
+  memcpy(&stats, (const void*)&signalStats, sizeof(stats));
+  // The last* values describe the latest event and carry over
+  signalStats.cycles                = 0;
+  signalStats.cyclePeriods          = 0;
+  signalStats.cyclePeriodSumUs      = 0;
+  signalStats.cyclePeriodMinUs      = UINT32_MAX;
+  signalStats.cyclePeriodMaxUs      = 0;
+  signalStats.cyclePeriodOutOfRange = 0;
+  signalStats.frameGaps             = 0;
+  signalStats.frameGapSumUs         = 0;
+  signalStats.frameGapMinUs         = UINT32_MAX;
+  signalStats.frameGapMaxUs         = 0;
+  signalStats.syncLoss              = 0;
+  signalStats.bitCountErrors        = 0;
+  signalStats.unknownSegments       = 0;
+  signalStats.ledConfirmResets      = 0;
+  portEXIT_CRITICAL(&signalMux);
+
+  // The backend measures the ISR, around the decoder
+  BusBackend::EdgeCost cost = backend ? backend->takeEdgeCost() : BusBackend::EdgeCost();
+  stats.isrCalls      = cost.calls;
+  stats.isrCyclesSum  = cost.cyclesSum;
+  stats.isrCyclesMin  = cost.cyclesMin;
+  stats.isrCyclesMax  = cost.cyclesMax;
+  stats.isrSpacingMin = cost.spacingMin;
+  memcpy(stats.isrCycleBuckets, cost.buckets, sizeof(stats.isrCycleBuckets));
+  return stats;
+}
+
+unsigned int PureSpaIO::getExpectedCyclePeriodUs()
+{
+  return CYCLE::PERIOD*1000;
+}
+
+unsigned int PureSpaIO::getExpectedFramesPerCycle()
+{
+  return CYCLE::TOTAL_FRAMES;
+}
+
+unsigned int PureSpaIO::getExpectedClockEdgesPerSecond()
+{
+  return FRAME::BITS*CYCLE::TOTAL_FRAMES*1000/CYCLE::PERIOD;
+}
+
+PureSpaIO::BusCounters PureSpaIO::getBusCounters() const
+{
+  BusCounters counters;
+  counters.isr               = debugState.isrCount;
+  counters.validFrames       = debugState.validFrameCount;
+  counters.invalidFrames     = debugState.invalidFrameCount;
+  counters.cueFrames         = debugState.cueFrameCount;
+  counters.digitFrames       = debugState.digitFrameCount;
+  counters.ledFrames         = debugState.ledFrameCount;
+  counters.buttonFrames      = debugState.buttonFrameCount;
+  counters.unsupportedFrames = debugState.unsupportedFrameCount;
+  return counters;
+}
+
 int PureSpaIO::getActWaterTempCelsius() const
 {
   return (state.waterTemp != UNDEF::UINT) ? convertDisplayToCelsius(state.waterTemp) : UNDEF::INT;
@@ -251,7 +231,7 @@ int PureSpaIO::getDesiredWaterTempCelsius() const
 
 int PureSpaIO::getDisinfectionTime() const
 {
-  return isDisinfectionOn() ? (state.disinfectionTime != UNDEF::UINT ? display2Num(state.disinfectionTime) : UNDEF::INT) : 0;
+  return isDisinfectionOn() ? (state.disinfectionTime != UNDEF::UINT && displayHasNum(state.disinfectionTime) ? display2Num(state.disinfectionTime) : UNDEF::INT) : 0;
 }
 
 std::string PureSpaIO::getErrorCode() const
@@ -293,7 +273,7 @@ std::string PureSpaIO::getErrorMessage(const std::string& errorCode) const
 
 unsigned int PureSpaIO::getRawLedValue() const
 {
-  return (state.ledStatus != UNDEF::USHORT) ? state.ledStatus : UNDEF::USHORT;
+  return state.ledStatus;
 }
 
 uint8_t PureSpaIO::isPowerOn() const
@@ -344,7 +324,7 @@ uint8_t PureSpaIO::isJetOn() const
 #endif
 }
 
-void PureSpaIO::setDesiredWaterTempCelsius(int temp)
+bool PureSpaIO::setDesiredWaterTempCelsius(int temp)
 {
   if (temp >= WATER_TEMP::SET_MIN && temp <= WATER_TEMP::SET_MAX)
   {
@@ -382,7 +362,7 @@ void PureSpaIO::setDesiredWaterTempCelsius(int temp)
 
         if (newSetTemp == UNDEF::INT)
         {
-          return;
+          return false;
         }
         else
         {
@@ -405,8 +385,11 @@ void PureSpaIO::setDesiredWaterTempCelsius(int temp)
           }
         }
       } while (temp != setTemp && changeTries);
+
+      return temp == setTemp;
     }
   }
+  return false;
 }
 
 void PureSpaIO::setDisinfectionTime(int hours)
@@ -452,45 +435,50 @@ bool PureSpaIO::pressButton(volatile unsigned int& buttonPressCount)
   return success;
 }
 
-void PureSpaIO::setBubbleOn(bool on)
+bool PureSpaIO::setBubbleOn(bool on)
 {
   if (on ^ (isBubbleOn() == true))
   {
-    pressButton(buttons.toggleBubble);
+    return pressButton(buttons.toggleBubble);
   }
+  return true;
 }
 
-void PureSpaIO::setFilterOn(bool on)
+bool PureSpaIO::setFilterOn(bool on)
 {
   if (on ^ (isFilterOn() == true))
   {
-    pressButton(buttons.toggleFilter);
+    return pressButton(buttons.toggleFilter);
   }
+  return true;
 }
 
-void PureSpaIO::setHeaterOn(bool on)
+bool PureSpaIO::setHeaterOn(bool on)
 {
   if (on ^ (isHeaterOn() == true || isHeaterStandby() == true))
   {
-    pressButton(buttons.toggleHeater);
+    return pressButton(buttons.toggleHeater);
   }
+  return true;
 }
 
-void PureSpaIO::setJetOn(bool on)
+bool PureSpaIO::setJetOn(bool on)
 {
   if (on ^ (isJetOn() == true))
   {
-    pressButton(buttons.toggleJet);
+    return pressButton(buttons.toggleJet);
   }
+  return true;
 }
 
-void PureSpaIO::setPowerOn(bool on)
+bool PureSpaIO::setPowerOn(bool on)
 {
   bool active = isPowerOn() == true;
   if (on ^ active)
   {
-    pressButton(buttons.togglePower);
+    return pressButton(buttons.togglePower);
   }
+  return true;
 }
 
 bool PureSpaIO::waitBuzzerOff() const
@@ -558,6 +546,12 @@ bool PureSpaIO::changeWaterTemp(int up)
 
 int PureSpaIO::convertDisplayToCelsius(uint32_t value) const
 {
+  // Letters in the digit positions would wrap display2Num into range
+  if (!displayHasNum(value))
+  {
+    return UNDEF::INT;
+  }
+
   int celsiusValue = display2Num(value);
   char tempUnit = display2LastDigit(value);
   if (tempUnit == 'F')
@@ -579,74 +573,83 @@ int PureSpaIO::convertDisplayToCelsius(uint32_t value) const
   isrState.receivedBits = isrState.receivedBits + 1;
 }*/
 
-IRAM_ATTR void PureSpaIO::clockRisingISR(void* arg)
+IRAM_ATTR void PureSpaIO::receiveEdge(void* arg, bool data, bool enabled)
 {
-  bool data = !gpio_get_level(PIN::DATA);
-  bool enabled = !gpio_get_level(PIN::LATCH);
+  static_cast<PureSpaIO*>(arg)->handleEdge(data, enabled);
+}
 
-  if (enabled || isrState.receivedBits == (FRAME::BITS - 1))
+// A complete frame, once per 16 edges
+IRAM_ATTR void PureSpaIO::handleFrame()
+{
+  state.frameCounter = state.frameCounter + 1;
+  debugState.validFrameCount = debugState.validFrameCount + 1;
+  recordFrameTiming(isrState.frameValue == FRAME_TYPE::CUE);
+  if (isrState.frameValue == FRAME_TYPE::CUE)
+  {
+    debugState.cueFrameCount = debugState.cueFrameCount + 1;
+  }
+  else if (isrState.frameValue & FRAME_TYPE::DIGIT)
   {
-    isrState.frameValue = (isrState.frameValue << 1) + data;
-    isrState.receivedBits = isrState.receivedBits + 1;
+    debugState.digitFrameCount = debugState.digitFrameCount + 1;
+    decodeDisplay();
+  }
+  else if (isrState.frameValue & FRAME_TYPE::LED)
+  {
+    debugState.ledFrameCount = debugState.ledFrameCount + 1;
+    decodeLED();
+  }
+  else if (isrState.frameValue & FRAME_TYPE::BUTTON)
+  {
+    debugState.buttonFrameCount = debugState.buttonFrameCount + 1;
+    decodeButton();
+  }
+  else if (isrState.frameValue != 0)
+  {
+    debugState.unsupportedFrameCount = debugState.unsupportedFrameCount + 1;
+  }
 
-    if (isrState.receivedBits == FRAME::BITS)
-    {
-      state.frameCounter = state.frameCounter + 1;
-      if (isrState.frameValue == FRAME_TYPE::CUE)
-      {
-      }
-      else if (isrState.frameValue & FRAME_TYPE::DIGIT)
-      {
-        decodeDisplay();
-      }
-      else if (isrState.frameValue & FRAME_TYPE::LED)
-      {
-        decodeLED();
-      }
-      else if (isrState.frameValue & FRAME_TYPE::BUTTON)
-      {
-        decodeButton();
-      }
-      else if (isrState.frameValue != 0)
-      {
-      }
+  isrState.receivedBits = 0;
+}
 
-      isrState.receivedBits = 0;
-    }
-  }
-  else
+// LATCH released before the 16th bit
+IRAM_ATTR void PureSpaIO::handleCutFrame()
+{
+  if (isrState.receivedBits)
   {
-    isrState.receivedBits = 0;
-    state.frameDropped = state.frameDropped + 1;
-    state.frameCounter = state.frameCounter + 1;
+    recordBitCountError(isrState.receivedBits);
   }
+  isrState.receivedBits = 0;
+  state.frameDropped = state.frameDropped + 1;
+  state.frameCounter = state.frameCounter + 1;
+  debugState.invalidFrameCount = debugState.invalidFrameCount + 1;
 }
 
 IRAM_ATTR void PureSpaIO::latchRisingISR(void* arg)
 {
-  if (isrState.receivedBits == FRAME::BITS)
+  PureSpaIO* self = static_cast<PureSpaIO*>(arg);
+  if (self->isrState.receivedBits == FRAME::BITS)
   {
-    state.frameCounter = state.frameCounter + 1;
+    self->state.frameCounter = self->state.frameCounter + 1;
     
-    if (isrState.frameValue == FRAME_TYPE::CUE) {
+    if (self->isrState.frameValue == FRAME_TYPE::CUE) {
     }
-    else if (isrState.frameValue & FRAME_TYPE::DIGIT) {
-        decodeDisplay();
+    else if (self->isrState.frameValue & FRAME_TYPE::DIGIT) {
+        self->decodeDisplay();
     }
-    else if (isrState.frameValue & FRAME_TYPE::LED) {
-        decodeLED();
+    else if (self->isrState.frameValue & FRAME_TYPE::LED) {
+        self->decodeLED();
     }
-    else if (isrState.frameValue & FRAME_TYPE::BUTTON) {
-        decodeButton();
+    else if (self->isrState.frameValue & FRAME_TYPE::BUTTON) {
+        self->decodeButton();
     }
 
-    isrState.receivedBits = 0;
+    self->isrState.receivedBits = 0;
   }
   else
   {
-    state.frameCounter = state.frameCounter + 1;
-    state.frameDropped = state.frameDropped + 1;
-    isrState.receivedBits = 0;
+    self->state.frameCounter = self->state.frameCounter + 1;
+    self->state.frameDropped = self->state.frameDropped + 1;
+    self->isrState.receivedBits = 0;
   }
 }
 
@@ -707,6 +710,10 @@ IRAM_ATTR void PureSpaIO::decodeDisplay()
       digit = 'N';
       break;
     default:
+      portENTER_CRITICAL_ISR(&signalMux);
+      signalStats.unknownSegments = signalStats.unknownSegments + 1;
+      signalStats.lastUnknownSegments = isrState.frameValue & FRAME_DIGIT::SEGMENTS;
+      portEXIT_CRITICAL_ISR(&signalMux);
       return;
   }
 
@@ -763,6 +770,9 @@ IRAM_ATTR void PureSpaIO::decodeDisplay()
         {
           if (displayIsTemp(isrState.displayValue))
           {
+            // A temperature replaces the error code once it has been cleared
+            state.error = 0;
+
             if (isrState.isDisplayBlinking)
             {
               if (isrState.displayValue == isrState.latestBlinkingTemp)
@@ -873,11 +883,72 @@ IRAM_ATTR void PureSpaIO::decodeLED()
   }
   else
   {
+    if (isrState.latestLedStatus != UNDEF::USHORT)
+    {
+      portENTER_CRITICAL_ISR(&signalMux);
+      signalStats.ledConfirmResets = signalStats.ledConfirmResets + 1;
+      portEXIT_CRITICAL_ISR(&signalMux);
+    }
     isrState.latestLedStatus = isrState.frameValue;
     isrState.stableLedStatusCount = CONFIRM_FRAMES::REGULAR;
   }
 }
 
+// Called for every complete frame, a CUE frame also closes the display cycle.
+// Gaps longer than CYCLE::RECEIVE_TIMEOUT are the bus going quiet, not jitter.
+IRAM_ATTR void PureSpaIO::recordFrameTiming(bool cue)
+{
+  int64_t now = esp_timer_get_time();
+  const int64_t quiet = CYCLE::RECEIVE_TIMEOUT*1000;
+
+  portENTER_CRITICAL_ISR(&signalMux);
+  if (isrState.lastFrameTime && now - isrState.lastFrameTime < quiet)
+  {
+    uint32_t gap = now - isrState.lastFrameTime;
+    signalStats.frameGaps = signalStats.frameGaps + 1;
+    signalStats.frameGapSumUs = signalStats.frameGapSumUs + gap;
+    if (gap < signalStats.frameGapMinUs) signalStats.frameGapMinUs = gap;
+    if (gap > signalStats.frameGapMaxUs) signalStats.frameGapMaxUs = gap;
+  }
+  isrState.lastFrameTime = now;
+  isrState.framesSinceCue = isrState.framesSinceCue + 1;
+
+  if (cue)
+  {
+    signalStats.cycles = signalStats.cycles + 1;
+    if (isrState.lastCueTime && now - isrState.lastCueTime < quiet)
+    {
+      uint32_t period = now - isrState.lastCueTime;
+      signalStats.cyclePeriods = signalStats.cyclePeriods + 1;
+      signalStats.cyclePeriodSumUs = signalStats.cyclePeriodSumUs + period;
+      if (period < signalStats.cyclePeriodMinUs) signalStats.cyclePeriodMinUs = period;
+      if (period > signalStats.cyclePeriodMaxUs) signalStats.cyclePeriodMaxUs = period;
+      if (period + CYCLE::TOLERANCE*1000 < CYCLE::PERIOD*1000 || period > (CYCLE::PERIOD + CYCLE::TOLERANCE)*1000)
+      {
+        signalStats.cyclePeriodOutOfRange = signalStats.cyclePeriodOutOfRange + 1;
+      }
+
+      // Frames since the previous CUE, this one included
+      signalStats.lastFramesPerCycle = isrState.framesSinceCue;
+      if (isrState.framesSinceCue != CYCLE::TOTAL_FRAMES)
+      {
+        signalStats.syncLoss = signalStats.syncLoss + 1;
+      }
+    }
+    isrState.lastCueTime = now;
+    isrState.framesSinceCue = 0;
+  }
+  portEXIT_CRITICAL_ISR(&signalMux);
+}
+
+IRAM_ATTR void PureSpaIO::recordBitCountError(uint16_t receivedBits)
+{
+  portENTER_CRITICAL_ISR(&signalMux);
+  signalStats.bitCountErrors = signalStats.bitCountErrors + 1;
+  signalStats.lastBitCount = receivedBits;
+  portEXIT_CRITICAL_ISR(&signalMux);
+}
+
 IRAM_ATTR void PureSpaIO::updateButtonState(volatile unsigned int& buttonPressCount)
 {
   if (buttonPressCount)
@@ -923,11 +994,7 @@ IRAM_ATTR void PureSpaIO::decodeButton()
 
   if (isrState.reply)
   {
-    delayMicroseconds(1);
-    gpio_set_level(PIN::DATA, 0); // Explicitly pull low
-    gpio_set_direction(PIN::DATA, GPIO_MODE_OUTPUT);
-    delayMicroseconds(2);
-    gpio_set_direction(PIN::DATA, GPIO_MODE_INPUT);
+    backend->pullDataLow();
     isrState.reply = false;
   }
 }
@@ -7,6 +7,8 @@
 #include <string>
 #include "common.h"
 #include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "BusBackend.h"
 
 // Types missing in standard headers
 typedef int32_t sint32;
@@ -37,7 +39,10 @@ public:
   };
 
 public:
-  void setup(LANG language);
+  // Each instance decodes one spa: the decoder state lives in the object and
+  // the backend hands it back to the ISR, so several buses can run at once.
+  // Starts decoding the edges delivered by backend, which must outlive this
+  void setup(LANG language, BusBackend& backend);
   void loop();
 
 public:
@@ -45,6 +50,7 @@ public:
   const char* getModelName() const;
 
   bool isOnline() const;
+  const char* getBusBackendName() const;
 
   int getActWaterTempCelsius() const;
   int getDesiredWaterTempCelsius() const;
@@ -59,14 +65,15 @@ public:
   uint8_t isJetOn() const;
   uint8_t isPowerOn() const;
 
-  void setDesiredWaterTempCelsius(int temp);
+  // Setters block until the spa acknowledged the change and return false if it did not
+  bool setDesiredWaterTempCelsius(int temp);
   void setDisinfectionTime(int hours);
 
-  void setBubbleOn(bool on);
-  void setFilterOn(bool on);
-  void setHeaterOn(bool on);
-  void setJetOn(bool on);
-  void setPowerOn(bool on);
+  bool setBubbleOn(bool on);
+  bool setFilterOn(bool on);
+  bool setHeaterOn(bool on);
+  bool setJetOn(bool on);
+  bool setPowerOn(bool on);
 
   std::string getErrorCode() const;
   std::string getErrorMessage(const std::string& errorCode) const;
@@ -76,6 +83,63 @@ public:
   unsigned int getTotalFrames() const;
   unsigned int getDroppedFrames() const;
 
+  // Decoder counters maintained by the ISR (monotonic, wrap at 2^32)
+  struct BusCounters
+  {
+    uint32_t isr;
+    uint32_t validFrames;
+    uint32_t invalidFrames;
+    uint32_t cueFrames;
+    uint32_t digitFrames;
+    uint32_t ledFrames;
+    uint32_t buttonFrames;
+    uint32_t unsupportedFrames;
+  };
+  BusCounters getBusCounters() const;
+
+  // Clock ISR cost histogram: bucket i counts invocations below
+  // ISR_CYCLES_FIRST_BUCKET << i CPU cycles, the last bucket the rest
+  static const unsigned int ISR_CYCLE_BUCKETS = BusBackend::COST_BUCKETS;
+  static const unsigned int ISR_CYCLES_FIRST_BUCKET = BusBackend::COST_FIRST_BUCKET;
+
+  // Bus signal quality accumulated by the ISR since the previous call to
+  // takeSignalStats(), which starts a new interval
+  struct SignalStats
+  {
+    uint32_t cycles;                 // CUE frames, one per display cycle
+    uint32_t cyclePeriods;           // measured CUE to CUE periods
+    uint64_t cyclePeriodSumUs;
+    uint32_t cyclePeriodMinUs;
+    uint32_t cyclePeriodMaxUs;
+    uint32_t cyclePeriodOutOfRange;  // off CYCLE::PERIOD by more than CYCLE::TOLERANCE
+    uint32_t frameGaps;              // measured periods between complete frames
+    uint64_t frameGapSumUs;
+    uint32_t frameGapMinUs;
+    uint32_t frameGapMaxUs;
+    uint32_t syncLoss;               // cycles without CYCLE::TOTAL_FRAMES frames
+    uint32_t bitCountErrors;         // frames cut short by the LATCH level
+    uint32_t unknownSegments;        // digit frames with an undecodable segment pattern
+    uint32_t ledConfirmResets;       // LED value changed before it was confirmed
+    uint16_t lastFramesPerCycle;
+    uint16_t lastBitCount;           // bits received when the last frame was cut short
+    uint16_t lastUnknownSegments;    // segment bits of the last undecodable digit
+
+    // Cost of the clock ISR body in CPU cycles (GPIO ISR dispatch not included),
+    // as measured by the bus backend
+    uint32_t isrCalls;
+    uint64_t isrCyclesSum;
+    uint32_t isrCyclesMin;
+    uint32_t isrCyclesMax;
+    uint32_t isrSpacingMin;          // cycles between two ISR entries, the real budget
+    uint32_t isrCycleBuckets[ISR_CYCLE_BUCKETS];
+  };
+  SignalStats takeSignalStats();
+
+  // Reference values the signal stats are measured against
+  static unsigned int getExpectedCyclePeriodUs();
+  static unsigned int getExpectedFramesPerCycle();
+  static unsigned int getExpectedClockEdgesPerSecond();
+
 private:
   class CYCLE
   {
@@ -88,6 +152,7 @@ private:
     static const unsigned int TOTAL_FRAMES = 25 + BUTTON_FRAMES;
     static const unsigned int DISPLAY_FRAME_GROUPS =  5;
     static const unsigned int PERIOD = 21; // ms
+    static const unsigned int TOLERANCE = 3; // ms
     static const unsigned int RECEIVE_TIMEOUT = 50*CYCLE::PERIOD; // ms
   };
 
@@ -169,6 +234,10 @@ private:
     bool isDisplayBlinking = false;
 
     bool reply = false;
+
+    int64_t lastFrameTime = 0; // us
+    int64_t lastCueTime = 0;   // us
+    uint16_t framesSinceCue = 0;
   };
 
   struct Buttons
@@ -212,20 +281,33 @@ private:
   };
 
 private:
-  // ISR and ISR helper
-  static IRAM_ATTR void clockRisingISR(void* arg);
+  // GpioBusBackend<PureSpaIO> calls handleEdge from its ISR, without going
+  // through the receiveEdge pointer
+  template<typename Sink> friend class GpioBusBackend;
+
+  // ISR and ISR helper, arg is the instance
+  static IRAM_ATTR void receiveEdge(void* arg, bool data, bool enabled);
   static IRAM_ATTR void latchRisingISR(void* arg);
-  static IRAM_ATTR void decodeDisplay();
-  static IRAM_ATTR void decodeLED();
-  static IRAM_ATTR void decodeButton();
-  static IRAM_ATTR void updateButtonState(volatile unsigned int& buttonPressCount);
+  inline void handleEdge(bool data, bool enabled) __attribute__((always_inline));
+  IRAM_ATTR void handleFrame();
+  IRAM_ATTR void handleCutFrame();
+  IRAM_ATTR void decodeDisplay();
+  IRAM_ATTR void decodeLED();
+  IRAM_ATTR void decodeButton();
+  IRAM_ATTR void updateButtonState(volatile unsigned int& buttonPressCount);
+  IRAM_ATTR void recordFrameTiming(bool cue);
+  IRAM_ATTR void recordBitCountError(uint16_t receivedBits);
 
 private:
   // ISR variables
-  static volatile State state;
-  static volatile IsrState isrState;
-  static volatile Buttons buttons;
-  static volatile DebugState debugState;
+  volatile State state;
+  volatile IsrState isrState;
+  volatile Buttons buttons;
+  volatile DebugState debugState;
+  volatile SignalStats signalStats = {};
+
+  // Guards signalStats between the ISR and takeSignalStats()
+  portMUX_TYPE signalMux = portMUX_INITIALIZER_UNLOCKED;
 
 private:
   int convertDisplayToCelsius(uint32_t value) const;
@@ -244,9 +326,33 @@ private:
 
 private:
   LANG language;
+  BusBackend* backend = nullptr;
   unsigned long lastStateUpdateTime = 0;
   bool init = false;
   char errorBuffer[4];
 };
 
+// Called by the bus backend on every clock edge (~24k/s), from the GPIO ISR on
+// the spa. Always inlined, so the per-edge shift costs no call in the ISR; the
+// frame handling behind it runs once per 16 edges.
+inline void PureSpaIO::handleEdge(bool data, bool enabled)
+{
+  debugState.isrCount = debugState.isrCount + 1;
+
+  if (enabled || isrState.receivedBits == (FRAME::BITS - 1))
+  {
+    isrState.frameValue = (isrState.frameValue << 1) + data;
+    isrState.receivedBits = isrState.receivedBits + 1;
+
+    if (isrState.receivedBits == FRAME::BITS)
+    {
+      handleFrame();
+    }
+  }
+  else
+  {
+    handleCutFrame();
+  }
+}
+
 #endif /* PURE_SPA_IO_H */
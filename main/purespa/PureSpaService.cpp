@@ -1,32 +1,140 @@
 #include "PureSpaService.h"
 #include "AuditLogger.h"
+#include "ota_updater.h"
+#include "json_writer.h"
+#include "cbor_writer.h"
+#include "metrics.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_timer.h"
 #include "esp_log.h"
-#include "cJSON.h"
 #include "nvs_flash.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
+#include "esp_random.h"
+#include "esp_rom_sys.h"
 #include <time.h>
+#include <cstring>
+#include <chrono>
 #include <algorithm>
+#include <atomic>
 
 static const char *TAG = "PureSpaService";
 #define SCHEDULE_NAMESPACE "purespa_sched"
 #define SCHEDULE_KEY "events"
+#define SCENE_NAMESPACE "purespa_scene"
+#define SCENE_KEY "scenes"
 
-void PureSpaService::init() {
+// Event IDs count up from 1. Stored IDs and next_id past this are rejected,
+// which leaves room for the following ones without overflowing.
+static const int32_t MAX_EVENT_ID = 1000000000;
+
+// Shared between the caller waiting in runBatch() and the service task; whoever
+// drops the last reference frees it, so a timed out caller never leaves a
+// dangling pointer in the queue.
+struct SpaBatchJob {
+    SpaBatchCommand commands[PureSpaService::MAX_BATCH_COMMANDS];
+    size_t count;
+    char source[32];
+    SpaBatchResult result;
+    SemaphoreHandle_t done;
+    std::atomic<int> refs;
+};
+
+static void releaseBatchJob(SpaBatchJob* job) {
+    if (job->refs.fetch_sub(1) == 1) {
+        vSemaphoreDelete(job->done);
+        delete job;
+    }
+}
+
+const JsonField SCHEDULED_EVENT_FIELDS[] = {
+    JSON_FIELD(ScheduledEvent, id,              "id",          0),
+    JSON_FIELD(ScheduledEvent, enabled,         "enabled",     true),
+    JSON_FIELD(ScheduledEvent, recurring,       "recurring",   false),
+    JSON_FIELD(ScheduledEvent, dayOfWeekMask,   "dow",         0),
+    JSON_FIELD(ScheduledEvent, year,            "year",        0),
+    JSON_FIELD(ScheduledEvent, month,           "month",       0),
+    JSON_FIELD(ScheduledEvent, day,             "day",         0),
+    JSON_FIELD(ScheduledEvent, hour,            "hour",        0),
+    JSON_FIELD(ScheduledEvent, minute,          "minute",      0),
+
+    JSON_FIELD(ScheduledEvent, setPower,        "setPower",    false),
+    JSON_FIELD(ScheduledEvent, powerValue,      "powerValue",  false),
+    JSON_FIELD(ScheduledEvent, setFilter,       "setFilter",   false),
+    JSON_FIELD(ScheduledEvent, filterValue,     "filterValue", false),
+    JSON_FIELD(ScheduledEvent, setHeater,       "setHeater",   false),
+    JSON_FIELD(ScheduledEvent, heaterValue,     "heaterValue", false),
+    JSON_FIELD(ScheduledEvent, setBubble,       "setBubble",   false),
+    JSON_FIELD(ScheduledEvent, bubbleValue,     "bubbleValue", false),
+    JSON_FIELD(ScheduledEvent, setTargetTemp,   "setTemp",     false),
+    JSON_FIELD(ScheduledEvent, targetTempValue, "tempValue",   38),
+};
+const size_t SCHEDULED_EVENT_FIELD_COUNT = sizeof(SCHEDULED_EVENT_FIELDS) / sizeof(SCHEDULED_EVENT_FIELDS[0]);
+
+void PureSpaService::init(BusBackend& bus) {
+    _bus = &bus;
     _cmdQueue = xQueueCreate(10, sizeof(SpaRequest));
     if (_cmdQueue == NULL) {
         ESP_LOGE(TAG, "Failed to create command queue!");
         return;
     }
 
-    loadSchedule();
-    AuditLogger::getInstance().init();
+    size_t spa = getIndex();
+    if (spa == 0) {
+        loadSchedule();
+        loadScenes();
+        AuditLogger::getInstance().init();
+    }
+
+    // Random start so ETags from a previous boot never match the new cache
+    _statusVersion = esp_random();
+    refreshStatus(true);
+
+    // Every bus on core 1, next to its interrupt
+    char taskName[16];
+    snprintf(taskName, sizeof(taskName), "purespa_svc_%u", (unsigned int)spa);
+    ESP_LOGI(TAG, "Spa %u: command queue created. Starting service task...", (unsigned int)spa);
+    xTaskCreatePinnedToCore(taskWrapper, spa == 0 ? "purespa_service_task" : taskName, 8192, this, 5, NULL, 1);
+}
+
+PureSpaService* PureSpaService::getInstance(size_t spa) {
+    return spa < getSpaCount() ? &slot(spa) : nullptr;
+}
+
+PureSpaService* PureSpaService::addSpa(BusBackend& bus) {
+    size_t spa = getSpaCount();
+    if (spa >= MAX_SPAS) {
+        ESP_LOGE(TAG, "Only %u spas are supported", (unsigned int)MAX_SPAS);
+        return nullptr;
+    }
+    slot(spa).init(bus);
+    return &slot(spa);
+}
+
+size_t PureSpaService::getSpaCount() {
+    size_t count = 0;
+    while (count < MAX_SPAS && slot(count)._bus != nullptr) {
+        count++;
+    }
+    return count;
+}
+
+size_t PureSpaService::getIndex() const {
+    return this - &slot(0);
+}
 
-    ESP_LOGI(TAG, "Command queue created. Starting service task...");
-    xTaskCreatePinnedToCore(taskWrapper, "purespa_service_task", 8192, this, 5, NULL, 1);
+// All spas share the audit log; changes on the others carry the spa index
+void PureSpaService::logAudit(const char* source, const char* feature, bool on) {
+    size_t spa = getIndex();
+    if (spa == 0) {
+        AuditLogger::getInstance().logEvent(source, feature, on);
+        return;
+    }
+    char tagged[sizeof(AuditEvent::feature)];
+    snprintf(tagged, sizeof(tagged), "%s #%u", feature, (unsigned int)spa);
+    AuditLogger::getInstance().logEvent(source, tagged, on);
 }
 
 void PureSpaService::taskWrapper(void* param) {
@@ -35,7 +143,7 @@ void PureSpaService::taskWrapper(void* param) {
 
 void PureSpaService::run() {
     ESP_LOGI(TAG, "PureSpa Service task running on core %d", xPortGetCoreID());
-    _io.setup(LANG::EN);
+    _io.setup(LANG::EN, *_bus);
     
     SpaRequest req;
     TickType_t lastCheck = xTaskGetTickCount();
@@ -56,13 +164,23 @@ void PureSpaService::run() {
                 case SpaCommand::HEATER_ON:  _io.setHeaterOn(true); break;
                 case SpaCommand::HEATER_OFF: _io.setHeaterOn(false); break;
                 case SpaCommand::SET_TEMP:   _io.setDesiredWaterTempCelsius(req.value); break;
+                case SpaCommand::BATCH:
+                    executeBatch(req.batch->commands, req.batch->count, req.batch->source, req.batch->result);
+                    xSemaphoreGive(req.batch->done);
+                    releaseBatchJob(req.batch);
+                    break;
                 default: ESP_LOGW(TAG, "Unknown command type: %d", (int)req.cmd); break;
             }
             ESP_LOGI(TAG, "Command %d execution finished.", (int)req.cmd);
+            Metrics::getInstance().recordCommand(req.cmd, (uint32_t)((esp_timer_get_time() - req.queuedAt) / 1000));
         }
 
-        // Check schedule every 10 seconds (checkSchedule handles per-minute precision)
-        if (xTaskGetTickCount() - lastCheck > pdMS_TO_TICKS(10000)) {
+        refreshStatus(false);
+        sampleBusStats();
+
+        // Check schedule every 10 seconds (checkSchedule handles per-minute precision).
+        // The schedule drives the first spa only.
+        if (getIndex() == 0 && xTaskGetTickCount() - lastCheck > pdMS_TO_TICKS(10000)) {
             checkSchedule();
             lastCheck = xTaskGetTickCount();
         }
@@ -89,153 +207,550 @@ void PureSpaService::checkSchedule() {
 
     ESP_LOGI(TAG, "Checking schedule for %02d:%02d", timeinfo.tm_hour, timeinfo.tm_min);
 
-    std::lock_guard<std::recursive_mutex> lock(_eventsMutex);
-    for (auto it = _events.begin(); it != _events.end(); ) {
-        bool trigger = false;
-        if (it->enabled && it->hour == timeinfo.tm_hour && it->minute == timeinfo.tm_min) {
-            if (it->recurring) {
-                if (it->dayOfWeekMask & (1 << timeinfo.tm_wday)) {
-                    trigger = true;
-                }
-            } else {
-                if (it->year == (timeinfo.tm_year + 1900) && 
-                    it->month == (timeinfo.tm_mon + 1) && 
-                    it->day == timeinfo.tm_mday) {
-                    trigger = true;
+    // Due events are copied out under the lock and run after it is released,
+    // so API calls editing the schedule never wait for button presses
+    ScheduledEvent due[MAX_EVENTS];
+    size_t dueCount = 0;
+    bool removed = false;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_eventsMutex);
+        Metrics::ProfileScope profile(Metrics::PROFILE_SCHEDULE_CHECK, _events.size());
+        for (auto it = _events.begin(); it != _events.end(); ) {
+            bool trigger = false;
+            if (it->enabled && it->hour == timeinfo.tm_hour && it->minute == timeinfo.tm_min) {
+                if (it->recurring) {
+                    if (it->dayOfWeekMask & (1 << timeinfo.tm_wday)) {
+                        trigger = true;
+                    }
+                } else {
+                    if (it->year == (timeinfo.tm_year + 1900) && 
+                        it->month == (timeinfo.tm_mon + 1) && 
+                        it->day == timeinfo.tm_mday) {
+                        trigger = true;
+                    }
                 }
             }
-        }
 
-        if (trigger) {
-            ESP_LOGI(TAG, "Triggering event ID %d", it->id);
-            executeEvent(*it);
-            if (!it->recurring) {
-                // Remove non-recurring event after it trigger
-                it = _events.erase(it);
-                saveSchedule(); // Persist the removal
-                continue;
+            if (trigger && dueCount < MAX_EVENTS) {
+                due[dueCount++] = *it;
+                if (!it->recurring) {
+                    // Remove non-recurring event after it trigger
+                    it = _events.erase(it);
+                    removed = true;
+                    continue;
+                }
             }
+            ++it;
         }
-        ++it;
+    }
+
+    if (removed) saveSchedule(); // Persist the removal
+    for (size_t i = 0; i < dueCount; i++) {
+        ESP_LOGI(TAG, "Triggering event ID %d", due[i].id);
+        executeEvent(due[i]);
     }
 }
 
 void PureSpaService::executeEvent(const ScheduledEvent& event) {
-    bool isCurrentlyOn = _io.isPowerOn();
-
     char source_buf[32];
     snprintf(source_buf, sizeof(source_buf), "Schedule #%d", event.id);
 
-    // 1. Check if we need to auto power-on (only if we want to turn something ON)
-    bool needsPowerOn = (event.setFilter && event.filterValue) || 
-                        (event.setHeater && event.heaterValue) || 
-                        (event.setBubble && event.bubbleValue) ||
-                        (event.setTargetTemp);
+    SpaBatchCommand commands[MAX_BATCH_COMMANDS];
+    size_t count = 0;
+    if (event.setPower)      commands[count++] = { event.powerValue ? SpaCommand::POWER_ON : SpaCommand::POWER_OFF, 0 };
+    if (event.setFilter)     commands[count++] = { event.filterValue ? SpaCommand::FILTER_ON : SpaCommand::FILTER_OFF, 0 };
+    if (event.setHeater)     commands[count++] = { event.heaterValue ? SpaCommand::HEATER_ON : SpaCommand::HEATER_OFF, 0 };
+    if (event.setBubble)     commands[count++] = { event.bubbleValue ? SpaCommand::BUBBLE_ON : SpaCommand::BUBBLE_OFF, 0 };
+    if (event.setTargetTemp) commands[count++] = { SpaCommand::SET_TEMP, event.targetTempValue };
 
-    if (needsPowerOn && !isCurrentlyOn) {
-        ESP_LOGI(TAG, "Auto powering ON for scheduled task");
-        setPower(true, source_buf);
-        isCurrentlyOn = true; // Assume it will turn on for subsequent command checks
+    // Already on the service task, so run in place instead of queueing
+    SpaBatchResult result;
+    executeBatch(commands, count, source_buf, result);
+}
+
+esp_err_t PureSpaService::runBatch(const SpaBatchCommand* commands, size_t count, const char* source,
+                                   uint32_t timeoutMs, SpaBatchResult& result) {
+    result = {};
+    if (count == 0 || count > MAX_BATCH_COMMANDS) return ESP_ERR_INVALID_ARG;
+
+    SpaBatchJob* job = new SpaBatchJob();
+    job->done = xSemaphoreCreateBinary();
+    if (job->done == NULL) {
+        delete job;
+        return ESP_ERR_NO_MEM;
     }
+    memcpy(job->commands, commands, count * sizeof(SpaBatchCommand));
+    job->count = count;
+    snprintf(job->source, sizeof(job->source), "%s", source);
+    job->refs = 2;
 
-    // 2. Execute commands
-    if (event.setPower) setPower(event.powerValue, source_buf);
-    
-    // Only execute feature commands if power is ON (either it was already ON, or we just turned it ON)
-    if (isCurrentlyOn) {
-        if (event.setFilter) setFilter(event.filterValue, source_buf);
-        if (event.setHeater) setHeater(event.heaterValue, source_buf);
-        if (event.setBubble) setBubble(event.bubbleValue, source_buf);
-        if (event.setTargetTemp) setTargetTemp(event.targetTempValue);
+    SpaRequest req = { SpaCommand::BATCH, 0, job, esp_timer_get_time() };
+    if (_cmdQueue == nullptr || xQueueSend(_cmdQueue, &req, pdMS_TO_TICKS(10)) != pdPASS) {
+        ESP_LOGW(TAG, "Queue is FULL, could not send batch");
+        job->refs = 1;
+        releaseBatchJob(job);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (xSemaphoreTake(job->done, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
+        result = job->result;
     } else {
-        ESP_LOGI(TAG, "Skipping feature commands as Power is OFF and no 'ON' trigger was present");
+        ESP_LOGW(TAG, "Batch from %s still running after %lu ms", source, (unsigned long)timeoutMs);
+        err = ESP_ERR_TIMEOUT;
     }
+    releaseBatchJob(job);
+    return err;
 }
 
-std::string PureSpaService::getStatusJson() {
-    cJSON *root = cJSON_CreateObject();
-    
-    cJSON_AddBoolToObject(root, "online", _io.isOnline());
-    cJSON_AddNumberToObject(root, "act_temp", _io.getActWaterTempCelsius());
-    cJSON_AddNumberToObject(root, "set_temp", _io.getDesiredWaterTempCelsius());
-    cJSON_AddBoolToObject(root, "power", _io.isPowerOn());
-    cJSON_AddBoolToObject(root, "filter", _io.isFilterOn());
-    cJSON_AddBoolToObject(root, "heater", _io.isHeaterOn());
-    cJSON_AddBoolToObject(root, "bubble", _io.isBubbleOn());
+void PureSpaService::executeBatch(const SpaBatchCommand* commands, size_t count, const char* source,
+                                  SpaBatchResult& result) {
+    int64_t start = esp_timer_get_time();
+    result = {};
+
+    // Collapse the list into one wanted state per feature (-1 = untouched, last command wins)
+    int power = -1, filter = -1, heater = -1, bubble = -1, temp = -1;
+    for (size_t i = 0; i < count; i++) {
+        int* slot = nullptr;
+        int value = 0;
+        switch (commands[i].cmd) {
+            case SpaCommand::POWER_ON:   slot = &power;  value = 1; break;
+            case SpaCommand::POWER_OFF:  slot = &power;  value = 0; break;
+            case SpaCommand::FILTER_ON:  slot = &filter; value = 1; break;
+            case SpaCommand::FILTER_OFF: slot = &filter; value = 0; break;
+            case SpaCommand::HEATER_ON:  slot = &heater; value = 1; break;
+            case SpaCommand::HEATER_OFF: slot = &heater; value = 0; break;
+            case SpaCommand::BUBBLE_ON:  slot = &bubble; value = 1; break;
+            case SpaCommand::BUBBLE_OFF: slot = &bubble; value = 0; break;
+            case SpaCommand::SET_TEMP:   slot = &temp;   value = commands[i].value; break;
+            default: break;
+        }
+        if (slot == nullptr || *slot != -1) result.skipped++;
+        if (slot != nullptr) *slot = value;
+    }
 
+    // The heater switches the filter on by itself
+    if (heater == 1 && filter == 0) {
+        filter = -1;
+        result.skipped++;
+    }
+
+    auto toggle = [&](const char* feature, uint8_t current, int want, bool (PureSpaIO::*set)(bool)) {
+        if (want < 0) return;
+        if (current != (uint8_t)want) {
+            logAudit(source, feature, want == 1);
+        }
+        if ((_io.*set)(want == 1)) result.executed++; else result.failed++;
+    };
+
+    int features = (filter >= 0) + (heater >= 0) + (bubble >= 0) + (temp >= 0);
+    bool needsPowerOn = filter == 1 || heater == 1 || bubble == 1 || temp >= 0;
+    bool isOn = _io.isPowerOn() == true;
+
+    if (power == 0) {
+        // Everything goes off with the power anyway
+        result.skipped += features;
+        toggle("Power", _io.isPowerOn(), 0, &PureSpaIO::setPowerOn);
+    } else {
+        if (power == 1 || (needsPowerOn && !isOn)) {
+            if (!isOn) ESP_LOGI(TAG, "Auto powering ON for %s", source);
+            toggle("Power", _io.isPowerOn(), 1, &PureSpaIO::setPowerOn);
+            isOn = _io.isPowerOn() == true;
+        }
+
+        if (isOn) {
+            if (filter == 1) toggle("Filter", _io.isFilterOn(), filter, &PureSpaIO::setFilterOn);
+            toggle("Heater", _io.isHeaterOn(), heater, &PureSpaIO::setHeaterOn);
+            toggle("Bubbles", _io.isBubbleOn(), bubble, &PureSpaIO::setBubbleOn);
+            if (filter == 0) toggle("Filter", _io.isFilterOn(), filter, &PureSpaIO::setFilterOn);
+            if (temp >= 0) {
+                if (_io.setDesiredWaterTempCelsius(temp)) result.executed++; else result.failed++;
+            }
+        } else {
+            ESP_LOGI(TAG, "Skipping feature commands as Power is OFF and no 'ON' trigger was present");
+            result.skipped += features;
+        }
+    }
+
+    result.durationMs = (esp_timer_get_time() - start) / 1000;
+    ESP_LOGI(TAG, "Batch from %s done in %lu ms: %d executed, %d failed, %d skipped", source,
+             (unsigned long)result.durationMs, result.executed, result.failed, result.skipped);
+}
+
+bool PureSpaService::StatusSnapshot::operator==(const StatusSnapshot& o) const {
+    return online == o.online && actTemp == o.actTemp && setTemp == o.setTemp &&
+           power == o.power && filter == o.filter && heater == o.heater && bubble == o.bubble &&
+           heaterStandby == o.heaterStandby && jet == o.jet && disinfection == o.disinfection &&
+           strcmp(error, o.error) == 0 &&
+           otaActive == o.otaActive && otaReceived == o.otaReceived &&
+           otaWritten == o.otaWritten && otaTotal == o.otaTotal;
+}
+
+void PureSpaService::refreshStatus(bool force) {
+    std::unique_lock<std::mutex> lock(_statusMutex, std::defer_lock);
+    if (force) {
+        lock.lock();
+    } else if (!lock.try_lock()) {
+        return; // A client is still being served from the cache, retry on the next loop
+    }
+
+    StatusSnapshot next = _status;
+    next.online = _io.isOnline();
+    next.actTemp = _io.getActWaterTempCelsius();
+    next.setTemp = _io.getDesiredWaterTempCelsius();
+    next.power = _io.isPowerOn();
+    next.filter = _io.isFilterOn();
+    next.heater = _io.isHeaterOn();
+    next.bubble = _io.isBubbleOn();
+    next.heaterStandby = _io.isHeaterStandby();
+    next.jet = _io.isJetOn();
+    next.disinfection = _io.isDisinfectionOn();
+    snprintf(next.error, sizeof(next.error), "%s", _io.getErrorCode().c_str());
+
+    OtaUpdater::Progress ota = OtaUpdater::getInstance().getProgress();
+    next.otaActive = ota.active;
+    next.otaReceived = ota.received;
+    next.otaWritten = ota.written;
+    next.otaTotal = ota.total;
+
+    int64_t now = esp_timer_get_time();
+    bool sampled = force || now - _lastMetricsSample >= STATUS_METRICS_PERIOD;
+    if (sampled) {
+        sampleMetrics(next);
+        _lastMetricsSample = now;
+    }
+
+    // Fresh metrics are rendered into the cache but keep the version, so
+    // pollers and long-polls only wake up for spa or update changes
+    bool changed = force || !(next == _status);
+    if (!changed && !sampled) return;
+
+    _status = next;
+    if (changed) _statusVersion++;
+    _statusRenders++;
+    renderStatus();
+    if (changed) _statusCond.notify_all();
+    if (_statusListener) _statusListener(_statusListenerCtx, _status);
+}
+
+void PureSpaService::setStatusListener(StatusListener listener, void* ctx) {
+    std::lock_guard<std::mutex> lock(_statusMutex);
+    _statusListener = listener;
+    _statusListenerCtx = ctx;
+    // Replay the current state so the listener starts from a known snapshot
+    if (_statusListener) _statusListener(_statusListenerCtx, _status);
+}
+
+void PureSpaService::sampleMetrics(StatusSnapshot& snapshot) {
     // Add current time for UI
     time_t now;
     struct tm timeinfo;
     time(&now);
     localtime_r(&now, &timeinfo);
     if (timeinfo.tm_year > (2020 - 1900)) {
-        char strftime_buf[64];
-        strftime(strftime_buf, sizeof(strftime_buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
-        cJSON_AddStringToObject(root, "time", strftime_buf);
+        strftime(snapshot.time, sizeof(snapshot.time), "%Y-%m-%d %H:%M:%S", &timeinfo);
     } else {
-        cJSON_AddStringToObject(root, "time", "Not set");
+        snprintf(snapshot.time, sizeof(snapshot.time), "Not set");
     }
 
     // System diagnostics
-    cJSON_AddNumberToObject(root, "free_heap", esp_get_free_heap_size());
-    cJSON_AddNumberToObject(root, "min_free_heap", esp_get_minimum_free_heap_size());
-    cJSON_AddNumberToObject(root, "uptime", esp_timer_get_time() / 1000000);
-    
-    int rssi = -127;
+    snapshot.freeHeap = esp_get_free_heap_size();
+    snapshot.minFreeHeap = esp_get_minimum_free_heap_size();
+    snapshot.uptime = esp_timer_get_time() / 1000000;
+
+    snapshot.rssi = -127;
     wifi_ap_record_t ap_info;
     if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
-        rssi = ap_info.rssi;
+        snapshot.rssi = ap_info.rssi;
     }
-    cJSON_AddNumberToObject(root, "wifi_rssi", rssi);
-    
-    char *json_str = cJSON_PrintUnformatted(root);
-    std::string result = json_str ? json_str : "{}";
-    
-    if (json_str) free(json_str);
-    cJSON_Delete(root);
-    
-    return result;
 }
 
-std::string PureSpaService::getScheduleJson() {
-    std::lock_guard<std::recursive_mutex> lock(_eventsMutex);
-    cJSON *root = cJSON_CreateArray();
-    for (const auto& ev : _events) {
-        cJSON *item = cJSON_CreateObject();
-        cJSON_AddNumberToObject(item, "id", ev.id);
-        cJSON_AddBoolToObject(item, "enabled", ev.enabled);
-        cJSON_AddBoolToObject(item, "recurring", ev.recurring);
-        cJSON_AddNumberToObject(item, "dow", ev.dayOfWeekMask);
-        cJSON_AddNumberToObject(item, "year", ev.year);
-        cJSON_AddNumberToObject(item, "month", ev.month);
-        cJSON_AddNumberToObject(item, "day", ev.day);
-        cJSON_AddNumberToObject(item, "hour", ev.hour);
-        cJSON_AddNumberToObject(item, "minute", ev.minute);
-        
-        cJSON_AddBoolToObject(item, "setPower", ev.setPower);
-        cJSON_AddBoolToObject(item, "powerValue", ev.powerValue);
-        cJSON_AddBoolToObject(item, "setFilter", ev.setFilter);
-        cJSON_AddBoolToObject(item, "filterValue", ev.filterValue);
-        cJSON_AddBoolToObject(item, "setHeater", ev.setHeater);
-        cJSON_AddBoolToObject(item, "heaterValue", ev.heaterValue);
-        cJSON_AddBoolToObject(item, "setBubble", ev.setBubble);
-        cJSON_AddBoolToObject(item, "bubbleValue", ev.bubbleValue);
-        cJSON_AddBoolToObject(item, "setTemp", ev.setTargetTemp);
-        cJSON_AddNumberToObject(item, "tempValue", ev.targetTempValue);
-        
-        cJSON_AddItemToArray(root, item);
-    }
-    char *json_str = cJSON_PrintUnformatted(root);
-    std::string result = json_str ? json_str : "[]";
-    if (json_str) free(json_str);
-    cJSON_Delete(root);
-    return result;
+// Accumulates an interval into a window: counters add up, the last* values
+// come from the newer interval when it saw the event
+static void mergeSignalStats(PureSpaIO::SignalStats& into, const PureSpaIO::SignalStats& s) {
+    into.cycles += s.cycles;
+    into.cyclePeriods += s.cyclePeriods;
+    into.cyclePeriodSumUs += s.cyclePeriodSumUs;
+    if (s.cyclePeriods && (!into.cyclePeriodMinUs || s.cyclePeriodMinUs < into.cyclePeriodMinUs)) into.cyclePeriodMinUs = s.cyclePeriodMinUs;
+    if (s.cyclePeriodMaxUs > into.cyclePeriodMaxUs) into.cyclePeriodMaxUs = s.cyclePeriodMaxUs;
+    into.cyclePeriodOutOfRange += s.cyclePeriodOutOfRange;
+    into.frameGaps += s.frameGaps;
+    into.frameGapSumUs += s.frameGapSumUs;
+    if (s.frameGaps && (!into.frameGapMinUs || s.frameGapMinUs < into.frameGapMinUs)) into.frameGapMinUs = s.frameGapMinUs;
+    if (s.frameGapMaxUs > into.frameGapMaxUs) into.frameGapMaxUs = s.frameGapMaxUs;
+    into.syncLoss += s.syncLoss;
+    into.bitCountErrors += s.bitCountErrors;
+    into.unknownSegments += s.unknownSegments;
+    into.ledConfirmResets += s.ledConfirmResets;
+    if (s.isrCalls && (!into.isrCalls || s.isrCyclesMin < into.isrCyclesMin)) into.isrCyclesMin = s.isrCyclesMin;
+    if (s.isrCalls && (!into.isrCalls || s.isrSpacingMin < into.isrSpacingMin)) into.isrSpacingMin = s.isrSpacingMin;
+    if (s.isrCyclesMax > into.isrCyclesMax) into.isrCyclesMax = s.isrCyclesMax;
+    into.isrCalls += s.isrCalls;
+    into.isrCyclesSum += s.isrCyclesSum;
+    for (unsigned int i = 0; i < PureSpaIO::ISR_CYCLE_BUCKETS; i++) {
+        into.isrCycleBuckets[i] += s.isrCycleBuckets[i];
+    }
+    if (s.cyclePeriods) into.lastFramesPerCycle = s.lastFramesPerCycle;
+    if (s.bitCountErrors) into.lastBitCount = s.lastBitCount;
+    if (s.unknownSegments) into.lastUnknownSegments = s.lastUnknownSegments;
+}
+
+// Closes the current signal stats interval every BUS_SLOT_PERIOD. A slot can
+// run longer while a command blocks the loop, its length is kept with it.
+void PureSpaService::sampleBusStats() {
+    int64_t now = esp_timer_get_time();
+    if (_lastBusSample == 0) {
+        _lastBusSample = now;
+        return;
+    }
+    if (now - _lastBusSample < BUS_SLOT_PERIOD) return;
+
+    PureSpaIO::SignalStats slot = _io.takeSignalStats();
+    std::lock_guard<std::mutex> lock(_busMutex);
+    _busSlots[_busSlotNext] = slot;
+    _busSlotMs[_busSlotNext] = (uint32_t)((now - _lastBusSample) / 1000);
+    _busSlotNext = (_busSlotNext + 1) % BUS_SLOTS;
+    if (_busSlotCount < BUS_SLOTS) _busSlotCount++;
+    mergeSignalStats(_busTotal, slot);
+    _lastBusSample = now;
+
+    if (slot.syncLoss || slot.bitCountErrors || slot.unknownSegments) {
+        ESP_LOGD(TAG, "Bus quality: %lu sync loss, %lu bit count errors, %lu unknown segments in %lu cycles",
+                 (unsigned long)slot.syncLoss, (unsigned long)slot.bitCountErrors,
+                 (unsigned long)slot.unknownSegments, (unsigned long)slot.cycles);
+    }
+}
+
+static void writeSignalStats(DocWriter& w, const PureSpaIO::SignalStats& s) {
+    w.field("cycles", (unsigned long)s.cycles);
+    w.beginObject("cyclePeriodUs")
+        .field("min", (unsigned long)(s.cyclePeriods ? s.cyclePeriodMinUs : 0))
+        .field("avg", (unsigned long)(s.cyclePeriods ? s.cyclePeriodSumUs / s.cyclePeriods : 0))
+        .field("max", (unsigned long)s.cyclePeriodMaxUs)
+        .field("outOfRange", (unsigned long)s.cyclePeriodOutOfRange)
+        .endObject();
+    w.beginObject("frameGapUs")
+        .field("min", (unsigned long)(s.frameGaps ? s.frameGapMinUs : 0))
+        .field("avg", (unsigned long)(s.frameGaps ? s.frameGapSumUs / s.frameGaps : 0))
+        .field("max", (unsigned long)s.frameGapMaxUs)
+        .endObject();
+    w.field("syncLoss", (unsigned long)s.syncLoss);
+    w.field("bitCountErrors", (unsigned long)s.bitCountErrors);
+    w.field("unknownSegments", (unsigned long)s.unknownSegments);
+    w.field("ledConfirmResets", (unsigned long)s.ledConfirmResets);
+    w.field("lastFramesPerCycle", (unsigned int)s.lastFramesPerCycle);
+    w.field("lastBitCount", (unsigned int)s.lastBitCount);
+    w.field("lastUnknownSegments", (unsigned int)s.lastUnknownSegments);
+    w.beginObject("isr");
+    w.field("calls", (unsigned long)s.isrCalls);
+    w.beginObject("cycles")
+        .field("min", (unsigned long)(s.isrCalls ? s.isrCyclesMin : 0))
+        .field("avg", (unsigned long)(s.isrCalls ? s.isrCyclesSum / s.isrCalls : 0))
+        .field("max", (unsigned long)s.isrCyclesMax)
+        .endObject();
+    w.field("minSpacingCycles", (unsigned long)(s.isrCalls > 1 ? s.isrSpacingMin : 0));
+    // Worst case left between two clock edges, negative means edges were missed
+    if (s.isrCalls > 1) {
+        w.field("headroomCycles", (long long)s.isrSpacingMin - (long long)s.isrCyclesMax);
+    }
+    // Bucket upper bounds in cycles, the last one is open ended
+    w.beginArray("histogram");
+    for (unsigned int i = 0; i < PureSpaIO::ISR_CYCLE_BUCKETS; i++) {
+        w.beginObject();
+        if (i + 1 < PureSpaIO::ISR_CYCLE_BUCKETS) {
+            w.field("lt", (unsigned long)(PureSpaIO::ISR_CYCLES_FIRST_BUCKET << i));
+        }
+        w.field("count", (unsigned long)s.isrCycleBuckets[i]);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+}
+
+void PureSpaService::writeBusStats(DocWriter& w) {
+    PureSpaIO::SignalStats window = {};
+    PureSpaIO::SignalStats total;
+    PureSpaIO::SignalStats slots[BUS_SLOTS];
+    uint32_t slotMs[BUS_SLOTS];
+    uint32_t windowMs = 0;
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(_busMutex);
+        count = _busSlotCount;
+        // Oldest first
+        for (size_t i = 0; i < count; i++) {
+            size_t index = (_busSlotNext + BUS_SLOTS - count + i) % BUS_SLOTS;
+            slots[i] = _busSlots[index];
+            slotMs[i] = _busSlotMs[index];
+            mergeSignalStats(window, slots[i]);
+            windowMs += slotMs[i];
+        }
+        total = _busTotal;
+    }
+
+    uint32_t cpuMhz = esp_rom_get_cpu_ticks_per_us();
+    unsigned int edgesPerSecond = PureSpaIO::getExpectedClockEdgesPerSecond();
+
+    w.beginObject();
+    w.field("spa", (int)getIndex());
+    w.field("online", _io.isOnline());
+    w.field("backend", _io.getBusBackendName());
+    w.beginObject("expected")
+        .field("cyclePeriodUs", PureSpaIO::getExpectedCyclePeriodUs())
+        .field("framesPerCycle", PureSpaIO::getExpectedFramesPerCycle())
+        .field("clockEdgesPerSecond", edgesPerSecond)
+        .field("cpuMhz", (unsigned long)cpuMhz)
+        .field("isrBudgetCycles", (unsigned long)(cpuMhz * 1000000ULL / edgesPerSecond))
+        .endObject();
+    w.beginObject("window");
+    w.field("ms", (unsigned long)windowMs);
+    writeSignalStats(w, window);
+    // Share of one core spent in the clock ISR body
+    if (windowMs) {
+        w.field("isrLoadPermille", (unsigned long)(window.isrCyclesSum / ((uint64_t)windowMs * cpuMhz)));
+    }
+    w.endObject();
+    w.beginObject("total");
+    writeSignalStats(w, total);
+    w.endObject();
+    // Error counts per slot to see whether a problem is ongoing
+    w.beginArray("slots");
+    for (size_t i = 0; i < count; i++) {
+        w.beginObject()
+            .field("ms", (unsigned long)slotMs[i])
+            .field("cycles", (unsigned long)slots[i].cycles)
+            .field("syncLoss", (unsigned long)slots[i].syncLoss)
+            .field("bitCountErrors", (unsigned long)slots[i].bitCountErrors)
+            .field("unknownSegments", (unsigned long)slots[i].unknownSegments)
+            .field("ledConfirmResets", (unsigned long)slots[i].ledConfirmResets)
+            .endObject();
+    }
+    w.endArray();
+    w.endObject();
+}
+
+void PureSpaService::renderStatus() {
+    Metrics::ProfileScope profile(Metrics::PROFILE_STATUS_RENDER);
+    // Both encodings are rendered once per change so requests never serialize
+    JsonWriter json(_statusJson, sizeof(_statusJson));
+    writeStatus(json);
+    if (json.finish() != ESP_OK) {
+        ESP_LOGE(TAG, "Status JSON does not fit %d bytes", (int)sizeof(_statusJson));
+        strcpy(_statusJson, "{}");
+    }
+    _statusJsonLen = strlen(_statusJson);
+
+    CborWriter cbor(_statusCbor, sizeof(_statusCbor));
+    writeStatus(cbor);
+    if (cbor.finish() != ESP_OK) {
+        ESP_LOGE(TAG, "Status CBOR does not fit %d bytes", (int)sizeof(_statusCbor));
+        _statusCbor[0] = (char)0xA0;
+        _statusCborLen = 1;
+    } else {
+        _statusCborLen = cbor.length();
+    }
+    profile.setUnits(_statusJsonLen + _statusCborLen);
+}
+
+void PureSpaService::writeStatus(DocWriter& w) {
+    const StatusSnapshot& s = _status;
+    w.beginObject()
+        .field("spa", (int)getIndex())
+        .field("online", s.online)
+        .field("act_temp", s.actTemp)
+        .field("set_temp", s.setTemp)
+        // Not decoded yet (UNDEF) reads as off rather than as a truthy 255
+        .field("power", s.power == 1)
+        .field("filter", s.filter == 1)
+        .field("heater", s.heater == 1)
+        .field("bubble", s.bubble == 1)
+        .field("time", s.time)
+        .field("free_heap", s.freeHeap)
+        .field("min_free_heap", s.minFreeHeap)
+        .field("uptime", s.uptime)
+        .field("wifi_rssi", s.rssi)
+        .field("version", _statusVersion);
+    if (s.otaActive) {
+        w.beginObject("ota")
+            .field("received", s.otaReceived)
+            .field("written", s.otaWritten)
+            .field("total", s.otaTotal)
+            .endObject();
+    }
+    w.endObject();
+}
+
+PureSpaService::Capabilities PureSpaService::getCapabilities() const {
+    // Jets and the disinfection timer only exist on the SJB-HS
+    bool sjbhs = _io.getModel() == PureSpaIO::MODEL::SJBHS;
+    Capabilities caps;
+    caps.modelName = _io.getModelName();
+    caps.jet = sjbhs;
+    caps.disinfection = sjbhs;
+    caps.minTemp = PureSpaIO::WATER_TEMP::SET_MIN;
+    caps.maxTemp = PureSpaIO::WATER_TEMP::SET_MAX;
+    return caps;
+}
+
+size_t PureSpaService::getQueueDepth() const {
+    return _cmdQueue != nullptr ? uxQueueMessagesWaiting(_cmdQueue) : 0;
+}
+
+uint32_t PureSpaService::getStatusVersion() {
+    std::lock_guard<std::mutex> lock(_statusMutex);
+    return _statusVersion;
+}
+
+bool PureSpaService::waitForStatusChange(uint32_t sinceVersion, uint32_t timeoutMs) {
+    std::unique_lock<std::mutex> lock(_statusMutex);
+    return _statusCond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+        return _statusVersion != sinceVersion;
+    });
+}
+
+void PureSpaService::writeSchedule(DocWriter& w, const char* key) {
+    // Streaming writers flush to their sink in here, so a slow client shows up
+    Metrics::ProfileScope profile(Metrics::PROFILE_SCHEDULE_WRITE);
+    // Copy out so a slow client does not hold the schedule lock while streaming
+    ScheduledEvent events[MAX_EVENTS];
+    size_t count = 0;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_eventsMutex);
+        for (const auto& ev : _events) {
+            if (count == MAX_EVENTS) break;
+            events[count++] = ev;
+        }
+    }
+
+    w.beginArray(key);
+    for (size_t i = 0; i < count; i++) {
+        w.beginObject();
+        writeFields(w, SCHEDULED_EVENT_FIELDS, SCHEDULED_EVENT_FIELD_COUNT, &events[i]);
+        w.endObject();
+    }
+    w.endArray();
+    profile.setUnits(count);
+}
+
+bool PureSpaService::isValidEvent(const ScheduledEvent& event) {
+    if (event.hour < 0 || event.hour > 23 || event.minute < 0 || event.minute > 59) return false;
+    if (event.recurring) {
+        if (event.dayOfWeekMask & ~0x7F) return false;
+    } else if (event.year < 2020 || event.year > 2099 || event.month < 1 || event.month > 12 ||
+               event.day < 1 || event.day > 31) {
+        return false;
+    }
+    if (event.setTargetTemp && (event.targetTempValue < PureSpaIO::WATER_TEMP::SET_MIN ||
+                                event.targetTempValue > PureSpaIO::WATER_TEMP::SET_MAX)) {
+        return false;
+    }
+    return true;
 }
 
 void PureSpaService::addEvent(const ScheduledEvent& event) {
     std::lock_guard<std::recursive_mutex> lock(_eventsMutex);
-    if (_events.size() >= 10) {
-        ESP_LOGW(TAG, "Maximum number of events (10) reached. Cannot add more.");
+    if (_events.size() >= MAX_EVENTS) {
+        ESP_LOGW(TAG, "Maximum number of events (%d) reached. Cannot add more.", (int)MAX_EVENTS);
         return;
     }
     ScheduledEvent newEvent = event;
@@ -322,6 +837,7 @@ void PureSpaService::clearSchedule() {
         nvs_set_i32(nvs_handle, "next_id", _nextEventId);
         nvs_commit(nvs_handle);
         nvs_close(nvs_handle);
+        Metrics::getInstance().countNvsCommit(SCHEDULE_NAMESPACE);
         ESP_LOGI(TAG, "Schedule erased from NVS");
     } else {
         ESP_LOGE(TAG, "Error opening NVS for clearing schedule: %s", esp_err_to_name(err));
@@ -330,7 +846,11 @@ void PureSpaService::clearSchedule() {
 
 void PureSpaService::saveSchedule() {
     ESP_LOGI(TAG, "Saving schedule to NVS...");
-    std::string json = getScheduleJson();
+    std::string json;
+    char chunk[128];
+    JsonWriter w(chunk, sizeof(chunk), JsonWriter::stringSink, &json);
+    writeSchedule(w);
+    w.finish();
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(SCHEDULE_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err == ESP_OK) {
@@ -338,6 +858,7 @@ void PureSpaService::saveSchedule() {
         nvs_set_i32(nvs_handle, "next_id", _nextEventId);
         nvs_commit(nvs_handle);
         nvs_close(nvs_handle);
+        Metrics::getInstance().countNvsCommit(SCHEDULE_NAMESPACE);
         ESP_LOGI(TAG, "Schedule saved successfully (%d bytes)", (int)json.length());
     } else {
         ESP_LOGE(TAG, "Error opening NVS for saving: %s", esp_err_to_name(err));
@@ -348,51 +869,160 @@ void PureSpaService::loadSchedule() {
     ESP_LOGI(TAG, "Loading schedule from NVS...");
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(SCHEDULE_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err == ESP_OK) {
-        size_t required_size;
-        nvs_get_str(nvs_handle, SCHEDULE_KEY, NULL, &required_size);
-        char* json_buf = (char*)malloc(required_size);
-        nvs_get_str(nvs_handle, SCHEDULE_KEY, json_buf, &required_size);
-        nvs_get_i32(nvs_handle, "next_id", &_nextEventId);
-        nvs_close(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGI(TAG, "No schedule found in NVS (or first boot)");
+        return;
+    }
+
+    size_t required_size = 0;
+    char* json_buf = NULL;
+    err = nvs_get_str(nvs_handle, SCHEDULE_KEY, NULL, &required_size);
+    if (err == ESP_OK && required_size > 0) {
+        json_buf = (char*)malloc(required_size);
+        if (json_buf) err = nvs_get_str(nvs_handle, SCHEDULE_KEY, json_buf, &required_size);
+    }
+    nvs_get_i32(nvs_handle, "next_id", &_nextEventId);
+    nvs_close(nvs_handle);
+    if (_nextEventId < 1 || _nextEventId > MAX_EVENT_ID) _nextEventId = 1;
 
-        cJSON *root = cJSON_Parse(json_buf);
-        if (root && cJSON_IsArray(root)) {
-            _events.clear();
-            int n = cJSON_GetArraySize(root);
-            for (int i = 0; i < n; i++) {
-                cJSON *item = cJSON_GetArrayItem(root, i);
-                ScheduledEvent ev;
-                ev.id = cJSON_GetObjectItem(item, "id")->valueint;
-                ev.enabled = cJSON_IsTrue(cJSON_GetObjectItem(item, "enabled"));
-                ev.recurring = cJSON_IsTrue(cJSON_GetObjectItem(item, "recurring"));
-                ev.dayOfWeekMask = cJSON_GetObjectItem(item, "dow")->valueint;
-                ev.year = cJSON_GetObjectItem(item, "year")->valueint;
-                ev.month = cJSON_GetObjectItem(item, "month")->valueint;
-                ev.day = cJSON_GetObjectItem(item, "day")->valueint;
-                ev.hour = cJSON_GetObjectItem(item, "hour")->valueint;
-                ev.minute = cJSON_GetObjectItem(item, "minute")->valueint;
-                
-                ev.setPower = cJSON_IsTrue(cJSON_GetObjectItem(item, "setPower"));
-                ev.powerValue = cJSON_IsTrue(cJSON_GetObjectItem(item, "powerValue"));
-                ev.setFilter = cJSON_IsTrue(cJSON_GetObjectItem(item, "setFilter"));
-                ev.filterValue = cJSON_IsTrue(cJSON_GetObjectItem(item, "filterValue"));
-                ev.setHeater = cJSON_IsTrue(cJSON_GetObjectItem(item, "setHeater"));
-                ev.heaterValue = cJSON_IsTrue(cJSON_GetObjectItem(item, "heaterValue"));
-                ev.setBubble = cJSON_IsTrue(cJSON_GetObjectItem(item, "setBubble"));
-                ev.bubbleValue = cJSON_IsTrue(cJSON_GetObjectItem(item, "bubbleValue"));
-                ev.setTargetTemp = cJSON_IsTrue(cJSON_GetObjectItem(item, "setTemp"));
-                ev.targetTempValue = cJSON_GetObjectItem(item, "tempValue")->valueint;
-                
-                _events.push_back(ev);
+    if (json_buf == NULL || err != ESP_OK) {
+        ESP_LOGI(TAG, "No schedule stored in NVS");
+        free(json_buf);
+        return;
+    }
+
+    std::vector<ScheduledEvent> loaded;
+    ScheduledEvent ev;
+    JsonFieldBinder binder(SCHEDULED_EVENT_FIELDS, SCHEDULED_EVENT_FIELD_COUNT, &ev, 2,
+        [](void* ctx, void* obj, uint32_t seen) {
+            auto* events = static_cast<std::vector<ScheduledEvent>*>(ctx);
+            const ScheduledEvent& event = *static_cast<ScheduledEvent*>(obj);
+            if (!isValidEvent(event) || event.id < 1 || event.id > MAX_EVENT_ID) {
+                ESP_LOGW(TAG, "Dropping invalid stored event ID %d", event.id);
+            } else if (events->size() < MAX_EVENTS) {
+                events->push_back(event);
             }
-            ESP_LOGI(TAG, "Loaded %d events from NVS. Next ID: %ld", n, (long)_nextEventId);
+            return true;
+        }, &loaded);
+    JsonReader reader(binder);
+    if (reader.feed(json_buf, strlen(json_buf)) == ESP_OK && reader.finish() == ESP_OK) {
+        std::lock_guard<std::recursive_mutex> lock(_eventsMutex);
+        _events.swap(loaded);
+        // A lost or stale next_id must not hand out an ID that is still in use
+        for (const auto& event : _events) {
+            if (event.id >= _nextEventId) _nextEventId = event.id + 1;
         }
-        if (root) cJSON_Delete(root);
-        free(json_buf);
+        ESP_LOGI(TAG, "Loaded %d events from NVS. Next ID: %ld", (int)_events.size(), (long)_nextEventId);
     } else {
-        ESP_LOGI(TAG, "No schedule found in NVS (or first boot)");
+        ESP_LOGE(TAG, "Stored schedule is not valid JSON, ignoring it");
+    }
+    free(json_buf);
+}
+
+std::vector<SpaScene> PureSpaService::getScenes() {
+    std::lock_guard<std::mutex> lock(_scenesMutex);
+    return _scenes;
+}
+
+bool PureSpaService::getScene(const char* name, SpaScene& scene) {
+    std::lock_guard<std::mutex> lock(_scenesMutex);
+    for (const auto& s : _scenes) {
+        if (strcmp(s.name, name) == 0) {
+            scene = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t PureSpaService::saveScene(const SpaScene& scene) {
+    std::lock_guard<std::mutex> lock(_scenesMutex);
+    for (auto& s : _scenes) {
+        if (strcmp(s.name, scene.name) == 0) {
+            s = scene;
+            ESP_LOGI(TAG, "Updated scene '%s' (%d commands)", scene.name, scene.count);
+            return storeScenes();
+        }
+    }
+    if (_scenes.size() >= MAX_SCENES) {
+        ESP_LOGW(TAG, "Maximum number of scenes (%d) reached. Cannot add more.", (int)MAX_SCENES);
+        return ESP_ERR_NO_MEM;
+    }
+    _scenes.push_back(scene);
+    ESP_LOGI(TAG, "Added scene '%s' (%d commands)", scene.name, scene.count);
+    return storeScenes();
+}
+
+bool PureSpaService::deleteScene(const char* name) {
+    std::lock_guard<std::mutex> lock(_scenesMutex);
+    size_t oldSize = _scenes.size();
+    _scenes.erase(std::remove_if(_scenes.begin(), _scenes.end(), [name](const SpaScene& s) {
+        return strcmp(s.name, name) == 0;
+    }), _scenes.end());
+    if (_scenes.size() == oldSize) {
+        ESP_LOGW(TAG, "Failed to delete scene '%s': Not found", name);
+        return false;
+    }
+    ESP_LOGI(TAG, "Deleted scene '%s'", name);
+    storeScenes();
+    return true;
+}
+
+esp_err_t PureSpaService::storeScenes() {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(SCENE_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error opening NVS for saving scenes: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (_scenes.empty()) {
+        err = nvs_erase_key(nvs_handle, SCENE_KEY);
+        if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+    } else {
+        err = nvs_set_blob(nvs_handle, SCENE_KEY, _scenes.data(), _scenes.size() * sizeof(SpaScene));
+    }
+    if (err == ESP_OK) err = nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    if (err == ESP_OK) Metrics::getInstance().countNvsCommit(SCENE_NAMESPACE);
+    if (err != ESP_OK) ESP_LOGE(TAG, "Error saving scenes: %s", esp_err_to_name(err));
+    return err;
+}
+
+void PureSpaService::loadScenes() {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SCENE_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) return;
+
+    SpaScene scenes[MAX_SCENES];
+    size_t size = sizeof(scenes);
+    esp_err_t err = nvs_get_blob(nvs_handle, SCENE_KEY, scenes, &size);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK || size % sizeof(SpaScene) != 0) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) ESP_LOGE(TAG, "Stored scenes are invalid, ignoring them");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_scenesMutex);
+    _scenes.clear();
+    for (size_t i = 0; i < size / sizeof(SpaScene); i++) {
+        SpaScene& scene = scenes[i];
+        scene.name[SpaScene::MAX_NAME] = '\0';
+        if (scene.count > SpaScene::MAX_COMMANDS) continue;
+        bool valid = true;
+        for (size_t c = 0; c < scene.count; c++) {
+            const SpaBatchCommand& cmd = scene.commands[c];
+            if (cmd.cmd == SpaCommand::SET_TEMP) {
+                valid = valid && cmd.value >= PureSpaIO::WATER_TEMP::SET_MIN && cmd.value <= PureSpaIO::WATER_TEMP::SET_MAX;
+            } else {
+                valid = valid && cmd.cmd >= SpaCommand::POWER_ON && cmd.cmd < SpaCommand::SET_TEMP;
+            }
+        }
+        if (!valid) {
+            ESP_LOGW(TAG, "Dropping stored scene with invalid commands");
+            continue;
+        }
+        _scenes.push_back(scene);
     }
+    ESP_LOGI(TAG, "Loaded %d scenes from NVS", (int)_scenes.size());
 }
 
 void PureSpaService::sendRequest(SpaCommand cmd, int value) {
@@ -400,7 +1030,7 @@ void PureSpaService::sendRequest(SpaCommand cmd, int value) {
         ESP_LOGE(TAG, "Cannot send request: queue is NULL");
         return;
     }
-    SpaRequest req = {cmd, value};
+    SpaRequest req = {cmd, value, nullptr, esp_timer_get_time()};
     ESP_LOGI(TAG, "Sending request %d to queue...", (int)cmd);
     if (xQueueSend(_cmdQueue, &req, pdMS_TO_TICKS(10)) != pdPASS) {
         ESP_LOGW(TAG, "Queue is FULL, could not send request %d", (int)cmd);
@@ -411,28 +1041,28 @@ void PureSpaService::sendRequest(SpaCommand cmd, int value) {
 
 void PureSpaService::setPower(bool on, const char* source) {
     if (_io.isPowerOn() != on) {
-        AuditLogger::getInstance().logEvent(source, "Power", on);
+        logAudit(source, "Power", on);
     }
     sendRequest(on ? SpaCommand::POWER_ON : SpaCommand::POWER_OFF);
 }
 
 void PureSpaService::setFilter(bool on, const char* source) {
     if (_io.isFilterOn() != on) {
-        AuditLogger::getInstance().logEvent(source, "Filter", on);
+        logAudit(source, "Filter", on);
     }
     sendRequest(on ? SpaCommand::FILTER_ON : SpaCommand::FILTER_OFF);
 }
 
 void PureSpaService::setBubble(bool on, const char* source) {
     if (_io.isBubbleOn() != on) {
-        AuditLogger::getInstance().logEvent(source, "Bubbles", on);
+        logAudit(source, "Bubbles", on);
     }
     sendRequest(on ? SpaCommand::BUBBLE_ON : SpaCommand::BUBBLE_OFF);
 }
 
 void PureSpaService::setHeater(bool on, const char* source) {
     if (_io.isHeaterOn() != on) {
-        AuditLogger::getInstance().logEvent(source, "Heater", on);
+        logAudit(source, "Heater", on);
     }
     sendRequest(on ? SpaCommand::HEATER_ON : SpaCommand::HEATER_OFF);
 }
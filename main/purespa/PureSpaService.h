@@ -2,8 +2,11 @@
 #define PURE_SPA_SERVICE_H
 
 #include "PureSpaIO.h"
+#include "doc_writer.h"
+#include "json_fields.h"
 #include <string>
 #include <mutex>
+#include <condition_variable>
 #include <vector>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
@@ -14,12 +17,41 @@ enum class SpaCommand {
     FILTER_ON, FILTER_OFF,
     BUBBLE_ON, BUBBLE_OFF,
     HEATER_ON, HEATER_OFF,
-    SET_TEMP
+    SET_TEMP,
+    BATCH
 };
 
+struct SpaBatchJob;
+
 struct SpaRequest {
     SpaCommand cmd;
     int value;
+    SpaBatchJob* batch; // only for SpaCommand::BATCH
+    int64_t queuedAt;   // [us] for the command latency metrics
+};
+
+// One step of a batch; value is only used by SET_TEMP
+struct SpaBatchCommand {
+    SpaCommand cmd;
+    int value;
+};
+
+// Aggregated completion status of a batch
+struct SpaBatchResult {
+    uint8_t executed;    // steps acknowledged by the spa (or already in the wanted state)
+    uint8_t failed;      // steps the spa did not acknowledge
+    uint8_t skipped;     // steps dropped by dependency resolution
+    uint32_t durationMs;
+};
+
+// Named command list stored in NVS
+struct SpaScene {
+    static const size_t MAX_NAME = 15;
+    static const size_t MAX_COMMANDS = 8;
+
+    char name[MAX_NAME + 1];
+    uint8_t count;
+    SpaBatchCommand commands[MAX_COMMANDS];
 };
 
 struct ScheduledEvent {
@@ -43,27 +75,130 @@ struct ScheduledEvent {
     int targetTempValue;
 };
 
+// JSON keys of ScheduledEvent, shared by the API handlers and the NVS copy
+extern const JsonField SCHEDULED_EVENT_FIELDS[];
+extern const size_t SCHEDULED_EVENT_FIELD_COUNT;
+
 class PureSpaService {
 public:
-    static PureSpaService& getInstance() {
-        static PureSpaService instance;
-        return instance;
-    }
+    // One service per spa, each with its own decoder, command queue, task and
+    // status cache. Spa 0 is the default and also runs the schedule and scenes.
+    static const size_t MAX_SPAS = 2;
+    static PureSpaService& getInstance() { return slot(0); }
+    // Spa started with init(), nullptr for an index >= getSpaCount()
+    static PureSpaService* getInstance(size_t spa);
+    // Starts the next spa on bus, nullptr when MAX_SPAS are already running
+    static PureSpaService* addSpa(BusBackend& bus);
+    // Spas started with init(), the valid indexes for getInstance()
+    static size_t getSpaCount();
+    size_t getIndex() const;
 
     PureSpaService(const PureSpaService&) = delete;
     PureSpaService& operator=(const PureSpaService&) = delete;
 
-    void init();
-    std::string getStatusJson();
+    // Decodes the spa on bus, which must outlive the service
+    void init(BusBackend& bus);
+
+    // Cached status: re-rendered when the bus snapshot changes (new version) and
+    // when the system metrics are re-sampled (same version). The render count
+    // tells the two apart for validators; waiters only wake on a new version.
+    static const size_t STATUS_JSON_SIZE = 400;
+    static const size_t STATUS_CBOR_SIZE = 320;
+    uint32_t getStatusVersion();
+    bool waitForStatusChange(uint32_t sinceVersion, uint32_t timeoutMs);
+    template<typename F> void withStatusJson(F&& fn) {
+        std::lock_guard<std::mutex> lock(_statusMutex);
+        fn(_statusJson, _statusJsonLen, _statusVersion, _statusRenders);
+    }
+    template<typename F> void withStatusCbor(F&& fn) {
+        std::lock_guard<std::mutex> lock(_statusMutex);
+        fn(_statusCbor, _statusCborLen, _statusVersion, _statusRenders);
+    }
     
+    // Decoded spa state plus sampled system metrics behind the status cache.
+    // Bus values are PureSpaIO::UNDEF until the first frames are decoded.
+    struct StatusSnapshot {
+        bool online;
+        int actTemp;
+        int setTemp;
+        uint8_t power;
+        uint8_t filter;
+        uint8_t heater;
+        uint8_t bubble;
+        uint8_t heaterStandby;
+        uint8_t jet;
+        uint8_t disinfection;
+        char error[5];      // display error code, empty when none
+
+        // Sampled every STATUS_METRICS_PERIOD, left out of operator== so they
+        // never bump the status version
+        char time[20];
+        uint32_t freeHeap;
+        uint32_t minFreeHeap;
+        uint32_t uptime;
+        int rssi;
+
+        // Firmware update in progress
+        bool otaActive;
+        uint32_t otaReceived;
+        uint32_t otaWritten;
+        uint32_t otaTotal;
+
+        bool operator==(const StatusSnapshot& o) const;
+    };
+
+    // Called from the service task, with the status lock held, every time the
+    // snapshot changes. Must not block: it runs in the bus polling loop.
+    typedef void (*StatusListener)(void* ctx, const StatusSnapshot& status);
+    void setStatusListener(StatusListener listener, void* ctx);
+
+    // What the connected spa model supports, for clients adapting their controls
+    struct Capabilities {
+        const char* modelName;
+        bool jet;
+        bool disinfection;
+        int minTemp;
+        int maxTemp;
+    };
+    Capabilities getCapabilities() const;
+
+    // Bus and queue diagnostics for /metrics
+    PureSpaIO::BusCounters getBusCounters() const { return _io.getBusCounters(); }
+    unsigned int getDroppedFrames() const { return _io.getDroppedFrames(); }
+    size_t getQueueDepth() const;
+
+    // Bus signal quality over the last minute (BUS_SLOTS rolling slots of
+    // BUS_SLOT_PERIOD) and since boot, for /api/debug/bus
+    static const int64_t BUS_SLOT_PERIOD = 10000000; // [us]
+    static const size_t BUS_SLOTS = 6;
+    void writeBusStats(DocWriter& w);
+
     void setPower(bool on, const char* source = "Web UI");
     void setFilter(bool on, const char* source = "Web UI");
     void setBubble(bool on, const char* source = "Web UI");
     void setHeater(bool on, const char* source = "Web UI");
     void setTargetTemp(int temp);
 
+    // Runs the commands back to back in the service task and waits for the
+    // aggregated result. Power-on is added first when a command needs it.
+    // ESP_ERR_TIMEOUT: still running, ESP_ERR_NO_MEM: command queue full,
+    // ESP_ERR_INVALID_ARG: empty or more than MAX_BATCH_COMMANDS commands
+    static const size_t MAX_BATCH_COMMANDS = SpaScene::MAX_COMMANDS;
+    esp_err_t runBatch(const SpaBatchCommand* commands, size_t count, const char* source,
+                  uint32_t timeoutMs, SpaBatchResult& result);
+
+    // Scenes
+    static const size_t MAX_SCENES = 8;
+    std::vector<SpaScene> getScenes();
+    bool getScene(const char* name, SpaScene& scene);
+    esp_err_t saveScene(const SpaScene& scene);
+    bool deleteScene(const char* name);
+
     // Scheduling
-    std::string getScheduleJson();
+    static const size_t MAX_EVENTS = 10;
+    void writeSchedule(DocWriter& w, const char* key = nullptr);
+    // Time, date and set point within range; checked on every way in (API, NVS)
+    static bool isValidEvent(const ScheduledEvent& event);
     void addEvent(const ScheduledEvent& event);
     void updateEvent(int id, const ScheduledEvent& event);
     void deleteEvent(int id);
@@ -73,9 +208,16 @@ public:
     void saveSchedule();
 
 private:
-    PureSpaService() : _io(), _cmdQueue(nullptr), _nextEventId(1) {}
+    static const int64_t STATUS_METRICS_PERIOD = 5000000; // [us]
+
+    PureSpaService() : _io(), _bus(nullptr), _cmdQueue(nullptr), _nextEventId(1) {}
+    static PureSpaService& slot(size_t spa) {
+        static PureSpaService instances[MAX_SPAS];
+        return instances[spa];
+    }
     
     PureSpaIO _io;
+    BusBackend* _bus;
     QueueHandle_t _cmdQueue;
     
     std::vector<ScheduledEvent> _events;
@@ -83,11 +225,49 @@ private:
     int32_t _nextEventId;
     int _lastCheckedMinute = -1;
 
+    std::vector<SpaScene> _scenes;
+    std::mutex _scenesMutex;
+
+    std::mutex _statusMutex;
+    std::condition_variable _statusCond;
+    StatusSnapshot _status = {};
+    char _statusJson[STATUS_JSON_SIZE] = "{}";
+    size_t _statusJsonLen = 2;
+    char _statusCbor[STATUS_CBOR_SIZE] = { (char)0xA0 }; // empty map
+    size_t _statusCborLen = 1;
+    uint32_t _statusVersion = 0;
+    uint32_t _statusRenders = 0;
+    int64_t _lastMetricsSample = 0;
+    StatusListener _statusListener = nullptr;
+    void* _statusListenerCtx = nullptr;
+
+    std::mutex _busMutex;
+    PureSpaIO::SignalStats _busSlots[BUS_SLOTS] = {};
+    uint32_t _busSlotMs[BUS_SLOTS] = {};
+    size_t _busSlotNext = 0;
+    size_t _busSlotCount = 0;
+    PureSpaIO::SignalStats _busTotal = {};
+    int64_t _lastBusSample = 0;
+
     static void taskWrapper(void* param);
     void run();
     void sendRequest(SpaCommand cmd, int value = 0);
+    void logAudit(const char* source, const char* feature, bool on);
     void checkSchedule();
     void executeEvent(const ScheduledEvent& event);
+    void executeBatch(const SpaBatchCommand* commands, size_t count, const char* source, SpaBatchResult& result);
+    void loadScenes();
+    esp_err_t storeScenes();
+    void refreshStatus(bool force);
+    void sampleMetrics(StatusSnapshot& snapshot);
+    void sampleBusStats();
+    void renderStatus();
+    void writeStatus(DocWriter& w);
+
+    // host_test/bench.cpp times the schedule scan and the status rendering,
+    // the host_test/fuzz targets check the snapshot and the stored schedule
+    friend class ServiceBench;
+    friend class ServiceFuzz;
 };
 
 #endif // PURE_SPA_SERVICE_H
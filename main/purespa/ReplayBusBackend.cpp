@@ -0,0 +1,220 @@
+#include "ReplayBusBackend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "ReplayBusBackend";
+
+// At speed 0 the task still yields this often so lower priority tasks run
+static const unsigned int YIELD_FRAMES = 64;
+
+ReplayBusBackend::ReplayBusBackend(uint32_t framePeriodUs, unsigned int speed, bool loop)
+  : framePeriodUs(framePeriodUs), speed(speed), loop(loop)
+{
+}
+
+ReplayBusBackend::~ReplayBusBackend()
+{
+  stop();
+}
+
+bool ReplayBusBackend::load(const char* path)
+{
+  FILE* f = fopen(path, "r");
+  if (!f)
+  {
+    ESP_LOGE(TAG, "Cannot open %s", path);
+    return false;
+  }
+
+  std::vector<Frame> loaded;
+  char token[32];
+  bool ok = true;
+  while (fscanf(f, "%31s", token) == 1)
+  {
+    if (token[0] == '#')
+    {
+      int c;
+      while ((c = fgetc(f)) != EOF && c != '\n') {}
+      continue;
+    }
+
+    Frame frame;
+    char* end;
+    if (strcmp(token, "wait") == 0)
+    {
+      unsigned long ms;
+      if (fscanf(f, "%lu", &ms) != 1 || ms > UINT16_MAX)
+      {
+        ESP_LOGE(TAG, "%s: wait needs a duration in ms up to %u", path, UINT16_MAX);
+        ok = false;
+        break;
+      }
+      frame.value = ms;
+      frame.bits = 0;
+    }
+    else
+    {
+      unsigned long value = strtoul(token, &end, 16);
+      unsigned long bits = FRAME_BITS;
+      if (*end == '/')
+      {
+        bits = strtoul(end + 1, &end, 10);
+      }
+      if (end == token || *end || value > UINT16_MAX || bits == 0 || bits > FRAME_BITS)
+      {
+        ESP_LOGE(TAG, "%s: invalid frame '%s'", path, token);
+        ok = false;
+        break;
+      }
+      frame.value = value;
+      frame.bits = bits;
+    }
+    loaded.push_back(frame);
+  }
+  fclose(f);
+
+  if (!ok) return false;
+  if (taskAlive)
+  {
+    ESP_LOGE(TAG, "Cannot load %s while replaying", path);
+    return false;
+  }
+  frames.swap(loaded);
+  ESP_LOGI(TAG, "Loaded %u frames from %s", (unsigned int)frames.size(), path);
+  return true;
+}
+
+void ReplayBusBackend::setFrames(const Frame* frames, size_t count)
+{
+  if (taskAlive)
+  {
+    ESP_LOGE(TAG, "Cannot replace the stream while replaying");
+    return;
+  }
+  this->frames.assign(frames, frames + count);
+}
+
+const char* ReplayBusBackend::getName() const
+{
+  return "replay";
+}
+
+bool ReplayBusBackend::start(EdgeHandler handler, void* ctx)
+{
+  if (taskAlive || frames.empty())
+  {
+    ESP_LOGE(TAG, taskAlive ? "Already replaying" : "Nothing to replay");
+    return false;
+  }
+
+  this->handler = handler;
+  this->handlerCtx = ctx;
+  finished = false;
+  running = true;
+  taskAlive = true;
+  // Above the service task, like the interrupt it stands in for
+  if (xTaskCreate(taskWrapper, "bus_replay", 4096, this, 6, NULL) != pdPASS)
+  {
+    running = false;
+    taskAlive = false;
+    return false;
+  }
+  return true;
+}
+
+void ReplayBusBackend::stop()
+{
+  running = false;
+  while (taskAlive)
+  {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+void ReplayBusBackend::pullDataLow()
+{
+  acknowledgements++;
+}
+
+void ReplayBusBackend::taskWrapper(void* param)
+{
+  ReplayBusBackend* self = static_cast<ReplayBusBackend*>(param);
+  self->run();
+  self->taskAlive = false;
+  vTaskDelete(NULL);
+}
+
+void ReplayBusBackend::run()
+{
+  ESP_LOGI(TAG, "Replaying %u frames at speed %u%s", (unsigned int)frames.size(), speed, loop ? ", looped" : "");
+
+  int64_t start = esp_timer_get_time();
+  uint64_t streamUs = 0;  // position in the stream at speed 1
+  uint32_t delivered = 0;
+  unsigned int sinceYield = 0;
+  size_t index = 0;
+  while (running)
+  {
+    if (index == frames.size())
+    {
+      if (!loop)
+      {
+        finished = true;
+        // At speed 0 this is the decoder throughput, yields included
+        int64_t elapsedUs = esp_timer_get_time() - start;
+        ESP_LOGI(TAG, "Replay finished: %lu frames in %lld ms (%llu frames/s)",
+                 (unsigned long)delivered, (long long)(elapsedUs/1000),
+                 (unsigned long long)(elapsedUs > 0 ? delivered*1000000ULL/elapsedUs : 0));
+        break;
+      }
+      index = 0;
+    }
+
+    const Frame& frame = frames[index++];
+    if (frame.bits)
+    {
+      deliver(frame);
+      delivered++;
+      streamUs += framePeriodUs;
+    }
+    else
+    {
+      streamUs += frame.value*1000ULL;
+    }
+
+    if (speed)
+    {
+      // Frames go out in bursts of at least one tick
+      int64_t aheadUs = (int64_t)(streamUs/speed) - (esp_timer_get_time() - start);
+      if (aheadUs >= (int64_t)portTICK_PERIOD_MS*1000)
+      {
+        vTaskDelay(aheadUs/1000/portTICK_PERIOD_MS);
+      }
+    }
+    else if (++sinceYield == YIELD_FRAMES)
+    {
+      sinceYield = 0;
+      vTaskDelay(1);
+    }
+  }
+  running = false;
+}
+
+// Clocks the frame out MSB first with LATCH active. A cut frame gets one more
+// edge with LATCH released, which is how the decoder sees it on the bus.
+void ReplayBusBackend::deliver(const Frame& frame)
+{
+  for (unsigned int i = 0; i < frame.bits; i++)
+  {
+    handler(handlerCtx, (frame.value >> (FRAME_BITS - 1 - i)) & 1, true);
+  }
+  if (frame.bits < FRAME_BITS)
+  {
+    handler(handlerCtx, false, false);
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef REPLAY_BUS_BACKEND_H
+#define REPLAY_BUS_BACKEND_H
+
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+#include "BusBackend.h"
+
+// Plays a recorded or synthesized frame stream into the decoder from a task,
+// at the bus rate or faster. Used on the linux target, where there is no bus.
+//
+// Capture files are text, whitespace separated:
+//   0100       a 16 bit frame in hex, sent MSB first
+//   0100/9     the same frame cut after 9 bits (LATCH released early)
+//   wait 500   a pause of 500 ms, e.g. the bus going quiet
+//   # ...      a comment up to the end of the line
+// tools/gen_bus_capture.py synthesizes such streams.
+class ReplayBusBackend : public BusBackend
+{
+public:
+  struct Frame
+  {
+    uint16_t value;  // frame, or pause in ms when bits is 0
+    uint8_t bits;    // 16 for a complete frame
+  };
+
+  // framePeriodUs: time between two frames at speed 1. speed: 1 plays in
+  // real time, N is N times faster, 0 as fast as the decoder takes them.
+  ReplayBusBackend(uint32_t framePeriodUs, unsigned int speed = 1, bool loop = false);
+  ~ReplayBusBackend();
+
+  // Replaces the stream, only while stopped. Returns false on a parse error.
+  bool load(const char* path);
+  void setFrames(const Frame* frames, size_t count);
+  const std::vector<Frame>& getFrames() const { return frames; }
+
+  const char* getName() const override;
+  bool start(EdgeHandler handler, void* ctx) override;
+  void stop() override;
+  void pullDataLow() override;
+
+  // Button acknowledgements sent by the decoder
+  uint32_t getAcknowledgements() const { return acknowledgements; }
+  // True once a stream without loop played to its end
+  bool isFinished() const { return finished; }
+
+private:
+  static void taskWrapper(void* param);
+  void run();
+  void deliver(const Frame& frame);
+
+private:
+  static const unsigned int FRAME_BITS = 16;
+
+  std::vector<Frame> frames;
+  uint32_t framePeriodUs;
+  unsigned int speed;
+  bool loop;
+
+  EdgeHandler handler = nullptr;
+  void* handlerCtx = nullptr;
+  std::atomic<bool> running{false};   // cleared to stop the task
+  std::atomic<bool> taskAlive{false};
+  std::atomic<bool> finished{false};
+  std::atomic<uint32_t> acknowledgements{0};
+};
+
+#endif /* REPLAY_BUS_BACKEND_H */
@@ -0,0 +1,410 @@
+#include "SpaEmulator.h"
+#include "PureSpaFrames.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Polled in this order after the LED frames
+const uint16_t SpaEmulator::BUTTON_FRAMES[BUTTON_COUNT] = {
+  FRAME_BUTTON::FILTER, FRAME_BUTTON::BUBBLE, FRAME_BUTTON::TEMP_DOWN, FRAME_BUTTON::POWER,
+  FRAME_BUTTON::TEMP_UP, FRAME_BUTTON::TEMP_UNIT, FRAME_BUTTON::HEATER
+};
+
+static const unsigned int DISPLAY_GROUPS = 5;
+static const unsigned int LED_FRAMES = 4;
+static const uint16_t DIGIT_POS[4] = { FRAME_DIGIT::POS_1, FRAME_DIGIT::POS_2, FRAME_DIGIT::POS_3, FRAME_DIGIT::POS_4 };
+
+static_assert(1 + DISPLAY_GROUPS*4 + LED_FRAMES + 7 == SpaEmulator::CYCLE_FRAMES, "SB-H20 display cycle");
+
+static uint16_t segments(char c)
+{
+  switch (c)
+  {
+    case '0': return FRAME_DIGIT::NUM_0;
+    case '1': return FRAME_DIGIT::NUM_1;
+    case '2': return FRAME_DIGIT::NUM_2;
+    case '3': return FRAME_DIGIT::NUM_3;
+    case '4': return FRAME_DIGIT::NUM_4;
+    case '5': return FRAME_DIGIT::NUM_5;
+    case '6': return FRAME_DIGIT::NUM_6;
+    case '7': return FRAME_DIGIT::NUM_7;
+    case '8': return FRAME_DIGIT::NUM_8;
+    case '9': return FRAME_DIGIT::NUM_9;
+    case 'C': return FRAME_DIGIT::LET_C;
+    case 'D': return FRAME_DIGIT::LET_D;
+    case 'E': return FRAME_DIGIT::LET_E;
+    case 'F': return FRAME_DIGIT::LET_F;
+    case 'H': return FRAME_DIGIT::LET_H;
+    case 'N': return FRAME_DIGIT::LET_N;
+    default:  return FRAME_DIGIT::OFF;
+  }
+}
+
+SpaEmulator::SpaEmulator()
+{
+}
+
+void SpaEmulator::buildCycle(uint16_t frames[CYCLE_FRAMES])
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  char text[4];
+  displayText(text);
+
+  size_t n = 0;
+  frames[n++] = FRAME_TYPE::CUE;
+  for (unsigned int group = 0; group < DISPLAY_GROUPS; group++)
+  {
+    for (unsigned int i = 0; i < 4; i++)
+    {
+      frames[n++] = DIGIT_POS[i] | segments(text[i]);
+    }
+  }
+  uint16_t led = ledFrame();
+  for (unsigned int i = 0; i < LED_FRAMES; i++)
+  {
+    frames[n++] = led;
+  }
+  for (unsigned int i = 0; i < BUTTON_COUNT; i++)
+  {
+    frames[n++] = BUTTON_FRAMES[i];
+  }
+}
+
+void SpaEmulator::acknowledge(uint16_t frame)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (unsigned int i = 0; i < BUTTON_COUNT; i++)
+  {
+    if (BUTTON_FRAMES[i] == frame)
+    {
+      acked[i] = true;
+      return;
+    }
+  }
+}
+
+void SpaEmulator::endCycle()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // A press registers once per hold; the decoder lets go when it hears the beep
+  for (unsigned int i = 0; i < BUTTON_COUNT; i++)
+  {
+    if (acked[i])
+    {
+      held[i]++;
+      if (held[i] == pressCycles)
+      {
+        press((Button)i);
+      }
+    }
+    else
+    {
+      held[i] = 0;
+    }
+    acked[i] = false;
+  }
+
+  now += CYCLE_PERIOD_MS;
+  updateWater(CYCLE_PERIOD_MS);
+
+  if (power && filter && !flow && !error[0])
+  {
+    if (!noFlowSince)
+    {
+      noFlowSince = now;
+    }
+    else if (now - noFlowSince >= NO_FLOW_TRIP_MS)
+    {
+      setError("E90");
+    }
+  }
+  else
+  {
+    noFlowSince = 0;
+  }
+}
+
+void SpaEmulator::press(Button button)
+{
+  presses++;
+
+  // Only power clears an error, by switching the spa off
+  if (error[0])
+  {
+    if (button == POWER)
+    {
+      error[0] = 0;
+      power = filter = bubble = heater = heating = false;
+      beepUntil = now + BEEP_MS;
+    }
+    return;
+  }
+
+  if (button == POWER)
+  {
+    power = !power;
+    if (!power)
+    {
+      filter = bubble = heater = heating = false;
+      setpointShownUntil = 0;
+    }
+  }
+  else if (!power)
+  {
+    return;
+  }
+  else
+  {
+    switch (button)
+    {
+      case FILTER:
+        filter = !filter;
+        if (!filter)
+        {
+          heater = heating = false;
+        }
+        break;
+
+      case HEATER:
+        heater = !heater;
+        // The heater needs the pump
+        filter = filter || heater;
+        heating = heater && waterTemp < setpoint;
+        break;
+
+      case BUBBLE:
+        bubble = !bubble;
+        break;
+
+      case TEMP_UP:
+      case TEMP_DOWN:
+        // The first press only shows the set point
+        if (now < setpointShownUntil)
+        {
+          int step = button == TEMP_UP ? 1 : -1;
+          if (setpoint + step >= SETPOINT_MIN && setpoint + step <= SETPOINT_MAX)
+          {
+            setpoint += step;
+          }
+        }
+        setpointShownSince = now;
+        setpointShownUntil = now + SETPOINT_SHOWN_MS;
+        break;
+
+      default:
+        // Celsius only, the unit button is not emulated
+        return;
+    }
+  }
+
+  beepUntil = now + BEEP_MS;
+}
+
+void SpaEmulator::setError(const char* code)
+{
+  strncpy(error, code, sizeof(error) - 1);
+  error[sizeof(error) - 1] = 0;
+  if (error[0])
+  {
+    filter = bubble = heater = heating = false;
+    setpointShownUntil = 0;
+    beepUntil = now + BEEP_MS;
+  }
+}
+
+// Heats at heatingRate up to the set point, then idles in standby until the
+// water is a degree below it. Otherwise the water drifts towards ambient.
+void SpaEmulator::updateWater(unsigned int ms)
+{
+  if (!power || !heater || error[0])
+  {
+    heating = false;
+  }
+  else if (heating && waterTemp >= setpoint)
+  {
+    heating = false;
+  }
+  else if (!heating && waterTemp < setpoint - 1)
+  {
+    heating = true;
+  }
+
+  float hours = ms/3600000.0f;
+  if (heating)
+  {
+    waterTemp += heatingRate*hours;
+  }
+  else if (waterTemp > ambientTemp)
+  {
+    waterTemp = fmaxf(ambientTemp, waterTemp - coolingRate*hours);
+  }
+  else
+  {
+    waterTemp = fminf(ambientTemp, waterTemp + coolingRate*hours);
+  }
+}
+
+void SpaEmulator::displayText(char text[4])
+{
+  char buf[8];
+  if (!power)
+  {
+    memcpy(text, "    ", 4);
+  }
+  else if (error[0])
+  {
+    snprintf(buf, sizeof(buf), "%-4s", error);
+    memcpy(text, buf, 4);
+  }
+  else if (now < setpointShownUntil && ((now - setpointShownSince)/BLINK_HALF_PERIOD_MS) % 2)
+  {
+    // Blinking set point, off half
+    memcpy(text, "    ", 4);
+  }
+  else
+  {
+    // Three digits and the unit, as the decoder reads them
+    int value = now < setpointShownUntil ? setpoint : (int)lroundf(waterTemp);
+    if (value < 0) value = 0;
+    if (value > 99) value = 99;
+    snprintf(buf, sizeof(buf), "%03dC", value);
+    memcpy(text, buf, 4);
+  }
+}
+
+uint16_t SpaEmulator::ledFrame()
+{
+  uint16_t led = FRAME_TYPE::LED;
+  if (power)             led |= FRAME_LED::POWER;
+  if (filter)            led |= FRAME_LED::FILTER;
+  if (bubble)            led |= FRAME_LED::BUBBLE;
+  if (heating)           led |= FRAME_LED::HEATER_ON;
+  else if (heater)       led |= FRAME_LED::HEATER_STANDBY;
+  if (now >= beepUntil)  led |= FRAME_LED::NO_BEEP;
+  return led;
+}
+
+void SpaEmulator::setWaterTemp(float celsius)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  waterTemp = celsius;
+}
+
+void SpaEmulator::setAmbientTemp(float celsius)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ambientTemp = celsius;
+}
+
+void SpaEmulator::setSetpoint(int celsius)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (celsius >= SETPOINT_MIN && celsius <= SETPOINT_MAX)
+  {
+    setpoint = celsius;
+  }
+}
+
+void SpaEmulator::setHeatingRate(float perHour)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  heatingRate = perHour;
+}
+
+void SpaEmulator::setCoolingRate(float perHour)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  coolingRate = perHour;
+}
+
+void SpaEmulator::setWaterFlow(bool flow)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  this->flow = flow;
+}
+
+void SpaEmulator::raiseError(const char* code)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  setError(code);
+}
+
+void SpaEmulator::setPressCycles(unsigned int cycles)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  pressCycles = cycles ? cycles : 1;
+}
+
+bool SpaEmulator::isPowerOn()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return power;
+}
+
+bool SpaEmulator::isFilterOn()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return filter;
+}
+
+bool SpaEmulator::isBubbleOn()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return bubble;
+}
+
+bool SpaEmulator::isHeaterOn()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return heater;
+}
+
+bool SpaEmulator::isHeating()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return heating;
+}
+
+bool SpaEmulator::isBeeping()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return now < beepUntil;
+}
+
+bool SpaEmulator::isSetpointShown()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return now < setpointShownUntil;
+}
+
+int SpaEmulator::getSetpoint()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return setpoint;
+}
+
+float SpaEmulator::getWaterTemp()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return waterTemp;
+}
+
+std::string SpaEmulator::getError()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::string(error);
+}
+
+uint32_t SpaEmulator::getPresses()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return presses;
+}
+
+uint64_t SpaEmulator::getTimeMs()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return now;
+}
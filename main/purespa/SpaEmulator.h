@@ -0,0 +1,114 @@
+#ifndef SPA_EMULATOR_H
+#define SPA_EMULATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <string>
+
+// Simulated SB-H20 mainboard for host testing. It generates the frames of each
+// 21 ms display cycle and reacts to the button acknowledgements the decoder
+// sends back, the way the spa does: presses beep and toggle the LEDs, temp
+// up/down blink and step the set point, the water heats and cools, and a lost
+// water flow raises E90. Time only advances with the cycles, so the model runs
+// as fast as it is driven. No FreeRTOS or IDF timing: EmulatorBusBackend
+// drives it on the target, anything else can call it directly.
+//
+// All methods are thread safe, scenario setters may run next to the bus task.
+class SpaEmulator
+{
+public:
+  static const unsigned int CYCLE_PERIOD_MS = 21;
+  // CUE, 5 groups of 4 digits, 4 LED frames and 7 button polls
+  static const size_t CYCLE_FRAMES = 32;
+
+  static const int SETPOINT_MIN = 20; // °C
+  static const int SETPOINT_MAX = 40; // °C
+
+  SpaEmulator();
+
+  // Frames of the current cycle, in bus order
+  void buildCycle(uint16_t frames[CYCLE_FRAMES]);
+  // The decoder pulled DATA low right after this frame
+  void acknowledge(uint16_t frame);
+  // Turns this cycle's acknowledgements into presses and advances time
+  void endCycle();
+
+  // Scenario setup
+  void setWaterTemp(float celsius);
+  void setAmbientTemp(float celsius);
+  void setSetpoint(int celsius);
+  // [°C/h], real Intex heaters manage about 1.5
+  void setHeatingRate(float perHour);
+  void setCoolingRate(float perHour);
+  // Without flow the pump trips E90 after a few seconds of filtering
+  void setWaterFlow(bool flow);
+  // Shows an error code such as "E90" until power is pressed
+  void raiseError(const char* code);
+  // Consecutive acknowledged cycles the board needs to register a press
+  void setPressCycles(unsigned int cycles);
+
+  // Observed state
+  bool isPowerOn();
+  bool isFilterOn();
+  bool isBubbleOn();
+  bool isHeaterOn();
+  bool isHeating();
+  bool isBeeping();
+  bool isSetpointShown();
+  int getSetpoint();
+  float getWaterTemp();
+  std::string getError();     // empty without error
+  uint32_t getPresses();      // presses registered, ignored ones included
+  uint64_t getTimeMs();       // simulated time
+
+private:
+  enum Button
+  {
+    FILTER, BUBBLE, TEMP_DOWN, POWER, TEMP_UP, TEMP_UNIT, HEATER,
+    BUTTON_COUNT
+  };
+
+  static const uint16_t BUTTON_FRAMES[BUTTON_COUNT];
+
+  static const unsigned int BEEP_MS = 100;
+  static const unsigned int BLINK_HALF_PERIOD_MS = 250;
+  static const unsigned int SETPOINT_SHOWN_MS = 5000;
+  static const unsigned int NO_FLOW_TRIP_MS = 3000;
+
+  void press(Button button);
+  void setError(const char* code);
+  void updateWater(unsigned int ms);
+  void displayText(char text[4]);
+  uint16_t ledFrame();
+
+private:
+  std::mutex mutex;
+
+  bool power = false;
+  bool filter = false;
+  bool bubble = false;
+  bool heater = false;
+  bool heating = false;
+  bool flow = true;
+  char error[4] = "";
+
+  int setpoint = 38;
+  float waterTemp = 30;
+  float ambientTemp = 20;
+  float heatingRate = 1.5f;
+  float coolingRate = 0.5f;
+
+  unsigned int pressCycles = 3;
+  unsigned int held[BUTTON_COUNT] = {};
+  bool acked[BUTTON_COUNT] = {};
+  uint32_t presses = 0;
+
+  uint64_t now = 0;               // [ms]
+  uint64_t beepUntil = 0;
+  uint64_t setpointShownUntil = 0;
+  uint64_t setpointShownSince = 0;
+  uint64_t noFlowSince = 0;
+};
+
+#endif /* SPA_EMULATOR_H */
@@ -56,6 +56,7 @@ namespace MQTT_TOPIC
   static const char WIFI_TEMP[]    = "wifi/temp";
   static const char STATE[]        = "wifi/state";
   static const char OTA[]          = "wifi/update";
+  static const char CMD_RESULT[]   = "pool/command/result";
 
   // subscribe
   static const char CMD_BUBBLE[]       = "pool/command/bubble";
@@ -0,0 +1,97 @@
+#include "static_assets.h"
+#include <esp_log.h>
+#include <cstring>
+#include <cstdlib>
+#include <strings.h>
+
+// Generated at build time, see main/CMakeLists.txt
+#include "static_assets_data.h"
+
+static const char *TAG = "StaticAssets";
+
+const StaticAsset* findStaticAsset(const char* path) {
+    size_t len = strcspn(path, "?#");
+    for (const auto& asset : STATIC_ASSETS) {
+        if (strlen(asset.path) == len && strncmp(asset.path, path, len) == 0) return &asset;
+    }
+    return NULL;
+}
+
+bool acceptsEncoding(const char* header, const char* coding) {
+    size_t codingLen = strlen(coding);
+    const char* p = header;
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        const char* end = p + strcspn(p, ",");
+        size_t nameLen = strcspn(p, ";, ");
+        if (nameLen == codingLen && strncasecmp(p, coding, codingLen) == 0) {
+            const char* q = strstr(p, "q=");
+            return !(q && q < end && strtod(q + 2, NULL) == 0);
+        }
+        p = end;
+    }
+    return false;
+}
+
+// Compares opaque tags only (weak comparison), as If-None-Match requires
+static const char* stripWeak(const char* tag) {
+    return strncmp(tag, "W/", 2) == 0 ? tag + 2 : tag;
+}
+
+bool matchesEtag(const char* header, const char* etag) {
+    etag = stripWeak(etag);
+    size_t etagLen = strlen(etag);
+    const char* p = header;
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        const char* end = p + strcspn(p, ",");
+        size_t tagLen = end - p;
+        while (tagLen > 0 && p[tagLen - 1] == ' ') tagLen--;
+        if (tagLen == 1 && *p == '*') return true;
+        const char* tag = stripWeak(p);
+        tagLen -= tag - p;
+        if (tagLen == etagLen && strncmp(tag, etag, etagLen) == 0) return true;
+        p = end;
+    }
+    return false;
+}
+
+esp_err_t sendStaticAsset(httpd_req_t* req, const StaticAsset& asset) {
+    char acceptEncoding[64] = "";
+    httpd_req_get_hdr_value_str(req, "Accept-Encoding", acceptEncoding, sizeof(acceptEncoding));
+
+    // Text assets only exist compressed; gzip (the last one) is the fallback every browser handles
+    const StaticAssetVariant* variant = &asset.variants[asset.variantCount - 1];
+    for (size_t i = 0; i < asset.variantCount; i++) {
+        const char* encoding = asset.variants[i].encoding;
+        if (encoding == NULL || acceptsEncoding(acceptEncoding, encoding)) {
+            variant = &asset.variants[i];
+            break;
+        }
+    }
+
+    httpd_resp_set_type(req, asset.contentType);
+    httpd_resp_set_hdr(req, "ETag", variant->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", asset.immutable ? "public, max-age=31536000, immutable" : "no-cache");
+    if (asset.variantCount > 1) httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    char ifNoneMatch[64] = "";
+    httpd_req_get_hdr_value_str(req, "If-None-Match", ifNoneMatch, sizeof(ifNoneMatch));
+    if (matchesEtag(ifNoneMatch, variant->etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    if (variant->encoding) httpd_resp_set_hdr(req, "Content-Encoding", variant->encoding);
+    return httpd_resp_send(req, (const char*)variant->data, variant->len);
+}
+
+esp_err_t staticAssetHandler(httpd_req_t* req) {
+    const StaticAsset* asset = findStaticAsset(req->uri);
+    if (asset == NULL) {
+        ESP_LOGW(TAG, "No asset for %s", req->uri);
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+        return ESP_FAIL;
+    }
+    return sendStaticAsset(req, *asset);
+}
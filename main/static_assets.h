@@ -0,0 +1,39 @@
+#ifndef STATIC_ASSETS_H
+#define STATIC_ASSETS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_http_server.h>
+
+// Web UI files embedded at build time by tools/gen_assets.py, each in one or
+// more pre-compressed encodings ordered by preference.
+struct StaticAssetVariant {
+    const char* encoding;  // Content-Encoding, NULL for identity
+    const char* etag;
+    const uint8_t* data;
+    size_t len;
+};
+
+struct StaticAsset {
+    const char* path;
+    const char* contentType;
+    bool immutable;        // content-hashed URL, cached for a year
+    const StaticAssetVariant* variants;
+    size_t variantCount;
+};
+
+const StaticAsset* findStaticAsset(const char* path);
+
+// True if the Accept-Encoding list names the coding without refusing it (q=0)
+bool acceptsEncoding(const char* header, const char* coding);
+
+// True if an If-None-Match list ("*" or comma separated, weak or strong tags) names etag
+bool matchesEtag(const char* header, const char* etag);
+
+// Picks the best encoding the client accepts and answers If-None-Match with 304
+esp_err_t sendStaticAsset(httpd_req_t* req, const StaticAsset& asset);
+
+// GET handler serving the asset at the request path (register with wildcard matching for /static/*)
+esp_err_t staticAssetHandler(httpd_req_t* req);
+
+#endif // STATIC_ASSETS_H
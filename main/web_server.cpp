@@ -1,10 +1,13 @@
 #include "web_server.h"
 #include <esp_log.h>
 #include <esp_netif.h>
+#include <esp_timer.h>
 #include <time.h>
 #include <sys/time.h>
 #include <cstring>
-#include "cJSON.h"
+#include <cstdlib>
+#include <cerrno>
+#include <sys/socket.h>
 #include "PureSpaService.h"
 #include "nvs_flash.h"
 #include "esp_system.h"
@@ -13,28 +16,295 @@
 #include "esp_ota_ops.h"
 #include "esp_partition.h"
 #include "AuditLogger.h"
+#include "json_writer.h"
+#include "cbor_writer.h"
+#include "json_reader.h"
+#include "json_fields.h"
+#include "http_body.h"
+#include "static_assets.h"
+#include "ota_updater.h"
+#include "ota_session.h"
+#include "delta_patcher.h"
+#include "gzip_inflater.h"
+#include "gzip_deflater.h"
+#include "metrics.h"
 
 static const char *TAG = "WebServer";
 
-extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
-extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
-extern const uint8_t favicon_png_start[] asm("_binary_favicon_png_start");
-extern const uint8_t favicon_png_end[]   asm("_binary_favicon_png_end");
+static const uint32_t STATUS_LONG_POLL_MAX_MS = 25000;
+static const size_t JSON_CHUNK_SIZE = 512;
+
+// Upper bounds for request bodies, per endpoint
+static const size_t MAX_CONTROL_BODY = 128;
+static const size_t MAX_EVENT_BODY = 1024;
+static const size_t MAX_EVENT_REF_BODY = 128;
+static const size_t MAX_TIME_BODY = 128;
+static const size_t MAX_AUDIT_CONFIG_BODY = 128;
+static const size_t MAX_BATCH_BODY = 1024;
+static const size_t MAX_SCENE_BODY = 1024;
+static const size_t MAX_OTA_SESSION_BODY = 64;
+
+// Timeouts tolerated per recv while receiving a resumable chunk; the client
+// resends from the accepted offset, so don't hold the session for a dead link
+static const int OTA_CHUNK_RECV_TIMEOUTS = 3;
+
+static const uint32_t BATCH_TIMEOUT_MS = 30000;
+
+static esp_err_t httpdChunkFlush(void* ctx, const char* data, size_t len) {
+    return httpd_resp_send_chunk(static_cast<httpd_req_t*>(ctx), data, len);
+}
+
+struct ControlRequest {
+    char cmd[12];
+    bool boolValue;
+    int intValue;
+};
+
+static const JsonField CONTROL_FIELDS[] = {
+    JSON_STRING_FIELD(ControlRequest, cmd, "cmd"),
+    JSON_FIELD(ControlRequest, boolValue, "value", false),
+    JSON_FIELD(ControlRequest, intValue, "value", 0),
+};
+enum { CONTROL_CMD, CONTROL_BOOL_VALUE, CONTROL_INT_VALUE };
+
+struct SwitchCommand {
+    const char* name;
+    SpaCommand on;
+    SpaCommand off;
+};
+
+static const SwitchCommand SWITCH_COMMANDS[] = {
+    { "power",  SpaCommand::POWER_ON,  SpaCommand::POWER_OFF },
+    { "filter", SpaCommand::FILTER_ON, SpaCommand::FILTER_OFF },
+    { "heater", SpaCommand::HEATER_ON, SpaCommand::HEATER_OFF },
+    { "bubble", SpaCommand::BUBBLE_ON, SpaCommand::BUBBLE_OFF },
+};
+
+static bool isValidSetTemp(int temp) {
+    return temp >= PureSpaIO::WATER_TEMP::SET_MIN && temp <= PureSpaIO::WATER_TEMP::SET_MAX;
+}
+
+// Maps a {"cmd","value"} object onto a spa command
+static bool toSpaCommand(const ControlRequest& ctl, uint32_t seen, SpaBatchCommand& out) {
+    if (strcmp(ctl.cmd, "temp") == 0) {
+        if (!((seen >> CONTROL_INT_VALUE) & 1) || !isValidSetTemp(ctl.intValue)) return false;
+        out = { SpaCommand::SET_TEMP, ctl.intValue };
+        return true;
+    }
+    if (!((seen >> CONTROL_BOOL_VALUE) & 1)) return false;
+    for (const auto& sw : SWITCH_COMMANDS) {
+        if (strcmp(ctl.cmd, sw.name) == 0) {
+            out = { ctl.boolValue ? sw.on : sw.off, 0 };
+            return true;
+        }
+    }
+    return false;
+}
+
+static void writeSpaCommand(DocWriter& w, const SpaBatchCommand& c) {
+    w.beginObject();
+    if (c.cmd == SpaCommand::SET_TEMP) {
+        w.field("cmd", "temp").field("value", c.value);
+    }
+    for (const auto& sw : SWITCH_COMMANDS) {
+        if (c.cmd == sw.on || c.cmd == sw.off) {
+            w.field("cmd", sw.name).field("value", c.cmd == sw.on);
+        }
+    }
+    w.endObject();
+}
+
+static void writeScenes(DocWriter& w, const std::vector<SpaScene>& scenes, const char* key = nullptr) {
+    w.beginArray(key);
+    for (const auto& scene : scenes) {
+        w.beginObject().field("name", scene.name).beginArray("commands");
+        for (size_t i = 0; i < scene.count; i++) writeSpaCommand(w, scene.commands[i]);
+        w.endArray().endObject();
+    }
+    w.endArray();
+}
+
+// Collects the objects of a "commands" array (members at depth 3). Rejected
+// commands don't abort parsing, they are answered by checkCommandList() so the
+// client learns what was wrong instead of getting "Invalid JSON".
+struct CommandList {
+    ControlRequest ctl;
+    SpaBatchCommand commands[PureSpaService::MAX_BATCH_COMMANDS];
+    size_t count;
+    size_t total;       // objects in the array, including rejected ones
+    const char* error;  // first rejected command, null when all are valid
+};
+
+static bool isKnownCommand(const char* cmd) {
+    if (strcmp(cmd, "temp") == 0) return true;
+    for (const auto& sw : SWITCH_COMMANDS) {
+        if (strcmp(cmd, sw.name) == 0) return true;
+    }
+    return false;
+}
+
+static bool collectCommand(void* ctx, void* obj, uint32_t seen) {
+    auto* list = static_cast<CommandList*>(ctx);
+    const ControlRequest& ctl = *static_cast<ControlRequest*>(obj);
+    list->total++;
+    if (list->error || list->count >= PureSpaService::MAX_BATCH_COMMANDS) return true;
+    if (!toSpaCommand(ctl, seen, list->commands[list->count])) {
+        list->error = isKnownCommand(ctl.cmd) ? "Invalid command value" : "Unknown command";
+        return true;
+    }
+    list->count++;
+    return true;
+}
+
+// Answers 400 for a list that is too long or holds a rejected command
+static bool checkCommandList(httpd_req_t *req, const CommandList& list) {
+    if (list.total > PureSpaService::MAX_BATCH_COMMANDS) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "Too many commands (max %u)", (unsigned int)PureSpaService::MAX_BATCH_COMMANDS);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+        return false;
+    }
+    if (list.error) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, list.error);
+        return false;
+    }
+    return true;
+}
+
+struct SceneRequest {
+    char name[SpaScene::MAX_NAME + 1];
+};
+
+static const JsonField SCENE_FIELDS[] = {
+    JSON_STRING_FIELD(SceneRequest, name, "name"),
+};
+
+static const JsonField BATCH_FIELDS[] = {
+    JSON_STRING_FIELD(SceneRequest, name, "scene"),
+};
+
+struct EventRefRequest {
+    int id;
+    bool enabled;
+};
+
+static const JsonField EVENT_REF_FIELDS[] = {
+    JSON_FIELD(EventRefRequest, id, "id", 0),
+    JSON_FIELD(EventRefRequest, enabled, "enabled", false),
+};
+enum { EVENT_REF_ID, EVENT_REF_ENABLED };
+
+struct TimeRequest {
+    int timestamp;
+};
+
+static const JsonField TIME_FIELDS[] = {
+    JSON_FIELD(TimeRequest, timestamp, "timestamp", 0),
+};
+
+struct AuditConfigRequest {
+    int retentionDays;
+};
+
+static const JsonField AUDIT_CONFIG_FIELDS[] = {
+    JSON_FIELD(AuditConfigRequest, retentionDays, "retentionDays", 0),
+};
+
+struct OtaSessionRequest {
+    int size;
+};
+
+static const JsonField OTA_SESSION_FIELDS[] = {
+    JSON_FIELD(OtaSessionRequest, size, "size", 0),
+};
+
+#define FIELD_COUNT(table) (sizeof(table) / sizeof(table[0]))
+#define FIELD_SEEN(binder, index) (((binder).seen() >> (index)) & 1)
+
+// Clients asking for application/cbor get the same documents CBOR encoded
+static bool acceptsCbor(httpd_req_t* req) {
+    char accept[96] = "";
+    httpd_req_get_hdr_value_str(req, "Accept", accept, sizeof(accept));
+    return strstr(accept, "application/cbor") != NULL;
+}
+
+// Chunk sink for dynamic bodies: once a body outgrows the first buffer it is
+// gzipped on the fly for clients that accept it, as long as the deflater
+// budget (GzipDeflater::MAX_ACTIVE) allows, otherwise sent as is
+struct ResponseSink {
+    httpd_req_t* req;
+    GzipDeflater* gzip;     // null when the client does not accept gzip
+    bool started;
+    bool compressing;
+};
+
+static esp_err_t responseSinkFlush(void* ctx, const char* data, size_t len) {
+    ResponseSink* sink = static_cast<ResponseSink*>(ctx);
+    if (!sink->started) {
+        sink->started = true;
+        if (sink->gzip && sink->gzip->init() == ESP_OK) {
+            httpd_resp_set_hdr(sink->req, "Content-Encoding", "gzip");
+            sink->compressing = true;
+        }
+    }
+    if (sink->compressing) return sink->gzip->feed((const uint8_t*)data, len);
+    return httpd_resp_send_chunk(sink->req, data, len);
+}
+
+// Streams a JSON or CBOR body (negotiated from Accept) through a stack buffer.
+// Bodies that fit in one buffer are sent with a Content-Length, larger ones go
+// out chunked as the buffer fills, gzipped when the client allows it.
+template<typename F>
+static esp_err_t sendDocument(httpd_req_t* req, F&& build) {
+    char acceptEncoding[64] = "";
+    httpd_req_get_hdr_value_str(req, "Accept-Encoding", acceptEncoding, sizeof(acceptEncoding));
+    GzipDeflater gzip(httpdChunkFlush, req);
+    ResponseSink sink = { req, acceptsEncoding(acceptEncoding, "gzip") ? &gzip : nullptr, false, false };
+
+    char buf[JSON_CHUNK_SIZE];
+    JsonWriter json(buf, sizeof(buf), responseSinkFlush, &sink);
+    CborWriter cbor(buf, sizeof(buf), responseSinkFlush, &sink);
+    DocWriter& w = acceptsCbor(req) ? static_cast<DocWriter&>(cbor) : json;
+    httpd_resp_set_type(req, w.contentType());
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Vary", "Accept, Accept-Encoding");
+    build(w);
+    if (!w.flushed()) {
+        return httpd_resp_send(req, w.data(), w.length());
+    }
+    esp_err_t err = w.finish();
+    if (err == ESP_OK && sink.compressing) {
+        err = gzip.finish();
+        ESP_LOGD(TAG, "Compressed %s: %d -> %d bytes", req->uri, (int)gzip.inputSize(), (int)gzip.outputSize());
+    }
+    if (err != ESP_OK) return err;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
 
 void WebServer::start() {
     if (_mainServer != NULL) return;
 
+    startAsyncWorkers();
+
     // 1. MAIN SERVER (Port 80)
     httpd_config_t configMain = HTTPD_DEFAULT_CONFIG();
     configMain.server_port = 80;
+    configMain.stack_size = HTTPD_STACK;
     configMain.lru_purge_enable = true;
-    configMain.max_uri_handlers = 20;
+    configMain.max_uri_handlers = MAX_ROUTES;
+    configMain.uri_match_fn = httpd_uri_match_wildcard;
 
-    static const httpd_uri_t root = { .uri = "/", .method = HTTP_GET, .handler = rootGetHandler, .user_ctx = NULL };
-    static const httpd_uri_t index_html = { .uri = "/index.html", .method = HTTP_GET, .handler = rootGetHandler, .user_ctx = NULL };
-    static const httpd_uri_t favicon_ico = { .uri = "/favicon.ico", .method = HTTP_GET, .handler = faviconGetHandler, .user_ctx = NULL };
+    static const httpd_uri_t root = { .uri = "/", .method = HTTP_GET, .handler = staticAssetHandler, .user_ctx = NULL };
+    static const httpd_uri_t index_html = { .uri = "/index.html", .method = HTTP_GET, .handler = staticAssetHandler, .user_ctx = NULL };
+    static const httpd_uri_t favicon_ico = { .uri = "/favicon.ico", .method = HTTP_GET, .handler = staticAssetHandler, .user_ctx = NULL };
+    static const httpd_uri_t static_files = { .uri = "/static/*", .method = HTTP_GET, .handler = staticAssetHandler, .user_ctx = NULL };
     static const httpd_uri_t api_status = { .uri = "/api/status", .method = HTTP_GET, .handler = apiStatusHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_bootstrap = { .uri = "/api/bootstrap", .method = HTTP_GET, .handler = apiBootstrapHandler, .user_ctx = NULL };
     static const httpd_uri_t api_control = { .uri = "/api/control", .method = HTTP_POST, .handler = apiControlHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_control_batch = { .uri = "/api/control/batch", .method = HTTP_POST, .handler = apiControlBatchHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_scenes_get = { .uri = "/api/scenes", .method = HTTP_GET, .handler = apiScenesGetHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_scenes_save = { .uri = "/api/scenes/save", .method = HTTP_POST, .handler = apiScenesSaveHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_scenes_delete = { .uri = "/api/scenes/delete", .method = HTTP_POST, .handler = apiScenesDeleteHandler, .user_ctx = NULL };
     static const httpd_uri_t api_schedule_get = { .uri = "/api/schedule", .method = HTTP_GET, .handler = apiScheduleGetHandler, .user_ctx = NULL };
     static const httpd_uri_t api_schedule_add = { .uri = "/api/schedule/add", .method = HTTP_POST, .handler = apiScheduleAddHandler, .user_ctx = NULL };
     static const httpd_uri_t api_schedule_update = { .uri = "/api/schedule/update", .method = HTTP_POST, .handler = apiScheduleUpdateHandler, .user_ctx = NULL };
@@ -46,10 +316,33 @@ void WebServer::start() {
     static const httpd_uri_t api_admin_reset_schedule = { .uri = "/api/admin/reset/schedule", .method = HTTP_POST, .handler = apiAdminResetScheduleHandler, .user_ctx = NULL };
     static const httpd_uri_t api_admin_reset_all = { .uri = "/api/admin/reset/all", .method = HTTP_POST, .handler = apiAdminResetAllHandler, .user_ctx = NULL };
     static const httpd_uri_t api_admin_ota = { .uri = "/api/admin/ota", .method = HTTP_POST, .handler = apiAdminOtaHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_admin_ota_session_start = { .uri = "/api/admin/ota/session", .method = HTTP_POST, .handler = apiAdminOtaSessionStartHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_admin_ota_session_get = { .uri = "/api/admin/ota/session", .method = HTTP_GET, .handler = apiAdminOtaSessionGetHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_admin_ota_session_put = { .uri = "/api/admin/ota/session", .method = HTTP_PUT, .handler = apiAdminOtaSessionPutHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_admin_ota_session_delete = { .uri = "/api/admin/ota/session", .method = HTTP_DELETE, .handler = apiAdminOtaSessionDeleteHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_admin_ota_session_finalize = { .uri = "/api/admin/ota/session/finalize", .method = HTTP_POST, .handler = apiAdminOtaSessionFinalizeHandler, .user_ctx = NULL };
     static const httpd_uri_t api_admin_audit_get = { .uri = "/api/admin/audit", .method = HTTP_GET, .handler = apiAdminAuditGetHandler, .user_ctx = NULL };
     static const httpd_uri_t api_admin_audit_config_get = { .uri = "/api/admin/audit/config", .method = HTTP_GET, .handler = apiAdminAuditConfigGetHandler, .user_ctx = NULL };
     static const httpd_uri_t api_admin_audit_config_post = { .uri = "/api/admin/audit/config", .method = HTTP_POST, .handler = apiAdminAuditConfigPostHandler, .user_ctx = NULL };
     static const httpd_uri_t api_admin_audit_clear = { .uri = "/api/admin/audit/clear", .method = HTTP_POST, .handler = apiAdminAuditClearHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_admin_http = { .uri = "/api/admin/http", .method = HTTP_GET, .handler = apiAdminHttpStatsHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_debug_bus = { .uri = "/api/debug/bus", .method = HTTP_GET, .handler = apiDebugBusHandler, .user_ctx = NULL };
+    static const httpd_uri_t api_debug_profile = { .uri = "/api/debug/profile", .method = HTTP_GET, .handler = apiDebugProfileHandler, .user_ctx = NULL };
+    static const httpd_uri_t metrics = { .uri = "/metrics", .method = HTTP_GET, .handler = metricsHandler, .user_ctx = NULL };
+
+    static const httpd_uri_t* const routes[] = {
+        &root, &index_html, &favicon_ico, &static_files,
+        &api_status, &api_bootstrap, &api_control, &api_control_batch,
+        &api_scenes_get, &api_scenes_save, &api_scenes_delete,
+        &api_schedule_get, &api_schedule_add, &api_schedule_update, &api_schedule_delete, &api_schedule_toggle,
+        &api_admin_time, &api_admin_reboot,
+        &api_admin_reset_wifi, &api_admin_reset_schedule, &api_admin_reset_all,
+        &api_admin_ota, &api_admin_ota_session_start, &api_admin_ota_session_get, &api_admin_ota_session_put,
+        &api_admin_ota_session_delete, &api_admin_ota_session_finalize,
+        &api_admin_audit_get, &api_admin_audit_config_get, &api_admin_audit_config_post, &api_admin_audit_clear,
+        &api_admin_http, &api_debug_bus, &api_debug_profile, &metrics,
+    };
+    static_assert(sizeof(routes) / sizeof(routes[0]) <= MAX_ROUTES, "raise MAX_ROUTES");
 
     esp_netif_ip_info_t ip_info;
     esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
@@ -60,26 +353,7 @@ void WebServer::start() {
     }
 
     if (httpd_start(&_mainServer, &configMain) == ESP_OK) {
-        httpd_register_uri_handler(_mainServer, &root);
-        httpd_register_uri_handler(_mainServer, &index_html);
-        httpd_register_uri_handler(_mainServer, &favicon_ico);
-        httpd_register_uri_handler(_mainServer, &api_status);
-        httpd_register_uri_handler(_mainServer, &api_control);
-        httpd_register_uri_handler(_mainServer, &api_schedule_get);
-        httpd_register_uri_handler(_mainServer, &api_schedule_add);
-        httpd_register_uri_handler(_mainServer, &api_schedule_update);
-        httpd_register_uri_handler(_mainServer, &api_schedule_delete);
-        httpd_register_uri_handler(_mainServer, &api_schedule_toggle);
-        httpd_register_uri_handler(_mainServer, &api_admin_time);
-        httpd_register_uri_handler(_mainServer, &api_admin_reboot);
-        httpd_register_uri_handler(_mainServer, &api_admin_reset_wifi);
-        httpd_register_uri_handler(_mainServer, &api_admin_reset_schedule);
-        httpd_register_uri_handler(_mainServer, &api_admin_reset_all);
-        httpd_register_uri_handler(_mainServer, &api_admin_ota);
-        httpd_register_uri_handler(_mainServer, &api_admin_audit_get);
-        httpd_register_uri_handler(_mainServer, &api_admin_audit_config_get);
-        httpd_register_uri_handler(_mainServer, &api_admin_audit_config_post);
-        httpd_register_uri_handler(_mainServer, &api_admin_audit_clear);
+        registerRoutes(routes, sizeof(routes) / sizeof(routes[0]));
     }
 
     /*
@@ -98,6 +372,71 @@ void WebServer::start() {
     */
 }
 
+// Wraps every handler in timedHandler; the route table survives a restart so
+// each endpoint keeps a single metrics slot
+void WebServer::registerRoutes(const httpd_uri_t* const* uris, size_t count) {
+    for (size_t i = 0; i < count && i < MAX_ROUTES; i++) {
+        httpd_uri_t uri = *uris[i];
+        Route& route = _routes[i];
+        if (i >= _routeCount) {
+            route.handler = uri.handler;
+            route.stats = Metrics::getInstance().registerEndpoint(uri.uri, uri.method);
+            _routeCount = i + 1;
+        }
+        uri.handler = timedHandler;
+        uri.user_ctx = &route;
+        httpd_register_uri_handler(_mainServer, &uri);
+    }
+}
+
+thread_local WebServer::RequestContext* WebServer::_currentRequest = nullptr;
+
+esp_err_t WebServer::timedHandler(httpd_req_t *req) {
+    const Route* route = static_cast<const Route*>(req->user_ctx);
+    RequestContext ctx = {};
+    ctx.startedAt = esp_timer_get_time();
+    ctx.freeHeap = esp_get_free_heap_size();
+    // Count what this session writes; the override stays for its later requests
+    httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), countingSend);
+
+    _currentRequest = &ctx;
+    esp_err_t err = route->handler(req);
+    _currentRequest = nullptr;
+    // Requests handed to a worker are recorded there once they complete
+    if (!ctx.detached) recordRequest(req, ctx, err);
+    return err;
+}
+
+void WebServer::recordRequest(httpd_req_t *req, const RequestContext& ctx, esp_err_t err) {
+    const Route* route = static_cast<const Route*>(req->user_ctx);
+    if (route == NULL) return;
+    Metrics::RequestSample sample;
+    sample.uri = req->uri;
+    sample.durationMs = (uint32_t)((esp_timer_get_time() - ctx.startedAt - ctx.parkedUs) / 1000);
+    sample.sendMs = (uint32_t)(ctx.sendUs / 1000);
+    sample.bytesOut = ctx.bytesOut;
+    sample.heapDelta = (int32_t)(esp_get_free_heap_size() - ctx.freeHeap);
+    sample.error = err != ESP_OK;
+    Metrics::getInstance().recordRequest(route->stats, sample);
+}
+
+// Same as the httpd default send, timing the call and counting the bytes
+// against the request handled by the calling task
+int WebServer::countingSend(httpd_handle_t hd, int sockfd, const char *buf, size_t len, int flags) {
+    if (buf == NULL) return HTTPD_SOCK_ERR_INVALID;
+    int64_t start = esp_timer_get_time();
+    int ret = send(sockfd, buf, len, flags);
+    RequestContext* ctx = _currentRequest;
+    if (ctx != nullptr) {
+        ctx->sendUs += esp_timer_get_time() - start;
+        if (ret > 0) ctx->bytesOut += ret;
+    }
+    if (ret < 0) {
+        return (errno == EAGAIN || errno == EINTR) ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+    }
+    return ret;
+}
+
 void WebServer::stop() {
     if (_mainServer) httpd_stop(_mainServer);
     if (_sseServer) httpd_stop(_sseServer);
@@ -105,57 +444,427 @@ void WebServer::stop() {
     _sseServer = NULL;
 }
 
-esp_err_t WebServer::rootGetHandler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-    httpd_resp_send(req, (const char *)index_html_gz_start, index_html_gz_end - index_html_gz_start);
+void WebServer::startAsyncWorkers() {
+    if (_asyncQueue != NULL) return;
+
+    _asyncQueue = xQueueCreate(ASYNC_QUEUE_SIZE, sizeof(AsyncRequest));
+    if (_asyncQueue == NULL) {
+        ESP_LOGE(TAG, "Failed to create async request queue");
+        return;
+    }
+    for (int i = 0; i < ASYNC_WORKER_COUNT; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "httpd_async_%d", i);
+        xTaskCreate(asyncWorkerTask, name, ASYNC_WORKER_STACK, this, tskIDLE_PRIORITY + 5, &_asyncWorkers[i]);
+    }
+    xTaskCreate(statusPollTask, "httpd_poll", POLL_TASK_STACK, this, tskIDLE_PRIORITY + 5, &_pollTask);
+}
+
+void WebServer::asyncWorkerTask(void *param) {
+    WebServer* self = static_cast<WebServer*>(param);
+    AsyncRequest job;
+    while (true) {
+        if (xQueueReceive(self->_asyncQueue, &job, portMAX_DELAY) == pdTRUE) {
+            _currentRequest = &job.ctx;
+            esp_err_t err = job.handler(job.req);
+            _currentRequest = nullptr;
+            // The detached copy keeps the route in user_ctx
+            recordRequest(job.req, job.ctx, err);
+            httpd_req_async_handler_complete(job.req);
+        }
+    }
+}
+
+bool WebServer::isAsyncWorker() {
+    WebServer& self = getInstance();
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < ASYNC_WORKER_COUNT; i++) {
+        if (self._asyncWorkers[i] == current) return true;
+    }
+    return false;
+}
+
+// Detaches the request from the httpd task and lets a worker call handler on it.
+// Only the httpd task submits, so checking for space first cannot race.
+esp_err_t WebServer::queueAsync(httpd_req_t *req, RequestHandler handler) {
+    WebServer& self = getInstance();
+    if (self._asyncQueue == NULL || uxQueueSpacesAvailable(self._asyncQueue) == 0) {
+        ESP_LOGW(TAG, "Async workers saturated, rejecting %s", req->uri);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "2");
+        httpd_resp_sendstr(req, "Server busy");
+        return ESP_OK;
+    }
+
+    httpd_req_t *copy = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &copy);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to detach request %s (%s)", req->uri, esp_err_to_name(err));
+        return err;
+    }
+    AsyncRequest job = { copy, handler, {} };
+    if (_currentRequest != nullptr) {
+        job.ctx = *_currentRequest;
+        _currentRequest->detached = true;
+    } else {
+        job.ctx.startedAt = esp_timer_get_time();
+        job.ctx.freeHeap = esp_get_free_heap_size();
+    }
+    xQueueSend(self._asyncQueue, &job, 0);
     return ESP_OK;
 }
 
-esp_err_t WebServer::faviconGetHandler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "image/png");
-    httpd_resp_send(req, (const char *)favicon_png_start, favicon_png_end - favicon_png_start);
+// Detaches a status long-poll and leaves it to statusPollTask. Runs on the
+// httpd task; a full list is answered with 503 so the client backs off.
+esp_err_t WebServer::parkStatusPoll(httpd_req_t *req, PureSpaService& service, uint32_t since, uint32_t waitMs) {
+    WebServer& self = getInstance();
+    std::lock_guard<std::mutex> lock(self._pollMutex);
+    if (self._pollTask == NULL || self._pollCount == MAX_PARKED_POLLS) {
+        ESP_LOGW(TAG, "Too many parked long-polls, rejecting %s", req->uri);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "2");
+        httpd_resp_sendstr(req, "Server busy");
+        return ESP_OK;
+    }
+
+    httpd_req_t *copy = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &copy);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to detach request %s (%s)", req->uri, esp_err_to_name(err));
+        return err;
+    }
+    int64_t now = esp_timer_get_time();
+    ParkedPoll& poll = self._polls[self._pollCount++];
+    poll = { copy, &service, since, now, now + (int64_t)waitMs * 1000, {} };
+    if (_currentRequest != nullptr) {
+        poll.ctx = *_currentRequest;
+        _currentRequest->detached = true;
+    } else {
+        poll.ctx.startedAt = now;
+        poll.ctx.freeHeap = esp_get_free_heap_size();
+    }
+    xTaskNotifyGive(self._pollTask);
     return ESP_OK;
 }
 
+size_t WebServer::getParkedPollCount() {
+    std::lock_guard<std::mutex> lock(_pollMutex);
+    return _pollCount;
+}
+
+// Sleeps while nothing is parked, otherwise checks every POLL_CHECK_MS and
+// answers the polls whose spa has a new status version or whose wait ran out
+void WebServer::statusPollTask(void *param) {
+    WebServer* self = static_cast<WebServer*>(param);
+    while (true) {
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(self->_pollMutex);
+            idle = self->_pollCount == 0;
+        }
+        ulTaskNotifyTake(pdTRUE, idle ? portMAX_DELAY : pdMS_TO_TICKS(POLL_CHECK_MS));
+
+        ParkedPoll due[MAX_PARKED_POLLS];
+        size_t dueCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(self->_pollMutex);
+            int64_t now = esp_timer_get_time();
+            for (size_t i = 0; i < self->_pollCount;) {
+                ParkedPoll& poll = self->_polls[i];
+                if (now < poll.deadline && poll.service->getStatusVersion() == poll.since) {
+                    i++;
+                    continue;
+                }
+                due[dueCount++] = poll;
+                poll = self->_polls[--self->_pollCount];
+            }
+        }
+
+        // Answered outside the lock, so a slow client does not hold up parking
+        for (size_t i = 0; i < dueCount; i++) {
+            ParkedPoll& poll = due[i];
+            poll.ctx.parkedUs += esp_timer_get_time() - poll.parkedAt;
+            _currentRequest = &poll.ctx;
+            esp_err_t err = sendStatus(poll.req, *poll.service);
+            _currentRequest = nullptr;
+            recordRequest(poll.req, poll.ctx, err);
+            httpd_req_async_handler_complete(poll.req);
+        }
+    }
+}
+
+// ?spa=<index> selects the spa, the first one without it. Answers 404 and
+// returns nullptr when no such spa is configured.
+static PureSpaService* getSpaQuery(httpd_req_t *req) {
+    char query[64];
+    char value[4];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "spa", value, sizeof(value)) != ESP_OK) {
+        return &PureSpaService::getInstance();
+    }
+    char* end;
+    unsigned long spa = strtoul(value, &end, 10);
+    if (end == value || *end || PureSpaService::getInstance(spa) == nullptr) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown spa");
+        return nullptr;
+    }
+    return PureSpaService::getInstance(spa);
+}
+
+// The schedule and the scenes belong to the first spa; ?spa=<n> naming
+// another one is refused rather than silently served from spa 0
+static bool isFirstSpaQuery(httpd_req_t *req) {
+    PureSpaService* spa = getSpaQuery(req);
+    if (spa == nullptr) return false;
+    if (spa->getIndex() != 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Schedule and scenes belong to spa 0");
+        return false;
+    }
+    return true;
+}
+
 esp_err_t WebServer::apiStatusHandler(httpd_req_t *req) {
-    std::string status = PureSpaService::getInstance().getStatusJson();
-    httpd_resp_set_type(req, "application/json");
+    PureSpaService* spa = getSpaQuery(req);
+    if (spa == nullptr) return ESP_FAIL;
+    PureSpaService& service = *spa;
+
+    // Long-poll: ?since=<version>&wait=<ms> parks the request until the status changes
+    char query[48];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[12];
+        if (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+            uint32_t since = strtoul(value, NULL, 10);
+            uint32_t waitMs = 0;
+            if (httpd_query_key_value(query, "wait", value, sizeof(value)) == ESP_OK) {
+                waitMs = strtoul(value, NULL, 10);
+            }
+            if (waitMs > STATUS_LONG_POLL_MAX_MS) waitMs = STATUS_LONG_POLL_MAX_MS;
+            if (waitMs > 0 && since == service.getStatusVersion()) {
+                return parkStatusPoll(req, service, since, waitMs);
+            }
+        }
+    }
+    return sendStatus(req, service);
+}
+
+// The cached status in the negotiated encoding, or 304 when the client has it
+esp_err_t WebServer::sendStatus(httpd_req_t *req, PureSpaService& service) {
+    char ifNoneMatch[64] = "";
+    httpd_req_get_hdr_value_str(req, "If-None-Match", ifNoneMatch, sizeof(ifNoneMatch));
+
+    // Copied out so the status lock is not held during the send (the JSON
+    // buffer is the larger of the two)
+    bool cbor = acceptsCbor(req);
+    char doc[PureSpaService::STATUS_JSON_SIZE];
+    size_t len = 0;
+    uint32_t version = 0;
+    uint32_t renders = 0;
+    auto copy = [&](const char* data, size_t n, uint32_t v, uint32_t r) {
+        memcpy(doc, data, n);
+        len = n;
+        version = v;
+        renders = r;
+    };
+    if (cbor) service.withStatusCbor(copy); else service.withStatusJson(copy);
+
+    // The render count changes with every metrics sample (time, heap, uptime),
+    // so a revalidating client gets those too and not a 304 for hours
+    char etag[32];
+    snprintf(etag, sizeof(etag), cbor ? "W/\"%08lx.%lx-c\"" : "W/\"%08lx.%lx\"",
+             (unsigned long)version, (unsigned long)renders);
+    httpd_resp_set_type(req, cbor ? "application/cbor" : "application/json");
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_send(req, status.c_str(), HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Vary", "Accept");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    if (matchesEtag(ifNoneMatch, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    return httpd_resp_send(req, doc, len);
+}
+
+// Everything the UI needs on first load in one response, so a page load costs
+// one round trip instead of one per endpoint
+esp_err_t WebServer::apiBootstrapHandler(httpd_req_t *req) {
+    PureSpaService* spa = getSpaQuery(req);
+    if (spa == nullptr) return ESP_FAIL;
+    PureSpaService& service = *spa;
+    // Schedule and scenes belong to the first spa
+    PureSpaService& first = PureSpaService::getInstance();
+
+    // Copy the cached status in the negotiated encoding so the status lock is
+    // not held while streaming (the JSON buffer is the larger of the two)
+    char status[PureSpaService::STATUS_JSON_SIZE];
+    size_t statusLen = 0;
+    auto copy = [&](const char* doc, size_t len, uint32_t version, uint32_t renders) {
+        memcpy(status, doc, len);
+        statusLen = len;
+    };
+    if (acceptsCbor(req)) service.withStatusCbor(copy); else service.withStatusJson(copy);
+    std::vector<SpaScene> scenes = first.getScenes();
+    PureSpaService::Capabilities caps = service.getCapabilities();
+
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return sendDocument(req, [&](DocWriter& w) {
+        w.beginObject();
+        w.field("spas", (int)PureSpaService::getSpaCount());
+        w.rawField("status", status, statusLen);
+        w.beginObject("capabilities")
+            .field("model", caps.modelName)
+            .field("jet", caps.jet)
+            .field("disinfection", caps.disinfection)
+            .field("minTemp", caps.minTemp)
+            .field("maxTemp", caps.maxTemp)
+            .field("maxEvents", (int)PureSpaService::MAX_EVENTS)
+            .field("maxScenes", (int)PureSpaService::MAX_SCENES)
+            .endObject();
+        first.writeSchedule(w, "schedule");
+        writeScenes(w, scenes, "scenes");
+        w.beginObject("audit")
+            .field("retentionDays", AuditLogger::getInstance().getRetentionDays())
+            .endObject();
+        w.endObject();
+    });
 }
 
 esp_err_t WebServer::apiControlHandler(httpd_req_t *req) {
-    char buf[128];
-    int ret = httpd_req_recv(req, buf, req->content_len);
-    if (ret <= 0) return ESP_FAIL;
-    buf[ret] = '\0';
-
-    cJSON *json = cJSON_Parse(buf);
-    if (json == NULL) return ESP_FAIL;
-
-    PureSpaService& service = PureSpaService::getInstance();
-    cJSON *item = cJSON_GetObjectItem(json, "cmd");
-    if (cJSON_IsString(item)) {
-        if (strcmp(item->valuestring, "power") == 0) {
-            cJSON *val = cJSON_GetObjectItem(json, "value");
-            if (cJSON_IsBool(val)) service.setPower(cJSON_IsTrue(val));
-        } else if (strcmp(item->valuestring, "filter") == 0) {
-            cJSON *val = cJSON_GetObjectItem(json, "value");
-            if (cJSON_IsBool(val)) service.setFilter(cJSON_IsTrue(val));
-        } else if (strcmp(item->valuestring, "bubble") == 0) {
-            cJSON *val = cJSON_GetObjectItem(json, "value");
-            if (cJSON_IsBool(val)) service.setBubble(cJSON_IsTrue(val));
-        } else if (strcmp(item->valuestring, "heater") == 0) {
-            cJSON *val = cJSON_GetObjectItem(json, "value");
-            if (cJSON_IsBool(val)) service.setHeater(cJSON_IsTrue(val));
-        } else if (strcmp(item->valuestring, "temp") == 0) {
-            cJSON *val = cJSON_GetObjectItem(json, "value");
-            if (cJSON_IsNumber(val)) service.setTargetTemp(val->valueint);
+    ControlRequest ctl;
+    JsonFieldBinder binder(CONTROL_FIELDS, FIELD_COUNT(CONTROL_FIELDS), &ctl);
+    if (readJsonBody(req, MAX_CONTROL_BODY, binder) != ESP_OK) return ESP_FAIL;
+
+    PureSpaService* spa = getSpaQuery(req);
+    if (spa == nullptr) return ESP_FAIL;
+    PureSpaService& service = *spa;
+    bool hasBool = FIELD_SEEN(binder, CONTROL_BOOL_VALUE);
+    if (strcmp(ctl.cmd, "power") == 0) {
+        if (hasBool) service.setPower(ctl.boolValue);
+    } else if (strcmp(ctl.cmd, "filter") == 0) {
+        if (hasBool) service.setFilter(ctl.boolValue);
+    } else if (strcmp(ctl.cmd, "bubble") == 0) {
+        if (hasBool) service.setBubble(ctl.boolValue);
+    } else if (strcmp(ctl.cmd, "heater") == 0) {
+        if (hasBool) service.setHeater(ctl.boolValue);
+    } else if (strcmp(ctl.cmd, "temp") == 0) {
+        if (FIELD_SEEN(binder, CONTROL_INT_VALUE) && !isValidSetTemp(ctl.intValue)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Temperature out of range");
+            return ESP_FAIL;
+        }
+        if (FIELD_SEEN(binder, CONTROL_INT_VALUE)) service.setTargetTemp(ctl.intValue);
+    }
+    httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+esp_err_t WebServer::apiControlBatchHandler(httpd_req_t *req) {
+    if (!isAsyncWorker()) return queueAsync(req, apiControlBatchHandler);
+    ESP_LOGI(TAG, "POST /api/control/batch");
+    // {"commands":[{"cmd":"power","value":true},...]} or {"scene":"<name>"}
+    CommandList list = {};
+    SceneRequest scene;
+    JsonFieldBinder commandBinder(CONTROL_FIELDS, FIELD_COUNT(CONTROL_FIELDS), &list.ctl, 3, collectCommand, &list);
+    JsonFieldBinder sceneBinder(BATCH_FIELDS, FIELD_COUNT(BATCH_FIELDS), &scene);
+    JsonTee tee(commandBinder, sceneBinder);
+    if (readJsonBody(req, MAX_BATCH_BODY, tee) != ESP_OK) return ESP_FAIL;
+    if (!checkCommandList(req, list)) return ESP_FAIL;
+
+    PureSpaService* spa = getSpaQuery(req);
+    if (spa == nullptr) return ESP_FAIL;
+    PureSpaService& service = *spa;
+    char source[32] = "Web UI";
+    if (sceneBinder.seen()) {
+        // Scenes are stored with the first spa and run on any
+        SpaScene stored;
+        if (!PureSpaService::getInstance().getScene(scene.name, stored)) {
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown scene");
+            return ESP_FAIL;
+        }
+        memcpy(list.commands, stored.commands, stored.count * sizeof(SpaBatchCommand));
+        list.count = stored.count;
+        snprintf(source, sizeof(source), "Scene %s", stored.name);
+    }
+    if (list.count == 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No commands");
+        return ESP_FAIL;
+    }
+
+    SpaBatchResult result;
+    esp_err_t err = service.runBatch(list.commands, list.count, source, BATCH_TIMEOUT_MS, result);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid command list");
+        return ESP_FAIL;
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Command queue full");
+        return ESP_OK;
+    }
+    return sendDocument(req, [&](DocWriter& w) {
+        w.beginObject();
+        if (err == ESP_ERR_TIMEOUT) {
+            w.field("status", "running");
+        } else {
+            w.field("status", result.failed ? "partial" : "ok")
+                .field("executed", (int)result.executed)
+                .field("failed", (int)result.failed)
+                .field("skipped", (int)result.skipped)
+                .field("duration_ms", result.durationMs);
         }
+        w.endObject();
+    });
+}
+
+esp_err_t WebServer::apiScenesGetHandler(httpd_req_t *req) {
+    if (!isFirstSpaQuery(req)) return ESP_FAIL;
+    std::vector<SpaScene> scenes = PureSpaService::getInstance().getScenes();
+    return sendDocument(req, [&](DocWriter& w) {
+        writeScenes(w, scenes);
+    });
+}
+
+esp_err_t WebServer::apiScenesSaveHandler(httpd_req_t *req) {
+    if (!isFirstSpaQuery(req)) return ESP_FAIL;
+    ESP_LOGI(TAG, "POST /api/scenes/save");
+    // {"name":"<name>","commands":[{"cmd":"power","value":true},...]}
+    CommandList list = {};
+    SceneRequest name;
+    JsonFieldBinder commandBinder(CONTROL_FIELDS, FIELD_COUNT(CONTROL_FIELDS), &list.ctl, 3, collectCommand, &list);
+    JsonFieldBinder nameBinder(SCENE_FIELDS, FIELD_COUNT(SCENE_FIELDS), &name);
+    JsonTee tee(commandBinder, nameBinder);
+    if (readJsonBody(req, MAX_SCENE_BODY, tee) != ESP_OK) return ESP_FAIL;
+    if (!checkCommandList(req, list)) return ESP_FAIL;
+    if (name.name[0] == '\0' || list.count == 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing name or commands");
+        return ESP_FAIL;
+    }
+
+    SpaScene scene = {};
+    memcpy(scene.name, name.name, sizeof(scene.name));
+    memcpy(scene.commands, list.commands, list.count * sizeof(SpaBatchCommand));
+    scene.count = list.count;
+    if (PureSpaService::getInstance().saveScene(scene) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not save scene");
+        return ESP_FAIL;
     }
-    cJSON_Delete(json);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+esp_err_t WebServer::apiScenesDeleteHandler(httpd_req_t *req) {
+    if (!isFirstSpaQuery(req)) return ESP_FAIL;
+    ESP_LOGI(TAG, "POST /api/scenes/delete");
+    SceneRequest name;
+    JsonFieldBinder binder(SCENE_FIELDS, FIELD_COUNT(SCENE_FIELDS), &name);
+    if (readJsonBody(req, MAX_EVENT_REF_BODY, binder) != ESP_OK) return ESP_FAIL;
+
+    if (!PureSpaService::getInstance().deleteScene(name.name)) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown scene");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
@@ -167,159 +876,117 @@ esp_err_t WebServer::apiSseHandler(httpd_req_t *req) {
     // Allow Port 80 UI to connect to Port 81 SSE
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
 
-    char sse_data[300];
+    PureSpaService* spa = getSpaQuery(req);
+    if (spa == nullptr) return ESP_FAIL;
+    PureSpaService& service = *spa;
     esp_err_t err = ESP_OK;
+    uint32_t version = service.getStatusVersion() - 1;
     
+    // Copied out like in sendStatus, so a slow client does not hold the
+    // status lock (and with it refreshStatus and the MQTT listener)
+    char doc[PureSpaService::STATUS_JSON_SIZE];
+    size_t len = 0;
     while (err == ESP_OK) {
-        std::string status = PureSpaService::getInstance().getStatusJson();
-        int len = snprintf(sse_data, sizeof(sse_data), "data: %s\n\n", status.c_str());
-        err = httpd_resp_send_chunk(req, sse_data, len);
+        service.withStatusJson([&](const char* json, size_t n, uint32_t v, uint32_t renders) {
+            memcpy(doc, json, n);
+            len = n;
+            version = v;
+        });
+        err = httpd_resp_send_chunk(req, "data: ", 6);
+        if (err == ESP_OK) err = httpd_resp_send_chunk(req, doc, len);
+        if (err == ESP_OK) err = httpd_resp_send_chunk(req, "\n\n", 2);
         if (err != ESP_OK) break;
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        service.waitForStatusChange(version, 1000);
     }
     httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
 esp_err_t WebServer::apiScheduleGetHandler(httpd_req_t *req) {
-    std::string schedule = PureSpaService::getInstance().getScheduleJson();
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, schedule.c_str(), HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    if (!isFirstSpaQuery(req)) return ESP_FAIL;
+    return sendDocument(req, [](DocWriter& w) {
+        PureSpaService::getInstance().writeSchedule(w);
+    });
 }
 
 esp_err_t WebServer::apiScheduleAddHandler(httpd_req_t *req) {
+    if (!isFirstSpaQuery(req)) return ESP_FAIL;
     ESP_LOGI(TAG, "POST /api/schedule/add");
-    char buf[512];
-    int ret = httpd_req_recv(req, buf, req->content_len);
-    if (ret <= 0) return ESP_FAIL;
-    buf[ret] = '\0';
-
-    cJSON *json = cJSON_Parse(buf);
-    if (json == NULL) return ESP_FAIL;
-
     ScheduledEvent ev;
+    JsonFieldBinder binder(SCHEDULED_EVENT_FIELDS, SCHEDULED_EVENT_FIELD_COUNT, &ev);
+    if (readJsonBody(req, MAX_EVENT_BODY, binder) != ESP_OK) return ESP_FAIL;
+    if (!PureSpaService::isValidEvent(ev)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid event");
+        return ESP_FAIL;
+    }
     ev.enabled = true;
-    ev.recurring = cJSON_IsTrue(cJSON_GetObjectItem(json, "recurring"));
-    ev.dayOfWeekMask = cJSON_GetObjectItem(json, "dow") ? cJSON_GetObjectItem(json, "dow")->valueint : 0;
-    ev.year = cJSON_GetObjectItem(json, "year") ? cJSON_GetObjectItem(json, "year")->valueint : 0;
-    ev.month = cJSON_GetObjectItem(json, "month") ? cJSON_GetObjectItem(json, "month")->valueint : 0;
-    ev.day = cJSON_GetObjectItem(json, "day") ? cJSON_GetObjectItem(json, "day")->valueint : 0;
-    ev.hour = cJSON_GetObjectItem(json, "hour") ? cJSON_GetObjectItem(json, "hour")->valueint : 0;
-    ev.minute = cJSON_GetObjectItem(json, "minute") ? cJSON_GetObjectItem(json, "minute")->valueint : 0;
-    
-    ev.setPower = cJSON_IsBool(cJSON_GetObjectItem(json, "setPower")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setPower")) : false;
-    ev.powerValue = cJSON_IsTrue(cJSON_GetObjectItem(json, "powerValue"));
-    ev.setFilter = cJSON_IsBool(cJSON_GetObjectItem(json, "setFilter")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setFilter")) : false;
-    ev.filterValue = cJSON_IsTrue(cJSON_GetObjectItem(json, "filterValue"));
-    ev.setHeater = cJSON_IsBool(cJSON_GetObjectItem(json, "setHeater")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setHeater")) : false;
-    ev.heaterValue = cJSON_IsTrue(cJSON_GetObjectItem(json, "heaterValue"));
-    ev.setBubble = cJSON_IsBool(cJSON_GetObjectItem(json, "setBubble")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setBubble")) : false;
-    ev.bubbleValue = cJSON_IsTrue(cJSON_GetObjectItem(json, "bubbleValue"));
-    ev.setTargetTemp = cJSON_IsBool(cJSON_GetObjectItem(json, "setTemp")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setTemp")) : false;
-    ev.targetTempValue = cJSON_GetObjectItem(json, "tempValue") ? cJSON_GetObjectItem(json, "tempValue")->valueint : 38;
 
     PureSpaService::getInstance().addEvent(ev);
     
-    cJSON_Delete(json);
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
 
 esp_err_t WebServer::apiScheduleUpdateHandler(httpd_req_t *req) {
+    if (!isFirstSpaQuery(req)) return ESP_FAIL;
     ESP_LOGI(TAG, "POST /api/schedule/update");
-    char buf[512];
-    int ret = httpd_req_recv(req, buf, req->content_len);
-    if (ret <= 0) return ESP_FAIL;
-    buf[ret] = '\0';
-
-    cJSON *json = cJSON_Parse(buf);
-    if (json == NULL) return ESP_FAIL;
-
-    cJSON *id_item = cJSON_GetObjectItem(json, "id");
-    if (!cJSON_IsNumber(id_item)) {
-        cJSON_Delete(json);
+    ScheduledEvent ev;
+    JsonFieldBinder binder(SCHEDULED_EVENT_FIELDS, SCHEDULED_EVENT_FIELD_COUNT, &ev);
+    if (readJsonBody(req, MAX_EVENT_BODY, binder) != ESP_OK) return ESP_FAIL;
+    if (!binder.has("id")) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing id");
+        return ESP_FAIL;
+    }
+    if (!PureSpaService::isValidEvent(ev)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid event");
         return ESP_FAIL;
     }
-    int id = id_item->valueint;
 
-    ScheduledEvent ev;
-    ev.enabled = cJSON_IsBool(cJSON_GetObjectItem(json, "enabled")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "enabled")) : true;
-    ev.recurring = cJSON_IsTrue(cJSON_GetObjectItem(json, "recurring"));
-    ev.dayOfWeekMask = cJSON_GetObjectItem(json, "dow") ? cJSON_GetObjectItem(json, "dow")->valueint : 0;
-    ev.year = cJSON_GetObjectItem(json, "year") ? cJSON_GetObjectItem(json, "year")->valueint : 0;
-    ev.month = cJSON_GetObjectItem(json, "month") ? cJSON_GetObjectItem(json, "month")->valueint : 0;
-    ev.day = cJSON_GetObjectItem(json, "day") ? cJSON_GetObjectItem(json, "day")->valueint : 0;
-    ev.hour = cJSON_GetObjectItem(json, "hour") ? cJSON_GetObjectItem(json, "hour")->valueint : 0;
-    ev.minute = cJSON_GetObjectItem(json, "minute") ? cJSON_GetObjectItem(json, "minute")->valueint : 0;
+    PureSpaService::getInstance().updateEvent(ev.id, ev);
     
-    ev.setPower = cJSON_IsBool(cJSON_GetObjectItem(json, "setPower")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setPower")) : false;
-    ev.powerValue = cJSON_IsTrue(cJSON_GetObjectItem(json, "powerValue"));
-    ev.setFilter = cJSON_IsBool(cJSON_GetObjectItem(json, "setFilter")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setFilter")) : false;
-    ev.filterValue = cJSON_IsTrue(cJSON_GetObjectItem(json, "filterValue"));
-    ev.setHeater = cJSON_IsBool(cJSON_GetObjectItem(json, "setHeater")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setHeater")) : false;
-    ev.heaterValue = cJSON_IsTrue(cJSON_GetObjectItem(json, "heaterValue"));
-    ev.setBubble = cJSON_IsBool(cJSON_GetObjectItem(json, "setBubble")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setBubble")) : false;
-    ev.bubbleValue = cJSON_IsTrue(cJSON_GetObjectItem(json, "bubbleValue"));
-    ev.setTargetTemp = cJSON_IsBool(cJSON_GetObjectItem(json, "setTemp")) ? cJSON_IsTrue(cJSON_GetObjectItem(json, "setTemp")) : false;
-    ev.targetTempValue = cJSON_GetObjectItem(json, "tempValue") ? cJSON_GetObjectItem(json, "tempValue")->valueint : 38;
-
-    PureSpaService::getInstance().updateEvent(id, ev);
-    
-    cJSON_Delete(json);
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
 
 esp_err_t WebServer::apiScheduleDeleteHandler(httpd_req_t *req) {
+    if (!isFirstSpaQuery(req)) return ESP_FAIL;
     ESP_LOGI(TAG, "POST /api/schedule/delete");
-    char buf[64];
-    int ret = httpd_req_recv(req, buf, req->content_len);
-    if (ret <= 0) return ESP_FAIL;
-    buf[ret] = '\0';
-
-    cJSON *json = cJSON_Parse(buf);
-    if (json == NULL) return ESP_FAIL;
-
-    int id = cJSON_GetObjectItem(json, "id")->valueint;
-    PureSpaService::getInstance().deleteEvent(id);
+    EventRefRequest ref;
+    JsonFieldBinder binder(EVENT_REF_FIELDS, FIELD_COUNT(EVENT_REF_FIELDS), &ref);
+    if (readJsonBody(req, MAX_EVENT_REF_BODY, binder) != ESP_OK) return ESP_FAIL;
+    if (!FIELD_SEEN(binder, EVENT_REF_ID)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing id");
+        return ESP_FAIL;
+    }
+    PureSpaService::getInstance().deleteEvent(ref.id);
 
-    cJSON_Delete(json);
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
 
 esp_err_t WebServer::apiScheduleToggleHandler(httpd_req_t *req) {
+    if (!isFirstSpaQuery(req)) return ESP_FAIL;
     ESP_LOGI(TAG, "POST /api/schedule/toggle");
-    char buf[64];
-    int ret = httpd_req_recv(req, buf, req->content_len);
-    if (ret <= 0) return ESP_FAIL;
-    buf[ret] = '\0';
-
-    cJSON *json = cJSON_Parse(buf);
-    if (json == NULL) return ESP_FAIL;
-
-    int id = cJSON_GetObjectItem(json, "id")->valueint;
-    bool enabled = cJSON_IsTrue(cJSON_GetObjectItem(json, "enabled"));
-    PureSpaService::getInstance().toggleEvent(id, enabled);
+    EventRefRequest ref;
+    JsonFieldBinder binder(EVENT_REF_FIELDS, FIELD_COUNT(EVENT_REF_FIELDS), &ref);
+    if (readJsonBody(req, MAX_EVENT_REF_BODY, binder) != ESP_OK) return ESP_FAIL;
+    if (!FIELD_SEEN(binder, EVENT_REF_ID)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing id");
+        return ESP_FAIL;
+    }
+    PureSpaService::getInstance().toggleEvent(ref.id, ref.enabled);
 
-    cJSON_Delete(json);
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
 
 esp_err_t WebServer::apiAdminTimeHandler(httpd_req_t *req) {
-    char buf[128];
-    int ret = httpd_req_recv(req, buf, req->content_len);
-    if (ret <= 0) return ESP_FAIL;
-    buf[ret] = '\0';
-
-    cJSON *json = cJSON_Parse(buf);
-    if (json == NULL) return ESP_FAIL;
+    TimeRequest tr;
+    JsonFieldBinder binder(TIME_FIELDS, FIELD_COUNT(TIME_FIELDS), &tr);
+    if (readJsonBody(req, MAX_TIME_BODY, binder) != ESP_OK) return ESP_FAIL;
 
-    cJSON *ts_item = cJSON_GetObjectItem(json, "timestamp");
-    if (cJSON_IsNumber(ts_item)) {
-        time_t timestamp = ts_item->valueint;
+    if (binder.seen()) {
+        time_t timestamp = tr.timestamp;
         struct timeval tv;
         tv.tv_sec = timestamp;
         tv.tv_usec = 0;
@@ -327,7 +994,6 @@ esp_err_t WebServer::apiAdminTimeHandler(httpd_req_t *req) {
         ESP_LOGI(TAG, "System time synchronized to: %ld", (long)timestamp);
     }
 
-    cJSON_Delete(json);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
@@ -355,6 +1021,7 @@ esp_err_t WebServer::apiAdminResetWifiHandler(httpd_req_t *req) {
         nvs_erase_all(nvs_handle);
         nvs_commit(nvs_handle);
         nvs_close(nvs_handle);
+        Metrics::getInstance().countNvsCommit("wifi_creds");
         ESP_LOGI(TAG, "Wi-Fi credentials erased from NVS");
     }
     
@@ -383,142 +1050,353 @@ esp_err_t WebServer::apiAdminResetAllHandler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-esp_err_t WebServer::apiAdminOtaHandler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "Starting OTA update upload...");
+// Receives up to len bytes, retrying socket timeouts (at most maxTimeouts
+// times, unbounded when negative); <= 0 when the connection is gone
+static int recvRetry(httpd_req_t *req, char *buf, size_t len, int maxTimeouts = -1) {
+    int ret;
+    int timeouts = 0;
+    do {
+        ret = httpd_req_recv(req, buf, len);
+    } while (ret == HTTPD_SOCK_ERR_TIMEOUT && (maxTimeouts < 0 || timeouts++ < maxTimeouts));
+    return ret;
+}
 
-    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "Passive OTA partition not found");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No passive OTA partition found");
-        return ESP_FAIL;
+// Receives len bytes straight into the updater's ring; the writer task flashes
+// full buffers meanwhile. ESP_ERR_INVALID_RESPONSE when the connection dropped.
+static esp_err_t receiveToUpdater(httpd_req_t *req, OtaUpdater& ota, size_t len, int maxTimeouts = -1) {
+    while (len > 0) {
+        size_t room;
+        char* buf = ota.reserve(&room);
+        if (buf == NULL) return ESP_ERR_TIMEOUT;
+        int ret = recvRetry(req, buf, len < room ? len : room, maxTimeouts);
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Connection closed or error during OTA receive (%d)", ret);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        len -= ret;
+        esp_err_t err = ota.commit(ret);
+        if (err != ESP_OK) return err;
     }
-    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, (unsigned long)update_partition->address);
+    return ESP_OK;
+}
 
-    esp_ota_handle_t update_handle = 0;
-    esp_err_t err = esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &update_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA begin failed");
-        return ESP_FAIL;
+static void sendOtaReceiveError(httpd_req_t *req, esp_err_t err) {
+    if (err == ESP_ERR_INVALID_RESPONSE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Connection lost during upload");
+    } else if (err == ESP_ERR_TIMEOUT) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Flash writer stalled");
+    } else {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Flash write failed");
     }
+}
 
-    char *buf = (char *)malloc(1024);
-    if (buf == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for buffer");
-        esp_ota_abort(update_handle);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+// Answers the outcome of OtaUpdater::finish() and reboots into the new image on success
+static esp_err_t completeOta(httpd_req_t *req, esp_err_t err) {
+    if (err != ESP_OK) {
+        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
+            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Image validation failed");
+        } else {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA validation end failed");
+        }
         return ESP_FAIL;
     }
 
-    int remaining = req->content_len;
-    int received = 0;
-    while (remaining > 0) {
-        int read_len = (remaining > 1024) ? 1024 : remaining;
-        int ret = httpd_req_recv(req, buf, read_len);
+    ESP_LOGI(TAG, "OTA update successful! Rebooting in 1 second...");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
+
+    xTaskCreate(reboot_task, "reboot_task", 2048, NULL, 5, NULL);
+    return ESP_OK;
+}
+
+static esp_err_t otaDecodedOutput(void *ctx, const char *data, size_t len) {
+    return static_cast<OtaUpdater*>(ctx)->write(data, len);
+}
+
+// Streams the rest of an encoded upload through a decoder (gzip or delta)
+// that hands the plain image to the updater. ESP_ERR_INVALID_RESPONSE when
+// the connection dropped, otherwise the decoder's verdict.
+template <typename Decoder>
+static esp_err_t receiveDecoded(httpd_req_t *req, Decoder& decoder, const char *head, size_t headLen, size_t remaining) {
+    char buf[1024];
+    esp_err_t err = decoder.init();
+    if (err == ESP_OK) err = decoder.feed((const uint8_t*)head, headLen);
+    while (err == ESP_OK && remaining > 0) {
+        int ret = recvRetry(req, buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
         if (ret <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                continue;
-            }
             ESP_LOGE(TAG, "Connection closed or error during OTA receive (%d)", ret);
-            free(buf);
-            esp_ota_abort(update_handle);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        remaining -= ret;
+        err = decoder.feed((const uint8_t*)buf, ret);
+    }
+    if (err == ESP_OK) err = decoder.finish();
+    return err;
+}
+
+esp_err_t WebServer::apiAdminOtaHandler(httpd_req_t *req) {
+    if (!isAsyncWorker()) return queueAsync(req, apiAdminOtaHandler);
+    ESP_LOGI(TAG, "Starting OTA update upload...");
+
+    // A plain image starts with 0xE9, a gzip stream with 1f 8b, a delta patch with "PSDL"
+    char encoding[16] = "";
+    httpd_req_get_hdr_value_str(req, "Content-Encoding", encoding, sizeof(encoding));
+    char head[4];
+    size_t headLen = 0;
+    size_t remaining = req->content_len;
+    while (headLen < sizeof(head) && remaining > 0) {
+        int ret = recvRetry(req, head + headLen, sizeof(head) - headLen);
+        if (ret <= 0) {
             httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Connection lost during upload");
             return ESP_FAIL;
         }
+        headLen += ret;
+        remaining -= ret;
+    }
+    bool delta = DeltaPatcher::isDelta((const uint8_t*)head, headLen);
+    bool gzip = !delta && (strcmp(encoding, "gzip") == 0 || GzipInflater::isGzip((const uint8_t*)head, headLen));
 
-        err = esp_ota_write(update_handle, (const void *)buf, ret);
+    OtaUpdater& ota = OtaUpdater::getInstance();
+    esp_err_t err = ota.begin(gzip || delta ? 0 : req->content_len);
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "An update is already running");
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA begin failed");
+        return ESP_FAIL;
+    }
+
+    if (gzip || delta) {
+        // Decode on the fly; the updater only ever sees the plain image
+        const char* invalid = "Invalid compressed image";
+        size_t produced;
+        if (delta) {
+            ESP_LOGI(TAG, "Receiving delta patch (%d bytes)", (int)req->content_len);
+            DeltaPatcher patcher(otaDecodedOutput, &ota);
+            err = receiveDecoded(req, patcher, head, headLen, remaining);
+            produced = patcher.outputSize();
+            invalid = err == ESP_ERR_INVALID_VERSION ? "Patch does not match the running firmware" : "Invalid delta patch";
+        } else {
+            ESP_LOGI(TAG, "Receiving gzip compressed image (%d bytes)", (int)req->content_len);
+            GzipInflater inflater(otaDecodedOutput, &ota);
+            err = receiveDecoded(req, inflater, head, headLen, remaining);
+            produced = inflater.outputSize();
+        }
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "esp_ota_write failed (%s)", esp_err_to_name(err));
-            free(buf);
-            esp_ota_abort(update_handle);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Flash write failed");
+            ota.abort();
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                err == ESP_ERR_INVALID_RESPONSE ? "Connection lost during upload" : invalid);
             return ESP_FAIL;
         }
-
-        remaining -= ret;
-        received += ret;
-        if (received % 102400 == 0 || remaining == 0) {
-            ESP_LOGI(TAG, "OTA Progress: %d / %d bytes written", received, (int)req->content_len);
+        ESP_LOGI(TAG, "Decoded %d bytes to %d bytes", (int)req->content_len, (int)produced);
+    } else {
+        err = ota.write(head, headLen);
+        if (err == ESP_OK) err = receiveToUpdater(req, ota, remaining);
+        if (err != ESP_OK) {
+            ota.abort();
+            sendOtaReceiveError(req, err);
+            return ESP_FAIL;
         }
     }
 
-    free(buf);
+    return completeOta(req, ota.finish());
+}
 
-    err = esp_ota_end(update_handle);
-    if (err != ESP_OK) {
-        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
-            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
-            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Image validation failed");
-        } else {
-            ESP_LOGE(TAG, "esp_ota_end failed (%s)", esp_err_to_name(err));
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA validation end failed");
-        }
+static void writeOtaSession(DocWriter& w, const OtaSession::Info& info) {
+    w.beginObject()
+        .field("id", info.id)
+        .field("size", info.size)
+        .field("offset", info.offset)
+        .field("flushed", info.flushed)
+        .field("expires_ms", info.expiresInMs)
+        .endObject();
+}
+
+// Reads ?id=<session>[&offset=<n>]
+static bool getOtaSessionQuery(httpd_req_t *req, char (&id)[OtaSession::ID_LEN + 1], uint32_t* offset) {
+    char query[48];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) return false;
+    if (httpd_query_key_value(query, "id", id, sizeof(id)) != ESP_OK) return false;
+    if (offset) {
+        char value[12];
+        if (httpd_query_key_value(query, "offset", value, sizeof(value)) != ESP_OK) return false;
+        *offset = strtoul(value, NULL, 10);
+    }
+    return true;
+}
+
+// Claims the session named in the query, answering 400/404/409 itself on failure
+static bool acquireOtaSession(httpd_req_t *req, uint32_t* offset) {
+    char id[OtaSession::ID_LEN + 1];
+    if (!getOtaSessionQuery(req, id, offset)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing session id or offset");
+        return false;
+    }
+    esp_err_t err = OtaSession::getInstance().acquire(id);
+    if (err == ESP_ERR_NOT_FOUND) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown or expired session");
+        return false;
+    } else if (err != ESP_OK) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Session is busy");
+        return false;
+    }
+    return true;
+}
+
+esp_err_t WebServer::apiAdminOtaSessionStartHandler(httpd_req_t *req) {
+    OtaSessionRequest body;
+    JsonFieldBinder binder(OTA_SESSION_FIELDS, FIELD_COUNT(OTA_SESSION_FIELDS), &body);
+    if (readJsonBody(req, MAX_OTA_SESSION_BODY, binder) != ESP_OK) return ESP_FAIL;
+    if (body.size <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing image size");
         return ESP_FAIL;
     }
 
-    err = esp_ota_set_boot_partition(update_partition);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_ota_set_boot_partition failed (%s)", esp_err_to_name(err));
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to set boot partition");
+    OtaSession::Info info;
+    esp_err_t err = OtaSession::getInstance().start(body.size, &info);
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "An update is already running");
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA begin failed");
         return ESP_FAIL;
     }
+    return sendDocument(req, [&](DocWriter& w) { writeOtaSession(w, info); });
+}
+
+esp_err_t WebServer::apiAdminOtaSessionGetHandler(httpd_req_t *req) {
+    char id[OtaSession::ID_LEN + 1];
+    OtaSession::Info info = OtaSession::getInstance().getInfo();
+    if (!getOtaSessionQuery(req, id, NULL) || !info.active || strcmp(id, info.id) != 0) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown or expired session");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return sendDocument(req, [&](DocWriter& w) { writeOtaSession(w, info); });
+}
+
+// PUT ?id=<session>&offset=<n> with the image bytes starting at n. Bytes the
+// device already has are skipped, a gap is refused with the current offset.
+esp_err_t WebServer::apiAdminOtaSessionPutHandler(httpd_req_t *req) {
+    if (!isAsyncWorker()) return queueAsync(req, apiAdminOtaSessionPutHandler);
+    uint32_t offset;
+    if (!acquireOtaSession(req, &offset)) return ESP_FAIL;
+
+    OtaSession& session = OtaSession::getInstance();
+    OtaSession::Info info = session.getInfo();
+    size_t remaining = req->content_len;
+    if (offset > info.offset) {
+        session.release();
+        httpd_resp_set_status(req, "409 Conflict");
+        return sendDocument(req, [&](DocWriter& w) { writeOtaSession(w, info); });
+    }
+    if (offset + remaining > info.size) {
+        session.release();
+        httpd_resp_set_status(req, "413 Payload Too Large");
+        httpd_resp_sendstr(req, "Chunk exceeds image size");
+        return ESP_FAIL;
+    }
+
+    // Drop the part of a resent chunk that was accepted before the link broke
+    size_t overlap = info.offset - offset;
+    if (overlap > remaining) overlap = remaining;
+    remaining -= overlap;
+    char scratch[256];
+    while (overlap > 0) {
+        int ret = recvRetry(req, scratch, overlap < sizeof(scratch) ? overlap : sizeof(scratch), OTA_CHUNK_RECV_TIMEOUTS);
+        if (ret <= 0) {
+            session.release();
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Connection lost during upload");
+            return ESP_FAIL;
+        }
+        overlap -= ret;
+    }
+
+    esp_err_t err = receiveToUpdater(req, OtaUpdater::getInstance(), remaining, OTA_CHUNK_RECV_TIMEOUTS);
+    if (err == ESP_ERR_INVALID_RESPONSE) {
+        // Everything received so far stays accepted; the client resumes from the session offset
+        session.release();
+        sendOtaReceiveError(req, err);
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        session.cancel();
+        sendOtaReceiveError(req, err);
+        return ESP_FAIL;
+    }
+
+    session.release();
+    info = session.getInfo();
+    return sendDocument(req, [&](DocWriter& w) { writeOtaSession(w, info); });
+}
+
+esp_err_t WebServer::apiAdminOtaSessionFinalizeHandler(httpd_req_t *req) {
+    if (!isAsyncWorker()) return queueAsync(req, apiAdminOtaSessionFinalizeHandler);
+    if (!acquireOtaSession(req, NULL)) return ESP_FAIL;
+
+    OtaSession& session = OtaSession::getInstance();
+    OtaSession::Info info = session.getInfo();
+    if (info.offset != info.size) {
+        session.release();
+        httpd_resp_set_status(req, "409 Conflict");
+        return sendDocument(req, [&](DocWriter& w) { writeOtaSession(w, info); });
+    }
+    return completeOta(req, session.finish());
+}
+
+esp_err_t WebServer::apiAdminOtaSessionDeleteHandler(httpd_req_t *req) {
+    if (!isAsyncWorker()) return queueAsync(req, apiAdminOtaSessionDeleteHandler);
+    if (!acquireOtaSession(req, NULL)) return ESP_FAIL;
+    OtaSession::getInstance().cancel();
 
-    ESP_LOGI(TAG, "OTA update successful! Rebooting in 1 second...");
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
-
-    xTaskCreate(reboot_task, "reboot_task", 2048, NULL, 5, NULL);
     return ESP_OK;
 }
 
 esp_err_t WebServer::apiAdminAuditGetHandler(httpd_req_t *req) {
-    std::vector<AuditEvent> events = AuditLogger::getInstance().getEvents();
-    cJSON *root = cJSON_CreateArray();
-    for (const auto& ev : events) {
-        cJSON *item = cJSON_CreateObject();
-        cJSON_AddNumberToObject(item, "timestamp", ev.timestamp);
-        cJSON_AddStringToObject(item, "source", ev.source);
-        cJSON_AddStringToObject(item, "feature", ev.feature);
-        cJSON_AddBoolToObject(item, "state", ev.state);
-        cJSON_AddItemToArray(root, item);
-    }
-    char *json_str = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_send(req, json_str, HTTPD_RESP_USE_STRLEN);
-    free(json_str);
-    return ESP_OK;
+    return sendDocument(req, [](DocWriter& w) {
+        Metrics::ProfileScope profile(Metrics::PROFILE_AUDIT_WRITE);
+        AuditLogger& logger = AuditLogger::getInstance();
+        AuditEvent batch[8];
+        size_t start = 0;
+        size_t count;
+        w.beginArray();
+        while ((count = logger.copyEvents(start, batch, 8)) > 0 && w.ok()) {
+            for (size_t i = 0; i < count; i++) {
+                w.beginObject()
+                    .field("timestamp", (long long)batch[i].timestamp)
+                    .field("source", batch[i].source)
+                    .field("feature", batch[i].feature)
+                    .field("state", batch[i].state)
+                    .endObject();
+            }
+            start += count;
+        }
+        w.endArray();
+        profile.setUnits(start);
+    });
 }
 
 esp_err_t WebServer::apiAdminAuditConfigGetHandler(httpd_req_t *req) {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "retentionDays", AuditLogger::getInstance().getRetentionDays());
-    char *json_str = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_send(req, json_str, HTTPD_RESP_USE_STRLEN);
-    free(json_str);
-    return ESP_OK;
+    return sendDocument(req, [](DocWriter& w) {
+        w.beginObject()
+            .field("retentionDays", AuditLogger::getInstance().getRetentionDays())
+            .endObject();
+    });
 }
 
 esp_err_t WebServer::apiAdminAuditConfigPostHandler(httpd_req_t *req) {
-    char buf[64];
-    int ret = httpd_req_recv(req, buf, req->content_len);
-    if (ret <= 0) return ESP_FAIL;
-    buf[ret] = '\0';
-    
-    cJSON *json = cJSON_Parse(buf);
-    if (json == NULL) return ESP_FAIL;
+    AuditConfigRequest cfg;
+    JsonFieldBinder binder(AUDIT_CONFIG_FIELDS, FIELD_COUNT(AUDIT_CONFIG_FIELDS), &cfg);
+    if (readJsonBody(req, MAX_AUDIT_CONFIG_BODY, binder) != ESP_OK) return ESP_FAIL;
     
-    cJSON *days_item = cJSON_GetObjectItem(json, "retentionDays");
-    if (cJSON_IsNumber(days_item)) {
-        AuditLogger::getInstance().setRetentionDays(days_item->valueint);
+    if (binder.seen()) {
+        AuditLogger::getInstance().setRetentionDays(cfg.retentionDays);
     }
-    cJSON_Delete(json);
     
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
@@ -531,3 +1409,38 @@ esp_err_t WebServer::apiAdminAuditClearHandler(httpd_req_t *req) {
     httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
+
+// Compact per-endpoint latency/throughput summary for the admin panel
+esp_err_t WebServer::apiAdminHttpStatsHandler(httpd_req_t *req) {
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return sendDocument(req, [](DocWriter& w) {
+        Metrics::getInstance().writeHttpStats(w);
+    });
+}
+
+// Bus signal quality: rolling one-minute window, totals and per-slot errors
+esp_err_t WebServer::apiDebugBusHandler(httpd_req_t *req) {
+    PureSpaService* spa = getSpaQuery(req);
+    if (spa == nullptr) return ESP_FAIL;
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return sendDocument(req, [spa](DocWriter& w) {
+        spa->writeBusStats(w);
+    });
+}
+
+// Cost of the profiled code paths, for comparing firmware builds
+esp_err_t WebServer::apiDebugProfileHandler(httpd_req_t *req) {
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return sendDocument(req, [](DocWriter& w) {
+        Metrics::getInstance().writeProfile(w);
+    });
+}
+
+// Prometheus text exposition, streamed in chunks
+esp_err_t WebServer::metricsHandler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = Metrics::getInstance().render(httpdChunkFlush, req);
+    if (err != ESP_OK) return err;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -2,6 +2,13 @@
 #define WEB_SERVER_H
 
 #include <esp_http_server.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "metrics.h"
+#include <mutex>
+
+class PureSpaService;
 
 class WebServer {
 public:
@@ -16,15 +23,98 @@ public:
     void start();
     void stop();
 
+    size_t getAsyncQueueDepth() const { return _asyncQueue != NULL ? uxQueueMessagesWaiting(_asyncQueue) : 0; }
+    size_t getParkedPollCount();
+
 private:
-    WebServer() : _mainServer(NULL), _sseServer(NULL) {}
+    typedef esp_err_t (*RequestHandler)(httpd_req_t *req);
+
+    // Every URI is registered through timedHandler, with a Route as user_ctx,
+    // so request counts and durations are recorded in one place
+    static const size_t MAX_ROUTES = 40;
+
+    struct Route {
+        RequestHandler handler;
+        Metrics::Endpoint* stats;
+    };
+
+    // The httpd task itself builds /api/bootstrap (status copy, chunk buffer,
+    // writers, gzip and lwIP send frames), too much for the 4096 B default
+    static const uint32_t HTTPD_STACK = 6144;
+
+    // Long-running handlers (OTA upload, batches) are handed to a small worker
+    // pool so the single httpd task keeps serving short requests
+    static const int ASYNC_WORKER_COUNT = 3;
+    static const int ASYNC_QUEUE_SIZE = 4;
+    static const uint32_t ASYNC_WORKER_STACK = 6144;
+
+    // Measurements of the request being handled by the current task. The send
+    // override and long-poll parking add to it through a thread-local pointer.
+    struct RequestContext {
+        int64_t startedAt;     // [us] when the httpd task received it
+        int64_t sendUs;        // blocked in send()
+        int64_t parkedUs;      // waiting for a status change, not work
+        uint32_t bytesOut;
+        uint32_t freeHeap;     // at start, for the heap delta
+        bool detached;         // handed to a worker, recorded there
+    };
+
+    struct AsyncRequest {
+        httpd_req_t *req;
+        RequestHandler handler;
+        RequestContext ctx;
+    };
+
+    // Status long-polls do not take a worker: they are parked here and one
+    // task answers them when the status version moves or their wait runs out.
+    // Beyond MAX_PARKED_POLLS they get 503 like a saturated worker queue.
+    static const int MAX_PARKED_POLLS = 4;
+    static const uint32_t POLL_CHECK_MS = 20;
+    static const uint32_t POLL_TASK_STACK = 4096;
+
+    struct ParkedPoll {
+        httpd_req_t *req;
+        PureSpaService *service;
+        uint32_t since;        // status version the client has
+        int64_t parkedAt;      // [us]
+        int64_t deadline;      // [us]
+        RequestContext ctx;
+    };
+
+    // Request being handled by this task (httpd or async worker), if any
+    static thread_local RequestContext* _currentRequest;
+
+    WebServer() : _mainServer(NULL), _sseServer(NULL), _asyncQueue(NULL), _asyncWorkers(), _pollTask(NULL) {}
     httpd_handle_t _mainServer;
     httpd_handle_t _sseServer;
+    QueueHandle_t _asyncQueue;
+    TaskHandle_t _asyncWorkers[ASYNC_WORKER_COUNT];
+    TaskHandle_t _pollTask;
+    std::mutex _pollMutex;
+    ParkedPoll _polls[MAX_PARKED_POLLS] = {};
+    size_t _pollCount = 0;
+    Route _routes[MAX_ROUTES] = {};
+    size_t _routeCount = 0;
+
+    void startAsyncWorkers();
+    static void asyncWorkerTask(void *param);
+    static bool isAsyncWorker();
+    static esp_err_t queueAsync(httpd_req_t *req, RequestHandler handler);
+    static void statusPollTask(void *param);
+    static esp_err_t parkStatusPoll(httpd_req_t *req, PureSpaService& service, uint32_t since, uint32_t waitMs);
+    static esp_err_t sendStatus(httpd_req_t *req, PureSpaService& service);
+    void registerRoutes(const httpd_uri_t* const* uris, size_t count);
+    static esp_err_t timedHandler(httpd_req_t *req);
+    static void recordRequest(httpd_req_t *req, const RequestContext& ctx, esp_err_t err);
+    static int countingSend(httpd_handle_t hd, int sockfd, const char *buf, size_t len, int flags);
 
-    static esp_err_t rootGetHandler(httpd_req_t *req);
-    static esp_err_t faviconGetHandler(httpd_req_t *req);
     static esp_err_t apiStatusHandler(httpd_req_t *req);
+    static esp_err_t apiBootstrapHandler(httpd_req_t *req);
     static esp_err_t apiControlHandler(httpd_req_t *req);
+    static esp_err_t apiControlBatchHandler(httpd_req_t *req);
+    static esp_err_t apiScenesGetHandler(httpd_req_t *req);
+    static esp_err_t apiScenesSaveHandler(httpd_req_t *req);
+    static esp_err_t apiScenesDeleteHandler(httpd_req_t *req);
     static esp_err_t apiSseHandler(httpd_req_t *req);
     static esp_err_t apiScheduleGetHandler(httpd_req_t *req);
     static esp_err_t apiScheduleAddHandler(httpd_req_t *req);
@@ -37,10 +127,19 @@ private:
     static esp_err_t apiAdminResetScheduleHandler(httpd_req_t *req);
     static esp_err_t apiAdminResetAllHandler(httpd_req_t *req);
     static esp_err_t apiAdminOtaHandler(httpd_req_t *req);
+    static esp_err_t apiAdminOtaSessionStartHandler(httpd_req_t *req);
+    static esp_err_t apiAdminOtaSessionGetHandler(httpd_req_t *req);
+    static esp_err_t apiAdminOtaSessionPutHandler(httpd_req_t *req);
+    static esp_err_t apiAdminOtaSessionFinalizeHandler(httpd_req_t *req);
+    static esp_err_t apiAdminOtaSessionDeleteHandler(httpd_req_t *req);
     static esp_err_t apiAdminAuditGetHandler(httpd_req_t *req);
     static esp_err_t apiAdminAuditConfigGetHandler(httpd_req_t *req);
     static esp_err_t apiAdminAuditConfigPostHandler(httpd_req_t *req);
     static esp_err_t apiAdminAuditClearHandler(httpd_req_t *req);
+    static esp_err_t metricsHandler(httpd_req_t *req);
+    static esp_err_t apiAdminHttpStatsHandler(httpd_req_t *req);
+    static esp_err_t apiDebugBusHandler(httpd_req_t *req);
+    static esp_err_t apiDebugProfileHandler(httpd_req_t *req);
 };
 
 #endif // WEB_SERVER_H
@@ -6,6 +6,7 @@
 #include "nvs_flash.h"
 #include "mdns.h"
 #include "status_led.h"
+#include "metrics.h"
 
 static const char *TAG = "WiFiManager";
 
@@ -134,4 +135,5 @@ void WiFiManager::saveCredentials(const std::string& ssid, const std::string& pa
     ESP_ERROR_CHECK(nvs_set_str(nvs_handle, WIFI_PASS_KEY, password.c_str()));
     ESP_ERROR_CHECK(nvs_commit(nvs_handle));
     nvs_close(nvs_handle);
+    Metrics::getInstance().countNvsCommit(WIFI_NAMESPACE);
 }
@@ -180,8 +180,26 @@ app.post('/config', (req: Request, res: Response) => {
 });
 
 // APIs
+let statusVersion = 1;
+
 app.get('/api/status', (req: Request, res: Response) => {
-  res.json(state);
+  // Long-poll: the mock simply answers with a new version after the metrics period
+  if (req.query.since !== undefined && req.query.wait !== undefined) {
+    const wait = Math.min(Number(req.query.wait), 5000);
+    setTimeout(() => res.json({ ...state, version: ++statusVersion }), wait);
+    return;
+  }
+  res.json({ ...state, version: statusVersion });
+});
+
+app.get('/api/bootstrap', (req: Request, res: Response) => {
+  res.json({
+    status: { ...state, version: statusVersion },
+    capabilities: { model: 'Intex PureSpa SB-H20', jet: false, disinfection: false, minTemp: 20, maxTemp: 40, maxEvents: 10, maxScenes: 8 },
+    schedule: scheduleList,
+    scenes,
+    audit: { retentionDays }
+  });
 });
 
 app.post('/api/control', (req: Request, res: Response) => {
@@ -356,6 +374,48 @@ app.post('/api/admin/ota', express.raw({ type: 'application/octet-stream', limit
   res.json({ status: 'ok' });
 });
 
+// Resumable OTA session: start, PUT chunks at an offset, query, finalize
+let otaSession: { id: string; size: number; offset: number } | null = null;
+
+const otaSessionInfo = () => ({ ...otaSession!, flushed: otaSession!.offset, expires_ms: 120000 });
+
+app.post('/api/admin/ota/session', (req: Request, res: Response) => {
+  const size = Number(req.body?.size);
+  if (!(size > 0)) return res.status(400).send('Missing image size');
+  otaSession = { id: Math.floor(Math.random() * 0xffffffff).toString(16).padStart(8, '0'), size, offset: 0 };
+  console.log(`[Admin API] OTA session ${otaSession.id} started for ${size} bytes`);
+  res.json(otaSessionInfo());
+});
+
+app.get('/api/admin/ota/session', (req: Request, res: Response) => {
+  if (!otaSession || req.query.id !== otaSession.id) return res.status(404).send('Unknown or expired session');
+  res.json(otaSessionInfo());
+});
+
+app.put('/api/admin/ota/session', express.raw({ type: 'application/octet-stream', limit: '1mb' }), (req: Request, res: Response) => {
+  if (!otaSession || req.query.id !== otaSession.id) return res.status(404).send('Unknown or expired session');
+  const offset = Number(req.query.offset);
+  const data = req.body as Buffer;
+  if (offset > otaSession.offset) return res.status(409).json(otaSessionInfo());
+  if (offset + data.length > otaSession.size) return res.status(413).send('Chunk exceeds image size');
+  otaSession.offset = Math.max(otaSession.offset, offset + data.length);
+  res.json(otaSessionInfo());
+});
+
+app.post('/api/admin/ota/session/finalize', (req: Request, res: Response) => {
+  if (!otaSession || req.query.id !== otaSession.id) return res.status(404).send('Unknown or expired session');
+  if (otaSession.offset !== otaSession.size) return res.status(409).json(otaSessionInfo());
+  console.log(`[Admin API] OTA session ${otaSession.id} completed (${otaSession.size} bytes).`);
+  otaSession = null;
+  res.json({ status: 'ok' });
+});
+
+app.delete('/api/admin/ota/session', (req: Request, res: Response) => {
+  if (!otaSession || req.query.id !== otaSession.id) return res.status(404).send('Unknown or expired session');
+  otaSession = null;
+  res.json({ status: 'ok' });
+});
+
 app.get('/api/admin/audit', (req: Request, res: Response) => {
   console.log('[Admin API] Fetching mock audit trail events');
   const cutoff = Math.floor(Date.now() / 1000) - (retentionDays * 24 * 3600);
@@ -383,6 +443,54 @@ app.post('/api/admin/audit/clear', (req: Request, res: Response) => {
   res.json({ status: 'ok' });
 });
 
+interface SpaCommand {
+  cmd: string;
+  value: boolean | number;
+}
+
+let scenes: { name: string; commands: SpaCommand[] }[] = [];
+
+app.post('/api/control/batch', (req: Request, res: Response) => {
+  let commands: SpaCommand[] = req.body.commands || [];
+  if (req.body.scene) {
+    const scene = scenes.find(s => s.name === req.body.scene);
+    if (!scene) return res.status(404).send('Unknown scene');
+    commands = scene.commands;
+  }
+  console.log(`[Control API] batch:`, commands);
+
+  let executed = 0;
+  if (commands.some(c => c.cmd !== 'power' && c.value !== false) && !state.power) {
+    state.power = true;
+    executed++;
+  }
+  for (const c of commands) {
+    if (c.cmd === 'power') state.power = c.value as boolean;
+    else if (c.cmd === 'filter') state.filter = c.value as boolean;
+    else if (c.cmd === 'heater') state.heater = c.value as boolean;
+    else if (c.cmd === 'bubble') state.bubble = c.value as boolean;
+    else if (c.cmd === 'temp') state.set_temp = c.value as number;
+    executed++;
+  }
+  res.json({ status: 'ok', executed, failed: 0, skipped: 0, duration_ms: 0 });
+});
+
+app.get('/api/scenes', (req: Request, res: Response) => {
+  res.json(scenes);
+});
+
+app.post('/api/scenes/save', (req: Request, res: Response) => {
+  const { name, commands } = req.body;
+  scenes = scenes.filter(s => s.name !== name);
+  scenes.push({ name, commands });
+  res.json({ status: 'ok' });
+});
+
+app.post('/api/scenes/delete', (req: Request, res: Response) => {
+  scenes = scenes.filter(s => s.name !== req.body.name);
+  res.json({ status: 'ok' });
+});
+
 // Run server
 app.listen(PORT, () => {
   console.log(`==================================================`);
@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+#
+# Generates the static asset table served by main/static_assets.cpp:
+#
+#   gen_assets.py [--brotli] <output.h> <file>=<url>[,<url>...] ...
+#
+# HTML pages keep their URLs and are revalidated with ETags. Every other asset
+# is also published under /static/<hash>/<name> with immutable caching, and
+# references to its plain URLs inside the pages are rewritten to that path.
+# Text is embedded gzip (and brotli) compressed, binary formats as they are.
+import gzip
+import hashlib
+import os
+import sys
+
+CONTENT_TYPES = {
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.json': 'application/json',
+    '.svg': 'image/svg+xml',
+    '.png': 'image/png',
+    '.ico': 'image/x-icon',
+}
+COMPRESSIBLE = ('text/', 'application/javascript', 'application/json', 'image/svg+xml')
+
+
+class Asset:
+    def __init__(self, path: str, urls: list) -> None:
+        self.path = path
+        self.name = os.path.basename(path)
+        self.urls = urls
+        self.content_type = CONTENT_TYPES.get(os.path.splitext(path)[1], 'application/octet-stream')
+        with open(path, 'rb') as f:
+            self.data = f.read()
+
+    @property
+    def is_page(self) -> bool:
+        return self.content_type == 'text/html'
+
+    @property
+    def digest(self) -> str:
+        return hashlib.sha256(self.data).hexdigest()
+
+    @property
+    def hashed_url(self) -> str:
+        return f'/static/{self.digest[:8]}/{self.name}'
+
+
+def encode(asset: Asset, use_brotli: bool) -> list:
+    """(encoding, data) pairs in order of preference; None is identity."""
+    if not asset.content_type.startswith(COMPRESSIBLE):
+        return [(None, asset.data)]
+    variants = []
+    if use_brotli:
+        import brotli
+        variants.append(('br', brotli.compress(asset.data, quality=11)))
+    # mtime=0 keeps the output reproducible
+    variants.append(('gzip', gzip.compress(asset.data, compresslevel=9, mtime=0)))
+    return variants
+
+
+def c_array(name: str, data: bytes) -> str:
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join(f'0x{b:02x}' for b in data[i:i + 16]) + ',')
+    return f'static const uint8_t {name}[] = {{\n' + '\n'.join(lines) + '\n};\n'
+
+
+def c_string(value) -> str:
+    if value is None:
+        return 'NULL'
+    return '"' + value.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def main() -> None:
+    args = sys.argv[1:]
+    use_brotli = '--brotli' in args
+    args = [a for a in args if a != '--brotli']
+    if len(args) < 2:
+        sys.exit('usage: gen_assets.py [--brotli] <output.h> <file>=<url>[,<url>...] ...')
+    if use_brotli:
+        try:
+            import brotli  # noqa: F401
+        except ImportError:
+            print('gen_assets.py: python brotli module not found, embedding gzip only (pip install brotli)')
+            use_brotli = False
+
+    assets = []
+    for spec in args[1:]:
+        path, urls = spec.split('=', 1)
+        assets.append(Asset(path, urls.split(',')))
+
+    # Point the pages at the immutable copies of everything else
+    for page in (a for a in assets if a.is_page):
+        text = page.data.decode('utf-8')
+        for asset in (a for a in assets if not a.is_page):
+            for url in asset.urls:
+                text = text.replace(f'"{url}"', f'"{asset.hashed_url}"')
+        page.data = text.encode('utf-8')
+
+    out = ['// Generated by tools/gen_assets.py, do not edit\n']
+    table = []
+    total = 0
+    for i, asset in enumerate(assets):
+        variants = encode(asset, use_brotli)
+        etag = asset.digest[:16]
+        entries = []
+        for encoding, data in variants:
+            array = f'asset{i}_{encoding or "identity"}'
+            out.append(c_array(array, data))
+            tag = f'"{etag}-{encoding}"' if encoding else f'"{etag}"'
+            entries.append(f'    {{ {c_string(encoding)}, {c_string(tag)}, {array}, sizeof({array}) }},')
+            total += len(data)
+        out.append(f'static const StaticAssetVariant asset{i}_variants[] = {{\n' + '\n'.join(entries) + '\n};\n')
+
+        urls = [(url, False) for url in asset.urls]
+        if not asset.is_page:
+            urls.append((asset.hashed_url, True))
+        for url, immutable in urls:
+            table.append(f'    {{ {c_string(url)}, {c_string(asset.content_type)}, {"true" if immutable else "false"}, '
+                         f'asset{i}_variants, {len(variants)} }},')
+
+    out.append('static const StaticAsset STATIC_ASSETS[] = {\n' + '\n'.join(table) + '\n};\n')
+
+    with open(args[0], 'w') as f:
+        f.write('\n'.join(out))
+    print(f'{args[0]}: {len(assets)} assets, {total} bytes embedded')
+
+
+if __name__ == '__main__':
+    main()
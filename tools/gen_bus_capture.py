@@ -0,0 +1,125 @@
+#!/usr/bin/env python
+#
+# Synthesizes a display bus capture for ReplayBusBackend (SB-H20 frames):
+#
+#   gen_bus_capture.py [--cycles N] [--water 36] [--unit C] [--leds power,filter]
+#                      [--error E90] [--cut-rate 0.001] [--seed 1] [--fuzz] [output]
+#
+# Each 21 ms cycle is a CUE frame, five groups of the four display digits, four
+# LED frames and the button frames. --cut-rate cuts random frames short to
+# exercise the bit count error path. Writes to stdout without an output file.
+# --fuzz writes a seed for host_test/fuzz/fuzz_decoder.cpp instead: three bytes
+# per frame, the value MSB first, then 0 or 0x80 | (bits - 1) for a cut frame.
+import argparse
+import random
+import sys
+
+CUE = 0x0100
+LED = 0x4000
+
+DIGIT_POS = (0x0040, 0x0020, 0x0800, 0x0004)
+
+SEG_A, SEG_B, SEG_C, SEG_D = 0x2000, 0x1000, 0x0200, 0x0400
+SEG_E, SEG_F, SEG_G = 0x0080, 0x0008, 0x0010
+
+SEGMENTS = {
+    ' ': 0,
+    '0': SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F,
+    '1': SEG_B | SEG_C,
+    '2': SEG_A | SEG_B | SEG_G | SEG_E | SEG_D,
+    '3': SEG_A | SEG_B | SEG_C | SEG_D | SEG_G,
+    '4': SEG_F | SEG_G | SEG_B | SEG_C,
+    '5': SEG_A | SEG_F | SEG_G | SEG_C | SEG_D,
+    '6': SEG_A | SEG_F | SEG_E | SEG_D | SEG_C | SEG_G,
+    '7': SEG_A | SEG_B | SEG_C,
+    '8': SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,
+    '9': SEG_A | SEG_B | SEG_C | SEG_D | SEG_F | SEG_G,
+    'C': SEG_A | SEG_F | SEG_E | SEG_D,
+    'D': SEG_B | SEG_C | SEG_D | SEG_E | SEG_G,
+    'E': SEG_A | SEG_F | SEG_E | SEG_D | SEG_G,
+    'F': SEG_E | SEG_F | SEG_A | SEG_G,
+    'H': SEG_B | SEG_C | SEG_E | SEG_F | SEG_G,
+    'N': SEG_A | SEG_B | SEG_C | SEG_E | SEG_F,
+}
+
+LEDS = {
+    'power': 0x0001,
+    'heater': 0x0080,
+    'standby': 0x0200,
+    'bubble': 0x0400,
+    'filter': 0x1000,
+}
+NO_BEEP = 0x0100
+
+# Filter, bubble, temp down, power, temp up, temp unit, heater
+BUTTONS = (0x0002, 0x0008, 0x0080, 0x0400, 0x1000, 0x2000, 0x8000)
+
+DISPLAY_GROUPS = 5
+LED_FRAMES = 4
+
+
+def display_text(args: argparse.Namespace) -> str:
+    if args.error:
+        return f'{args.error:<4}'[:4]
+    # Three digits and the unit, as the decoder reads them
+    return f'{args.water:03d}{args.unit}'
+
+
+def cycle(text: str, led: int) -> list:
+    digits = [DIGIT_POS[i] | SEGMENTS[c] for i, c in enumerate(text)]
+    return [CUE] + digits * DISPLAY_GROUPS + [LED | led] * LED_FRAMES + list(BUTTONS)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description='Synthesize a display bus capture for ReplayBusBackend')
+    parser.add_argument('--cycles', type=int, default=500, help='21 ms display cycles (default 500)')
+    parser.add_argument('--water', type=int, default=36, help='water temperature shown')
+    parser.add_argument('--unit', choices=('C', 'F'), default='C')
+    parser.add_argument('--leds', default='power,filter,heater', help='comma separated: ' + ','.join(LEDS))
+    parser.add_argument('--error', help='error code shown instead of the temperature, e.g. E90')
+    parser.add_argument('--cut-rate', type=float, default=0.0, help='share of frames cut short')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--fuzz', action='store_true', help='binary fuzz_decoder seed instead of text')
+    parser.add_argument('output', nargs='?')
+    args = parser.parse_args()
+
+    text = display_text(args)
+    if any(c not in SEGMENTS for c in text):
+        parser.error(f'cannot show "{text}" on the display')
+    led = NO_BEEP
+    for name in filter(None, args.leds.split(',')):
+        if name not in LEDS:
+            parser.error(f'unknown LED "{name}"')
+        led |= LEDS[name]
+
+    rng = random.Random(args.seed)
+    frames = cycle(text, led)
+    if args.fuzz:
+        seed = bytearray()
+        for _ in range(args.cycles):
+            for frame in frames:
+                bits = rng.randint(1, 14) if args.cut_rate and rng.random() < args.cut_rate else 16
+                seed += bytes((frame >> 8, frame & 0xFF, 0 if bits == 16 else 0x80 | (bits - 1)))
+        out = open(args.output, 'wb') if args.output else sys.stdout.buffer
+        out.write(seed)
+        if out is not sys.stdout.buffer:
+            out.close()
+        return 0
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    out.write(f'# {args.cycles} cycles, display "{text}", LED {led:04x}\n')
+    for _ in range(args.cycles):
+        tokens = []
+        for frame in frames:
+            if args.cut_rate and rng.random() < args.cut_rate:
+                tokens.append(f'{frame:04x}/{rng.randint(1, 14)}')
+            else:
+                tokens.append(f'{frame:04x}')
+        out.write(' '.join(tokens) + '\n')
+    if out is not sys.stdout:
+        out.close()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
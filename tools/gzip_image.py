@@ -0,0 +1,22 @@
+#!/usr/bin/env python
+#
+# Compresses a firmware image for /api/admin/ota. The device inflates the
+# stream with the ROM inflater (32 KB window), so plain gzip level 9 is fine.
+import gzip
+import sys
+
+
+def main() -> None:
+    if len(sys.argv) != 3:
+        sys.exit('usage: gzip_image.py <image.bin> <image.bin.gz>')
+    with open(sys.argv[1], 'rb') as f:
+        image = f.read()
+    # mtime=0 keeps the output reproducible for identical images
+    compressed = gzip.compress(image, compresslevel=9, mtime=0)
+    with open(sys.argv[2], 'wb') as f:
+        f.write(compressed)
+    print(f'{sys.argv[2]}: {len(image)} -> {len(compressed)} bytes ({100 * len(compressed) // max(len(image), 1)}%)')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,160 @@
+#!/usr/bin/env python
+#
+# Builds delta patches for /api/admin/ota. A patch turns the firmware that is
+# currently running on the device into a new build, so only the difference has
+# to be uploaded:
+#
+#   ota_delta.py diff  <old.bin> <new.bin> <patch.delta>
+#   ota_delta.py apply <old.bin> <patch.delta> <out.bin>
+#
+# The format is bsdiff style (see main/delta_patcher.h): a fixed header with
+# both sizes and sha256 digests, then a gzip stream of records. Each record
+# adds "diff" bytes to the old image (mostly zeros when code only moved),
+# copies "extra" bytes that have no counterpart, then seeks in the old image.
+# The device applies it while streaming, so records only ever read old data
+# and never reference the output.
+import gzip
+import hashlib
+import struct
+import sys
+
+MAGIC = b'PSDL'
+VERSION = 1
+HEADER = struct.Struct('<4sB3xI32sI32s')
+RECORD = struct.Struct('<IIi')
+
+KEY_LEN = 12        # bytes hashed to find match candidates
+KEY_STEP = 4        # old image offsets indexed (matches are extended backwards)
+MAX_CANDIDATES = 16
+MIN_MATCH = 32
+
+
+def build_index(old: bytes) -> dict:
+    index = {}
+    for pos in range(0, len(old) - KEY_LEN + 1, KEY_STEP):
+        bucket = index.setdefault(old[pos:pos + KEY_LEN], [])
+        if len(bucket) < MAX_CANDIDATES:
+            bucket.append(pos)
+    return index
+
+
+def match_length(a: bytes, ai: int, b: bytes, bi: int) -> int:
+    n = 0
+    limit = min(len(a) - ai, len(b) - bi)
+    while n < limit and a[ai + n] == b[bi + n]:
+        n += 1
+    return n
+
+
+def find_matches(old: bytes, new: bytes) -> list:
+    """Exact matches (new_pos, old_pos, length), ascending and non-overlapping in new."""
+    index = build_index(old)
+    matches = []
+    last_end = 0
+    pos = 0
+    while pos + KEY_LEN <= len(new):
+        best_len = 0
+        best_old = 0
+        for candidate in index.get(new[pos:pos + KEY_LEN], ()):
+            length = match_length(old, candidate, new, pos)
+            if length > best_len:
+                best_len, best_old = length, candidate
+        if best_len < MIN_MATCH:
+            pos += 1
+            continue
+        # Extend backwards over bytes the aligned index could not see
+        start, old_start = pos, best_old
+        while start > last_end and old_start > 0 and new[start - 1] == old[old_start - 1]:
+            start -= 1
+            old_start -= 1
+        matches.append((start, old_start, pos + best_len - start))
+        last_end = pos + best_len
+        pos = last_end
+    return matches
+
+
+def approximate_length(old: bytes, old_pos: int, new: bytes, new_pos: int, limit: int) -> int:
+    """Extends a match through mismatches while at least half the bytes still agree."""
+    limit = min(limit, len(old) - old_pos)
+    best = score = best_score = 0
+    for i in range(limit):
+        if old[old_pos + i] == new[new_pos + i]:
+            score += 1
+        if score * 2 - (i + 1) > best_score * 2 - best:
+            best, best_score = i + 1, score
+    return best
+
+
+def diff(old: bytes, new: bytes) -> bytes:
+    matches = find_matches(old, new)
+    records = bytearray()
+
+    # Leading literal data, then one record per match; the match covers the
+    # diff part and the gap up to the next match becomes extra data.
+    first_new, first_old = (matches[0][0], matches[0][1]) if matches else (len(new), 0)
+    records += RECORD.pack(0, first_new, first_old)
+    records += new[:first_new]
+
+    for i, (new_pos, old_pos, length) in enumerate(matches):
+        next_new, next_old = (matches[i + 1][0], matches[i + 1][1]) if i + 1 < len(matches) else (len(new), old_pos)
+        gap = next_new - (new_pos + length)
+        length += approximate_length(old, old_pos + length, new, new_pos + length, gap)
+        extra = next_new - (new_pos + length)
+        seek = next_old - (old_pos + length) if i + 1 < len(matches) else 0
+        records += RECORD.pack(length, extra, seek)
+        records += bytes((new[new_pos + k] - old[old_pos + k]) & 0xFF for k in range(length))
+        records += new[new_pos + length:next_new]
+
+    header = HEADER.pack(MAGIC, VERSION, len(old), hashlib.sha256(old).digest(),
+                         len(new), hashlib.sha256(new).digest())
+    return header + gzip.compress(bytes(records), compresslevel=9, mtime=0)
+
+
+def apply(old: bytes, patch: bytes) -> bytes:
+    magic, version, old_size, old_sha, new_size, new_sha = HEADER.unpack_from(patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('not a delta patch')
+    if old_size != len(old) or hashlib.sha256(old).digest() != old_sha:
+        raise ValueError('patch was made for a different base image')
+    records = gzip.decompress(patch[HEADER.size:])
+    out = bytearray()
+    pos = old_pos = 0
+    while pos < len(records):
+        diff_len, extra_len, seek = RECORD.unpack_from(records, pos)
+        pos += RECORD.size
+        out += bytes((old[old_pos + k] + records[pos + k]) & 0xFF for k in range(diff_len))
+        pos += diff_len
+        old_pos += diff_len
+        out += records[pos:pos + extra_len]
+        pos += extra_len
+        old_pos += seek
+    if len(out) != new_size or hashlib.sha256(out).digest() != new_sha:
+        raise ValueError('patched image does not match')
+    return bytes(out)
+
+
+def main() -> None:
+    if len(sys.argv) != 5 or sys.argv[1] not in ('diff', 'apply'):
+        sys.exit('usage: ota_delta.py diff <old.bin> <new.bin> <patch.delta>\n'
+                 '       ota_delta.py apply <old.bin> <patch.delta> <out.bin>')
+    with open(sys.argv[2], 'rb') as f:
+        old = f.read()
+    with open(sys.argv[3], 'rb') as f:
+        data = f.read()
+
+    if sys.argv[1] == 'diff':
+        patch = diff(old, data)
+        # Never ship a patch that does not reproduce the new image
+        apply(old, patch)
+        with open(sys.argv[4], 'wb') as f:
+            f.write(patch)
+        print(f'{sys.argv[4]}: {len(data)} -> {len(patch)} bytes ({100 * len(patch) // max(len(data), 1)}%)')
+    else:
+        out = apply(old, data)
+        with open(sys.argv[4], 'wb') as f:
+            f.write(out)
+        print(f'{sys.argv[4]}: {len(out)} bytes')
+
+
+if __name__ == '__main__':
+    main()